@@ -0,0 +1,45 @@
+#include "AstArena.h"
+
+namespace dsc
+{
+	static const uint32 BLOCK_SIZE = 16384;
+	static const uint32 ALIGNMENT = 8;
+
+	//--------------------------------------------------------------------------------
+	AstArena::AstArena()
+	: m_blockUsed(BLOCK_SIZE)
+	{
+	}
+
+	//--------------------------------------------------------------------------------
+	AstArena::~AstArena()
+	{
+		for (uint32 i=0; i<m_blocks.size(); ++i)
+			delete[] m_blocks[i];
+	}
+
+	//--------------------------------------------------------------------------------
+	void* AstArena::Allocate(uint32 size)
+	{
+		size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+		if (size > BLOCK_SIZE / 4)
+		{
+			//big allocations get a block of their own.  the last block stays the one being filled.
+			char* pBlock = new char[size];
+			m_blocks.insert(m_blocks.begin(), pBlock);
+			return pBlock;
+		}
+
+		if (m_blockUsed + size > BLOCK_SIZE)
+		{
+			m_blocks.push_back(new char[BLOCK_SIZE]);
+			m_blockUsed = 0;
+		}
+
+		void* p = m_blocks.back() + m_blockUsed;
+		m_blockUsed += size;
+
+		return p;
+	}
+}
@@ -0,0 +1,91 @@
+#if !defined(DSC_ASTARENA_H_)
+#define DSC_ASTARENA_H_
+
+#include <new>
+#include <vector>
+#include <cassert>
+#include "ClassUtils.h"
+#include "BaseTypes.h"
+
+namespace dsc
+{
+	//-------------------------------------------------------------------------------------
+	/// Bump allocator for the syntax tree of one script.
+	/// Memory is only released when the arena is destroyed, and destructors of the
+	/// objects placed in it are never run, so nodes must not own anything.
+	class AstArena
+	{
+		DSC_NOCOPY(AstArena)
+	public:
+		AstArena();
+		~AstArena();
+
+		void* Allocate(uint32 size);
+		uint32 GetNumBlocks() const { return (uint32) m_blocks.size(); }
+
+	private:
+		std::vector<char*> m_blocks;
+		uint32 m_blockUsed;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Fixed size array living in an AstArena.
+	template <class T>
+	class AstArray
+	{
+	public:
+		AstArray() : m_data(0), m_size(0) {}
+
+		uint32 GetSize() const { return m_size; }
+		bool IsEmpty() const { return m_size == 0; }
+		const T& operator[](uint32 idx) const { assert(idx < m_size); return m_data[idx]; }
+
+		static AstArray<T> Copy(AstArena& arena, const T* pSrc, uint32 size)
+		{
+			AstArray<T> res;
+			if (size > 0)
+			{
+				T* pData = (T*) arena.Allocate(size * sizeof(T));
+				for (uint32 i=0; i<size; ++i)
+					new (pData + i) T(pSrc[i]);
+
+				res.m_data = pData;
+				res.m_size = size;
+			}
+
+			return res;
+		}
+
+		/// copies the elements [first, stack.end()) into the arena and pops them off the stack
+		static AstArray<T> Pop(AstArena& arena, std::vector<T>& stack, uint32 first)
+		{
+			assert(first <= stack.size());
+			if (first == stack.size())
+				return AstArray<T>();
+
+			AstArray<T> res = Copy(arena, &stack[first], (uint32) stack.size() - first);
+			stack.erase(stack.begin() + first, stack.end());
+
+			return res;
+		}
+
+	private:
+		const T* m_data;
+		uint32 m_size;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Base of everything allocated in an AstArena: new (arena) StWhile(...)
+	class AstNode
+	{
+	public:
+		static void* operator new(size_t size, AstArena& arena) { return arena.Allocate((uint32) size); }
+		static void operator delete(void*, AstArena&) {}
+
+	private:
+		static void* operator new(size_t size);
+		static void operator delete(void* p);
+	};
+}
+
+#endif
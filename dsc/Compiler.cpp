@@ -1,5 +1,5 @@
-#include <stdarg.h>
 #include <algorithm>
+#include <set>
 #include "File.h"
 #include "StringUtils.h"
 #include "Parser.h"
@@ -39,18 +39,6 @@ namespace dsc
 		m_pInstance = 0;
 	}
 
-	static const char* FORMAT(const char *fmt, ...)
-	{
-		static char str[1024];
-
-		va_list ap;
-		va_start(ap, fmt);
-		_vsnprintf(str, 1024, fmt, ap);
-		va_end(ap);
-
-		return str;
-	}
-
 	std::string VMDataTypeToString(uint32 dataType)
 	{
 		std::string ret;
@@ -109,6 +97,49 @@ namespace dsc
 		return (code >> 24);
 	}
 
+	/// tail call variant of a call instruction, VMI_INVALID if there is none
+	dsr::VMInstruction GetTailCall(dsr::VMInstruction inst)
+	{
+		switch (inst)
+		{
+		case dsr::VMI_CALLF_SELF_G:
+			return dsr::VMI_TAILCALLF_SELF_G;
+		case dsr::VMI_CALLF_SUPER_G:
+			return dsr::VMI_TAILCALLF_SUPER_G;
+		case dsr::VMI_CALLF_SELF_D:
+			return dsr::VMI_TAILCALLF_SELF_D;
+		}
+
+		return dsr::VMI_INVALID;
+	}
+
+	/// Turns calls whose result is returned right away into tail calls, which the VM runs
+	/// in place of the calling function.  The VMI_RET stays, for jumps to it.
+	void MarkTailCalls(FunctionImplementation* pFuncImpl)
+	{
+		FunctionImplementation::VMCodeBlock code = pFuncImpl->GetVMCodeBlock();
+		bool changed = false;
+		for (uint32 pc=0; pc<code.size(); ++pc)
+		{
+			const dsr::VMInstruction inst = ExtractVMInstruction(code[pc]);
+			if (!HasDataWord(inst))
+				continue;
+
+			const dsr::VMInstruction tailInst = GetTailCall(inst);
+			if (tailInst != dsr::VMI_INVALID && pc + 2 < code.size() && ExtractVMInstruction(code[pc + 2]) == dsr::VMI_RET)
+			{
+				code[pc] = BuildCode(tailInst);
+				changed = true;
+			}
+
+			//skip the data word
+			++pc;
+		}
+
+		if (changed)
+			pFuncImpl->SetVMCodeBlock(code);
+	}
+
 	uint32 GetDataType(const std::string& typeName)
 	{
 		if (strcmp(typeName.c_str(), "float") == 0)
@@ -197,30 +228,311 @@ namespace dsc
 		return fileName;
 	}
 
+	DataDeclarationCPtr BuildDataDeclaration(const FunctionParameterSrc& source)
+	{
+		DataDeclarationCPtr dataDecl = new DataDeclaration();
+		dataDecl->SetLine(source.GetLine());
+		dataDecl->SetName(source.GetName());
+		dataDecl->SetSymbol(source.GetSymbol());
+		dataDecl->SetType(GetDataType(source.GetType()));
+		if (dataDecl->GetType() == dsr::VMDATATYPE_NATIVE)
+			dataDecl->SetNativeType(source.GetType());
+		else
+			dataDecl->SetNativeType("");
+		return dataDecl;
+	}
+
+	DataDeclarationCPtr BuildDataDeclaration(const DataSrc& source)
+	{
+		DataDeclarationCPtr dataDecl = new DataDeclaration();
+		dataDecl->SetLine(source.GetLine());
+		dataDecl->SetName(source.GetName());
+		dataDecl->SetSymbol(source.GetSymbol());
+		dataDecl->SetType(GetDataType(source.GetType()));
+		if (dataDecl->GetType() == dsr::VMDATATYPE_NATIVE)
+			dataDecl->SetNativeType(source.GetType());
+		else
+			dataDecl->SetNativeType("");
+		return dataDecl;
+	}
+
+	//----------------------------------------------------------------------
+	class FunctionCompileTask : public ThreadTask
+	{
+	public:
+		FunctionCompileTask() : m_pDeclaration(0), m_pSource(0), m_funcIdx(-1), m_ctorIdx(-1), m_bindCalls(false), m_failed(false) {}
+
+		void Set(const ScriptClassDeclaration* pDeclaration, const FunctionSrc* pSource, uint32 funcIdx, uint32 ctorIdx, bool bindCalls)
+		{
+			m_pDeclaration = pDeclaration;
+			m_pSource = pSource;
+			m_funcIdx = funcIdx;
+			m_ctorIdx = ctorIdx;
+			m_bindCalls = bindCalls;
+		}
+
+		virtual void Execute()
+		{
+			try
+			{
+				FunctionCompiler compiler(m_pDeclaration, m_funcIdx, m_ctorIdx, m_bindCalls);
+				m_result = compiler.BuildFunctionImplementation(*m_pSource);
+				m_callSites = compiler.GetCallSites();
+			}
+			catch (const CompilerException& e)
+			{
+				m_failed = true;
+				m_error = e.GetError();
+			}
+			catch (...)
+			{
+				m_failed = true;
+				m_error = FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__);
+			}
+		}
+
+		bool HasFailed() const { return m_failed; }
+		const char* GetError() const { return m_error.c_str(); }
+		FunctionImplementation* GetResult() const { return m_result; }
+		const ScriptClassDeclaration* GetDeclarationPtr() const { return m_pDeclaration; }
+		const FunctionSrc* GetSourcePtr() const { return m_pSource; }
+		uint32 GetFunctionIndex() const { return m_funcIdx; }
+		uint32 GetConstructorIndex() const { return m_ctorIdx; }
+		const IRCallSiteArray& GetCallSites() const { return m_callSites; }
+
+	private:
+		const ScriptClassDeclaration* m_pDeclaration;
+		const FunctionSrc* m_pSource;
+		uint32 m_funcIdx;
+		uint32 m_ctorIdx;
+		bool m_bindCalls;
+		FunctionImplementationCPtr m_result;
+		IRCallSiteArray m_callSites;
+		bool m_failed;
+		std::string m_error;
+	};
+
+	//----------------------------------------------------------------------
+	/// Calls the inliner can follow: the ones the function compiler bound to an
+	/// implementation, and super calls.
+	class Compiler::CallResolver : public IRCallResolver
+	{
+	public:
+		void AddClass(const ScriptClassDeclaration* pDecl, const ScriptClassDeclaration* pSuper) { m_supers[pDecl] = pSuper; m_classes[pDecl->GetName()] = pDecl; }
+		/// the source of pDecl defines the function.  pCallee is 0 if its code isn't known.
+		void AddFunction(const ScriptClassDeclaration* pDecl, uint32 funcIdx, const IRCallee* pCallee) { Add(m_funcs, pDecl, funcIdx, pCallee); }
+		void AddConstructor(const ScriptClassDeclaration* pDecl, uint32 ctorIdx, const IRCallee* pCallee) { Add(m_ctors, pDecl, ctorIdx, pCallee); }
+
+		virtual const IRCallee* GetCallee(const IRFunction& func, const IRInstruction& call) const
+		{
+			const ScriptClassDeclaration* pDecl = func.GetScriptClassDeclarationPtr();
+			switch (call.GetOpcode())
+			{
+			case dsr::VMI_CALLF_SELF_D:
+				{
+					const DirectCall& target = func.GetDirectCall(call.GetValue());
+					std::map<std::string, const ScriptClassDeclaration*>::const_iterator it = m_classes.find(target.GetClassName());
+					return it != m_classes.end() ? FindFunction(it->second, target.GetFunctionIndex()) : 0;
+				}
+
+			case dsr::VMI_CALLF_SUPER_G:
+				return FindFunction(GetSuperPtr(pDecl), call.GetValue());
+
+			case dsr::VMI_CALLC_SELF_SUPER:
+				{
+					CalleeMap::const_iterator it = m_ctors.find(Key(GetSuperPtr(pDecl), call.GetValue()));
+					return it != m_ctors.end() ? it->second : 0;
+				}
+			}
+
+			return 0;
+		}
+
+	private:
+		typedef std::pair<const ScriptClassDeclaration*, uint32> Key;
+		typedef std::map<Key, const IRCallee*> CalleeMap;
+
+		void Add(CalleeMap& callees, const ScriptClassDeclaration* pDecl, uint32 idx, const IRCallee* pCallee)
+		{
+			if (pCallee)
+			{
+				m_callees.push_back(*pCallee);
+				pCallee = &m_callees.back();
+			}
+			callees.insert(std::make_pair(Key(pDecl, idx), pCallee));
+		}
+
+		const ScriptClassDeclaration* GetSuperPtr(const ScriptClassDeclaration* pDecl) const
+		{
+			std::map<const ScriptClassDeclaration*, const ScriptClassDeclaration*>::const_iterator it = m_supers.find(pDecl);
+			return it != m_supers.end() ? it->second : 0;
+		}
+
+		/// the closest definition, starting at pDecl
+		const IRCallee* FindFunction(const ScriptClassDeclaration* pDecl, uint32 funcIdx) const
+		{
+			while (pDecl)
+			{
+				CalleeMap::const_iterator it = m_funcs.find(Key(pDecl, funcIdx));
+				if (it != m_funcs.end())
+					return it->second;
+				pDecl = GetSuperPtr(pDecl);
+			}
+			return 0;
+		}
+
+	private:
+		std::list<IRCallee> m_callees;
+		CalleeMap m_funcs;
+		CalleeMap m_ctors;
+		std::map<const ScriptClassDeclaration*, const ScriptClassDeclaration*> m_supers;
+		std::map<std::string, const ScriptClassDeclaration*> m_classes;
+	};
+
+	//----------------------------------------------------------------------
+	/// Optimizes a compiled function into a new implementation.
+	/// The compiled one stays as it is, other functions may inline it at the same time.
+	class FunctionOptimizeTask : public ThreadTask
+	{
+	public:
+		FunctionOptimizeTask() : m_pSource(0), m_pResolver(0), m_failed(false) {}
+
+		void Set(const FunctionCompileTask* pSource, const IRCallResolver* pResolver, const InlineLimits& limits)
+		{
+			m_pSource = pSource;
+			m_pResolver = pResolver;
+			m_limits = limits;
+		}
+
+		virtual void Execute()
+		{
+			try
+			{
+				const FunctionImplementation* pCompiled = m_pSource->GetResult();
+				FunctionImplementationCPtr funcImpl = new FunctionImplementation();
+				for (uint32 i=0; i<pCompiled->GetNumLocals(); ++i)
+					funcImpl->AddLocalDataDeclaration((DataDeclaration*) pCompiled->GetLocalDataDeclarationPtr(i));
+				for (uint32 i=0; i<pCompiled->GetNumNewClassNames(); ++i)
+					funcImpl->AddNewClassName(pCompiled->GetNewClassName(i));
+				for (uint32 i=0; i<pCompiled->GetNumDirectCalls(); ++i)
+					funcImpl->AddDirectCall(pCompiled->GetDirectCall(i));
+
+				PassManager passManager;
+				if (m_limits.GetMaxDepth() > 0)
+					passManager.AddPass(new InliningPass(*m_pResolver, m_limits));
+				passManager.AddDefaultPasses();
+
+				VMCodeBlock code = pCompiled->GetVMCodeBlock();
+				uint32 maxStackSize = pCompiled->GetMaxStackSize();
+				const ScriptClassDeclaration* pDeclaration = m_pSource->GetDeclarationPtr();
+				const FunctionDeclaration* pFuncDecl = GetFunctionDeclarationPtr(pDeclaration, m_pSource->GetFunctionIndex(), m_pSource->GetConstructorIndex());
+				passManager.Optimize(*funcImpl, code, maxStackSize, *pFuncDecl, *pDeclaration, m_pSource->GetCallSites());
+
+				funcImpl->SetVMCodeBlock(code);
+				funcImpl->SetMaxStackSize(maxStackSize);
+				m_result = funcImpl;
+				m_stats = passManager.GetStats();
+			}
+			catch (...)
+			{
+				m_failed = true;
+				m_error = FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__);
+			}
+		}
+
+		bool HasFailed() const { return m_failed; }
+		const char* GetError() const { return m_error.c_str(); }
+		FunctionImplementation* GetResult() const { return m_result; }
+		const OptimizerStats& GetStats() const { return m_stats; }
+
+	private:
+		typedef std::vector<dsr::VMBytecode> VMCodeBlock;
+
+		const FunctionCompileTask* m_pSource;
+		const IRCallResolver* m_pResolver;
+		InlineLimits m_limits;
+		FunctionImplementationCPtr m_result;
+		OptimizerStats m_stats;
+		bool m_failed;
+		std::string m_error;
+	};
+
+	//----------------------------------------------------------------------
+	class Compiler::ScriptLoadTask : public ThreadTask
+	{
+	public:
+		explicit ScriptLoadTask(const char* name) : m_name(name), m_failed(false) {}
+
+		virtual void Execute()
+		{
+			try
+			{
+				m_result = CompilerPtr()->LoadScriptSource(m_name.c_str());
+			}
+			catch (const CompilerException& e)
+			{
+				m_failed = true;
+				m_error = e.GetError();
+				return;
+			}
+			catch (...)
+			{
+				m_failed = true;
+				m_error = FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__);
+				return;
+			}
+
+			for (uint32 i=0; i<m_result->GetNumImportClasses(); ++i)
+				CompilerPtr()->ScheduleScriptSource(m_result->GetImportClass(i));
+		}
+
+		bool HasFailed() const { return m_failed; }
+		const char* GetError() const { return m_error.c_str(); }
+		ScriptSource* GetResult() const { return m_result; }
+
+	private:
+		std::string m_name;
+		ScriptSourceCPtr m_result;
+		bool m_failed;
+		std::string m_error;
+	};
+
 	//----------------------------------------------------------------------
 	Compiler::Compiler()
+	: m_pSymbols(0), m_pThreadPool(0), m_optimize(true)
 	{
 		Clear();
+		SetNumThreads(0);
 	}
 
 	Compiler::~Compiler()
 	{
 		Clear();
+		ClearLoadTasks();
+		delete m_pSymbols;
+		delete m_pThreadPool;
 	}
 
 	void Compiler::Clear()
 	{
-		m_curStackSize = 0;
-		m_maxStackSize = 0;
-		m_curCode.clear();
 		m_error = "";
-		m_pDeclaration = 0;
-		m_curFuncIdx = -1;
-		m_curCtorIdx = -1;
 		m_declarationList.clear();
 		m_sources.clear();
-		m_pCurFuncImpl = 0;
+		delete m_pSymbols;
+		m_pSymbols = new SymbolTable();
 		m_curCompilePass = COMPILEPASS_UNDEF;
+		m_optimizerStats.Clear();
+	}
+
+	void Compiler::SetNumThreads(uint32 numThreads)
+	{
+		delete m_pThreadPool;
+		m_pThreadPool = new ThreadPool(numThreads);
+	}
+
+	uint32 Compiler::GetNumThreads() const
+	{
+		return m_pThreadPool->GetNumThreads();
 	}
 
 	ScriptClassDeclarationCPtr Compiler::BuildScriptClassDeclarationPass1(const ScriptSource& scriptSource) const
@@ -235,12 +547,17 @@ namespace dsc
 
 		//set name
 		curDeclaration->SetName(scriptSource.GetName());
+		curDeclaration->SetSymbol(scriptSource.GetNameSymbol());
 
 		//set native
 		curDeclaration->SetNative(scriptSource.IsNative());
 
+		//set final
+		curDeclaration->SetFinal(scriptSource.IsFinal());
+
 		//set super
 		curDeclaration->SetSuperClassName(scriptSource.GetSuper());
+		curDeclaration->SetSuperClassSymbol(scriptSource.GetSuperSymbol());
 
 		//set data
 		for (uint32 i=0; i<scriptSource.GetNumData(); ++i)
@@ -276,29 +593,152 @@ namespace dsc
 		return curDeclaration;
 	}
 
-	void Compiler::ClearCurCode()
+	//----------------------------------------------------------------------
+	FunctionCompiler::FunctionCompiler(const ScriptClassDeclaration* pDeclaration, uint32 funcIdx, uint32 ctorIdx, bool bindCalls)
+	: m_curStackSize(0), m_maxStackSize(0), m_pDeclaration(pDeclaration), m_pCurFuncImpl(0), m_curFuncIdx(funcIdx), m_curCtorIdx(ctorIdx), m_unreachable(false), m_bindCalls(bindCalls)
+	{
+		assert(m_pDeclaration);
+	}
+
+	uint32 FunctionCompiler::GetDirectCallIndex(const ScriptClassDeclaration* pReceiver, uint32 fnIdx)
+	{
+		//final functions and classes can't be overridden, the others only if the analysis found no override
+		const bool bound = pReceiver->GetFunctionDeclarationPtr(fnIdx)->IsFinal() || pReceiver->IsFinal()
+			|| (m_bindCalls && !pReceiver->IsFunctionOverridden(fnIdx));
+		if (!bound)
+			return -1;
+
+		//the code that runs is the closest definition
+		const ScriptClassDeclaration* pDefining = pReceiver;
+		while (!pDefining->DefinesFunction(fnIdx))
+			pDefining = GetScriptClassDeclarationPtr(pDefining->GetSuperClassName());
+
+		return m_pCurFuncImpl->AddDirectCall(DirectCall(pDefining->GetName(), fnIdx));
+	}
+
+	const ScriptClassDeclaration* FunctionCompiler::GetScriptClassDeclarationPtr(const char* className) const
+	{
+		return CompilerPtr()->GetScriptClassDeclarationPtr(className);
+	}
+
+	bool FunctionCompiler::IsA(const char* derived, const char* base) const
+	{
+		return CompilerPtr()->IsA(derived, base);
+	}
+
+	void FunctionCompiler::ClearCurCode()
 	{
 		m_curCode.clear();
 		m_curStackSize = 0;
 		m_maxStackSize = 0;
+		m_unreachable = false;
+		m_callSites.clear();
+	}
+
+	void FunctionCompiler::TruncateCode(uint32 codePos)
+	{
+		m_curCode.resize(codePos);
+		while (!m_callSites.empty() && m_callSites.back().GetCodePos() >= codePos)
+			m_callSites.pop_back();
+	}
+
+	void FunctionCompiler::RelocateCode(uint32 codePos, uint32 oldCodePos, int32 delta)
+	{
+		//jumps out of an expression only go forward to its end, so only the code
+		//after codePos can refer to the moved part
+		for (uint32 pc=codePos; pc<m_curCode.size(); ++pc)
+		{
+			const dsr::VMInstruction inst = ExtractVMInstruction(m_curCode[pc]);
+			if ((inst == dsr::VMI_JZ || inst == dsr::VMI_JMP) && ExtractUnsignedValue(m_curCode[pc]) > oldCodePos)
+				m_curCode[pc] = BuildCode(inst, ExtractUnsignedValue(m_curCode[pc]) + delta);
+			else if (HasDataWord(inst))
+				++pc;
+		}
+
+		for (uint32 i=(uint32) m_callSites.size(); i-->0 && m_callSites[i].GetCodePos() >= oldCodePos; )
+		{
+			const IRCallSite& cs = m_callSites[i];
+			m_callSites[i] = IRCallSite(cs.GetCodePos() + delta, cs.GetNumArgs(), cs.GetReturnType(), cs.GetNativeReturnType());
+		}
+	}
+
+	void FunctionCompiler::InsertCode(uint32 codePos, const VMCodeBlock& code)
+	{
+		m_curCode.insert(m_curCode.begin() + codePos, code.begin(), code.end());
+		RelocateCode(codePos + (uint32) code.size(), codePos, (int32) code.size());
+	}
+
+	void FunctionCompiler::EraseCode(uint32 codePos, uint32 size)
+	{
+		//no jump or call may be in the erased part
+		m_curCode.erase(m_curCode.begin() + codePos, m_curCode.begin() + codePos + size);
+		RelocateCode(codePos, codePos, -(int32) size);
+	}
+
+	void FunctionCompiler::VisitDeadStatement(const StatementSrc& statement)
+	{
+		//still compiled so that errors get reported, but the code is thrown away.  the
+		//statement's loops and ifs don't make the code after it reachable.
+		const uint32 deadPos = (uint32) m_curCode.size();
+		const bool unreachable = m_unreachable;
+		statement.Visit(*this);
+		TruncateCode(deadPos);
+		m_unreachable = unreachable;
+	}
+
+	bool FunctionCompiler::IsConstantCondition(uint32 codePos, bool& value) const
+	{
+		//a folded condition is a single push
+		if (m_curCode.size() != codePos + 1 || ExtractVMInstruction(m_curCode[codePos]) != dsr::VMI_PUSHB)
+			return false;
+
+		value = ExtractUnsignedValue(m_curCode[codePos]) != 0;
+		return true;
 	}
 
-	void Compiler::VisitBlock(const StBlock& stBlock)
+	void FunctionCompiler::VisitBlock(const StBlock& stBlock)
 	{
 		for (uint32 i=0; i<stBlock.GetNumStatements(); ++i)
 		{
 			const StatementSrc* statement = stBlock.GetStatementSrcPtr(i);
-			statement->Visit(*this);
+			if (m_unreachable)
+				VisitDeadStatement(*statement);
+			else
+				statement->Visit(*this);
 		}
 	}
 
-	void Compiler::VisitWhile(const StWhile& stWhile)
+	void FunctionCompiler::VisitWhile(const StWhile& stWhile)
 	{
 		assert(m_curStackSize == 0);
 
 		const uint32 loopPos = (uint32) m_curCode.size();
 		VisitExpressionAndCheckRetTypes(*(stWhile.GetConditionExpressionSrcPtr()), dsr::VMDATATYPE_BOOL, 0);
 
+		bool condition;
+		if (IsConstantCondition(loopPos, condition))
+		{
+			TruncateCode(loopPos);
+			DecStackSize();
+
+			if (!condition)
+			{
+				//never entered
+				VisitDeadStatement(*(stWhile.GetStatementSrcPtr()));
+				m_unreachable = false;
+			}
+			else
+			{
+				//endless loop.  there is no break, so only a return gets out of it.
+				stWhile.GetStatementSrcPtr()->Visit(*this);
+				m_curCode.push_back(BuildCode(dsr::VMI_JMP, loopPos));
+				m_unreachable = true;
+			}
+
+			assert(m_curStackSize == 0);
+			return;
+		}
+
 		m_curCode.push_back(BuildCode(dsr::VMI_INVALID));	//jz to be added later
 		DecStackSize();
 		const uint32 jzPos = (uint32) (m_curCode.size() - 1);
@@ -314,25 +754,64 @@ namespace dsc
 		m_curCode[jzPos] = BuildCode(dsr::VMI_JZ, endOfLoopPos);
 		assert(endOfLoopPos == ExtractUnsignedValue(m_curCode[jzPos]));
 
+		//the loop can exit through the condition
+		m_unreachable = false;
+
 		assert(m_curStackSize == 0);
 	}
 
-	void Compiler::VisitIf(const StIf& stIf)
+	void FunctionCompiler::VisitIf(const StIf& stIf)
 	{
 		assert(m_curStackSize == 0);
 
+		const uint32 conditionPos = (uint32) m_curCode.size();
 		VisitExpressionAndCheckRetTypes(*(stIf.GetConditionExpressionSrcPtr()), dsr::VMDATATYPE_BOOL, 0);
 
+		bool condition;
+		if (IsConstantCondition(conditionPos, condition))
+		{
+			//only the branch that is taken gets emitted
+			TruncateCode(conditionPos);
+			DecStackSize();
+
+			const StatementSrc* pTaken = condition ? stIf.GetTrueStatementSrcPtr() : stIf.GetFalseStatementSrcPtr();
+			const StatementSrc* pNotTaken = condition ? stIf.GetFalseStatementSrcPtr() : stIf.GetTrueStatementSrcPtr();
+			if (pNotTaken)
+				VisitDeadStatement(*pNotTaken);
+
+			m_unreachable = false;
+			if (pTaken)
+				pTaken->Visit(*this);
+
+			assert(m_curStackSize == 0);
+			return;
+		}
+
 		m_curCode.push_back(BuildCode(dsr::VMI_INVALID));	//jz to be added later
 		DecStackSize();
 		uint32 jzPos = (uint32) (m_curCode.size() - 1);
 
 		stIf.GetTrueStatementSrcPtr()->Visit(*this);
+		const bool trueReturns = m_unreachable;
+		m_unreachable = false;
 
 		uint32 falsePos = (uint32) m_curCode.size();
 		if (stIf.GetFalseStatementSrcPtr())
 		{
+			//jump over the false statement
+			uint32 jmpPos = (uint32) -1;
+			if (!trueReturns)
+			{
+				m_curCode.push_back(BuildCode(dsr::VMI_INVALID));	//jmp to be added later
+				jmpPos = (uint32) (m_curCode.size() - 1);
+			}
+
+			falsePos = (uint32) m_curCode.size();
 			stIf.GetFalseStatementSrcPtr()->Visit(*this);
+			m_unreachable = m_unreachable && trueReturns;
+
+			if (jmpPos != (uint32) -1)
+				m_curCode[jmpPos] = BuildCode(dsr::VMI_JMP, (uint32) m_curCode.size());
 		}
 
 		//add missing jz (backpatching)
@@ -341,12 +820,12 @@ namespace dsc
 		assert(m_curStackSize == 0);
 	}
 
-	void Compiler::AssignToVariable(const VarInfo& varInfo)
+	void FunctionCompiler::AssignToVariable(const VarInfo& varInfo)
 	{
 		assert(m_pCurFuncImpl);
 
 		//assign result to a variable
-		if (varInfo.GetDataLoc() == Compiler::VarInfo::DATALOC_SCRIPT)
+		if (varInfo.GetDataLoc() == VarInfo::DATALOC_SCRIPT)
 		{
 			switch (varInfo.GetDataType())
 			{
@@ -373,7 +852,7 @@ namespace dsc
 
 			};
 		}
-		else if (varInfo.GetDataLoc() == Compiler::VarInfo::DATALOC_LOCAL)
+		else if (varInfo.GetDataLoc() == VarInfo::DATALOC_LOCAL)
 		{
 			switch (varInfo.GetDataType())
 			{
@@ -400,7 +879,7 @@ namespace dsc
 
 			};
 		}
-		else if (varInfo.GetDataLoc() == Compiler::VarInfo::DATALOC_PARAMETER)
+		else if (varInfo.GetDataLoc() == VarInfo::DATALOC_PARAMETER)
 		{
 			switch (varInfo.GetDataType())
 			{
@@ -430,13 +909,13 @@ namespace dsc
 		DecStackSize();
 	}
 
-	void Compiler::VisitAssign(const StAssign& stAssign)
+	void FunctionCompiler::VisitAssign(const StAssign& stAssign)
 	{
 		assert(m_curStackSize == 0);
 
 		//find variable
 		VarInfo varInfo;
-		GetVarInfo(stAssign.GetVariableName(), varInfo);
+		GetVarInfo(stAssign.GetVariableName(), stAssign.GetVariableSymbol(), varInfo);
 
 		//evaluate expression
 		VisitExpressionAndCheckRetTypes(*(stAssign.GetExpressionSrcPtr()), varInfo.GetDataType(), varInfo.GetDataNativeType());
@@ -446,7 +925,7 @@ namespace dsc
 		assert(m_curStackSize == 0);
 	}
 
-	void Compiler::VisitReturn(const StReturn& stReturn)
+	void FunctionCompiler::VisitReturn(const StReturn& stReturn)
 	{
 		assert(m_curStackSize == 0);
 
@@ -477,11 +956,12 @@ namespace dsc
 
 		m_curCode.push_back(BuildCode(dsr::VMI_RET));
 		DecStackSize();
+		m_unreachable = true;
 
 		assert(m_curStackSize == 0);
 	}
 
-	void Compiler::VisitFunctionCall(const StFunctionCall& fncCall)
+	void FunctionCompiler::VisitFunctionCall(const StFunctionCall& fncCall)
 	{
 		assert(m_curStackSize == 0);
 
@@ -499,7 +979,7 @@ namespace dsc
 		assert(m_curStackSize == 0);
 	}
 
-	void Compiler::VisitFunctionCall(const FunctionCallSrc& fncCallSrc, uint32& retValType, std::string& nativeRetType, const char* pushedType)
+	void FunctionCompiler::VisitFunctionCall(const FunctionCallSrc& fncCallSrc, uint32& retValType, std::string& nativeRetType, const char* pushedType)
 	{
 		//init return values
 		retValType = dsr::VMDATATYPE_MAX;
@@ -529,7 +1009,7 @@ namespace dsc
 				throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
 
 			VarInfo varInfo;
-			GetVarInfo(fncCallSrc.GetVarName(), varInfo);
+			GetVarInfo(fncCallSrc.GetVarName(), fncCallSrc.GetVarNameSymbol(), varInfo);
 
 			//check if variable is native
 			type = varInfo.GetDataNativeType();
@@ -576,7 +1056,7 @@ namespace dsc
 		}
 		else
 		{
-			fnIdx = pDeclaration->GetFunctionIndex(fncCallSrc.GetName());
+			fnIdx = pDeclaration->GetFunctionIndex(fncCallSrc.GetNameSymbol());
 			if (fnIdx == -1)
 			{
 				throw CompilerException(FORMAT("Unknown function \"%s\"called.  Class %s, line %u.",
@@ -671,22 +1151,43 @@ namespace dsc
 				{
 					uint32 tempType;
 					std::string tempNT;
-					Token tok(TOKEN_IDENTIFIER, fncCallSrc.GetVarName(), 0, 0);
+					Token tok(TOKEN_IDENTIFIER, fncCallSrc.GetVarNameSymbol(), fncCallSrc.GetVarName(), 0, 0);
 					ExprPushValue(tok, tempType, tempNT);
 				}
 
 				//call function on the native type that is on the stack
-				m_curCode.push_back(BuildCode(dsr::VMI_CALLF_PUSHED_G));
-				m_curCode.push_back(BuildData(fnIdx));
+				const uint32 directIdx = GetDirectCallIndex(pDeclaration, fnIdx);
+				if (directIdx != -1)
+				{
+					m_curCode.push_back(BuildCode(dsr::VMI_CALLF_PUSHED_D));
+					m_curCode.push_back(BuildData(directIdx));
+				}
+				else
+				{
+					m_curCode.push_back(BuildCode(dsr::VMI_CALLF_PUSHED_G));
+					m_curCode.push_back(BuildData(fnIdx));
+				}
 				DecStackSize();
 			}
 			else
 			{
 				assert(!fncCallSrc.IsNew());
-				m_curCode.push_back(BuildCode(dsr::VMI_CALLF_SELF_G));
-				m_curCode.push_back(BuildData(fnIdx));
+				const uint32 directIdx = GetDirectCallIndex(m_pDeclaration, fnIdx);
+				if (directIdx != -1)
+				{
+					m_curCode.push_back(BuildCode(dsr::VMI_CALLF_SELF_D));
+					m_curCode.push_back(BuildData(directIdx));
+				}
+				else
+				{
+					m_curCode.push_back(BuildCode(dsr::VMI_CALLF_SELF_G));
+					m_curCode.push_back(BuildData(fnIdx));
+				}
 			}
 
+			//the optimizer can't tell the arguments and the result from the bytecode
+			m_callSites.push_back(IRCallSite((uint32) m_curCode.size() - 2, pFuncDecl->GetNumParameters(), retValType, nativeRetType.c_str()));
+
 			for (uint32 i=0; i<pFuncDecl->GetNumParameters(); ++i)
 				DecStackSize();
 			IncStackSize();
@@ -705,16 +1206,16 @@ namespace dsc
 		}
 	}
 
-	void Compiler::ExprPushValue(const Token& tok, uint32& type, std::string& nativeType)
+	void FunctionCompiler::ExprPushValue(const Token& tok, uint32& type, std::string& nativeType)
 	{
 		switch (tok.GetType())
 		{
 		case TOKEN_IDENTIFIER:
 			{
 				VarInfo varInfo;
-				GetVarInfo(tok.GetSpelling(), varInfo);
+				GetVarInfo(tok.GetSpelling(), tok.GetSymbol(), varInfo);
 
-				if (varInfo.GetDataLoc() == Compiler::VarInfo::DATALOC_PARAMETER)
+				if (varInfo.GetDataLoc() == VarInfo::DATALOC_PARAMETER)
 				{
 					switch (varInfo.GetDataType())
 					{
@@ -741,7 +1242,7 @@ namespace dsc
 					IncStackSize();
 					return;
 				}
-				else if (varInfo.GetDataLoc() == Compiler::VarInfo::DATALOC_LOCAL)
+				else if (varInfo.GetDataLoc() == VarInfo::DATALOC_LOCAL)
 				{
 					switch (varInfo.GetDataType())
 					{
@@ -768,7 +1269,7 @@ namespace dsc
 					IncStackSize();
 					return;
 				}
-				else if (varInfo.GetDataLoc() == Compiler::VarInfo::DATALOC_SCRIPT)
+				else if (varInfo.GetDataLoc() == VarInfo::DATALOC_SCRIPT)
 				{
 					switch (varInfo.GetDataType())
 					{
@@ -790,69 +1291,333 @@ namespace dsc
 						break;
 					};
 
-					type = varInfo.GetDataType();
-					nativeType = varInfo.GetDataNativeType();
-					IncStackSize();
-					return;
-				}
+					type = varInfo.GetDataType();
+					nativeType = varInfo.GetDataNativeType();
+					IncStackSize();
+					return;
+				}
+				else
+				{
+					throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
+				}
+			}
+			break;
+
+		case TOKEN_TRUE:
+			{
+				m_curCode.push_back(BuildCode(dsr::VMI_PUSHB, 1));
+				type = dsr::VMDATATYPE_BOOL;
+				nativeType = "";
+				IncStackSize();
+				return;
+			}
+			break;
+
+		case TOKEN_FALSE:
+			{
+				m_curCode.push_back(BuildCode(dsr::VMI_PUSHB, 0));
+				type = dsr::VMDATATYPE_BOOL;
+				nativeType = "";
+				IncStackSize();
+				return;
+			}
+			break;
+
+		case TOKEN_INTEGER_LITERAL:
+			{
+				m_curCode.push_back(BuildCode(dsr::VMI_PUSHI));
+				m_curCode.push_back(BuildData(atoi(tok.GetSpelling())));
+				type = dsr::VMDATATYPE_INT;
+				nativeType = "";
+				IncStackSize();
+				return;
+			}
+			break;
+
+		case TOKEN_FLOAT_LITERAL:
+			{
+				m_curCode.push_back(BuildCode(dsr::VMI_PUSHF));
+				m_curCode.push_back(BuildData((float) atof(tok.GetSpelling())));
+				type = dsr::VMDATATYPE_FLOAT;
+				nativeType = "";
+				IncStackSize();
+				return;
+			}
+			break;
+
+		default:
+			throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
+			break;
+		};
+
+		throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
+	}
+
+	FunctionCompiler::ConstValue FunctionCompiler::ExprShortCircuit(bool isAnd, uint32 op1CodePos, uint32 op2CodePos, const ConstValue& op1Value, const ConstValue& op2Value)
+	{
+		//the second operand is only evaluated if the first one doesn't decide the result.
+		//a constant operand either decides it or drops out.
+		const bool decisive = !isAnd;
+		if (op1Value.IsConstant())
+		{
+			if (op1Value.GetBool() == decisive)
+			{
+				TruncateCode(op1CodePos);
+				DecStackSize();
+				DecStackSize();
+				ExprPushConstant(op1Value);
+				return op1Value;
+			}
+
+			EraseCode(op1CodePos, op2CodePos - op1CodePos);
+			DecStackSize();
+			return op2Value;
+		}
+
+		if (op2Value.IsConstant())
+		{
+			if (op2Value.GetBool() == decisive)
+			{
+				VMCodeBlock pop(1, BuildCode(dsr::VMI_POP));
+				InsertCode(op2CodePos, pop);
+			}
+			else
+			{
+				TruncateCode(op2CodePos);
+			}
+			DecStackSize();
+			return ConstValue();
+		}
+
+		//a && b:  a, JZ false, b, JMP end, false: PUSHB 0, end:
+		//a || b:  a, JZ b, PUSHB 1, JMP end, b: b, end:
+		VMCodeBlock test;
+		test.push_back(BuildCode(dsr::VMI_JZ));
+		if (!isAnd)
+		{
+			test.push_back(BuildCode(dsr::VMI_PUSHB, 1));
+			test.push_back(BuildCode(dsr::VMI_JMP));
+		}
+		InsertCode(op2CodePos, test);
+
+		if (isAnd)
+		{
+			m_curCode.push_back(BuildCode(dsr::VMI_JMP, (uint32) m_curCode.size() + 2));
+			m_curCode[op2CodePos] = BuildCode(dsr::VMI_JZ, (uint32) m_curCode.size());
+			m_curCode.push_back(BuildCode(dsr::VMI_PUSHB, 0));
+		}
+		else
+		{
+			m_curCode[op2CodePos] = BuildCode(dsr::VMI_JZ, op2CodePos + 3);
+			m_curCode[op2CodePos + 2] = BuildCode(dsr::VMI_JMP, (uint32) m_curCode.size());
+		}
+
+		//the operands are never on the stack together, so the stack size counted
+		//for them is an upper bound
+		DecStackSize();
+		return ConstValue();
+	}
+
+	void FunctionCompiler::ExprPushConstant(const ConstValue& value)
+	{
+		switch (value.GetType())
+		{
+		case dsr::VMDATATYPE_BOOL:
+			m_curCode.push_back(BuildCode(dsr::VMI_PUSHB, value.GetBool() ? 1 : 0));
+			break;
+
+		case dsr::VMDATATYPE_INT:
+			m_curCode.push_back(BuildCode(dsr::VMI_PUSHI));
+			m_curCode.push_back(BuildData(value.GetInt()));
+			break;
+
+		case dsr::VMDATATYPE_FLOAT:
+			m_curCode.push_back(BuildCode(dsr::VMI_PUSHF));
+			m_curCode.push_back(BuildData(value.GetFloat()));
+			break;
+
+		default:
+			throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
+			break;
+		};
+
+		IncStackSize();
+	}
+
+	FunctionCompiler::ConstValue FunctionCompiler::GetLiteralValue(const Token& tok)
+	{
+		switch (tok.GetType())
+		{
+		case TOKEN_TRUE:
+			return ConstValue::Bool(true);
+
+		case TOKEN_FALSE:
+			return ConstValue::Bool(false);
+
+		case TOKEN_INTEGER_LITERAL:
+			return ConstValue::Int(atoi(tok.GetSpelling()));
+
+		case TOKEN_FLOAT_LITERAL:
+			return ConstValue::Float((float) atof(tok.GetSpelling()));
+		};
+
+		return ConstValue();
+	}
+
+	bool FunctionCompiler::FoldUnaryOperation(uint32 tokType, const ConstValue& op, ConstValue& res)
+	{
+		if (tokType == TOKEN_UNARY_MINUS)
+		{
+			if (op.GetType() == dsr::VMDATATYPE_INT)
+				res = ConstValue::Int((int32) (0u - (uint32) op.GetInt()));
+			else if (op.GetType() == dsr::VMDATATYPE_FLOAT)
+				res = ConstValue::Float(-op.GetFloat());
+			else
+				return false;
+		}
+		else if (tokType == TOKEN_NOT && op.GetType() == dsr::VMDATATYPE_BOOL)
+		{
+			res = ConstValue::Bool(!op.GetBool());
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	bool FunctionCompiler::FoldBinaryOperation(uint32 tokType, const ConstValue& op1, const ConstValue& op2, ConstValue& res)
+	{
+		//evaluated the same way the VM does.  anything that would not compile, or
+		//could fault at runtime, is left alone.
+		if (!op1.IsConstant() || !op2.IsConstant())
+			return false;
+
+		const bool isInt = op1.GetType() == dsr::VMDATATYPE_INT && op2.GetType() == dsr::VMDATATYPE_INT;
+		const bool isBool = op1.GetType() == dsr::VMDATATYPE_BOOL && op2.GetType() == dsr::VMDATATYPE_BOOL;
+		const bool isNumber = (op1.GetType() == dsr::VMDATATYPE_INT || op1.GetType() == dsr::VMDATATYPE_FLOAT)
+			&& (op2.GetType() == dsr::VMDATATYPE_INT || op2.GetType() == dsr::VMDATATYPE_FLOAT);
+
+		//ints wrap around like the VM's 32 bit registers
+		const uint32 u1 = (uint32) op1.GetInt();
+		const uint32 u2 = (uint32) op2.GetInt();
+		const float f1 = op1.GetAsFloat();
+		const float f2 = op2.GetAsFloat();
+
+		switch (tokType)
+		{
+		case TOKEN_PLUS:
+			if (isInt)
+				res = ConstValue::Int((int32) (u1 + u2));
+			else if (isNumber)
+				res = ConstValue::Float(f1 + f2);
+			else
+				return false;
+			break;
+
+		case TOKEN_MINUS:
+			if (isInt)
+				res = ConstValue::Int((int32) (u1 - u2));
+			else if (isNumber)
+				res = ConstValue::Float(f1 - f2);
+			else
+				return false;
+			break;
+
+		case TOKEN_MULTIPLY:
+			if (isInt)
+				res = ConstValue::Int((int32) (u1 * u2));
+			else if (isNumber)
+				res = ConstValue::Float(f1 * f2);
+			else
+				return false;
+			break;
+
+		case TOKEN_DIVIDE:
+		case TOKEN_MODULO:
+			if (isInt)
+			{
+				if (op2.GetInt() == 0 || (op2.GetInt() == -1 && u1 == 0x80000000))
+					return false;
+
+				if (tokType == TOKEN_DIVIDE)
+					res = ConstValue::Int(op1.GetInt() / op2.GetInt());
 				else
-				{
-					throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
-				}
+					res = ConstValue::Int(op1.GetInt() % op2.GetInt());
 			}
-			break;
-
-		case TOKEN_TRUE:
+			else if (isNumber && tokType == TOKEN_DIVIDE)
 			{
-				m_curCode.push_back(BuildCode(dsr::VMI_PUSHB, 1));
-				type = dsr::VMDATATYPE_BOOL;
-				nativeType = "";
-				IncStackSize();
-				return;
+				res = ConstValue::Float(f1 / f2);
 			}
-			break;
-
-		case TOKEN_FALSE:
+			else
 			{
-				m_curCode.push_back(BuildCode(dsr::VMI_PUSHB, 0));
-				type = dsr::VMDATATYPE_BOOL;
-				nativeType = "";
-				IncStackSize();
-				return;
+				return false;
 			}
 			break;
 
-		case TOKEN_INTEGER_LITERAL:
+		case TOKEN_EQUALS:
+		case TOKEN_NOT_EQUALS:
 			{
-				m_curCode.push_back(BuildCode(dsr::VMI_PUSHI));
-				m_curCode.push_back(BuildData(atoi(tok.GetSpelling())));
-				type = dsr::VMDATATYPE_INT;
-				nativeType = "";
-				IncStackSize();
-				return;
+				bool equal = false;
+				if (isInt || isBool)
+					equal = op1.GetInt() == op2.GetInt();
+				else if (isNumber)
+					equal = f1 == f2;
+				else
+					return false;
+
+				res = ConstValue::Bool(tokType == TOKEN_EQUALS ? equal : !equal);
 			}
 			break;
 
-		case TOKEN_FLOAT_LITERAL:
+		case TOKEN_LTEQ:
+		case TOKEN_LT:
+		case TOKEN_GTEQ:
+		case TOKEN_GT:
 			{
-				m_curCode.push_back(BuildCode(dsr::VMI_PUSHF));
-				m_curCode.push_back(BuildData((float) atof(tok.GetSpelling())));
-				type = dsr::VMDATATYPE_FLOAT;
-				nativeType = "";
-				IncStackSize();
-				return;
+				int32 cmp = 0;
+				if (isInt)
+					cmp = op1.GetInt() < op2.GetInt() ? -1 : (op1.GetInt() > op2.GetInt() ? 1 : 0);
+				else if (isNumber)
+					cmp = f1 < f2 ? -1 : (f1 > f2 ? 1 : 0);
+				else
+					return false;
+
+				//unordered floats compare false, like in the VM
+				if (!isInt && !(f1 == f1 && f2 == f2))
+					res = ConstValue::Bool(false);
+				else if (tokType == TOKEN_LTEQ)
+					res = ConstValue::Bool(cmp <= 0);
+				else if (tokType == TOKEN_LT)
+					res = ConstValue::Bool(cmp < 0);
+				else if (tokType == TOKEN_GTEQ)
+					res = ConstValue::Bool(cmp >= 0);
+				else
+					res = ConstValue::Bool(cmp > 0);
 			}
 			break;
 
-		default:
-			throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
+		case TOKEN_AND:
+			if (!isBool)
+				return false;
+			res = ConstValue::Bool(op1.GetBool() && op2.GetBool());
+			break;
+
+		case TOKEN_OR:
+			if (!isBool)
+				return false;
+			res = ConstValue::Bool(op1.GetBool() || op2.GetBool());
 			break;
+
+		default:
+			return false;
 		};
 
-		throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
+		return true;
 	}
 
-	void Compiler::VisitExpressionAndCheckRetTypes(const ExpressionSrc& expr, uint32 returnType, const char* nativeReturnType)
+	void FunctionCompiler::VisitExpressionAndCheckRetTypes(const ExpressionSrc& expr, uint32 returnType, const char* nativeReturnType)
 	{
 		uint32 ret;
 		std::string nativeRet;
@@ -890,7 +1655,7 @@ namespace dsc
 			m_pDeclaration->GetName(), expr.GetLine()));
 	}
 
-	void Compiler::VisitExpression(const ExpressionSrc& expr, uint32& retType, std::string& nativeRetType)
+	void FunctionCompiler::VisitExpression(const ExpressionSrc& expr, uint32& retType, std::string& nativeRetType)
 	{
 		//init ret vals
 		retType = dsr::VMDATATYPE_MAX;
@@ -901,9 +1666,13 @@ namespace dsc
 
 		std::list<uint32> typeStack;
 		std::list<std::string> nativeTypeStack;
+		//compile time values of the operands, and where their code starts
+		std::vector<ConstValue> constStack;
+		std::vector<uint32> codePosStack;
 		for (uint32 i=0; i<expr.GetNumExpressionMembers(); ++i)
 		{
 			const ExpressionSrc::ExpressionMember& member = *expr.GetExpressionMemberPtr(i);
+			const uint32 codePos = (uint32) m_curCode.size();
 			if (member.GetFunctionCallSrcPtr())
 			{
 				uint32 retValType = dsr::VMDATATYPE_MAX;
@@ -911,6 +1680,8 @@ namespace dsc
 				VisitFunctionCall(*(member.GetFunctionCallSrcPtr()), retValType, nativeRetValType, "");
 				typeStack.push_back(retValType);
 				nativeTypeStack.push_back(nativeRetValType);
+				constStack.push_back(ConstValue());
+				codePosStack.push_back(codePos);
 			}
 			else
 			{
@@ -922,6 +1693,8 @@ namespace dsc
 					ExprPushValue(member.GetToken(), type, nativeTypeTemp);
 					typeStack.push_back(type);
 					nativeTypeStack.push_back(nativeTypeTemp);
+					constStack.push_back(GetLiteralValue(member.GetToken()));
+					codePosStack.push_back(codePos);
 				}
 				else if (IsUnaryOperation(member.GetToken().GetType()))
 				{
@@ -929,6 +1702,18 @@ namespace dsc
 					if (typeStack.empty())
 						throw CompilerException(FORMAT("Invalid expression.  Class %s, line %u.", m_pDeclaration->GetName(), expr.GetLine()));
 
+					//fold constant operand
+					ConstValue folded;
+					if (FoldUnaryOperation(member.GetToken().GetType(), constStack.back(), folded))
+					{
+						TruncateCode(codePosStack.back());
+						DecStackSize();
+						ExprPushConstant(folded);
+						constStack.back() = folded;
+						continue;
+					}
+					constStack.back() = ConstValue();
+
 					//unary minus
 					if (member.GetToken().GetType() == TOKEN_UNARY_MINUS)
 					{
@@ -964,6 +1749,34 @@ namespace dsc
 						throw CompilerException(FORMAT("Invalid expression.  Class %s, line %u.", m_pDeclaration->GetName(), expr.GetLine()));
 					}
 				}
+				else if (member.GetToken().GetType() == TOKEN_IS || member.GetToken().GetType() == TOKEN_AS)
+				{
+					//instance of or checked cast to the class named by the token
+					if (typeStack.empty() || typeStack.back() != dsr::VMDATATYPE_NATIVE)
+						throw CompilerException(FORMAT("Invalid expression.  Class %s, line %u.", m_pDeclaration->GetName(), expr.GetLine()));
+
+					const char* className = member.GetToken().GetSpelling();
+					GetScriptClassDeclarationPtr(className);
+					if (!IsA(className, nativeTypeStack.back().c_str()) && !IsA(nativeTypeStack.back().c_str(), className))
+					{
+						throw CompilerException(FORMAT("%s can never be a %s.  Class %s, line %u.",
+							nativeTypeStack.back().c_str(), className, m_pDeclaration->GetName(), expr.GetLine()));
+					}
+					constStack.back() = ConstValue();
+
+					const uint32 nameIdx = m_pCurFuncImpl->AddNewClassName(className);
+					if (member.GetToken().GetType() == TOKEN_IS)
+					{
+						m_curCode.push_back(BuildCode(dsr::VMI_ISN, nameIdx));
+						typeStack.back() = dsr::VMDATATYPE_BOOL;
+						nativeTypeStack.back() = "";
+					}
+					else
+					{
+						m_curCode.push_back(BuildCode(dsr::VMI_CASTN, nameIdx));
+						nativeTypeStack.back() = className;
+					}
+				}
 				else if (IsBinaryOperation(member.GetToken().GetType()))
 				{
 					//make sure that the number of operands is correct
@@ -978,6 +1791,32 @@ namespace dsc
 					typeStack.pop_back();
 					nativeTypeStack.pop_back();
 
+					const ConstValue op2Value = constStack.back();
+					constStack.pop_back();
+					const uint32 op2CodePos = codePosStack.back();
+					codePosStack.pop_back();
+					const ConstValue op1Value = constStack.back();
+					constStack.pop_back();
+					const uint32 op1CodePos = codePosStack.back();
+					codePosStack.pop_back();
+
+					//both operands constant, replace their code with the result
+					ConstValue folded;
+					if (FoldBinaryOperation(member.GetToken().GetType(), op1Value, op2Value, folded))
+					{
+						TruncateCode(op1CodePos);
+						DecStackSize();
+						DecStackSize();
+						ExprPushConstant(folded);
+						typeStack.push_back(folded.GetType());
+						nativeTypeStack.push_back("");
+						constStack.push_back(folded);
+						codePosStack.push_back(op1CodePos);
+						continue;
+					}
+					constStack.push_back(ConstValue());
+					codePosStack.push_back(op1CodePos);
+
 					//ops
 					if (member.GetToken().GetType() == TOKEN_DIVIDE)
 					{
@@ -1246,29 +2085,18 @@ namespace dsc
 						nativeTypeStack.push_back("");
 						DecStackSize();
 					}
-					else if (member.GetToken().GetType() == TOKEN_AND)
+					else if (member.GetToken().GetType() == TOKEN_AND || member.GetToken().GetType() == TOKEN_OR)
 					{
 						if (op1Type == dsr::VMDATATYPE_BOOL && op2Type == dsr::VMDATATYPE_BOOL)
-							m_curCode.push_back(BuildCode(dsr::VMI_AND));
-						else
 						{
-							throw CompilerException(FORMAT("Invalid expression.  Class %s, line %u.", m_pDeclaration->GetName(), expr.GetLine()));
+							constStack.back() = ExprShortCircuit(member.GetToken().GetType() == TOKEN_AND, op1CodePos, op2CodePos, op1Value, op2Value);
 						}
-						typeStack.push_back(dsr::VMDATATYPE_BOOL);
-						nativeTypeStack.push_back("");
-						DecStackSize();
-					}
-					else if (member.GetToken().GetType() == TOKEN_OR)
-					{
-						if (op1Type == dsr::VMDATATYPE_BOOL && op2Type == dsr::VMDATATYPE_BOOL)
-							m_curCode.push_back(BuildCode(dsr::VMI_OR));
 						else
 						{
 							throw CompilerException(FORMAT("Invalid expression.  Class %s, line %u.", m_pDeclaration->GetName(), expr.GetLine()));
 						}
 						typeStack.push_back(dsr::VMDATATYPE_BOOL);
 						nativeTypeStack.push_back("");
-						DecStackSize();
 					}
 					else
 					{
@@ -1298,20 +2126,24 @@ namespace dsc
 		if (strlen(derived) == 0 || strlen(base) == 0)
 			return false;
 
-		const char* der = derived;
-		while (strlen(der) != 0)
+		const uint32 baseSymbol = m_pSymbols->Find(base, (uint32) strlen(base));
+		uint32 der = m_pSymbols->Find(derived, (uint32) strlen(derived));
+		if (der == SymbolTable::INVALID_SYMBOL)
+			der = GetScriptClassDeclarationPtr(derived)->GetSymbol();
+
+		while (der != baseSymbol)
 		{
-			if (strcmp(der, base) == 0)
-				return true;
+			const ScriptClassDeclaration* pDer = GetScriptClassDeclarationPtr(der);
+			if (strlen(pDer->GetSuperClassName()) == 0)
+				return false;
 
-			const ScriptClassDeclaration* pDer = GetScriptClassDeclarationPtr(derived);
-			der = pDer->GetSuperClassName();
+			der = pDer->GetSuperClassSymbol();
 		}
 
-		return false;
+		return true;
 	}
 
-	ScriptSourceCPtr Compiler::LoadScriptSource(const char* scriptName)
+	ScriptSourceCPtr Compiler::LoadScriptSource(const char* scriptName) const
 	{
 		if (GetNumPaths() == 0)
 		{
@@ -1319,22 +2151,28 @@ namespace dsc
 			throw CompilerException(FORMAT("Must have at least one script path defined."));
 		}
 
+		if (strchr(scriptName, '*') || strchr(scriptName, '?'))
+		{
+			assert(false);
+			throw CompilerException(FORMAT("Can't use wildcards in Compiler::BuildClass()."));
+		}
+
 		std::string scriptFileName = GenerateScriptFileName(scriptName);
 
+		//open the file directly instead of scanning the directory
 		std::string data;
 		for (uint32 i=0; i<GetNumPaths() && data.empty(); ++i)
 		{
-			const char* path = GetPath(i);
-			File::StringVector foundFiles;
-			FindFiles(path, scriptFileName.c_str(), foundFiles);
-			if (foundFiles.size() == 1)
-			{
-				LoadScriptFile(foundFiles[0].c_str(), data);
-			}
-			else if (foundFiles.size() > 1)
+			std::string fileName = GetPath(i);
+			if (!fileName.empty() && fileName[fileName.size()-1] != '/' && fileName[fileName.size()-1] != '\\')
+				fileName += "/";
+			fileName += scriptFileName;
+
+			File file;
+			if (file.Open(fileName.c_str(), File::READ_BINARY))
 			{
-				assert(false);
-				throw CompilerException(FORMAT("Can't use wildcards in Compiler::BuildClass()."));
+				file.Close();
+				LoadScriptFile(fileName.c_str(), data);
 			}
 		}
 
@@ -1344,7 +2182,7 @@ namespace dsc
 			throw CompilerException(FORMAT("Could not find the file %s.", scriptFileName.c_str()));
 		}
 
-		Parser parser;
+		Parser parser(*m_pSymbols);
 		ScriptSourceCPtr scriptSource = parser.ParseScript(data.c_str());
 		if (strcmp(scriptSource->GetName(), scriptName) != 0)
 		{
@@ -1356,10 +2194,50 @@ namespace dsc
 		return scriptSource;
 	}
 
+	void Compiler::ScheduleScriptSource(const char* name)
+	{
+		ScriptLoadTask* pTask = 0;
+		{
+			ScopedLock lock(m_loadLock);
+			if (m_loadTasks.find(name) != m_loadTasks.end())
+				return;
+
+			pTask = new ScriptLoadTask(name);
+			m_loadTasks[name] = pTask;
+		}
+
+		m_pThreadPool->Add(pTask);
+	}
+
 	void Compiler::LoadAllScriptSources(const char* name)
 	{
 		m_curCompilePass = COMPILEPASS_LOADSCRIPTSOURCES;
 
+		//load the whole import graph.  each loaded script schedules its imports
+		//right away, so files are read and parsed while others are still loading.
+		ClearLoadTasks();
+		ScriptLoadTask* pRoot = new ScriptLoadTask(name);
+		m_loadTasks[name] = pRoot;
+		ThreadPool::ThreadTaskPtrArray tasks(1, pRoot);
+		m_pThreadPool->Run(tasks);
+
+		//collect in the same depth first order as loading one file at a time,
+		//so declarations and errors come out the same regardless of timing
+		try
+		{
+			AddScriptSources(name);
+		}
+		catch (const CompilerException&)
+		{
+			ClearLoadTasks();
+			throw;
+		}
+
+		ClearLoadTasks();
+	}
+
+	void Compiler::AddScriptSources(const char* name)
+	{
 		for (ScriptSourceCPtrList::const_iterator itt = m_sources.begin();
 				itt != m_sources.end();
 				++itt)
@@ -1368,15 +2246,31 @@ namespace dsc
 				return;
 		}
 
-		ScriptSourceCPtr scriptSource = LoadScriptSource(name);
+		ScriptLoadTaskMap::const_iterator it = m_loadTasks.find(name);
+		if (it == m_loadTasks.end())
+			throw CompilerException(FORMAT("Internal compiler error. File %s, line %u.", __FILE__, __LINE__));
+
+		const ScriptLoadTask* pTask = it->second;
+		if (pTask->HasFailed())
+			throw CompilerException(pTask->GetError());
+
+		ScriptSourceCPtr scriptSource = pTask->GetResult();
 		m_sources.push_back(scriptSource);
 
 		for (uint32 i=0; i<scriptSource->GetNumImportClasses(); ++i)
 		{
-			LoadAllScriptSources(scriptSource->GetImportClass(i));
+			AddScriptSources(scriptSource->GetImportClass(i));
 		}
 	}
 
+	void Compiler::ClearLoadTasks()
+	{
+		for (ScriptLoadTaskMap::iterator it = m_loadTasks.begin(); it != m_loadTasks.end(); ++it)
+			delete it->second;
+
+		m_loadTasks.clear();
+	}
+
 	void Compiler::BuildScriptClassDeclarationsPass1()
 	{
 		m_curCompilePass = COMPILEPASS_BUILDDECLARATIONS1;
@@ -1394,11 +2288,62 @@ namespace dsc
 	{
 		m_curCompilePass = COMPILEPASS_BUILDDECLARATIONS2;
 
+		//super classes first, removing overridden declarations changes the function indices
+		std::set<std::string> done;
+		while (done.size() < m_declarationList.size())
+		{
+			const size_t numDone = done.size();
+			for (ScriptClassDeclarationCPtrList::iterator it = m_declarationList.begin();
+					it != m_declarationList.end(); ++it)
+			{
+				ScriptClassDeclaration* pDecl = *it;
+				if (done.find(pDecl->GetName()) != done.end())
+					continue;
+				if (strlen(pDecl->GetSuperClassName()) > 0 && done.find(GetScriptClassDeclarationPtr(pDecl->GetSuperClassName())->GetName()) == done.end())
+					continue;
+
+				BuildScriptClassDeclarationPass2(pDecl);
+				done.insert(pDecl->GetName());
+			}
+
+			//the classes left are in a cycle, or derive from one
+			for (ScriptClassDeclarationCPtrList::iterator it = m_declarationList.begin();
+					it != m_declarationList.end() && done.size() == numDone; ++it)
+			{
+				if (done.find((*it)->GetName()) == done.end())
+					throw CompilerException(FORMAT("Class %s is derived from itself.", (*it)->GetName()));
+			}
+		}
+
+		AnalyzeClassHierarchy();
+	}
+
+	void Compiler::AnalyzeClassHierarchy()
+	{
+		//every class that has code for a function marks it in all of its super classes
 		for (ScriptClassDeclarationCPtrList::iterator it = m_declarationList.begin();
 				it != m_declarationList.end(); ++it)
 		{
-			ScriptClassDeclaration* pDecl = *it;
-			BuildScriptClassDeclarationPass2(pDecl);
+			const ScriptClassDeclaration* pDecl = *it;
+			if (strlen(pDecl->GetSuperClassName()) == 0)
+				continue;
+
+			const uint32 numSuperFunctions = pDecl->GetNumFunctions() - pDecl->GetNumNonSuperFunctions();
+			for (uint32 i=0; i<numSuperFunctions; ++i)
+			{
+				if (!pDecl->DefinesFunction(i))
+					continue;
+
+				ScriptClassDeclaration* pAncestor = (ScriptClassDeclaration*) GetScriptClassDeclarationPtr(pDecl->GetSuperClassName());
+				while (true)
+				{
+					if (i < pAncestor->GetNumFunctions())
+						pAncestor->SetFunctionOverridden(i);
+					if (strlen(pAncestor->GetSuperClassName()) == 0)
+						break;
+					pAncestor = (ScriptClassDeclaration*) GetScriptClassDeclarationPtr(pAncestor->GetSuperClassName());
+				}
+			}
 		}
 	}
 
@@ -1411,7 +2356,7 @@ namespace dsc
 			for (uint32 j=i+1; j<pDecl->GetNumData(); ++j)
 			{
 				const DataDeclaration* pData2 = pDecl->GetDataDeclarationPtr(j);
-				if (strcmp(pData->GetName(), pData2->GetName()) == 0)
+				if (pData->GetSymbol() == pData2->GetSymbol())
 				{
 					throw CompilerException(FORMAT("Data member \"%s\" is a duplicate.  Class %s, line %u.",
 						pData->GetName(), pDecl->GetName(), pData->GetLine()));
@@ -1440,7 +2385,7 @@ namespace dsc
 			for (uint32 j=i+1; j<pDecl->GetNumNonSuperFunctions(); ++j)
 			{
 				const FunctionDeclaration* pC2 = pDecl->GetNonSuperFunctionDeclarationPtr(j);
-				if (strcmp(pC1->GetName(), pC2->GetName()) == 0)
+				if (pC1->GetSymbol() == pC2->GetSymbol())
 				{
 					throw CompilerException(FORMAT("Function member \"%s\" is a duplicate.  Class %s, line %u.",
 						pC1->GetName(), pDecl->GetName(), pC2->GetLine()));
@@ -1451,8 +2396,14 @@ namespace dsc
 			for (uint32 j=0; j<pDecl->GetNumFunctions() - pDecl->GetNumNonSuperFunctions(); ++j)
 			{
 				const FunctionDeclaration* pC2 = pDecl->GetFunctionDeclarationPtr(j);
-				if (strcmp(pC1->GetName(), pC2->GetName()) == 0)
+				if (pC1->GetSymbol() == pC2->GetSymbol())
 				{
+					if (pC2->IsFinal())
+					{
+						throw CompilerException(FORMAT("Final function \"%s\" can't be overridden.  Class %s, line %u.",
+							pC1->GetName(), pDecl->GetName(), pC1->GetLine()));
+					}
+
 					//check ret type
 					if (pC1->GetReturnType() != pC2->GetReturnType())
 					{
@@ -1492,6 +2443,7 @@ namespace dsc
 					}
 
 					idxToRemove.push_back(i);
+					pDecl->AddOverride(j);
 				}
 			}
 		}
@@ -1578,45 +2530,178 @@ namespace dsc
 
 	void Compiler::BuildScriptClassDeclarationPass2(ScriptClassDeclaration* pDecl)
 	{
+		if (strlen(pDecl->GetSuperClassName()) > 0 && GetScriptClassDeclarationPtr(pDecl->GetSuperClassName())->IsFinal())
+			throw CompilerException(FORMAT("Final class \"%s\" can't be extended.  Class %s.", pDecl->GetSuperClassName(), pDecl->GetName()));
+
 		CheckDataDeclarations(pDecl);
 		CheckConstructorDeclarations(pDecl);
 		CheckFunctionDeclarations(pDecl);
 	}
 
-	ScriptClassCPtr Compiler::BuildScriptClassImplementation(const char* scriptName)
+	void Compiler::BuildScriptClassImplementations(const StringList& scriptNames, ScriptClassCPtrList& classes)
 	{
 		//set compile context
 		m_curCompilePass = COMPILEPASS_BUILDFUNCTIONIMPLEMENTATIONS;
-		m_pDeclaration = GetScriptClassDeclarationPtr(scriptName);
-		const ScriptSource* pScriptSource = *(std::find_if(m_sources.begin(), m_sources.end(), FindByName(scriptName)));
-		assert(m_pDeclaration);
-		assert(pScriptSource);
 
-		ScriptClassCPtr res = new ScriptClass();
-		res->SetScriptDeclaration(m_pDeclaration);
+		//super classes are compiled as well, so that their code can be inlined.
+		//they come last and only the named classes are returned.
+		const bool inlineCalls = m_optimize && m_inlineLimits.GetMaxDepth() > 0;
+		StringList compileNames = scriptNames;
+		for (StringList::const_iterator it = scriptNames.begin(); it != scriptNames.end() && inlineCalls; ++it)
+		{
+			const ScriptClassDeclaration* pDeclaration = GetScriptClassDeclarationPtr(it->c_str());
+			while (strlen(pDeclaration->GetSuperClassName()) > 0)
+			{
+				pDeclaration = GetScriptClassDeclarationPtr(pDeclaration->GetSuperClassName());
+				if (std::find(compileNames.begin(), compileNames.end(), pDeclaration->GetName()) == compileNames.end())
+					compileNames.push_back(pDeclaration->GetName());
+			}
+		}
+
+		//count functions so that the task array never reallocates
+		uint32 numTasks = 0;
+		uint32 numResults = 0;
+		for (StringList::const_iterator it = compileNames.begin(); it != compileNames.end(); ++it)
+		{
+			const ScriptSource* pScriptSource = *(std::find_if(m_sources.begin(), m_sources.end(), FindByName(it->c_str())));
+			assert(pScriptSource);
+			numTasks += pScriptSource->GetNumFunctions() + pScriptSource->GetNumConstructors();
+			if (std::find(scriptNames.begin(), scriptNames.end(), *it) != scriptNames.end())
+				numResults = numTasks;
+		}
+
+		//one task per function and constructor of every class
+		std::vector<FunctionCompileTask> tasks(numTasks);
+		ThreadPool::ThreadTaskPtrArray taskPtrs;
+		taskPtrs.reserve(numTasks);
+		for (StringList::const_iterator it = compileNames.begin(); it != compileNames.end(); ++it)
+		{
+			const ScriptClassDeclaration* pDeclaration = GetScriptClassDeclarationPtr(it->c_str());
+			const ScriptSource* pScriptSource = *(std::find_if(m_sources.begin(), m_sources.end(), FindByName(it->c_str())));
+			assert(pDeclaration);
+			assert(pScriptSource);
+
+			for (uint32 i=0; i<pScriptSource->GetNumFunctions(); ++i)
+			{
+				const FunctionSrc* pFuncSrc = pScriptSource->GetFunctionSrcPtr(i);
+				const uint32 funcIdx = pDeclaration->GetFunctionIndex(pFuncSrc->GetSymbol());
+				assert(funcIdx != -1);
+				tasks[taskPtrs.size()].Set(pDeclaration, pFuncSrc, funcIdx, -1, m_optimize);
+				taskPtrs.push_back(&tasks[taskPtrs.size()]);
+			}
+
+			for (uint32 i=0; i<pScriptSource->GetNumConstructors(); ++i)
+			{
+				const FunctionSrc* pFuncSrc = pScriptSource->GetConstructorFunctionSrcPtr(i);
+				tasks[taskPtrs.size()].Set(pDeclaration, pFuncSrc, -1, i, m_optimize);
+				taskPtrs.push_back(&tasks[taskPtrs.size()]);
+			}
+		}
+
+		//compile
+		m_pThreadPool->Run(taskPtrs);
+
+		//report the first error in source order, so errors don't depend on thread timing.
+		//super classes that don't compile just aren't inlined.
+		for (uint32 i=0; i<numResults; ++i)
+		{
+			if (tasks[i].HasFailed())
+				throw CompilerException(tasks[i].GetError());
+		}
+
+		std::vector<FunctionImplementationCPtr> results(numResults);
+		for (uint32 i=0; i<numResults; ++i)
+			results[i] = tasks[i].GetResult();
 
-		//build functions
-		for (uint32 i=0; i<pScriptSource->GetNumFunctions(); ++i)
+		//optimize, once all the code the inliner may copy is there
+		if (m_optimize)
 		{
-			const FunctionSrc* pFuncSrc = pScriptSource->GetFunctionSrcPtr(i);
-			m_curFuncIdx = m_pDeclaration->GetFunctionIndex(pFuncSrc->GetName());
-			assert(m_curFuncIdx != -1);
-			FunctionImplementationCPtr pFuncImpl = BuildFunctionImplementation(*pFuncSrc);
-			res->AddFunctionImplementation(pFuncImpl);
+			//code of the compiled functions first, then where the others are defined
+			CallResolver resolver;
+			for (uint32 i=0; i<tasks.size(); ++i)
+			{
+				const FunctionCompileTask& task = tasks[i];
+				if (task.HasFailed() || task.GetSourcePtr()->IsNative())
+					continue;
+
+				const ScriptClassDeclaration* pDeclaration = task.GetDeclarationPtr();
+				const FunctionDeclaration* pFuncDecl = GetFunctionDeclarationPtr(pDeclaration, task.GetFunctionIndex(), task.GetConstructorIndex());
+				IRCallee callee(task.GetResult(), pFuncDecl, pDeclaration, &task.GetCallSites());
+				if (task.GetFunctionIndex() != -1)
+					resolver.AddFunction(pDeclaration, task.GetFunctionIndex(), &callee);
+				else
+					resolver.AddConstructor(pDeclaration, task.GetConstructorIndex(), &callee);
+			}
+			AddDefinitions(resolver);
+
+			std::vector<FunctionOptimizeTask> optimizeTasks(numResults);
+			taskPtrs.clear();
+			for (uint32 i=0; i<numResults; ++i)
+			{
+				if (tasks[i].GetSourcePtr()->IsNative())
+					continue;
+
+				optimizeTasks[i].Set(&tasks[i], &resolver, inlineCalls ? m_inlineLimits : InlineLimits(0, 0, 0));
+				taskPtrs.push_back(&optimizeTasks[i]);
+			}
+			m_pThreadPool->Run(taskPtrs);
+
+			for (uint32 i=0; i<numResults; ++i)
+			{
+				if (optimizeTasks[i].HasFailed())
+					throw CompilerException(optimizeTasks[i].GetError());
+				if (optimizeTasks[i].GetResult())
+					results[i] = optimizeTasks[i].GetResult();
+				m_optimizerStats.Merge(optimizeTasks[i].GetStats());
+			}
+		}
+
+		//last, so that neither the optimizer nor the inliner sees tail calls
+		for (uint32 i=0; i<numResults; ++i)
+		{
+			if (!tasks[i].GetSourcePtr()->IsNative())
+				MarkTailCalls(results[i]);
 		}
-		m_curFuncIdx = -1;
 
-		//build constructors
-		for (uint32 i=0; i<pScriptSource->GetNumConstructors(); ++i)
+		//collect results
+		uint32 taskIdx = 0;
+		for (StringList::const_iterator it = scriptNames.begin(); it != scriptNames.end(); ++it)
 		{
-			const FunctionSrc* pFuncSrc = pScriptSource->GetConstructorFunctionSrcPtr(i);
-			m_curCtorIdx = i;
-			FunctionImplementationCPtr pFuncImpl = BuildFunctionImplementation(*pFuncSrc);
-			res->AddConstructorImplementation(pFuncImpl);
+			const ScriptClassDeclaration* pDeclaration = GetScriptClassDeclarationPtr(it->c_str());
+			const ScriptSource* pScriptSource = *(std::find_if(m_sources.begin(), m_sources.end(), FindByName(it->c_str())));
+
+			ScriptClassCPtr res = new ScriptClass();
+			res->SetScriptDeclaration(pDeclaration);
+
+			for (uint32 i=0; i<pScriptSource->GetNumFunctions(); ++i)
+				res->AddFunctionImplementation(results[taskIdx++], pDeclaration->GetFunctionIndex(pScriptSource->GetFunctionSrcPtr(i)->GetSymbol()));
+
+			for (uint32 i=0; i<pScriptSource->GetNumConstructors(); ++i)
+				res->AddConstructorImplementation(results[taskIdx++]);
+
+			classes.push_back(res);
 		}
-		m_curCtorIdx = -1;
+		assert(taskIdx == numResults);
+	}
 
-		return res;
+	void Compiler::AddDefinitions(CallResolver& resolver) const
+	{
+		//where every loaded class defines its functions
+		for (ScriptSourceCPtrList::const_iterator it = m_sources.begin(); it != m_sources.end(); ++it)
+		{
+			const ScriptSource* pScriptSource = *it;
+			const ScriptClassDeclaration* pDeclaration = GetScriptClassDeclarationPtr(pScriptSource->GetName());
+			const ScriptClassDeclaration* pSuper = 0;
+			if (strlen(pDeclaration->GetSuperClassName()) > 0)
+				pSuper = GetScriptClassDeclarationPtr(pDeclaration->GetSuperClassName());
+			resolver.AddClass(pDeclaration, pSuper);
+
+			for (uint32 i=0; i<pScriptSource->GetNumFunctions(); ++i)
+			{
+				const uint32 funcIdx = pDeclaration->GetFunctionIndex(pScriptSource->GetFunctionSrcPtr(i)->GetSymbol());
+				resolver.AddFunction(pDeclaration, funcIdx, 0);
+			}
+		}
 	}
 
 	ScriptClassCPtr Compiler::BuildScriptClass(const char* scriptName)
@@ -1627,7 +2712,13 @@ namespace dsc
 			LoadAllScriptSources(scriptName);
 			BuildScriptClassDeclarationsPass1();
 			BuildScriptClassDeclarationsPass2();
-			return BuildScriptClassImplementation(scriptName);
+
+			StringList scriptNames;
+			scriptNames.push_back(scriptName);
+			ScriptClassCPtrList classes;
+			BuildScriptClassImplementations(scriptNames, classes);
+			assert(classes.size() == 1);
+			return classes.front();
 		}
 		catch (const CompilerException& e)
 		{
@@ -1638,14 +2729,41 @@ namespace dsc
 		}
 	}
 
-	void Compiler::GetVarInfo(const char* vname, VarInfo& varInfo)
+	bool Compiler::BuildAllScriptClasses(const char* scriptName, ScriptClassCPtrList& classes)
+	{
+		try
+		{
+			Clear();
+			LoadAllScriptSources(scriptName);
+			BuildScriptClassDeclarationsPass1();
+			BuildScriptClassDeclarationsPass2();
+
+			StringList scriptNames;
+			for (ScriptSourceCPtrList::const_iterator it = m_sources.begin(); it != m_sources.end(); ++it)
+				scriptNames.push_back((*it)->GetName());
+
+			ScriptClassCPtrList res;
+			BuildScriptClassImplementations(scriptNames, res);
+			classes.splice(classes.end(), res);
+			return true;
+		}
+		catch (const CompilerException& e)
+		{
+			if (strlen(e.GetError()) > 0)
+				m_error = e.GetError();
+
+			return false;
+		}
+	}
+
+	void FunctionCompiler::GetVarInfo(const char* vname, uint32 symbol, VarInfo& varInfo)
 	{
 		//look for data in the parameter list
 		const FunctionDeclaration* pFuncDecl = GetFunctionDeclarationPtr(m_pDeclaration, m_curFuncIdx, m_curCtorIdx);
 		for (uint32 i=0; i<pFuncDecl->GetNumParameters(); ++i)
 		{
 			const DataDeclaration* pParam = pFuncDecl->GetParameterDataDeclarationPtr(i);
-			if (strcmp(pParam->GetName(), vname) == 0)
+			if (pParam->GetSymbol() == symbol)
 			{
 				//found
 				varInfo.Set(VarInfo::DATALOC_PARAMETER, i, pParam->GetType(), pParam->GetNativeType());
@@ -1658,7 +2776,7 @@ namespace dsc
 		for (uint32 i=0; i<m_pCurFuncImpl->GetNumLocals(); ++i)
 		{
 			const DataDeclaration* pLocal = m_pCurFuncImpl->GetLocalDataDeclarationPtr(i);
-			if (strcmp(pLocal->GetName(), vname) == 0)
+			if (pLocal->GetSymbol() == symbol)
 			{
 				//found
 				varInfo.Set(VarInfo::DATALOC_LOCAL, i, pLocal->GetType(), pLocal->GetNativeType());
@@ -1670,7 +2788,7 @@ namespace dsc
 		for (uint32 i=0; i<m_pDeclaration->GetNumData(); ++i)
 		{
 			const DataDeclaration* pData = m_pDeclaration->GetDataDeclarationPtr(i);
-			if (strcmp(pData->GetName(), vname) == 0)
+			if (pData->GetSymbol() == symbol)
 			{
 				//found
 				varInfo.Set(VarInfo::DATALOC_SCRIPT, i, pData->GetType(), pData->GetNativeType());
@@ -1683,6 +2801,18 @@ namespace dsc
 	}
 
 	const ScriptClassDeclaration* Compiler::GetScriptClassDeclarationPtr(const char* className) const
+	{
+		const uint32 classSymbol = m_pSymbols->Find(className, (uint32) strlen(className));
+		if (classSymbol == SymbolTable::INVALID_SYMBOL)
+		{
+			assert(false);
+			throw CompilerException(FORMAT("Could not find class %s.", className));
+		}
+
+		return GetScriptClassDeclarationPtr(classSymbol);
+	}
+
+	const ScriptClassDeclaration* Compiler::GetScriptClassDeclarationPtr(uint32 classSymbol) const
 	{
 		assert(m_curCompilePass == COMPILEPASS_BUILDFUNCTIONIMPLEMENTATIONS
 			|| m_curCompilePass == COMPILEPASS_BUILDDECLARATIONS2);
@@ -1691,46 +2821,22 @@ namespace dsc
 				it != m_declarationList.end(); ++it)
 		{
 			const ScriptClassDeclaration* pDecl = *it;
-			if (strcmp(className, pDecl->GetName()) == 0)
+			if (pDecl->GetSymbol() == classSymbol)
 				return pDecl;
 		}
 
 		assert(false);
-		throw CompilerException(FORMAT("Could not find class %s.", className));
+		throw CompilerException(FORMAT("Could not find class %s.", m_pSymbols->GetSpelling(classSymbol)));
 		return 0;
 	}
 
-	DataDeclarationCPtr Compiler::BuildDataDeclaration(const FunctionParameterSrc& source) const
-	{
-		DataDeclarationCPtr dataDecl = new DataDeclaration();
-		dataDecl->SetLine(source.GetLine());
-		dataDecl->SetName(source.GetName());
-		dataDecl->SetType(GetDataType(source.GetType()));
-		if (dataDecl->GetType() == dsr::VMDATATYPE_NATIVE)
-			dataDecl->SetNativeType(source.GetType());
-		else
-			dataDecl->SetNativeType("");
-		return dataDecl;
-	}
-
-	DataDeclarationCPtr Compiler::BuildDataDeclaration(const DataSrc& source) const
-	{
-		DataDeclarationCPtr dataDecl = new DataDeclaration();
-		dataDecl->SetLine(source.GetLine());
-		dataDecl->SetName(source.GetName());
-		dataDecl->SetType(GetDataType(source.GetType()));
-		if (dataDecl->GetType() == dsr::VMDATATYPE_NATIVE)
-			dataDecl->SetNativeType(source.GetType());
-		else
-			dataDecl->SetNativeType("");
-		return dataDecl;
-	}
-
 	FunctionDeclarationCPtr Compiler::BuildFunctionDeclaration(const FunctionSrc& source) const
 	{
 		FunctionDeclarationCPtr funcDecl = new FunctionDeclaration();
 		funcDecl->SetLine(source.GetLine());
 		funcDecl->SetName(source.GetName());
+		funcDecl->SetSymbol(source.GetSymbol());
+		funcDecl->SetFinal(source.IsFinal());
 		funcDecl->SetReturnType(GetDataType(source.GetReturnType()));
 		if (funcDecl->GetReturnType() == dsr::VMDATATYPE_NATIVE)
 			funcDecl->SetReturnNativeType(source.GetReturnType());
@@ -1743,7 +2849,7 @@ namespace dsc
 		return funcDecl;
 	}
 
-	FunctionImplementationCPtr Compiler::BuildFunctionImplementation(const FunctionSrc& source)
+	FunctionImplementationCPtr FunctionCompiler::BuildFunctionImplementation(const FunctionSrc& source)
 	{
 		const FunctionDeclaration* pFuncDecl = GetFunctionDeclarationPtr(m_pDeclaration, m_curFuncIdx, m_curCtorIdx);
 		FunctionImplementationCPtr funcImpl = new FunctionImplementation();
@@ -1776,6 +2882,10 @@ namespace dsc
 				const FunctionCallSrc* pBaseCtor = source.GetBaseConstructor();
 				assert(pBaseCtor);
 				VisitFunctionCall(*pBaseCtor, rt, nrt, "");
+
+				//pop the return value
+				m_curCode.push_back(BuildCode(dsr::VMI_POP));
+				DecStackSize();
 				assert(m_curStackSize == 0);
 			}
 
@@ -1789,7 +2899,7 @@ namespace dsc
 				if (pExpr)
 				{
 					VarInfo varInfo;
-					varInfo.Set(Compiler::VarInfo::DATALOC_SCRIPT, i, pDataDecl->GetType(), pDataDecl->GetNativeType());
+					varInfo.Set(VarInfo::DATALOC_LOCAL, i, pDataDecl->GetType(), pDataDecl->GetNativeType());
 					VisitExpressionAndCheckRetTypes(*pExpr, pDataDecl->GetType(), pDataDecl->GetNativeType());
 					AssignToVariable(varInfo);
 
@@ -1802,22 +2912,24 @@ namespace dsc
 				source.GetStatementSrcPtr()->Visit(*this);
 
 			//create fake return value for void functions
-			if (pFuncDecl->GetReturnType() == dsr::VMDATATYPE_VOID && (m_curCode.empty() || ExtractVMInstruction(m_curCode.back()) != dsr::VMI_RET))
+			if (pFuncDecl->GetReturnType() == dsr::VMDATATYPE_VOID && !m_unreachable)
 			{
 				m_curCode.push_back(BuildCode(dsr::VMI_PUSHB));
 				IncStackSize();
 				m_curCode.push_back(BuildCode(dsr::VMI_RET));
 				DecStackSize();
+				m_unreachable = true;
 			}
 
-			//check for return
-			if (m_curCode.empty() || ExtractVMInstruction(m_curCode.back()) != dsr::VMI_RET)
+			//check for return.  every path has to end in one.
+			if (!m_unreachable)
 				throw CompilerException(FORMAT("Function \"%s\" must return a value.  Class %s, line %u.", source.GetName(), m_pDeclaration->GetName(), source.GetLine()));
 		}
 
+		assert(m_curStackSize == 0);
+
 		//get bytecode
 		funcImpl->SetVMCodeBlock(m_curCode);
-		assert(m_curStackSize == 0);
 		funcImpl->SetMaxStackSize(m_maxStackSize);
 
 		m_pCurFuncImpl = 0;
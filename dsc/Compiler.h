@@ -1,9 +1,13 @@
 #if !defined(DSC_COMPILER_H_)
 #define DSC_COMPILER_H_
 
+#include <list>
+#include <map>
 #include "DSRVMDataType.h"
 #include "ScriptSource.h"
 #include "ScriptClass.h"
+#include "ThreadPool.h"
+#include "IRPasses.h"
 
 namespace dsc
 {
@@ -12,6 +16,7 @@ namespace dsc
 	{
 	public:
 		CompilerException(const char* error) { m_error = error; }
+		CompilerException(const std::string& error) { m_error = error; }
 		const char* GetError() const { return m_error.c_str(); }
 
 	private:
@@ -19,20 +24,21 @@ namespace dsc
 	};
 
 	//-------------------------------------------------------------------------------------
-	class Compiler : public StatementSrcVisitor
+	/// Generates bytecode for a single function or constructor.
+	/// Holds all per-function code generation state, so that function bodies
+	/// can be compiled on several threads at once.  Class declarations are
+	/// only read while compiling.
+	class FunctionCompiler : public StatementSrcVisitor
 	{
-		DSC_NOCOPY(Compiler)
+		DSC_NOCOPY(FunctionCompiler)
 	public:
-		static void Create();
-		static void Destroy();
-		friend Compiler* CompilerPtr() { return Compiler::m_pInstance; }
-
-		~Compiler();
+		/// Exactly one of funcIdx and ctorIdx is -1.
+		/// bindCalls calls functions no loaded class overrides directly, besides the final ones.
+		FunctionCompiler(const ScriptClassDeclaration* pDeclaration, uint32 funcIdx, uint32 ctorIdx, bool bindCalls);
 
-		ScriptClassCPtr BuildScriptClass(const char* scriptName);
-		void AddPath(const char* scriptPath) { m_paths.push_back(scriptPath); }
-		const char* GetError() const { return m_error.c_str(); }
-		const ScriptClassDeclaration* GetScriptClassDeclarationPtr(const char* className) const;
+		FunctionImplementationCPtr BuildFunctionImplementation(const FunctionSrc& source);
+		/// calls in the code of the last built function, for the optimizer
+		const IRCallSiteArray& GetCallSites() const { return m_callSites; }
 
 		virtual void VisitBlock(const StBlock& stBlock);
 		virtual void VisitWhile(const StWhile& stWhile);
@@ -41,10 +47,7 @@ namespace dsc
 		virtual void VisitReturn(const StReturn& stReturn);
 		virtual void VisitFunctionCall(const StFunctionCall& fncCall);
 	private:
-		typedef std::list<std::string> StringList;
 		typedef std::vector<dsr::VMBytecode> VMCodeBlock;
-		typedef std::list<ScriptClassDeclarationCPtr> ScriptClassDeclarationCPtrList;
-		typedef std::list<ScriptSourceCPtr> ScriptSourceCPtrList;
 
 		class VarInfo
 		{
@@ -79,44 +82,53 @@ namespace dsc
 			std::string m_nativeType;
 		};
 
-		enum CompilePass
+		/// Value of an expression operand that is known at compile time.
+		class ConstValue
 		{
-			COMPILEPASS_UNDEF,
-			COMPILEPASS_LOADSCRIPTSOURCES,
-			COMPILEPASS_BUILDDECLARATIONS1,
-			COMPILEPASS_BUILDDECLARATIONS2,
-			COMPILEPASS_BUILDFUNCTIONIMPLEMENTATIONS
+		public:
+			ConstValue() : m_type(dsr::VMDATATYPE_MAX), m_int(0), m_float(0.0f) {}
+			static ConstValue Int(int32 i) { ConstValue v; v.m_type = dsr::VMDATATYPE_INT; v.m_int = i; return v; }
+			static ConstValue Float(float f) { ConstValue v; v.m_type = dsr::VMDATATYPE_FLOAT; v.m_float = f; return v; }
+			static ConstValue Bool(bool b) { ConstValue v; v.m_type = dsr::VMDATATYPE_BOOL; v.m_int = b ? 1 : 0; return v; }
+
+			bool IsConstant() const { return m_type != dsr::VMDATATYPE_MAX; }
+			uint32 GetType() const { return m_type; }
+			int32 GetInt() const { return m_int; }
+			float GetFloat() const { return m_float; }
+			bool GetBool() const { return m_int != 0; }
+			/// ints are converted the same way the VM does for mixed operations
+			float GetAsFloat() const { return m_type == dsr::VMDATATYPE_FLOAT ? m_float : (float) m_int; }
+
+		private:
+			uint32 m_type;
+			int32 m_int;
+			float m_float;
 		};
 
-		Compiler();
-		ScriptClassDeclarationCPtr BuildScriptClassDeclarationPass1(const ScriptSource& source) const;
-		void BuildScriptClassDeclarationPass2(ScriptClassDeclaration* pDecl);
-		ScriptClassCPtr BuildScriptClassImplementation(const char* scriptName);
-		DataDeclarationCPtr BuildDataDeclaration(const DataSrc& source) const;
-		DataDeclarationCPtr BuildDataDeclaration(const FunctionParameterSrc& source) const;
-		FunctionDeclarationCPtr BuildFunctionDeclaration(const FunctionSrc& source) const;
 		void IncStackSize() { ++m_curStackSize; if (m_curStackSize > m_maxStackSize) m_maxStackSize = m_curStackSize; }
 		void DecStackSize() { assert(m_curStackSize > 0); --m_curStackSize; }
-		void GetVarInfo(const char* vname, VarInfo& varInfo);
+		void GetVarInfo(const char* vname, uint32 symbol, VarInfo& varInfo);
 		void VisitFunctionCall(const FunctionCallSrc& fncCall, uint32& retValType, std::string& nativeRetType, const char* pushedType);
+		/// direct call table index for calling function fnIdx on a pReceiver, -1 if the call has to use the vtable
+		uint32 GetDirectCallIndex(const ScriptClassDeclaration* pReceiver, uint32 fnIdx);
 		void ExprPushValue(const Token& tok, uint32& type, std::string& nativeType);
+		void ExprPushConstant(const ConstValue& value);
+		ConstValue ExprShortCircuit(bool isAnd, uint32 op1CodePos, uint32 op2CodePos, const ConstValue& op1Value, const ConstValue& op2Value);
+		static ConstValue GetLiteralValue(const Token& tok);
+		static bool FoldUnaryOperation(uint32 tokType, const ConstValue& op, ConstValue& res);
+		static bool FoldBinaryOperation(uint32 tokType, const ConstValue& op1, const ConstValue& op2, ConstValue& res);
+		bool IsConstantCondition(uint32 codePos, bool& value) const;
+		void VisitDeadStatement(const StatementSrc& statement);
 		void ClearCurCode();
+		void TruncateCode(uint32 codePos);
+		void InsertCode(uint32 codePos, const VMCodeBlock& code);
+		void EraseCode(uint32 codePos, uint32 size);
+		void RelocateCode(uint32 codePos, uint32 oldCodePos, int32 delta);
+		const ScriptClassDeclaration* GetScriptClassDeclarationPtr(const char* className) const;
 		bool IsA(const char* derived, const char* base) const;
-		void Clear();
-		void ClearPaths() { m_paths.clear(); }
-		uint32 GetNumPaths() const { return (uint32) m_paths.size(); }
-		const char* GetPath(uint32 idx) const { return GetListElement(m_paths, idx).c_str(); }
-		ScriptSourceCPtr LoadScriptSource(const char* scriptName);
-		void LoadAllScriptSources(const char* name);
-		void BuildScriptClassDeclarationsPass1();
-		void BuildScriptClassDeclarationsPass2();
-		FunctionImplementationCPtr BuildFunctionImplementation(const FunctionSrc& source);
 		virtual void VisitExpressionAndCheckRetTypes(const ExpressionSrc& expr, uint32 returnType, const char* nativeReturnType);
 		virtual void VisitExpression(const ExpressionSrc& expr, uint32& retType, std::string& nativeRetType);
 		void AssignToVariable(const VarInfo& varInfo);
-		void CheckDataDeclarations(const ScriptClassDeclaration* pDecl);
-		void CheckFunctionDeclarations(ScriptClassDeclaration* pDecl);
-		void CheckConstructorDeclarations(ScriptClassDeclaration* pDecl);
 
 	private:
 		/// Current size of the stack.
@@ -126,15 +138,111 @@ namespace dsc
 		/// Used for calculating the maximum stack size needed for a function call.
 		uint32 m_maxStackSize;
 		VMCodeBlock m_curCode;
-		std::string m_error;
 		const ScriptClassDeclaration* m_pDeclaration;
 		FunctionImplementation* m_pCurFuncImpl;
 		uint32 m_curFuncIdx;
 		uint32 m_curCtorIdx;
+		/// set after a return or an endless loop, until a jump target is reached
+		bool m_unreachable;
+		/// calls in m_curCode, by position, for the optimizer
+		IRCallSiteArray m_callSites;
+		bool m_bindCalls;
+	};
+
+	//-------------------------------------------------------------------------------------
+	class Compiler
+	{
+		DSC_NOCOPY(Compiler)
+	public:
+		typedef std::list<ScriptClassCPtr> ScriptClassCPtrList;
+
+		static void Create();
+		static void Destroy();
+		friend Compiler* CompilerPtr() { return Compiler::m_pInstance; }
+
+		~Compiler();
+
+		ScriptClassCPtr BuildScriptClass(const char* scriptName);
+		/// Builds the named class and every class it imports, directly or indirectly.
+		/// Returns false on error; see GetError().
+		bool BuildAllScriptClasses(const char* scriptName, ScriptClassCPtrList& classes);
+		void AddPath(const char* scriptPath) { m_paths.push_back(scriptPath); }
+		const char* GetError() const { return m_error.c_str(); }
+		const ScriptClassDeclaration* GetScriptClassDeclarationPtr(const char* className) const;
+		const ScriptClassDeclaration* GetScriptClassDeclarationPtr(uint32 classSymbol) const;
+		bool IsA(const char* derived, const char* base) const;
+
+		/// Number of threads used to compile function bodies.
+		/// 0 uses one thread per processor, 1 compiles everything on the calling thread.
+		void SetNumThreads(uint32 numThreads);
+		uint32 GetNumThreads() const;
+		/// Runs the optimizer over function bodies.  On by default.
+		/// Calls of functions no loaded class overrides skip the vtable then, which makes
+		/// the same assumption as the inliner.
+		void SetOptimize(bool optimize) { m_optimize = optimize; }
+		bool GetOptimize() const { return m_optimize; }
+		/// Budgets for inlining calls whose target is known at compile time, as part of
+		/// the optimizer.  Self calls count as known when no loaded class overrides the
+		/// function, so classes derived from a class have to be built along with it.
+		void SetInlineLimits(const InlineLimits& limits) { m_inlineLimits = limits; }
+		const InlineLimits& GetInlineLimits() const { return m_inlineLimits; }
+		/// optimizer statistics of the last build
+		const OptimizerStats& GetOptimizerStats() const { return m_optimizerStats; }
+
+	private:
+		typedef std::list<std::string> StringList;
+		typedef std::list<ScriptClassDeclarationCPtr> ScriptClassDeclarationCPtrList;
+		typedef std::list<ScriptSourceCPtr> ScriptSourceCPtrList;
+		class ScriptLoadTask;
+		class CallResolver;
+		typedef std::map<std::string, ScriptLoadTask*> ScriptLoadTaskMap;
+
+		enum CompilePass
+		{
+			COMPILEPASS_UNDEF,
+			COMPILEPASS_LOADSCRIPTSOURCES,
+			COMPILEPASS_BUILDDECLARATIONS1,
+			COMPILEPASS_BUILDDECLARATIONS2,
+			COMPILEPASS_BUILDFUNCTIONIMPLEMENTATIONS
+		};
+
+		Compiler();
+		ScriptClassDeclarationCPtr BuildScriptClassDeclarationPass1(const ScriptSource& source) const;
+		void BuildScriptClassDeclarationPass2(ScriptClassDeclaration* pDecl);
+		void BuildScriptClassImplementations(const StringList& scriptNames, ScriptClassCPtrList& classes);
+		FunctionDeclarationCPtr BuildFunctionDeclaration(const FunctionSrc& source) const;
+		void Clear();
+		void ClearPaths() { m_paths.clear(); }
+		uint32 GetNumPaths() const { return (uint32) m_paths.size(); }
+		const char* GetPath(uint32 idx) const { return m_paths[idx].c_str(); }
+		ScriptSourceCPtr LoadScriptSource(const char* scriptName) const;
+		void ScheduleScriptSource(const char* name);
+		void LoadAllScriptSources(const char* name);
+		void AddScriptSources(const char* name);
+		void ClearLoadTasks();
+		void BuildScriptClassDeclarationsPass1();
+		void BuildScriptClassDeclarationsPass2();
+		void CheckDataDeclarations(const ScriptClassDeclaration* pDecl);
+		void CheckFunctionDeclarations(ScriptClassDeclaration* pDecl);
+		void CheckConstructorDeclarations(ScriptClassDeclaration* pDecl);
+		void AnalyzeClassHierarchy();
+		void AddDefinitions(CallResolver& resolver) const;
+
+	private:
+		std::string m_error;
 		ScriptClassDeclarationCPtrList m_declarationList;
 		ScriptSourceCPtrList m_sources;
-		StringList m_paths;
+		/// names of all scripts of a build, so they can be compared by symbol
+		SymbolTable* m_pSymbols;
+		/// scripts scheduled for loading, by class name
+		ScriptLoadTaskMap m_loadTasks;
+		CriticalSection m_loadLock;
+		std::vector<std::string> m_paths;
 		CompilePass m_curCompilePass;
+		ThreadPool* m_pThreadPool;
+		bool m_optimize;
+		InlineLimits m_inlineLimits;
+		OptimizerStats m_optimizerStats;
 
 		static Compiler* m_pInstance;
 	};
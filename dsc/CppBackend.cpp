@@ -0,0 +1,669 @@
+#include <cassert>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include "CppBackend.h"
+#include "Compiler.h"
+#include "StringUtils.h"
+
+namespace dsc
+{
+	static uint32 ExtractUnsignedValue(dsr::VMBytecode code)
+	{
+		return code & 0x00FFFFFF;
+	}
+
+	static uint32 ExtractVMInstruction(dsr::VMBytecode code)
+	{
+		return code >> 24;
+	}
+
+	/// type the runtime gives values of type, void results are ints
+	static uint32 GetRuntimeType(uint32 type)
+	{
+		return type == dsr::VMDATATYPE_VOID ? (uint32) dsr::VMDATATYPE_INT : type;
+	}
+
+	static bool IsNumberType(uint32 type)
+	{
+		return type == dsr::VMDATATYPE_FLOAT || type == dsr::VMDATATYPE_INT || type == dsr::VMDATATYPE_BOOL;
+	}
+
+	//-------------------------------------------------------------------------------------
+	/// Translates the bytecode of one function.
+	/// The types on the operand stack are known at every instruction, so every stack slot
+	/// becomes one C++ variable per type it holds.  Results of void calls are kept as
+	/// VMData, they can only be popped or returned.
+	class FunctionTranslator
+	{
+	public:
+		FunctionTranslator(const ScriptClassDeclaration* pClassDecl, uint32 funcIdx, const FunctionImplementation* pFuncImpl, const std::string& name)
+		: m_pClassDecl(pClassDecl), m_pFuncDecl(pClassDecl->GetFunctionDeclarationPtr(funcIdx)), m_pFuncImpl(pFuncImpl),
+			m_code(pFuncImpl->GetVMCodeBlock()), m_funcIdx(funcIdx), m_name(name), m_usesData(false), m_usesStart(false)
+		{
+		}
+
+		/// false if the function uses something the translation doesn't support
+		bool Translate(std::string& source);
+
+	private:
+		typedef std::vector<uint32> TypeStack;
+		typedef std::map<uint32, TypeStack> TypeStackMap;
+
+		/// Checks the instruction at pc against the types on stack and updates them.  Appends
+		/// the C++ for it to pOut, if given.  succs are the instructions that can run next.
+		bool Step(uint32 pc, TypeStack& stack, std::vector<uint32>& succs, std::string* pOut);
+		bool StepCall(uint32 pc, TypeStack& stack, std::vector<uint32>& succs, std::string* pOut);
+		static bool GetBinaryOperation(uint32 opcode, uint32& type1, uint32& type2, uint32& resType, const char*& op);
+		/// expression for the slot at depth as a type, false if that would need a conversion
+		bool Read(const TypeStack& stack, uint32 depth, uint32 type, std::string& expr);
+		std::string Slot(uint32 depth, uint32 type);
+		static const char* GetTypeName(uint32 type);
+		static const char* GetDefaultValue(uint32 type);
+		static const char* GetVMDataGetter(uint32 type);
+		static std::string GetFloatLiteral(uint32 bits);
+		static std::string GetIntLiteral(uint32 bits);
+		static std::string GetSlotName(uint32 depth, uint32 type);
+		static void Emit(std::string* pOut, const std::string& line);
+
+	private:
+		const ScriptClassDeclaration* m_pClassDecl;
+		const FunctionDeclaration* m_pFuncDecl;
+		const FunctionImplementation* m_pFuncImpl;
+		const FunctionImplementation::VMCodeBlock& m_code;
+		uint32 m_funcIdx;
+		std::string m_name;
+		/// jump targets
+		std::vector<bool> m_labels;
+		/// slot variables, by type and depth
+		std::map<uint32, std::vector<bool> > m_slots;
+		bool m_usesData;
+		bool m_usesStart;
+	};
+
+	bool FunctionTranslator::Translate(std::string& source)
+	{
+		//arguments and locals become variables of their type
+		if (!IsNumberType(GetRuntimeType(m_pFuncDecl->GetReturnType())))
+			return false;
+		for (uint32 i=0; i<m_pFuncDecl->GetNumParameters(); ++i)
+		{
+			if (!IsNumberType(m_pFuncDecl->GetParameterDataDeclarationPtr(i)->GetType()))
+				return false;
+		}
+		for (uint32 i=0; i<m_pFuncImpl->GetNumLocals(); ++i)
+		{
+			if (!IsNumberType(m_pFuncImpl->GetLocalDataDeclarationPtr(i)->GetType()))
+				return false;
+		}
+
+		//types on the stack at every reachable instruction, they must not depend on the path
+		if (m_code.empty())
+			return false;
+		m_labels.assign(m_code.size(), false);
+		TypeStackMap stacks;
+		stacks[0] = TypeStack();
+		std::vector<uint32> work(1, 0);
+		while (!work.empty())
+		{
+			const uint32 pc = work.back();
+			work.pop_back();
+
+			TypeStack stack = stacks[pc];
+			std::vector<uint32> succs;
+			if (!Step(pc, stack, succs, 0))
+				return false;
+
+			for (uint32 i=0; i<succs.size(); ++i)
+			{
+				if (succs[i] >= m_code.size())
+					return false;
+
+				TypeStackMap::const_iterator it = stacks.find(succs[i]);
+				if (it == stacks.end())
+				{
+					stacks[succs[i]] = stack;
+					work.push_back(succs[i]);
+				}
+				else if (it->second != stack)
+					return false;
+			}
+		}
+
+		//translate the reachable instructions in code order
+		std::string body;
+		for (uint32 pc=0; pc<m_code.size(); pc += HasDataWord(ExtractVMInstruction(m_code[pc])) ? 2 : 1)
+		{
+			TypeStackMap::const_iterator it = stacks.find(pc);
+			if (it == stacks.end())
+				continue;
+
+			if (m_labels[pc])
+				body += FORMAT("\tL%u:\n", pc);
+
+			TypeStack stack = it->second;
+			std::vector<uint32> succs;
+			Step(pc, stack, succs, &body);
+		}
+
+		source += FORMAT("\tvoid %s(ScriptInstance* pInstance, VMDataArray& args, VMData* retVal)\n", m_name.c_str());
+		source += "\t{\n";
+		for (uint32 i=0; i<m_pFuncDecl->GetNumParameters(); ++i)
+		{
+			const uint32 type = m_pFuncDecl->GetParameterDataDeclarationPtr(i)->GetType();
+			source += FORMAT("\t\t%s a%u = args[%u].%s();\n", GetTypeName(type), i, i, GetVMDataGetter(type));
+		}
+		for (uint32 i=0; i<m_pFuncImpl->GetNumLocals(); ++i)
+		{
+			const uint32 type = m_pFuncImpl->GetLocalDataDeclarationPtr(i)->GetType();
+			source += FORMAT("\t\t%s l%u = %s;\n", GetTypeName(type), i, GetDefaultValue(type));
+		}
+		for (std::map<uint32, std::vector<bool> >::const_iterator it=m_slots.begin(); it!=m_slots.end(); ++it)
+		{
+			for (uint32 depth=0; depth<it->second.size(); ++depth)
+			{
+				if (!it->second[depth])
+					continue;
+				if (it->first == dsr::VMDATATYPE_VOID)
+					source += FORMAT("\t\tVMData %s;\n", GetSlotName(depth, it->first).c_str());
+				else
+					source += FORMAT("\t\t%s %s = %s;\n", GetTypeName(it->first), GetSlotName(depth, it->first).c_str(), GetDefaultValue(it->first));
+			}
+		}
+		if (m_usesData)
+			source += "\t\tint32* pData = pInstance->GetInstanceData();\n";
+		source += "\n";
+		if (m_usesStart)
+			source += "\tstart:\n";
+		source += body;
+		source += "\t}\n";
+		return true;
+	}
+
+	bool FunctionTranslator::Step(uint32 pc, TypeStack& stack, std::vector<uint32>& succs, std::string* pOut)
+	{
+		const uint32 opcode = ExtractVMInstruction(m_code[pc]);
+		const uint32 imm = ExtractUnsignedValue(m_code[pc]);
+		const uint32 top = (uint32) stack.size();
+		std::string expr;
+
+		switch (opcode)
+		{
+		case dsr::VMI_NOP:
+			break;
+
+		case dsr::VMI_JMP:
+			if (imm >= m_code.size())
+				return false;
+			m_labels[imm] = true;
+			Emit(pOut, FORMAT("goto L%u;", imm));
+			succs.push_back(imm);
+			return true;
+
+		case dsr::VMI_JZ:
+			{
+				//the interpreter tests the int value, bools are 0 or 1
+				if (top < 1 || imm >= m_code.size())
+					return false;
+				if (stack.back() == dsr::VMDATATYPE_INT)
+					Emit(pOut, FORMAT("if (%s == 0) goto L%u;", GetSlotName(top - 1, dsr::VMDATATYPE_INT).c_str(), imm));
+				else if (stack.back() == dsr::VMDATATYPE_BOOL)
+					Emit(pOut, FORMAT("if (!%s) goto L%u;", GetSlotName(top - 1, dsr::VMDATATYPE_BOOL).c_str(), imm));
+				else
+					return false;
+
+				m_labels[imm] = true;
+				stack.pop_back();
+				succs.push_back(imm);
+			}
+			break;
+
+		case dsr::VMI_STORESF:
+		case dsr::VMI_STORESI:
+		case dsr::VMI_STORESB:
+			{
+				const uint32 type = dsr::VMDATATYPE_FLOAT + (opcode - dsr::VMI_STORESF);
+				if (top < 1 || !Read(stack, top - 1, type, expr))
+					return false;
+
+				if (type == dsr::VMDATATYPE_FLOAT)
+					Emit(pOut, FORMAT("*((float*) &pData[%u]) = %s;", imm, expr.c_str()));
+				else if (type == dsr::VMDATATYPE_INT)
+					Emit(pOut, FORMAT("pData[%u] = %s;", imm, expr.c_str()));
+				else
+					Emit(pOut, FORMAT("pData[%u] = %s ? 1 : 0;", imm, expr.c_str()));
+				m_usesData = true;
+				stack.pop_back();
+			}
+			break;
+
+		case dsr::VMI_STORELF:
+		case dsr::VMI_STORELI:
+		case dsr::VMI_STORELB:
+		case dsr::VMI_STOREPF:
+		case dsr::VMI_STOREPI:
+		case dsr::VMI_STOREPB:
+			{
+				//the value keeps its type, so it must be the variable's
+				const bool local = (opcode <= dsr::VMI_STORELB);
+				const uint32 type = dsr::VMDATATYPE_FLOAT + (opcode - (local ? dsr::VMI_STORELF : dsr::VMI_STOREPF));
+				if (local ? imm >= m_pFuncImpl->GetNumLocals() : imm >= m_pFuncDecl->GetNumParameters())
+					return false;
+				const uint32 varType = local ? m_pFuncImpl->GetLocalDataDeclarationPtr(imm)->GetType()
+					: m_pFuncDecl->GetParameterDataDeclarationPtr(imm)->GetType();
+				if (top < 1 || varType != type || stack.back() != type)
+					return false;
+
+				Emit(pOut, FORMAT("%c%u = %s;", local ? 'l' : 'a', imm, Slot(top - 1, type).c_str()));
+				stack.pop_back();
+			}
+			break;
+
+		case dsr::VMI_FETCHSF:
+			m_usesData = true;
+			stack.push_back(dsr::VMDATATYPE_FLOAT);
+			Emit(pOut, FORMAT("%s = *((float*) &pData[%u]);", Slot(top, dsr::VMDATATYPE_FLOAT).c_str(), imm));
+			break;
+
+		case dsr::VMI_FETCHSI:
+			m_usesData = true;
+			stack.push_back(dsr::VMDATATYPE_INT);
+			Emit(pOut, FORMAT("%s = pData[%u];", Slot(top, dsr::VMDATATYPE_INT).c_str(), imm));
+			break;
+
+		case dsr::VMI_FETCHSB:
+			m_usesData = true;
+			stack.push_back(dsr::VMDATATYPE_BOOL);
+			Emit(pOut, FORMAT("%s = pData[%u] != 0;", Slot(top, dsr::VMDATATYPE_BOOL).c_str(), imm));
+			break;
+
+		case dsr::VMI_FETCHLF:
+		case dsr::VMI_FETCHLI:
+		case dsr::VMI_FETCHLB:
+		case dsr::VMI_FETCHPF:
+		case dsr::VMI_FETCHPI:
+		case dsr::VMI_FETCHPB:
+			{
+				const bool local = (opcode <= dsr::VMI_FETCHLB);
+				const uint32 type = dsr::VMDATATYPE_FLOAT + (opcode - (local ? dsr::VMI_FETCHLF : dsr::VMI_FETCHPF));
+				if (local ? imm >= m_pFuncImpl->GetNumLocals() : imm >= m_pFuncDecl->GetNumParameters())
+					return false;
+				const uint32 varType = local ? m_pFuncImpl->GetLocalDataDeclarationPtr(imm)->GetType()
+					: m_pFuncDecl->GetParameterDataDeclarationPtr(imm)->GetType();
+				if (varType != type)
+					return false;
+
+				stack.push_back(type);
+				Emit(pOut, FORMAT("%s = %c%u;", Slot(top, type).c_str(), local ? 'l' : 'a', imm));
+			}
+			break;
+
+		case dsr::VMI_PUSHF:
+			stack.push_back(dsr::VMDATATYPE_FLOAT);
+			Emit(pOut, FORMAT("%s = %s;", Slot(top, dsr::VMDATATYPE_FLOAT).c_str(), GetFloatLiteral(m_code[pc + 1]).c_str()));
+			succs.push_back(pc + 2);
+			return true;
+
+		case dsr::VMI_PUSHI:
+			stack.push_back(dsr::VMDATATYPE_INT);
+			Emit(pOut, FORMAT("%s = %s;", Slot(top, dsr::VMDATATYPE_INT).c_str(), GetIntLiteral(m_code[pc + 1]).c_str()));
+			succs.push_back(pc + 2);
+			return true;
+
+		case dsr::VMI_PUSHB:
+			stack.push_back(dsr::VMDATATYPE_BOOL);
+			Emit(pOut, FORMAT("%s = %s;", Slot(top, dsr::VMDATATYPE_BOOL).c_str(), imm != 0 ? "true" : "false"));
+			break;
+
+		case dsr::VMI_POP:
+			if (top < 1)
+				return false;
+			stack.pop_back();
+			break;
+
+		case dsr::VMI_NEGF:
+		case dsr::VMI_NEGI:
+		case dsr::VMI_NOT:
+			{
+				const uint32 type = opcode == dsr::VMI_NEGF ? dsr::VMDATATYPE_FLOAT : opcode == dsr::VMI_NEGI ? dsr::VMDATATYPE_INT : dsr::VMDATATYPE_BOOL;
+				if (top < 1 || !Read(stack, top - 1, type, expr))
+					return false;
+
+				stack.back() = type;
+				Emit(pOut, FORMAT("%s = %c%s;", Slot(top - 1, type).c_str(), opcode == dsr::VMI_NOT ? '!' : '-', expr.c_str()));
+			}
+			break;
+
+		case dsr::VMI_RET:
+			if (top < 1)
+				return false;
+			if (stack.back() == dsr::VMDATATYPE_VOID)
+				Emit(pOut, FORMAT("*retVal = %s;", Slot(top - 1, dsr::VMDATATYPE_VOID).c_str()));
+			else
+				Emit(pOut, FORMAT("retVal->Set(%s);", Slot(top - 1, stack.back()).c_str()));
+			Emit(pOut, "return;");
+			return true;
+
+		case dsr::VMI_CALLF_SELF_G:
+		case dsr::VMI_CALLF_SUPER_G:
+		case dsr::VMI_CALLF_SELF_D:
+		case dsr::VMI_TAILCALLF_SELF_G:
+		case dsr::VMI_TAILCALLF_SUPER_G:
+		case dsr::VMI_TAILCALLF_SELF_D:
+			return StepCall(pc, stack, succs, pOut);
+
+		default:
+			{
+				uint32 type1, type2, resType;
+				const char* op;
+				if (!GetBinaryOperation(opcode, type1, type2, resType, op))
+					return false;
+
+				//operands are converted the way the interpreter does
+				std::string expr2;
+				if (top < 2 || !Read(stack, top - 2, type1, expr) || !Read(stack, top - 1, type2, expr2))
+					return false;
+				if (type1 == dsr::VMDATATYPE_INT && type2 == dsr::VMDATATYPE_FLOAT)
+					expr = "((float) " + expr + ")";
+				if (type1 == dsr::VMDATATYPE_FLOAT && type2 == dsr::VMDATATYPE_INT)
+					expr2 = "((float) " + expr2 + ")";
+
+				stack.pop_back();
+				stack.back() = resType;
+				Emit(pOut, FORMAT("%s = %s %s %s;", Slot(top - 2, resType).c_str(), expr.c_str(), op, expr2.c_str()));
+			}
+			break;
+		}
+
+		succs.push_back(pc + 1);
+		return true;
+	}
+
+	bool FunctionTranslator::StepCall(uint32 pc, TypeStack& stack, std::vector<uint32>& succs, std::string* pOut)
+	{
+		const uint32 opcode = ExtractVMInstruction(m_code[pc]);
+		if (pc + 1 >= m_code.size())
+			return false;
+		const uint32 idx = m_code[pc + 1];
+
+		//find the callee's declaration, and how the runtime finds its implementation
+		const FunctionDeclaration* pCalleeDecl = 0;
+		std::string callee;
+		bool selfCall = false;
+		if (opcode == dsr::VMI_CALLF_SELF_G || opcode == dsr::VMI_TAILCALLF_SELF_G)
+		{
+			if (idx >= m_pClassDecl->GetNumFunctions())
+				return false;
+			pCalleeDecl = m_pClassDecl->GetFunctionDeclarationPtr(idx);
+			callee = FORMAT("pInstance->GetScriptClassPtr()->GetFunctionImplementationPtr(%u)", idx);
+		}
+		else if (opcode == dsr::VMI_CALLF_SUPER_G || opcode == dsr::VMI_TAILCALLF_SUPER_G)
+		{
+			const ScriptClassDeclaration* pSuperDecl = CompilerPtr()->GetScriptClassDeclarationPtr(m_pClassDecl->GetSuperClassName());
+			if (!pSuperDecl || idx >= pSuperDecl->GetNumFunctions())
+				return false;
+			pCalleeDecl = pSuperDecl->GetFunctionDeclarationPtr(idx);
+			callee = FORMAT("s_pImpl%s->GetScriptClassPtr()->GetSuperPtr()->GetFunctionImplementationPtr(%u)", m_name.c_str(), idx);
+		}
+		else
+		{
+			if (idx >= m_pFuncImpl->GetNumDirectCalls())
+				return false;
+			const DirectCall& call = m_pFuncImpl->GetDirectCall(idx);
+			const ScriptClassDeclaration* pCalleeClassDecl = CompilerPtr()->GetScriptClassDeclarationPtr(call.GetClassName());
+			if (!pCalleeClassDecl || call.GetFunctionIndex() >= pCalleeClassDecl->GetNumFunctions())
+				return false;
+			pCalleeDecl = pCalleeClassDecl->GetFunctionDeclarationPtr(call.GetFunctionIndex());
+			callee = FORMAT("s_pImpl%s->GetDirectCallPtr(%u)", m_name.c_str(), idx);
+			selfCall = opcode == dsr::VMI_TAILCALLF_SELF_D && call.GetFunctionIndex() == m_funcIdx
+				&& strcmp(call.GetClassName(), m_pClassDecl->GetName()) == 0;
+		}
+
+		//arguments keep their type, so they must be the parameters'
+		const uint32 numArgs = pCalleeDecl->GetNumParameters();
+		const uint32 top = (uint32) stack.size();
+		if (top < numArgs)
+			return false;
+		const uint32 base = top - numArgs;
+		for (uint32 i=0; i<numArgs; ++i)
+		{
+			const uint32 type = pCalleeDecl->GetParameterDataDeclarationPtr(i)->GetType();
+			if (!IsNumberType(type) || stack[base + i] != type)
+				return false;
+		}
+		const uint32 retType = pCalleeDecl->GetReturnType();
+		if (retType != dsr::VMDATATYPE_VOID && !IsNumberType(retType))
+			return false;
+
+		if (selfCall)
+		{
+			//a tail call of the function itself starts it over, the RET after it isn't reached
+			for (uint32 i=0; i<numArgs; ++i)
+				Emit(pOut, FORMAT("a%u = %s;", i, Slot(base + i, stack[base + i]).c_str()));
+			for (uint32 i=0; i<m_pFuncImpl->GetNumLocals(); ++i)
+			{
+				const uint32 type = m_pFuncImpl->GetLocalDataDeclarationPtr(i)->GetType();
+				Emit(pOut, FORMAT("l%u = %s;", i, GetDefaultValue(type)));
+			}
+			Emit(pOut, "goto start;");
+			m_usesStart = true;
+			return true;
+		}
+
+		Emit(pOut, "{");
+		Emit(pOut, FORMAT("\tVMDataArray callArgs(%u);", numArgs));
+		for (uint32 i=0; i<numArgs; ++i)
+			Emit(pOut, FORMAT("\tcallArgs[%u].Set(%s);", i, Slot(base + i, stack[base + i]).c_str()));
+		stack.resize(base);
+		if (retType == dsr::VMDATATYPE_VOID)
+		{
+			stack.push_back(dsr::VMDATATYPE_VOID);
+			Emit(pOut, FORMAT("\tif (!CallCompiled(%s, pInstance, callArgs, &%s))", callee.c_str(), Slot(base, dsr::VMDATATYPE_VOID).c_str()));
+			Emit(pOut, "\t\treturn;");
+		}
+		else
+		{
+			stack.push_back(retType);
+			Emit(pOut, "\tVMData callRet;");
+			Emit(pOut, FORMAT("\tif (!CallCompiled(%s, pInstance, callArgs, &callRet))", callee.c_str()));
+			Emit(pOut, "\t\treturn;");
+			Emit(pOut, FORMAT("\t%s = callRet.%s();", Slot(base, retType).c_str(), GetVMDataGetter(retType)));
+		}
+		Emit(pOut, "}");
+
+		succs.push_back(pc + 2);
+		return true;
+	}
+
+	bool FunctionTranslator::GetBinaryOperation(uint32 opcode, uint32& type1, uint32& type2, uint32& resType, const char*& op)
+	{
+		if (opcode == dsr::VMI_MOD)
+		{
+			type1 = type2 = resType = dsr::VMDATATYPE_INT;
+			op = "%";
+			return true;
+		}
+		if (opcode == dsr::VMI_EQBB || opcode == dsr::VMI_AND || opcode == dsr::VMI_OR)
+		{
+			type1 = type2 = resType = dsr::VMDATATYPE_BOOL;
+			op = opcode == dsr::VMI_EQBB ? "==" : opcode == dsr::VMI_AND ? "&&" : "||";
+			return true;
+		}
+
+		//four variants each, II, FF, FI and IF
+		static const char* s_arithmetic[] = { "/", "*", "-", "+" };
+		static const char* s_compare[] = { "<=", "<", ">=", ">" };
+		uint32 variant;
+		if (opcode >= dsr::VMI_DIVII && opcode <= dsr::VMI_ADDIF)
+		{
+			variant = (opcode - dsr::VMI_DIVII) % 4;
+			op = s_arithmetic[(opcode - dsr::VMI_DIVII) / 4];
+			resType = variant == 0 ? dsr::VMDATATYPE_INT : dsr::VMDATATYPE_FLOAT;
+		}
+		else if (opcode >= dsr::VMI_EQII && opcode <= dsr::VMI_EQIF)
+		{
+			variant = opcode - dsr::VMI_EQII;
+			op = "==";
+			resType = dsr::VMDATATYPE_BOOL;
+		}
+		else if (opcode >= dsr::VMI_LTEQII && opcode <= dsr::VMI_GTIF)
+		{
+			variant = (opcode - dsr::VMI_LTEQII) % 4;
+			op = s_compare[(opcode - dsr::VMI_LTEQII) / 4];
+			resType = dsr::VMDATATYPE_BOOL;
+		}
+		else
+			return false;
+
+		type1 = (variant == 0 || variant == 3) ? dsr::VMDATATYPE_INT : dsr::VMDATATYPE_FLOAT;
+		type2 = (variant == 0 || variant == 2) ? dsr::VMDATATYPE_INT : dsr::VMDATATYPE_FLOAT;
+		return true;
+	}
+
+	bool FunctionTranslator::Read(const TypeStack& stack, uint32 depth, uint32 type, std::string& expr)
+	{
+		//ints can be read from bools, anything else asserts in the interpreter
+		const uint32 slotType = stack[depth];
+		if (slotType == type)
+			expr = Slot(depth, type);
+		else if (slotType == dsr::VMDATATYPE_BOOL && type == dsr::VMDATATYPE_INT)
+			expr = "((int32) " + Slot(depth, slotType) + ")";
+		else
+			return false;
+
+		return true;
+	}
+
+	std::string FunctionTranslator::Slot(uint32 depth, uint32 type)
+	{
+		std::vector<bool>& slots = m_slots[type];
+		if (slots.size() <= depth)
+			slots.resize(depth + 1, false);
+		slots[depth] = true;
+		return GetSlotName(depth, type);
+	}
+
+	std::string FunctionTranslator::GetSlotName(uint32 depth, uint32 type)
+	{
+		const char prefix = type == dsr::VMDATATYPE_FLOAT ? 'f' : type == dsr::VMDATATYPE_INT ? 'i' : type == dsr::VMDATATYPE_BOOL ? 'b' : 'v';
+		return FORMAT("%c%u", prefix, depth);
+	}
+
+	const char* FunctionTranslator::GetTypeName(uint32 type)
+	{
+		return type == dsr::VMDATATYPE_FLOAT ? "float" : type == dsr::VMDATATYPE_INT ? "int32" : "bool";
+	}
+
+	const char* FunctionTranslator::GetDefaultValue(uint32 type)
+	{
+		return type == dsr::VMDATATYPE_FLOAT ? "0.0f" : type == dsr::VMDATATYPE_INT ? "0" : "false";
+	}
+
+	const char* FunctionTranslator::GetVMDataGetter(uint32 type)
+	{
+		return type == dsr::VMDATATYPE_FLOAT ? "GetFloat" : type == dsr::VMDATATYPE_INT ? "GetInt" : "GetBool";
+	}
+
+	std::string FunctionTranslator::GetFloatLiteral(uint32 bits)
+	{
+		//9 digits give back the same float, infinities and NaNs have no literal
+		if (((bits >> 23) & 0xFF) == 0xFF)
+			return FORMAT("CompiledFloat(0x%08Xu)", bits);
+
+		std::string literal = FORMAT("%.9g", *((float*) &bits));
+		if (literal.find_first_of(".e") == std::string::npos)
+			literal += ".0";
+		return literal + "f";
+	}
+
+	std::string FunctionTranslator::GetIntLiteral(uint32 bits)
+	{
+		if (bits == 0x80000000)
+			return "(-2147483647 - 1)";
+		return FORMAT("%d", (int32) bits);
+	}
+
+	void FunctionTranslator::Emit(std::string* pOut, const std::string& line)
+	{
+		if (!pOut)
+			return;
+
+		*pOut += "\t\t";
+		*pOut += line;
+		*pOut += "\n";
+	}
+
+	//-------------------------------------------------------------------------------------
+	uint32 CppBackend::Translate(const ScriptClass* pClass, std::string& source)
+	{
+		const ScriptClassDeclaration* pDecl = pClass->GetScriptDeclarationPtr();
+		const char* className = pDecl->GetName();
+
+		std::string functions;
+		std::string table;
+		uint32 numTranslated = 0;
+		for (uint32 i=0; i<pClass->GetNumFunctionImplementations(); ++i)
+		{
+			const FunctionImplementation* pFuncImpl = pClass->GetFunctionImplementationPtr(i);
+			const uint32 funcIdx = pClass->GetFunctionIndex(i);
+			const FunctionDeclaration* pFuncDecl = pDecl->GetFunctionDeclarationPtr(funcIdx);
+
+			//native functions have no code
+			if (pFuncImpl->GetVMCodeBlock().empty())
+				continue;
+
+			const std::string name = std::string(className) + "_" + pFuncDecl->GetName();
+			std::string function;
+			FunctionTranslator translator(pDecl, funcIdx, pFuncImpl, name);
+			if (!translator.Translate(function))
+				continue;
+
+			if (!functions.empty())
+				functions += "\n";
+			functions += FORMAT("\tconst ScriptedFunctionImplementation* s_pImpl%s = 0;\n\n", name.c_str());
+			functions += function;
+			table += FORMAT("\t\t{ \"%s\", %u, 0x%08Xu, %s, &s_pImpl%s },\n", className, funcIdx,
+				GetCodeHash(pFuncImpl, pFuncDecl), name.c_str(), name.c_str());
+			++numTranslated;
+		}
+
+		source += FORMAT("//C++ translation of script class %s, generated by dsc.\n", className);
+		source += "//It only runs while the loaded class has the bytecode it was translated from.\n\n";
+		source += "#include \"DSRCompiledFunction.h\"\n\n";
+		source += "using namespace dsr;\n\n";
+		if (numTranslated > 0)
+		{
+			source += "namespace\n{\n";
+			source += functions;
+			source += "}\n\n";
+		}
+		source += FORMAT("void RegisterCompiled%s()\n{\n", className);
+		if (numTranslated > 0)
+		{
+			source += "\tstatic const CompiledFunction s_functions[] =\n\t{\n";
+			source += table;
+			source += "\t};\n";
+			source += FORMAT("\tScriptManagerPtr()->Add(s_functions, %u);\n", numTranslated);
+		}
+		source += "}\n";
+
+		return numTranslated;
+	}
+
+	uint32 CppBackend::GetCodeHash(const FunctionImplementation* pFuncImpl, const FunctionDeclaration* pFuncDecl)
+	{
+		const FunctionImplementation::VMCodeBlock& code = pFuncImpl->GetVMCodeBlock();
+		uint32 hash = dsr::VMCODEHASH_SEED;
+		for (uint32 i=0; i<code.size(); ++i)
+			hash = dsr::HashVMCode(hash, code[i]);
+
+		hash = dsr::HashVMCode(hash, GetRuntimeType(pFuncDecl->GetReturnType()));
+		hash = dsr::HashVMCode(hash, pFuncDecl->GetNumParameters());
+		for (uint32 i=0; i<pFuncDecl->GetNumParameters(); ++i)
+			hash = dsr::HashVMCode(hash, pFuncDecl->GetParameterDataDeclarationPtr(i)->GetType());
+		hash = dsr::HashVMCode(hash, pFuncImpl->GetNumLocals());
+		for (uint32 i=0; i<pFuncImpl->GetNumLocals(); ++i)
+			hash = dsr::HashVMCode(hash, pFuncImpl->GetLocalDataDeclarationPtr(i)->GetType());
+		return hash;
+	}
+}
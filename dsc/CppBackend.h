@@ -0,0 +1,28 @@
+#if !defined(DSC_CPPBACKEND_H_)
+#define DSC_CPPBACKEND_H_
+
+#include <string>
+#include "ScriptClass.h"
+
+namespace dsc
+{
+	//-------------------------------------------------------------------------------------
+	/// Translates the bytecode of a compiled script class to C++.
+	/// The translation unit defines RegisterCompiled<Class>(), which registers the
+	/// translated functions with the dsr::ScriptManager as dsr::CompiledFunction entries.
+	/// They run in place of the bytecode while the loaded class has the same code.
+	///
+	/// Functions over numbers and bools are translated.  Constructors, native functions and
+	/// functions using native types, new or instance calls stay bytecode.  Calls go through
+	/// the runtime, except tail calls of the function itself, which become loops.
+	class CppBackend
+	{
+	public:
+		/// appends the translation unit of pClass to source, returns the number of functions translated
+		static uint32 Translate(const ScriptClass* pClass, std::string& source);
+		/// hash dsr::ScriptedFunctionImplementation::GetCodeHash gives the loaded function
+		static uint32 GetCodeHash(const FunctionImplementation* pFuncImpl, const FunctionDeclaration* pFuncDecl);
+	};
+}
+
+#endif
@@ -0,0 +1,2422 @@
+#include <cassert>
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+#include "IR.h"
+
+namespace dsc
+{
+	static dsr::VMBytecode BuildCode(uint32 type, uint32 value = 0)
+	{
+		return (type << 24) | (value & 0x00FFFFFF);
+	}
+
+	static uint32 ExtractUnsignedValue(dsr::VMBytecode code)
+	{
+		return code & 0x00FFFFFF;
+	}
+
+	static uint32 ExtractVMInstruction(dsr::VMBytecode code)
+	{
+		return code >> 24;
+	}
+
+	bool HasDataWord(uint32 opcode)
+	{
+		switch (opcode)
+		{
+		case dsr::VMI_CALLF_SELF_G:
+		case dsr::VMI_CALLF_SUPER_G:
+		case dsr::VMI_CALLF_PUSHED_G:
+		case dsr::VMI_CALLC_PUSHED_G:
+		case dsr::VMI_CALLC_SELF_SUPER:
+		case dsr::VMI_CALLF_SELF_D:
+		case dsr::VMI_CALLF_PUSHED_D:
+		case dsr::VMI_PUSHF:
+		case dsr::VMI_PUSHI:
+			return true;
+		}
+
+		return false;
+	}
+
+	/// result type of the arithmetic, logic and fetch instructions
+	static uint32 GetResultType(uint32 opcode)
+	{
+		switch (opcode)
+		{
+		case dsr::VMI_FETCHSF:
+		case dsr::VMI_PUSHF:
+		case dsr::VMI_NEGF:
+		case dsr::VMI_DIVFF:
+		case dsr::VMI_DIVFI:
+		case dsr::VMI_DIVIF:
+		case dsr::VMI_MULFF:
+		case dsr::VMI_MULFI:
+		case dsr::VMI_MULIF:
+		case dsr::VMI_SUBFF:
+		case dsr::VMI_SUBFI:
+		case dsr::VMI_SUBIF:
+		case dsr::VMI_ADDFF:
+		case dsr::VMI_ADDFI:
+		case dsr::VMI_ADDIF:
+			return dsr::VMDATATYPE_FLOAT;
+
+		case dsr::VMI_FETCHSI:
+		case dsr::VMI_PUSHI:
+		case dsr::VMI_NEGI:
+		case dsr::VMI_DIVII:
+		case dsr::VMI_MULII:
+		case dsr::VMI_SUBII:
+		case dsr::VMI_ADDII:
+		case dsr::VMI_MOD:
+			return dsr::VMDATATYPE_INT;
+
+		case dsr::VMI_FETCHSN:
+			return dsr::VMDATATYPE_NATIVE;
+		}
+
+		if (opcode >= dsr::VMI_EQII && opcode <= dsr::VMI_OR)
+			return dsr::VMDATATYPE_BOOL;
+		if (opcode == dsr::VMI_FETCHSB || opcode == dsr::VMI_PUSHB || opcode == dsr::VMI_NOT || opcode == dsr::VMI_ISN)
+			return dsr::VMDATATYPE_BOOL;
+
+		return dsr::VMDATATYPE_MAX;
+	}
+
+	static bool IsUnaryOperation(uint32 opcode)
+	{
+		return opcode == dsr::VMI_NEGF || opcode == dsr::VMI_NEGI || opcode == dsr::VMI_NOT;
+	}
+
+	static bool IsBinaryOperation(uint32 opcode)
+	{
+		return opcode >= dsr::VMI_DIVII && opcode <= dsr::VMI_OR;
+	}
+
+	/// opcode that gives the same result with the operands reversed, VMI_INVALID if there is none
+	static uint32 GetSwappedOpcode(uint32 opcode)
+	{
+		switch (opcode)
+		{
+		case dsr::VMI_MULII:
+		case dsr::VMI_MULFF:
+		case dsr::VMI_ADDII:
+		case dsr::VMI_ADDFF:
+		case dsr::VMI_EQII:
+		case dsr::VMI_EQFF:
+		case dsr::VMI_EQBB:
+		case dsr::VMI_AND:
+		case dsr::VMI_OR:
+			return opcode;
+
+		case dsr::VMI_MULFI: return dsr::VMI_MULIF;
+		case dsr::VMI_MULIF: return dsr::VMI_MULFI;
+		case dsr::VMI_ADDFI: return dsr::VMI_ADDIF;
+		case dsr::VMI_ADDIF: return dsr::VMI_ADDFI;
+		case dsr::VMI_EQFI: return dsr::VMI_EQIF;
+		case dsr::VMI_EQIF: return dsr::VMI_EQFI;
+		case dsr::VMI_LTEQII: return dsr::VMI_GTEQII;
+		case dsr::VMI_LTEQFF: return dsr::VMI_GTEQFF;
+		case dsr::VMI_LTEQFI: return dsr::VMI_GTEQIF;
+		case dsr::VMI_LTEQIF: return dsr::VMI_GTEQFI;
+		case dsr::VMI_LTII: return dsr::VMI_GTII;
+		case dsr::VMI_LTFF: return dsr::VMI_GTFF;
+		case dsr::VMI_LTFI: return dsr::VMI_GTIF;
+		case dsr::VMI_LTIF: return dsr::VMI_GTFI;
+		case dsr::VMI_GTEQII: return dsr::VMI_LTEQII;
+		case dsr::VMI_GTEQFF: return dsr::VMI_LTEQFF;
+		case dsr::VMI_GTEQFI: return dsr::VMI_LTEQIF;
+		case dsr::VMI_GTEQIF: return dsr::VMI_LTEQFI;
+		case dsr::VMI_GTII: return dsr::VMI_LTII;
+		case dsr::VMI_GTFF: return dsr::VMI_LTFF;
+		case dsr::VMI_GTFI: return dsr::VMI_LTIF;
+		case dsr::VMI_GTIF: return dsr::VMI_LTFI;
+		}
+
+		return dsr::VMI_INVALID;
+	}
+
+	static uint32 GetLocalStoreOpcode(uint32 type)
+	{
+		switch (type)
+		{
+		case dsr::VMDATATYPE_FLOAT: return dsr::VMI_STORELF;
+		case dsr::VMDATATYPE_INT: return dsr::VMI_STORELI;
+		case dsr::VMDATATYPE_BOOL: return dsr::VMI_STORELB;
+		}
+
+		assert(type == dsr::VMDATATYPE_NATIVE);
+		return dsr::VMI_STORELN;
+	}
+
+	static uint32 GetParamFetchOpcode(uint32 type)
+	{
+		switch (type)
+		{
+		case dsr::VMDATATYPE_FLOAT: return dsr::VMI_FETCHPF;
+		case dsr::VMDATATYPE_INT: return dsr::VMI_FETCHPI;
+		case dsr::VMDATATYPE_BOOL: return dsr::VMI_FETCHPB;
+		}
+
+		assert(type == dsr::VMDATATYPE_NATIVE);
+		return dsr::VMI_FETCHPN;
+	}
+
+	static uint32 GetLocalFetchOpcode(uint32 type)
+	{
+		switch (type)
+		{
+		case dsr::VMDATATYPE_FLOAT: return dsr::VMI_FETCHLF;
+		case dsr::VMDATATYPE_INT: return dsr::VMI_FETCHLI;
+		case dsr::VMDATATYPE_BOOL: return dsr::VMI_FETCHLB;
+		}
+
+		assert(type == dsr::VMDATATYPE_NATIVE);
+		return dsr::VMI_FETCHLN;
+	}
+
+	//--------------------------------------------------------------------------------
+	bool IRInstruction::IsConstant() const
+	{
+		return m_opcode == dsr::VMI_PUSHF || m_opcode == dsr::VMI_PUSHI || m_opcode == dsr::VMI_PUSHB;
+	}
+
+	bool IRInstruction::IsTerminator() const
+	{
+		return m_opcode == dsr::VMI_JMP || m_opcode == dsr::VMI_JZ || m_opcode == dsr::VMI_RET;
+	}
+
+	bool IRInstruction::IsFieldFetch() const
+	{
+		return m_opcode >= dsr::VMI_FETCHSF && m_opcode <= dsr::VMI_FETCHSN;
+	}
+
+	bool IRInstruction::IsFieldStore() const
+	{
+		return m_opcode >= dsr::VMI_STORESF && m_opcode <= dsr::VMI_STORESN;
+	}
+
+	bool IRInstruction::IsCall() const
+	{
+		switch (m_opcode)
+		{
+		case dsr::VMI_CALLF_SELF_G:
+		case dsr::VMI_CALLF_SUPER_G:
+		case dsr::VMI_CALLF_PUSHED_G:
+		case dsr::VMI_CALLC_PUSHED_G:
+		case dsr::VMI_CALLC_SELF_SUPER:
+		case dsr::VMI_CALLF_SELF_D:
+		case dsr::VMI_CALLF_PUSHED_D:
+		case dsr::VMI_NEW:
+			return true;
+		}
+
+		return false;
+	}
+
+	bool IRInstruction::SwapOperands()
+	{
+		const uint32 opcode = GetSwappedOpcode(m_opcode);
+		if (opcode == dsr::VMI_INVALID)
+			return false;
+
+		assert(m_operands.size() == 2);
+		m_opcode = opcode;
+		std::swap(m_operands[0], m_operands[1]);
+		return true;
+	}
+
+	bool IRInstruction::CanTrap() const
+	{
+		return m_opcode == dsr::VMI_DIVII || m_opcode == dsr::VMI_MOD;
+	}
+
+	bool IRInstruction::HasSideEffects() const
+	{
+		return IsTerminator() || IsFieldStore() || IsCall();
+	}
+
+	//--------------------------------------------------------------------------------
+	uint32 IRBlock::GetNumPhis() const
+	{
+		uint32 num = 0;
+		while (num < m_instructions.size() && m_instructions[num]->IsPhi())
+			++num;
+		return num;
+	}
+
+	void IRBlock::AddInstruction(IRInstruction* pInst)
+	{
+		pInst->SetBlockPtr(this);
+		m_instructions.push_back(pInst);
+	}
+
+	void IRBlock::InsertInstruction(IRInstruction* pInst)
+	{
+		assert(!m_instructions.empty() && GetTerminatorPtr()->IsTerminator());
+		pInst->SetBlockPtr(this);
+		m_instructions.insert(m_instructions.end() - 1, pInst);
+	}
+
+	void IRBlock::InsertPhi(IRInstruction* pPhi)
+	{
+		assert(pPhi->IsPhi());
+		pPhi->SetBlockPtr(this);
+		m_instructions.insert(m_instructions.begin() + GetNumPhis(), pPhi);
+	}
+
+	void IRBlock::RemoveInstruction(uint32 idx)
+	{
+		m_instructions[idx]->SetBlockPtr(0);
+		m_instructions.erase(m_instructions.begin() + idx);
+	}
+
+	uint32 IRBlock::GetPredecessorIndex(const IRBlock* pBlock) const
+	{
+		for (uint32 i=0; i<m_preds.size(); ++i)
+		{
+			if (m_preds[i] == pBlock)
+				return i;
+		}
+
+		return -1;
+	}
+
+	//--------------------------------------------------------------------------------
+	IRFunction::IRFunction()
+	: m_nextBlockId(0), m_pClassDecl(0)
+	{
+	}
+
+	IRFunction::~IRFunction()
+	{
+		for (uint32 i=0; i<m_instructions.size(); ++i)
+			delete m_instructions[i];
+		for (uint32 i=0; i<m_allBlocks.size(); ++i)
+			delete m_allBlocks[i];
+	}
+
+	uint32 IRFunction::GetNumInstructions() const
+	{
+		uint32 num = 0;
+		for (uint32 i=0; i<m_blocks.size(); ++i)
+			num += m_blocks[i]->GetNumInstructions();
+		return num;
+	}
+
+	IRInstruction* IRFunction::CreateInstruction(uint32 opcode, uint32 value, uint32 type, const char* nativeType)
+	{
+		IRInstruction* pInst = new IRInstruction((uint32) m_instructions.size(), opcode, value, type, nativeType);
+		m_instructions.push_back(pInst);
+		return pInst;
+	}
+
+	IRBlock* IRFunction::CreateBlock()
+	{
+		IRBlock* pBlock = new IRBlock(m_nextBlockId++);
+		m_allBlocks.push_back(pBlock);
+		return pBlock;
+	}
+
+	void IRFunction::InsertBlockAfter(IRBlock* pBlock, const IRBlock* pPrev)
+	{
+		IRBlockPtrArray::iterator it = std::find(m_blocks.begin(), m_blocks.end(), pPrev);
+		assert(it != m_blocks.end());
+		m_blocks.insert(it + 1, pBlock);
+	}
+
+	void IRFunction::InsertBlockBefore(IRBlock* pBlock, const IRBlock* pNext)
+	{
+		IRBlockPtrArray::iterator it = std::find(m_blocks.begin(), m_blocks.end(), pNext);
+		assert(it != m_blocks.end());
+		m_blocks.insert(it, pBlock);
+	}
+
+	void IRFunction::AddEdge(IRBlock* pFrom, IRBlock* pTo)
+	{
+		pFrom->m_succs.push_back(pTo);
+		pTo->m_preds.push_back(pFrom);
+	}
+
+	void IRFunction::ReplaceInstructions(IRInstructionPtrArray& replacements)
+	{
+		assert(replacements.size() == m_instructions.size());
+
+		//resolve chains
+		for (uint32 i=0; i<replacements.size(); ++i)
+		{
+			IRInstruction* pRepl = replacements[i];
+			if (!pRepl)
+				continue;
+
+			uint32 guard = 0;
+			while (replacements[pRepl->GetId()] && guard++ < replacements.size())
+				pRepl = replacements[pRepl->GetId()];
+			assert(pRepl->GetId() != i);
+			replacements[i] = pRepl;
+		}
+
+		for (uint32 b=0; b<m_blocks.size(); ++b)
+		{
+			IRBlock* pBlock = m_blocks[b];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); )
+			{
+				IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				if (replacements[pInst->GetId()])
+				{
+					pBlock->RemoveInstruction(i);
+					continue;
+				}
+
+				for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+				{
+					IRInstruction* pRepl = replacements[pInst->GetOperandPtr(o)->GetId()];
+					if (pRepl)
+						pInst->SetOperandPtr(o, pRepl);
+				}
+				++i;
+			}
+		}
+	}
+
+	void IRFunction::RemoveDeadInstructions()
+	{
+		//mark everything that side effects depend on
+		std::vector<bool> live(m_instructions.size(), false);
+		IRInstructionPtrArray work;
+		for (uint32 b=0; b<m_blocks.size(); ++b)
+		{
+			for (uint32 i=0; i<m_blocks[b]->GetNumInstructions(); ++i)
+			{
+				IRInstruction* pInst = m_blocks[b]->GetInstructionPtr(i);
+				if (pInst->HasSideEffects())
+				{
+					live[pInst->GetId()] = true;
+					work.push_back(pInst);
+				}
+			}
+		}
+
+		while (!work.empty())
+		{
+			IRInstruction* pInst = work.back();
+			work.pop_back();
+			for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+			{
+				IRInstruction* pOp = pInst->GetOperandPtr(o);
+				if (!live[pOp->GetId()])
+				{
+					live[pOp->GetId()] = true;
+					work.push_back(pOp);
+				}
+			}
+		}
+
+		//sweep
+		for (uint32 b=0; b<m_blocks.size(); ++b)
+		{
+			IRBlock* pBlock = m_blocks[b];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); )
+			{
+				if (!live[pBlock->GetInstructionPtr(i)->GetId()])
+					pBlock->RemoveInstruction(i);
+				else
+					++i;
+			}
+		}
+	}
+
+	void IRFunction::ComputeDominators()
+	{
+		//post order with an explicit stack, functions can have lots of blocks
+		m_rpo.clear();
+		for (uint32 b=0; b<m_blocks.size(); ++b)
+		{
+			m_blocks[b]->m_rpoIdx = -1;
+			m_blocks[b]->m_pIDom = 0;
+		}
+
+		std::vector<bool> visited(m_nextBlockId, false);
+		std::vector<std::pair<IRBlock*, uint32> > stack;
+		stack.push_back(std::make_pair(m_blocks[0], 0u));
+		visited[m_blocks[0]->GetId()] = true;
+		while (!stack.empty())
+		{
+			IRBlock* pBlock = stack.back().first;
+			const uint32 succIdx = stack.back().second;
+			if (succIdx < pBlock->GetNumSuccessors())
+			{
+				++stack.back().second;
+				IRBlock* pSucc = pBlock->GetSuccessorPtr(succIdx);
+				if (!visited[pSucc->GetId()])
+				{
+					visited[pSucc->GetId()] = true;
+					stack.push_back(std::make_pair(pSucc, 0u));
+				}
+			}
+			else
+			{
+				m_rpo.push_back(pBlock);
+				stack.pop_back();
+			}
+		}
+		std::reverse(m_rpo.begin(), m_rpo.end());
+		for (uint32 i=0; i<m_rpo.size(); ++i)
+			m_rpo[i]->m_rpoIdx = i;
+
+		//Cooper, Harvey, Kennedy: "A Simple, Fast Dominance Algorithm"
+		IRBlock* pEntry = m_rpo[0];
+		pEntry->m_pIDom = pEntry;
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (uint32 i=1; i<m_rpo.size(); ++i)
+			{
+				IRBlock* pBlock = m_rpo[i];
+				IRBlock* pNewIDom = 0;
+				for (uint32 p=0; p<pBlock->GetNumPredecessors(); ++p)
+				{
+					IRBlock* pPred = pBlock->GetPredecessorPtr(p);
+					if (!pPred->m_pIDom)
+						continue;
+
+					if (!pNewIDom)
+					{
+						pNewIDom = pPred;
+						continue;
+					}
+
+					IRBlock* pFinger1 = pPred;
+					IRBlock* pFinger2 = pNewIDom;
+					while (pFinger1 != pFinger2)
+					{
+						while (pFinger1->m_rpoIdx > pFinger2->m_rpoIdx)
+							pFinger1 = pFinger1->m_pIDom;
+						while (pFinger2->m_rpoIdx > pFinger1->m_rpoIdx)
+							pFinger2 = pFinger2->m_pIDom;
+					}
+					pNewIDom = pFinger1;
+				}
+
+				if (pBlock->m_pIDom != pNewIDom)
+				{
+					pBlock->m_pIDom = pNewIDom;
+					changed = true;
+				}
+			}
+		}
+		pEntry->m_pIDom = 0;
+	}
+
+	bool IRFunction::Dominates(const IRBlock* pDom, const IRBlock* pBlock) const
+	{
+		while (pBlock && pBlock != pDom)
+			pBlock = pBlock->GetIDomPtr();
+		return pBlock == pDom;
+	}
+
+	IRBlock* IRFunction::SplitEdge(IRBlock* pBlock, uint32 succIdx)
+	{
+		IRBlock* pSucc = pBlock->m_succs[succIdx];
+		const uint32 predIdx = pSucc->GetPredecessorIndex(pBlock);
+		assert(predIdx != -1);
+
+		IRBlock* pNew = CreateBlock();
+		pNew->AddInstruction(CreateInstruction(dsr::VMI_JMP, 0, dsr::VMDATATYPE_MAX, ""));
+		pNew->m_preds.push_back(pBlock);
+		pNew->m_succs.push_back(pSucc);
+		pBlock->m_succs[succIdx] = pNew;
+		pSucc->m_preds[predIdx] = pNew;
+
+		//keep fall through edges next to each other
+		if (succIdx == 0)
+			InsertBlockAfter(pNew, pBlock);
+		else
+			InsertBlockBefore(pNew, pSucc);
+
+		return pNew;
+	}
+
+	IRBlock* IRFunction::InsertPreheader(IRBlock* pHeader, const std::vector<bool>& loop)
+	{
+		IRBlock* pPre = CreateBlock();
+		pPre->AddInstruction(CreateInstruction(dsr::VMI_JMP, 0, dsr::VMDATATYPE_MAX, ""));
+
+		std::vector<uint32> outside;
+		for (uint32 p=0; p<pHeader->GetNumPredecessors(); ++p)
+		{
+			if (!loop[pHeader->GetPredecessorPtr(p)->GetId()])
+				outside.push_back(p);
+		}
+		assert(!outside.empty());
+
+		//values entering the loop now come through the preheader
+		const uint32 numPhis = pHeader->GetNumPhis();
+		for (uint32 i=0; i<numPhis; ++i)
+		{
+			IRInstruction* pPhi = pHeader->GetInstructionPtr(i);
+			IRInstruction* pValue = pPhi->GetOperandPtr(outside[0]);
+			if (outside.size() > 1)
+			{
+				pValue = CreateInstruction(IRInstruction::IROP_PHI, 0, pPhi->GetType(), pPhi->GetNativeType());
+				for (uint32 o=0; o<outside.size(); ++o)
+					pValue->AddOperand(pPhi->GetOperandPtr(outside[o]));
+				pPre->InsertPhi(pValue);
+			}
+
+			IRInstructionPtrArray ops;
+			for (uint32 p=0; p<pHeader->GetNumPredecessors(); ++p)
+			{
+				if (loop[pHeader->GetPredecessorPtr(p)->GetId()])
+					ops.push_back(pPhi->GetOperandPtr(p));
+			}
+			ops.push_back(pValue);
+
+			while (pPhi->GetNumOperands() > ops.size())
+				pPhi->RemoveOperand(pPhi->GetNumOperands() - 1);
+			for (uint32 o=0; o<ops.size(); ++o)
+				pPhi->SetOperandPtr(o, ops[o]);
+		}
+
+		//rewire the edges
+		IRBlockPtrArray preds;
+		for (uint32 p=0; p<pHeader->GetNumPredecessors(); ++p)
+		{
+			IRBlock* pPred = pHeader->GetPredecessorPtr(p);
+			if (loop[pPred->GetId()])
+			{
+				preds.push_back(pPred);
+				continue;
+			}
+
+			for (uint32 s=0; s<pPred->GetNumSuccessors(); ++s)
+			{
+				if (pPred->m_succs[s] == pHeader)
+					pPred->m_succs[s] = pPre;
+			}
+			pPre->m_preds.push_back(pPred);
+		}
+		preds.push_back(pPre);
+		pHeader->m_preds = preds;
+		pPre->m_succs.push_back(pHeader);
+
+		InsertBlockBefore(pPre, pHeader);
+		return pPre;
+	}
+
+	void IRFunction::RedirectEdge(IRBlock* pBlock, uint32 succIdx, IRBlock* pNewSucc, const IRInstructionPtrArray& phiOperands)
+	{
+		IRBlock* pOld = pBlock->m_succs[succIdx];
+		const uint32 predIdx = pOld->GetPredecessorIndex(pBlock);
+		assert(predIdx != -1);
+		assert(phiOperands.size() == pNewSucc->GetNumPhis());
+
+		pOld->m_preds.erase(pOld->m_preds.begin() + predIdx);
+		for (uint32 i=0; i<pOld->GetNumPhis(); ++i)
+			pOld->GetInstructionPtr(i)->RemoveOperand(predIdx);
+
+		pBlock->m_succs[succIdx] = pNewSucc;
+		pNewSucc->m_preds.push_back(pBlock);
+		for (uint32 i=0; i<phiOperands.size(); ++i)
+			pNewSucc->GetInstructionPtr(i)->AddOperand(phiOperands[i]);
+	}
+
+	IRBlock* IRFunction::InlineCall(IRInstruction* pCall, const IRFunction& callee)
+	{
+		IRBlock* pBlock = pCall->GetBlockPtr();
+		uint32 callIdx = 0;
+		while (pBlock->GetInstructionPtr(callIdx) != pCall)
+			++callIdx;
+
+		//the code behind the call continues in a block of its own
+		IRBlock* pCont = CreateBlock();
+		IRInstructionPtrArray tail(pBlock->m_instructions.begin() + callIdx + 1, pBlock->m_instructions.end());
+		while (pBlock->GetNumInstructions() > callIdx)
+			pBlock->RemoveInstruction(pBlock->GetNumInstructions() - 1);
+		for (uint32 i=0; i<tail.size(); ++i)
+			pCont->AddInstruction(tail[i]);
+
+		pCont->m_succs = pBlock->m_succs;
+		for (uint32 s=0; s<pCont->GetNumSuccessors(); ++s)
+		{
+			IRBlock* pSucc = pCont->m_succs[s];
+			pSucc->m_preds[pSucc->GetPredecessorIndex(pBlock)] = pCont;
+		}
+		pBlock->m_succs.clear();
+		InsertBlockAfter(pCont, pBlock);
+
+		//copy the blocks, in front of the continuation
+		std::vector<IRBlock*> blockMap(callee.m_nextBlockId, (IRBlock*) 0);
+		for (uint32 b=0; b<callee.m_blocks.size(); ++b)
+		{
+			IRBlock* pNew = CreateBlock();
+			blockMap[callee.m_blocks[b]->GetId()] = pNew;
+			InsertBlockBefore(pNew, pCont);
+		}
+
+		//copy the instructions, parameters are the arguments and native locals get a slot of their own
+		IRInstructionPtrArray instMap(callee.m_instructions.size(), (IRInstruction*) 0);
+		std::vector<uint32> localMap(callee.m_locals.size(), -1);
+		for (uint32 b=0; b<callee.m_blocks.size(); ++b)
+		{
+			const IRBlock* pOld = callee.m_blocks[b];
+			for (uint32 i=0; i<pOld->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pOld->GetInstructionPtr(i);
+				uint32 value = pInst->GetValue();
+				if (pInst->GetOpcode() == IRInstruction::IROP_PARAM)
+				{
+					instMap[pInst->GetId()] = pCall->GetOperandPtr(value);
+					continue;
+				}
+				else if (pInst->GetOpcode() == IRInstruction::IROP_LOCAL)
+				{
+					if (localMap[value] == -1)
+					{
+						localMap[value] = (uint32) m_locals.size();
+						m_locals.push_back(callee.m_locals[value]);
+					}
+					value = localMap[value];
+				}
+				else if (pInst->GetOpcode() == dsr::VMI_CALLF_SELF_D || pInst->GetOpcode() == dsr::VMI_CALLF_PUSHED_D)
+					value = AddDirectCall(callee.m_directCalls[value]);
+
+				instMap[pInst->GetId()] = CreateInstruction(pInst->GetOpcode(), value, pInst->GetType(), pInst->GetNativeType());
+			}
+		}
+
+		//returns jump to the continuation, which merges the returned values
+		IRInstructionPtrArray results;
+		for (uint32 b=0; b<callee.m_blocks.size(); ++b)
+		{
+			const IRBlock* pOld = callee.m_blocks[b];
+			IRBlock* pNew = blockMap[pOld->GetId()];
+			for (uint32 i=0; i<pOld->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pOld->GetInstructionPtr(i);
+				IRInstruction* pCopy = instMap[pInst->GetId()];
+				if (pInst->GetOpcode() == IRInstruction::IROP_PARAM)
+					continue;
+
+				if (pInst->GetOpcode() == dsr::VMI_RET)
+				{
+					results.push_back(instMap[pInst->GetOperandPtr(0)->GetId()]);
+					pNew->AddInstruction(CreateInstruction(dsr::VMI_JMP, 0, dsr::VMDATATYPE_MAX, ""));
+					AddEdge(pNew, pCont);
+					continue;
+				}
+
+				for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+					pCopy->AddOperand(instMap[pInst->GetOperandPtr(o)->GetId()]);
+				pNew->AddInstruction(pCopy);
+			}
+
+			//same edge order, it is the order of the phi operands
+			for (uint32 s=0; s<pOld->GetNumSuccessors(); ++s)
+				pNew->m_succs.push_back(blockMap[pOld->GetSuccessorPtr(s)->GetId()]);
+			for (uint32 p=0; p<pOld->GetNumPredecessors(); ++p)
+				pNew->m_preds.push_back(blockMap[pOld->GetPredecessorPtr(p)->GetId()]);
+		}
+
+		pBlock->AddInstruction(CreateInstruction(dsr::VMI_JMP, 0, dsr::VMDATATYPE_MAX, ""));
+		AddEdge(pBlock, blockMap[callee.m_blocks[0]->GetId()]);
+
+		//uses of the call get the returned value
+		assert(!results.empty());
+		IRInstruction* pResult = results[0];
+		if (results.size() > 1)
+		{
+			pResult = CreateInstruction(IRInstruction::IROP_PHI, 0, pCall->GetType(), pCall->GetNativeType());
+			for (uint32 i=0; i<results.size(); ++i)
+				pResult->AddOperand(results[i]);
+			pCont->InsertPhi(pResult);
+		}
+
+		IRInstructionPtrArray replacements(m_instructions.size(), (IRInstruction*) 0);
+		replacements[pCall->GetId()] = pResult;
+		ReplaceInstructions(replacements);
+		return pCont;
+	}
+
+	uint32 IRFunction::AddDirectCall(const DirectCall& call)
+	{
+		for (uint32 i=0; i<m_directCalls.size(); ++i)
+		{
+			if (m_directCalls[i] == call)
+				return i;
+		}
+
+		m_directCalls.push_back(call);
+		return (uint32) m_directCalls.size() - 1;
+	}
+
+	void IRFunction::MergeIntoPredecessor(IRBlock* pBlock)
+	{
+		assert(pBlock != m_blocks[0] && pBlock->GetNumPredecessors() == 1);
+		IRBlock* pPred = pBlock->m_preds[0];
+		assert(pPred != pBlock && pPred->GetNumSuccessors() == 1);
+
+		//phis with one operand are that operand
+		const uint32 numPhis = pBlock->GetNumPhis();
+		if (numPhis > 0)
+		{
+			IRInstructionPtrArray replacements(m_instructions.size(), (IRInstruction*) 0);
+			for (uint32 i=0; i<numPhis; ++i)
+				replacements[pBlock->GetInstructionPtr(i)->GetId()] = pBlock->GetInstructionPtr(i)->GetOperandPtr(0);
+			ReplaceInstructions(replacements);
+		}
+
+		pPred->RemoveInstruction(pPred->GetNumInstructions() - 1);
+		for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			pPred->AddInstruction(pBlock->GetInstructionPtr(i));
+		pBlock->m_instructions.clear();
+
+		pPred->m_succs = pBlock->m_succs;
+		for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+		{
+			IRBlock* pSucc = pBlock->m_succs[s];
+			pSucc->m_preds[pSucc->GetPredecessorIndex(pBlock)] = pPred;
+		}
+		pBlock->m_preds.clear();
+		pBlock->m_succs.clear();
+		m_blocks.erase(std::find(m_blocks.begin(), m_blocks.end(), pBlock));
+	}
+
+	void IRFunction::DuplicateReturn(IRBlock* pBlock)
+	{
+		assert(pBlock->GetNumSuccessors() == 1 && pBlock->GetTerminatorPtr()->GetOpcode() == dsr::VMI_JMP);
+		IRBlock* pSucc = pBlock->m_succs[0];
+		const IRInstruction* pRet = pSucc->GetTerminatorPtr();
+		assert(pRet->GetOpcode() == dsr::VMI_RET && pSucc->GetNumInstructions() == pSucc->GetNumPhis() + 1);
+
+		const uint32 predIdx = pSucc->GetPredecessorIndex(pBlock);
+		IRInstruction* pValue = pRet->GetOperandPtr(0);
+		if (pValue->IsPhi() && pValue->GetBlockPtr() == pSucc)
+			pValue = pValue->GetOperandPtr(predIdx);
+
+		IRInstruction* pNewRet = CreateInstruction(dsr::VMI_RET, pRet->GetValue(), pRet->GetType(), pRet->GetNativeType());
+		pNewRet->AddOperand(pValue);
+		pBlock->RemoveInstruction(pBlock->GetNumInstructions() - 1);
+		pBlock->AddInstruction(pNewRet);
+
+		pSucc->m_preds.erase(pSucc->m_preds.begin() + predIdx);
+		for (uint32 i=0; i<pSucc->GetNumPhis(); ++i)
+			pSucc->GetInstructionPtr(i)->RemoveOperand(predIdx);
+		pBlock->m_succs.clear();
+	}
+
+	void IRFunction::RemoveUnreachableBlocks()
+	{
+		std::vector<bool> reachable(m_nextBlockId, false);
+		IRBlockPtrArray work;
+		reachable[m_blocks[0]->GetId()] = true;
+		work.push_back(m_blocks[0]);
+		while (!work.empty())
+		{
+			IRBlock* pBlock = work.back();
+			work.pop_back();
+			for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+			{
+				IRBlock* pSucc = pBlock->GetSuccessorPtr(s);
+				if (!reachable[pSucc->GetId()])
+				{
+					reachable[pSucc->GetId()] = true;
+					work.push_back(pSucc);
+				}
+			}
+		}
+
+		IRBlockPtrArray blocks;
+		for (uint32 b=0; b<m_blocks.size(); ++b)
+		{
+			IRBlock* pBlock = m_blocks[b];
+			if (reachable[pBlock->GetId()])
+			{
+				blocks.push_back(pBlock);
+				continue;
+			}
+
+			//the edges into reachable blocks go away with it
+			for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+			{
+				IRBlock* pSucc = pBlock->GetSuccessorPtr(s);
+				if (!reachable[pSucc->GetId()])
+					continue;
+
+				const uint32 predIdx = pSucc->GetPredecessorIndex(pBlock);
+				pSucc->m_preds.erase(pSucc->m_preds.begin() + predIdx);
+				for (uint32 i=0; i<pSucc->GetNumPhis(); ++i)
+					pSucc->GetInstructionPtr(i)->RemoveOperand(predIdx);
+			}
+			pBlock->m_preds.clear();
+			pBlock->m_succs.clear();
+		}
+		m_blocks.swap(blocks);
+	}
+
+	//--------------------------------------------------------------------------------
+	/// Turns stack bytecode into SSA form.
+	/// Locals, parameters and the operand stack slots at block boundaries are all
+	/// treated as variables, phis are placed on the dominance frontiers and renamed
+	/// in a walk over the dominator tree.
+	class IRFunction::Builder
+	{
+	public:
+		Builder(IRFunction& func, const VMCodeBlock& code, const FunctionImplementation& funcImpl, const FunctionDeclaration& funcDecl,
+			const ScriptClassDeclaration& classDecl, const IRCallSiteArray& callSites)
+		: m_func(func), m_code(code), m_funcImpl(funcImpl), m_funcDecl(funcDecl), m_classDecl(classDecl), m_callSites(callSites) {}
+
+		bool Build();
+
+	private:
+		/// code range of a block, and what it does to the operand stack
+		struct BlockCode
+		{
+			BlockCode() : m_begin(0), m_end(0), m_stackIn(-1), m_stackOut(0), m_jzAsJmp(false) {}
+
+			uint32 m_begin;
+			uint32 m_end;
+			uint32 m_stackIn;
+			uint32 m_stackOut;
+			bool m_jzAsJmp;
+		};
+
+		/// position in the walk of the dominator tree
+		struct Frame
+		{
+			IRBlock* m_pBlock;
+			uint32 m_child;
+			uint32 m_logSize;
+		};
+
+		bool FindBlocks();
+		bool ComputeStackDepths();
+		bool GetStackEffect(uint32 pc, uint32& numPops, uint32& numPushes) const;
+		const IRCallSite* FindCallSite(uint32 pc) const;
+		void PlacePhis();
+		bool Rename();
+		bool RenameBlock(IRBlock* pBlock, std::vector<uint32>& defLog);
+		void Define(uint32 var, IRInstruction* pValue, std::vector<uint32>& defLog);
+		IRInstruction* GetCurrentDef(uint32 var) const;
+		void GetVariableType(uint32 var, uint32& type, const char*& nativeType) const;
+		uint32 GetParamVar(uint32 idx) const { return idx; }
+		uint32 GetLocalVar(uint32 idx) const { return m_funcDecl.GetNumParameters() + idx; }
+		uint32 GetStackVar(uint32 idx) const { return m_funcDecl.GetNumParameters() + m_funcImpl.GetNumLocals() + idx; }
+		uint32 GetNumVars() const { return GetStackVar(m_maxStack); }
+
+	private:
+		IRFunction& m_func;
+		const VMCodeBlock& m_code;
+		const FunctionImplementation& m_funcImpl;
+		const FunctionDeclaration& m_funcDecl;
+		const ScriptClassDeclaration& m_classDecl;
+		const IRCallSiteArray& m_callSites;
+
+		/// indexed by block id
+		std::vector<BlockCode> m_blockCode;
+		/// phis and the variable they belong to, indexed by block id
+		std::vector<std::vector<std::pair<uint32, IRInstruction*> > > m_phis;
+		/// definitions currently visible during renaming, per variable
+		std::vector<IRInstructionPtrArray> m_defs;
+		uint32 m_maxStack;
+	};
+
+	const IRCallSite* IRFunction::Builder::FindCallSite(uint32 pc) const
+	{
+		//call sites are recorded in code order
+		uint32 lo = 0;
+		uint32 hi = (uint32) m_callSites.size();
+		while (lo < hi)
+		{
+			const uint32 mid = (lo + hi) / 2;
+			if (m_callSites[mid].GetCodePos() < pc)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo < m_callSites.size() && m_callSites[lo].GetCodePos() == pc)
+			return &m_callSites[lo];
+		return 0;
+	}
+
+	bool IRFunction::Builder::GetStackEffect(uint32 pc, uint32& numPops, uint32& numPushes) const
+	{
+		const uint32 opcode = ExtractVMInstruction(m_code[pc]);
+		numPops = 0;
+		numPushes = 0;
+
+		switch (opcode)
+		{
+		case dsr::VMI_NOP:
+		case dsr::VMI_JMP:
+			return true;
+
+		case dsr::VMI_CALLF_SELF_G:
+		case dsr::VMI_CALLF_SUPER_G:
+		case dsr::VMI_CALLF_PUSHED_G:
+		case dsr::VMI_CALLC_PUSHED_G:
+		case dsr::VMI_CALLC_SELF_SUPER:
+		case dsr::VMI_CALLF_SELF_D:
+		case dsr::VMI_CALLF_PUSHED_D:
+			{
+				const IRCallSite* pCallSite = FindCallSite(pc);
+				if (!pCallSite)
+					return false;
+
+				numPops = pCallSite->GetNumArgs();
+				if (opcode == dsr::VMI_CALLF_PUSHED_G || opcode == dsr::VMI_CALLC_PUSHED_G || opcode == dsr::VMI_CALLF_PUSHED_D)
+					++numPops;
+				numPushes = 1;
+			}
+			return true;
+
+		case dsr::VMI_RET:
+		case dsr::VMI_JZ:
+		case dsr::VMI_POP:
+			numPops = 1;
+			return true;
+
+		case dsr::VMI_NEW:
+		case dsr::VMI_PUSHF:
+		case dsr::VMI_PUSHI:
+		case dsr::VMI_PUSHB:
+			numPushes = 1;
+			return true;
+		}
+
+		if (opcode >= dsr::VMI_STORESF && opcode <= dsr::VMI_STOREPN)
+		{
+			numPops = 1;
+			return true;
+		}
+
+		if (opcode >= dsr::VMI_FETCHSF && opcode <= dsr::VMI_FETCHPN)
+		{
+			numPushes = 1;
+			return true;
+		}
+
+		if (IsUnaryOperation(opcode) || opcode == dsr::VMI_ISN || opcode == dsr::VMI_CASTN)
+		{
+			numPops = 1;
+			numPushes = 1;
+			return true;
+		}
+
+		if (IsBinaryOperation(opcode))
+		{
+			numPops = 2;
+			numPushes = 1;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool IRFunction::Builder::FindBlocks()
+	{
+		const uint32 codeSize = (uint32) m_code.size();
+		if (codeSize == 0)
+			return false;
+
+		//find block starts
+		std::vector<bool> leaders(codeSize + 1, false);
+		leaders[0] = true;
+		for (uint32 pc=0; pc<codeSize; ++pc)
+		{
+			const uint32 opcode = ExtractVMInstruction(m_code[pc]);
+			if (opcode == dsr::VMI_JMP || opcode == dsr::VMI_JZ)
+			{
+				const uint32 target = ExtractUnsignedValue(m_code[pc]);
+				if (target >= codeSize)
+					return false;
+				leaders[target] = true;
+			}
+
+			if (opcode == dsr::VMI_JMP || opcode == dsr::VMI_JZ || opcode == dsr::VMI_RET)
+				leaders[pc + 1] = true;
+
+			if (HasDataWord(opcode))
+				++pc;
+		}
+
+		//the entry block only holds the initial values of the variables.
+		//that way no code block is the entry and loop headers always have a predecessor outside the loop.
+		IRBlock* pEntry = m_func.CreateBlock();
+		m_blockCode.push_back(BlockCode());
+		m_blockCode.back().m_stackIn = 0;
+
+		std::vector<IRBlock*> blockAtPc(codeSize, (IRBlock*) 0);
+		for (uint32 pc=0; pc<codeSize; ++pc)
+		{
+			if (!leaders[pc])
+				continue;
+
+			IRBlock* pBlock = m_func.CreateBlock();
+			blockAtPc[pc] = pBlock;
+			m_blockCode.push_back(BlockCode());
+			m_blockCode.back().m_begin = pc;
+		}
+
+		//block ends and edges
+		for (uint32 b=1; b<m_func.m_allBlocks.size(); ++b)
+		{
+			IRBlock* pBlock = m_func.m_allBlocks[b];
+			BlockCode& bc = m_blockCode[pBlock->GetId()];
+			bc.m_end = (b + 1 < m_func.m_allBlocks.size()) ? m_blockCode[b + 1].m_begin : codeSize;
+
+			//find the last instruction
+			uint32 lastPc = bc.m_begin;
+			for (uint32 pc=bc.m_begin; pc<bc.m_end; ++pc)
+			{
+				lastPc = pc;
+				if (HasDataWord(ExtractVMInstruction(m_code[pc])))
+					++pc;
+			}
+
+			const uint32 opcode = ExtractVMInstruction(m_code[lastPc]);
+			IRBlock* pNext = bc.m_end < codeSize ? blockAtPc[bc.m_end] : 0;
+			if (opcode == dsr::VMI_JMP)
+			{
+				m_func.AddEdge(pBlock, blockAtPc[ExtractUnsignedValue(m_code[lastPc])]);
+			}
+			else if (opcode == dsr::VMI_JZ)
+			{
+				IRBlock* pTarget = blockAtPc[ExtractUnsignedValue(m_code[lastPc])];
+				if (!pNext)
+					return false;
+
+				m_func.AddEdge(pBlock, pNext);
+				if (pTarget != pNext)
+					m_func.AddEdge(pBlock, pTarget);
+				else
+					bc.m_jzAsJmp = true;
+			}
+			else if (opcode != dsr::VMI_RET)
+			{
+				//falls through
+				if (!pNext)
+					return false;
+				m_func.AddEdge(pBlock, pNext);
+			}
+		}
+
+		m_func.AddEdge(pEntry, blockAtPc[0]);
+
+		//only keep reachable blocks, in code order
+		std::vector<bool> reachable(m_func.m_allBlocks.size(), false);
+		IRBlockPtrArray work;
+		work.push_back(pEntry);
+		reachable[pEntry->GetId()] = true;
+		while (!work.empty())
+		{
+			IRBlock* pBlock = work.back();
+			work.pop_back();
+			for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+			{
+				IRBlock* pSucc = pBlock->GetSuccessorPtr(s);
+				if (!reachable[pSucc->GetId()])
+				{
+					reachable[pSucc->GetId()] = true;
+					work.push_back(pSucc);
+				}
+			}
+		}
+
+		for (uint32 b=0; b<m_func.m_allBlocks.size(); ++b)
+		{
+			IRBlock* pBlock = m_func.m_allBlocks[b];
+			if (!reachable[pBlock->GetId()])
+				continue;
+
+			//forget edges coming from dead code
+			IRBlockPtrArray preds;
+			for (uint32 p=0; p<pBlock->GetNumPredecessors(); ++p)
+			{
+				if (reachable[pBlock->GetPredecessorPtr(p)->GetId()])
+					preds.push_back(pBlock->GetPredecessorPtr(p));
+			}
+			pBlock->m_preds = preds;
+
+			m_func.m_blocks.push_back(pBlock);
+		}
+
+		return true;
+	}
+
+	bool IRFunction::Builder::ComputeStackDepths()
+	{
+		m_maxStack = 0;
+
+		IRBlockPtrArray work;
+		work.push_back(m_func.m_blocks[0]);
+		while (!work.empty())
+		{
+			IRBlock* pBlock = work.back();
+			work.pop_back();
+
+			BlockCode& bc = m_blockCode[pBlock->GetId()];
+			uint32 depth = bc.m_stackIn;
+			for (uint32 pc=bc.m_begin; pc<bc.m_end; ++pc)
+			{
+				uint32 numPops, numPushes;
+				if (!GetStackEffect(pc, numPops, numPushes) || numPops > depth)
+					return false;
+
+				depth = depth - numPops + numPushes;
+				m_maxStack = std::max(m_maxStack, depth);
+				if (HasDataWord(ExtractVMInstruction(m_code[pc])))
+					++pc;
+			}
+
+			//returns leave nothing behind
+			if (pBlock->GetNumSuccessors() == 0 && depth != 0)
+				return false;
+
+			bc.m_stackOut = depth;
+			for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+			{
+				BlockCode& succ = m_blockCode[pBlock->GetSuccessorPtr(s)->GetId()];
+				if (succ.m_stackIn == -1)
+				{
+					succ.m_stackIn = depth;
+					work.push_back(pBlock->GetSuccessorPtr(s));
+				}
+				else if (succ.m_stackIn != depth)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void IRFunction::Builder::GetVariableType(uint32 var, uint32& type, const char*& nativeType) const
+	{
+		const DataDeclaration* pDecl = 0;
+		if (var < GetLocalVar(0))
+			pDecl = m_funcDecl.GetParameterDataDeclarationPtr(var);
+		else if (var < GetStackVar(0))
+			pDecl = m_funcImpl.GetLocalDataDeclarationPtr(var - GetLocalVar(0));
+
+		if (pDecl)
+		{
+			type = pDecl->GetType();
+			nativeType = pDecl->GetNativeType();
+		}
+		else
+		{
+			//stack slots take the type of the incoming values after renaming
+			type = dsr::VMDATATYPE_MAX;
+			nativeType = "";
+		}
+	}
+
+	void IRFunction::Builder::PlacePhis()
+	{
+		const uint32 numBlocks = m_func.GetMaxBlockId();
+		m_phis.resize(numBlocks);
+
+		//dominance frontiers
+		std::vector<IRBlockPtrArray> frontiers(numBlocks);
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			IRBlock* pBlock = m_func.m_blocks[b];
+			if (pBlock->GetNumPredecessors() < 2)
+				continue;
+
+			for (uint32 p=0; p<pBlock->GetNumPredecessors(); ++p)
+			{
+				IRBlock* pRunner = pBlock->GetPredecessorPtr(p);
+				while (pRunner && pRunner != pBlock->GetIDomPtr())
+				{
+					IRBlockPtrArray& df = frontiers[pRunner->GetId()];
+					if (std::find(df.begin(), df.end(), pBlock) == df.end())
+						df.push_back(pBlock);
+					pRunner = pRunner->GetIDomPtr();
+				}
+			}
+		}
+
+		//definition sites of every variable
+		std::vector<IRBlockPtrArray> defSites(GetNumVars());
+		for (uint32 v=0; v<GetStackVar(0); ++v)
+			defSites[v].push_back(m_func.m_blocks[0]);
+		for (uint32 b=1; b<m_func.m_blocks.size(); ++b)
+		{
+			IRBlock* pBlock = m_func.m_blocks[b];
+			const BlockCode& bc = m_blockCode[pBlock->GetId()];
+			for (uint32 pc=bc.m_begin; pc<bc.m_end; ++pc)
+			{
+				const uint32 opcode = ExtractVMInstruction(m_code[pc]);
+				uint32 var = -1;
+				if (opcode >= dsr::VMI_STORELF && opcode <= dsr::VMI_STORELN)
+					var = GetLocalVar(ExtractUnsignedValue(m_code[pc]));
+				else if (opcode >= dsr::VMI_STOREPF && opcode <= dsr::VMI_STOREPN)
+					var = GetParamVar(ExtractUnsignedValue(m_code[pc]));
+
+				if (var != -1 && (defSites[var].empty() || defSites[var].back() != pBlock))
+					defSites[var].push_back(pBlock);
+
+				if (HasDataWord(opcode))
+					++pc;
+			}
+
+			for (uint32 k=0; k<bc.m_stackOut; ++k)
+				defSites[GetStackVar(k)].push_back(pBlock);
+		}
+
+		//iterated dominance frontiers
+		std::vector<uint32> hasPhi(numBlocks, -1);
+		std::vector<uint32> inWork(numBlocks, -1);
+		for (uint32 v=0; v<GetNumVars(); ++v)
+		{
+			IRBlockPtrArray work = defSites[v];
+			for (uint32 i=0; i<work.size(); ++i)
+				inWork[work[i]->GetId()] = v;
+
+			while (!work.empty())
+			{
+				IRBlock* pBlock = work.back();
+				work.pop_back();
+
+				const IRBlockPtrArray& df = frontiers[pBlock->GetId()];
+				for (uint32 i=0; i<df.size(); ++i)
+				{
+					IRBlock* pFrontier = df[i];
+					if (hasPhi[pFrontier->GetId()] == v)
+						continue;
+
+					//stack slots are only live where the stack is that deep
+					if (v >= GetStackVar(0) && m_blockCode[pFrontier->GetId()].m_stackIn <= v - GetStackVar(0))
+						continue;
+
+					uint32 type;
+					const char* nativeType;
+					GetVariableType(v, type, nativeType);
+					IRInstruction* pPhi = m_func.CreateInstruction(IRInstruction::IROP_PHI, 0, type, nativeType);
+					for (uint32 p=0; p<pFrontier->GetNumPredecessors(); ++p)
+						pPhi->AddOperand(0);
+					pFrontier->InsertPhi(pPhi);
+					m_phis[pFrontier->GetId()].push_back(std::make_pair(v, pPhi));
+					hasPhi[pFrontier->GetId()] = v;
+
+					if (inWork[pFrontier->GetId()] != v)
+					{
+						inWork[pFrontier->GetId()] = v;
+						work.push_back(pFrontier);
+					}
+				}
+			}
+		}
+	}
+
+	void IRFunction::Builder::Define(uint32 var, IRInstruction* pValue, std::vector<uint32>& defLog)
+	{
+		m_defs[var].push_back(pValue);
+		defLog.push_back(var);
+	}
+
+	IRInstruction* IRFunction::Builder::GetCurrentDef(uint32 var) const
+	{
+		if (m_defs[var].empty())
+			return 0;
+		return m_defs[var].back();
+	}
+
+	bool IRFunction::Builder::RenameBlock(IRBlock* pBlock, std::vector<uint32>& defLog)
+	{
+		const BlockCode& bc = m_blockCode[pBlock->GetId()];
+
+		//phis define their variable on entry
+		const std::vector<std::pair<uint32, IRInstruction*> >& phis = m_phis[pBlock->GetId()];
+		for (uint32 i=0; i<phis.size(); ++i)
+			Define(phis[i].first, phis[i].second, defLog);
+
+		IRInstructionPtrArray stack;
+		for (uint32 k=0; k<bc.m_stackIn; ++k)
+		{
+			IRInstruction* pValue = GetCurrentDef(GetStackVar(k));
+			if (!pValue)
+				return false;
+			stack.push_back(pValue);
+		}
+
+		bool terminated = false;
+		for (uint32 pc=bc.m_begin; pc<bc.m_end; ++pc)
+		{
+			const uint32 opcode = ExtractVMInstruction(m_code[pc]);
+			const uint32 imm = ExtractUnsignedValue(m_code[pc]);
+			const uint32 data = HasDataWord(opcode) ? m_code[pc + 1] : 0;
+
+			uint32 numPops, numPushes;
+			if (!GetStackEffect(pc, numPops, numPushes) || numPops > stack.size())
+				return false;
+
+			IRInstruction* pInst = 0;
+			if (opcode == dsr::VMI_NOP)
+			{
+			}
+			else if (opcode == dsr::VMI_POP)
+			{
+				//unused values are dropped, lowering pops them again
+				stack.pop_back();
+			}
+			else if (opcode >= dsr::VMI_FETCHLF && opcode <= dsr::VMI_FETCHLN)
+			{
+				stack.push_back(GetCurrentDef(GetLocalVar(imm)));
+			}
+			else if (opcode >= dsr::VMI_FETCHPF && opcode <= dsr::VMI_FETCHPN)
+			{
+				stack.push_back(GetCurrentDef(GetParamVar(imm)));
+			}
+			else if ((opcode >= dsr::VMI_STORELF && opcode <= dsr::VMI_STORELN) || (opcode >= dsr::VMI_STOREPF && opcode <= dsr::VMI_STOREPN))
+			{
+				const uint32 var = opcode <= dsr::VMI_STORELN ? GetLocalVar(imm) : GetParamVar(imm);
+				uint32 type;
+				const char* nativeType;
+				GetVariableType(var, type, nativeType);
+
+				pInst = m_func.CreateInstruction(IRInstruction::IROP_COPY, 0, type, nativeType);
+				pInst->AddOperand(stack.back());
+				stack.pop_back();
+				pBlock->AddInstruction(pInst);
+				Define(var, pInst, defLog);
+			}
+			else
+			{
+				//everything else maps to one instruction
+				uint32 value = imm;
+				uint32 type = GetResultType(opcode);
+				const char* nativeType = "";
+				if (HasDataWord(opcode))
+					value = data;
+
+				if (opcode == dsr::VMI_FETCHSN)
+				{
+					if (imm >= m_classDecl.GetNumData())
+						return false;
+					nativeType = m_classDecl.GetDataDeclarationPtr(imm)->GetNativeType();
+				}
+				else if (opcode == dsr::VMI_NEW || opcode == dsr::VMI_CASTN)
+				{
+					if (imm >= m_funcImpl.GetNumNewClassNames())
+						return false;
+					type = dsr::VMDATATYPE_NATIVE;
+					nativeType = m_funcImpl.GetNewClassName(imm);
+				}
+				else if (numPushes > 0 && type == dsr::VMDATATYPE_MAX)
+				{
+					//calls.  void functions push a bool that is never used.
+					const IRCallSite* pCallSite = FindCallSite(pc);
+					assert(pCallSite);
+					type = pCallSite->GetReturnType();
+					nativeType = pCallSite->GetNativeReturnType();
+					if (type == dsr::VMDATATYPE_VOID)
+						type = dsr::VMDATATYPE_BOOL;
+				}
+				else if (opcode == dsr::VMI_JZ && bc.m_jzAsJmp)
+				{
+					stack.pop_back();
+					numPops = 0;
+					value = 0;
+					pInst = m_func.CreateInstruction(dsr::VMI_JMP, 0, dsr::VMDATATYPE_MAX, "");
+				}
+				else if (opcode == dsr::VMI_JMP || opcode == dsr::VMI_JZ)
+				{
+					//targets are given by the successors
+					value = 0;
+				}
+
+				if (!pInst)
+					pInst = m_func.CreateInstruction(opcode, value, numPushes > 0 ? type : dsr::VMDATATYPE_MAX, nativeType);
+
+				for (uint32 o=0; o<numPops; ++o)
+					pInst->AddOperand(stack[stack.size() - numPops + o]);
+				stack.resize(stack.size() - numPops);
+				if (numPushes > 0)
+					stack.push_back(pInst);
+
+				terminated = pInst->IsTerminator();
+				pBlock->AddInstruction(pInst);
+			}
+
+			if (!stack.empty() && !stack.back())
+				return false;
+
+			if (HasDataWord(opcode))
+				++pc;
+		}
+
+		if (!terminated)
+			pBlock->AddInstruction(m_func.CreateInstruction(dsr::VMI_JMP, 0, dsr::VMDATATYPE_MAX, ""));
+
+		//the stack left behind defines the stack slots for the successors
+		assert(stack.size() == bc.m_stackOut);
+		for (uint32 k=0; k<stack.size(); ++k)
+			Define(GetStackVar(k), stack[k], defLog);
+
+		//fill in phi operands of the successors
+		for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+		{
+			IRBlock* pSucc = pBlock->GetSuccessorPtr(s);
+			const uint32 predIdx = pSucc->GetPredecessorIndex(pBlock);
+			const std::vector<std::pair<uint32, IRInstruction*> >& succPhis = m_phis[pSucc->GetId()];
+			for (uint32 i=0; i<succPhis.size(); ++i)
+			{
+				IRInstruction* pValue = GetCurrentDef(succPhis[i].first);
+				if (!pValue)
+					return false;
+				succPhis[i].second->SetOperandPtr(predIdx, pValue);
+			}
+		}
+
+		return true;
+	}
+
+	bool IRFunction::Builder::Rename()
+	{
+		m_defs.resize(GetNumVars());
+
+		//initial values, in the entry block
+		IRBlock* pEntry = m_func.m_blocks[0];
+		std::vector<uint32> entryLog;
+		for (uint32 i=0; i<m_funcDecl.GetNumParameters(); ++i)
+		{
+			const DataDeclaration* pParam = m_funcDecl.GetParameterDataDeclarationPtr(i);
+			IRInstruction* pInst = m_func.CreateInstruction(IRInstruction::IROP_PARAM, i, pParam->GetType(), pParam->GetNativeType());
+			pEntry->AddInstruction(pInst);
+			Define(GetParamVar(i), pInst, entryLog);
+		}
+
+		for (uint32 i=0; i<m_funcImpl.GetNumLocals(); ++i)
+		{
+			const DataDeclaration* pLocal = m_funcImpl.GetLocalDataDeclarationPtr(i);
+			IRInstruction* pInst = 0;
+			switch (pLocal->GetType())
+			{
+			case dsr::VMDATATYPE_FLOAT:
+				pInst = m_func.CreateInstruction(dsr::VMI_PUSHF, 0, dsr::VMDATATYPE_FLOAT, "");
+				break;
+			case dsr::VMDATATYPE_INT:
+				pInst = m_func.CreateInstruction(dsr::VMI_PUSHI, 0, dsr::VMDATATYPE_INT, "");
+				break;
+			case dsr::VMDATATYPE_BOOL:
+				pInst = m_func.CreateInstruction(dsr::VMI_PUSHB, 0, dsr::VMDATATYPE_BOOL, "");
+				break;
+			case dsr::VMDATATYPE_NATIVE:
+				pInst = m_func.CreateInstruction(IRInstruction::IROP_LOCAL, i, dsr::VMDATATYPE_NATIVE, pLocal->GetNativeType());
+				break;
+			default:
+				return false;
+			}
+			pEntry->AddInstruction(pInst);
+			Define(GetLocalVar(i), pInst, entryLog);
+		}
+		pEntry->AddInstruction(m_func.CreateInstruction(dsr::VMI_JMP, 0, dsr::VMDATATYPE_MAX, ""));
+
+		//dominator tree
+		std::vector<IRBlockPtrArray> children(m_func.GetMaxBlockId());
+		for (uint32 b=1; b<m_func.m_blocks.size(); ++b)
+			children[m_func.m_blocks[b]->GetIDomPtr()->GetId()].push_back(m_func.m_blocks[b]);
+
+		//walk it without recursion, nested ifs make deep trees
+		std::vector<uint32> defLog;
+		std::vector<Frame> stack;
+		Frame entryFrame = { pEntry, 0, 0 };
+		stack.push_back(entryFrame);
+		for (uint32 s=0; s<pEntry->GetNumSuccessors(); ++s)
+		{
+			IRBlock* pSucc = pEntry->GetSuccessorPtr(s);
+			const std::vector<std::pair<uint32, IRInstruction*> >& succPhis = m_phis[pSucc->GetId()];
+			for (uint32 i=0; i<succPhis.size(); ++i)
+				succPhis[i].second->SetOperandPtr(pSucc->GetPredecessorIndex(pEntry), GetCurrentDef(succPhis[i].first));
+		}
+
+		while (!stack.empty())
+		{
+			Frame& frame = stack.back();
+			const IRBlockPtrArray& kids = children[frame.m_pBlock->GetId()];
+			if (frame.m_child < kids.size())
+			{
+				IRBlock* pChild = kids[frame.m_child++];
+				Frame childFrame = { pChild, 0, (uint32) defLog.size() };
+				if (!RenameBlock(pChild, defLog))
+					return false;
+				stack.push_back(childFrame);
+				continue;
+			}
+
+			//leaving the block, its definitions go out of scope
+			while (defLog.size() > frame.m_logSize)
+			{
+				m_defs[defLog.back()].pop_back();
+				defLog.pop_back();
+			}
+			stack.pop_back();
+		}
+
+		//phis of stack slots get the type of what flows in
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+			{
+				const std::vector<std::pair<uint32, IRInstruction*> >& phis = m_phis[m_func.m_blocks[b]->GetId()];
+				for (uint32 i=0; i<phis.size(); ++i)
+				{
+					IRInstruction* pPhi = phis[i].second;
+					if (pPhi->HasResult())
+						continue;
+
+					for (uint32 o=0; o<pPhi->GetNumOperands(); ++o)
+					{
+						IRInstruction* pOp = pPhi->GetOperandPtr(o);
+						if (pOp && pOp->HasResult())
+						{
+							pPhi->SetType(pOp->GetType(), pOp->GetNativeType());
+							changed = true;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const std::vector<std::pair<uint32, IRInstruction*> >& phis = m_phis[m_func.m_blocks[b]->GetId()];
+			for (uint32 i=0; i<phis.size(); ++i)
+			{
+				IRInstruction* pPhi = phis[i].second;
+				for (uint32 o=0; o<pPhi->GetNumOperands(); ++o)
+				{
+					if (!pPhi->GetOperandPtr(o))
+						return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool IRFunction::Builder::Build()
+	{
+		if (!FindBlocks())
+			return false;
+		if (!ComputeStackDepths())
+			return false;
+
+		m_func.ComputeDominators();
+		PlacePhis();
+		if (!Rename())
+			return false;
+
+		//unpruned phis
+		m_func.RemoveDeadInstructions();
+		return true;
+	}
+
+	bool IRFunction::Build(const VMCodeBlock& code, const FunctionImplementation& funcImpl, const FunctionDeclaration& funcDecl,
+		const ScriptClassDeclaration& classDecl, const IRCallSiteArray& callSites)
+	{
+		assert(m_blocks.empty());
+		m_pClassDecl = &classDecl;
+
+		for (uint32 i=0; i<funcImpl.GetNumLocals(); ++i)
+			m_locals.push_back((DataDeclaration*) funcImpl.GetLocalDataDeclarationPtr(i));
+		for (uint32 i=0; i<funcImpl.GetNumDirectCalls(); ++i)
+			m_directCalls.push_back(funcImpl.GetDirectCall(i));
+
+		Builder builder(*this, code, funcImpl, funcDecl, classDecl, callSites);
+		return builder.Build();
+	}
+
+	//--------------------------------------------------------------------------------
+	void IRFunction::ComputeAvailableFieldFetches(std::vector<IRInstructionPtrArray>& availIn, std::vector<IRInstructionPtrArray>& availOut)
+	{
+		ComputeDominators();
+
+		availIn.clear();
+		availOut.clear();
+		availIn.resize(m_nextBlockId);
+		availOut.resize(m_nextBlockId);
+		std::vector<bool> known(m_nextBlockId, false);
+
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (uint32 b=0; b<m_rpo.size(); ++b)
+			{
+				IRBlock* pBlock = m_rpo[b];
+
+				//intersect what the visited predecessors provide
+				IRInstructionPtrArray avail;
+				bool first = true;
+				for (uint32 p=0; p<pBlock->GetNumPredecessors(); ++p)
+				{
+					const IRBlock* pPred = pBlock->GetPredecessorPtr(p);
+					if (!known[pPred->GetId()])
+						continue;
+
+					const IRInstructionPtrArray& predOut = availOut[pPred->GetId()];
+					if (first)
+					{
+						avail = predOut;
+						first = false;
+						continue;
+					}
+
+					IRInstructionPtrArray isect;
+					std::set_intersection(avail.begin(), avail.end(), predOut.begin(), predOut.end(), std::back_inserter(isect));
+					avail.swap(isect);
+				}
+				availIn[pBlock->GetId()] = avail;
+
+				for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+					UpdateAvailableFieldFetches(pBlock->GetInstructionPtr(i), avail);
+
+				if (!known[pBlock->GetId()] || availOut[pBlock->GetId()] != avail)
+				{
+					known[pBlock->GetId()] = true;
+					availOut[pBlock->GetId()].swap(avail);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	void IRFunction::UpdateAvailableFieldFetches(const IRInstruction* pInst, IRInstructionPtrArray& avail)
+	{
+		if (pInst->IsCall())
+		{
+			avail.clear();
+		}
+		else if (pInst->IsFieldStore())
+		{
+			for (uint32 i=0; i<avail.size(); )
+			{
+				if (avail[i]->GetValue() == pInst->GetValue())
+					avail.erase(avail.begin() + i);
+				else
+					++i;
+			}
+		}
+		else if (pInst->IsFieldFetch())
+		{
+			//kept sorted, so that sets can be intersected
+			avail.insert(std::lower_bound(avail.begin(), avail.end(), (IRInstruction*) pInst), (IRInstruction*) pInst);
+		}
+	}
+
+	//--------------------------------------------------------------------------------
+	/// Turns SSA form back into stack code.
+	/// A value stays on the operand stack when it is used exactly once, later in the same
+	/// block, in stack order.  Constants, parameters and field fetches whose field can't
+	/// have changed are emitted again where they are used.  Everything else is kept in a
+	/// local; locals are shared by values that are never live at the same time.
+	class IRFunction::Lowering
+	{
+	public:
+		Lowering(IRFunction& func) : m_func(func), m_numSlots(0), m_pCode(0), m_curStack(0), m_maxStack(0) {}
+
+		bool Lower(VMCodeBlock& code, uint32& maxStackSize, DataDeclarationCPtrArray& locals);
+
+	private:
+		struct Slot
+		{
+			uint32 m_type;
+			const char* m_nativeType;
+		};
+
+		/// phis with an operand that already has a slot
+		struct HasSlottedOperand
+		{
+			HasSlottedOperand(const std::vector<uint32>& slots) : m_slots(slots) {}
+			bool operator()(const IRInstruction* pPhi) const
+			{
+				for (uint32 o=0; o<pPhi->GetNumOperands(); ++o)
+				{
+					if (m_slots[pPhi->GetOperandPtr(o)->GetId()] != -1)
+						return true;
+				}
+				return false;
+			}
+
+			const std::vector<uint32>& m_slots;
+		};
+
+		void SplitCriticalEdges();
+		void CountUses();
+		void OrderOperands();
+		void FindRematerializable();
+		bool ScheduleStack();
+		bool ScheduleBlock(const IRBlock* pBlock, bool& changed);
+		uint32 GetNumStackOperands(const IRInstruction* pInst) const;
+		bool IsFetchable(const IRInstruction* pInst) const { return m_remat[pInst->GetId()] || m_home[pInst->GetId()]; }
+		void ScanLiveness(const IRBlock* pBlock, const std::vector<std::vector<bool> >& liveIn, std::vector<bool>& live,
+			std::vector<std::vector<uint32> >* pInterference) const;
+		void AddInterference(const std::vector<bool>& live, uint32 homeIdx, std::vector<std::vector<uint32> >& interference) const;
+		bool AssignSlots(DataDeclarationCPtrArray& locals);
+		void Emit(VMCodeBlock& code, uint32& maxStackSize);
+		void EmitValue(const IRInstruction* pInst);
+		void EmitPhiCopies(const IRBlock* pBlock, const IRBlock* pSucc, bool runsOnce);
+		static bool IsZero(const IRInstruction* pInst) { return pInst->IsConstant() && pInst->GetValue() == 0; }
+		void Push() { ++m_curStack; m_maxStack = std::max(m_maxStack, m_curStack); }
+
+	private:
+		IRFunction& m_func;
+		/// indexed by instruction id
+		std::vector<uint32> m_numUses;
+		std::vector<bool> m_remat;
+		std::vector<bool> m_home;
+		std::vector<bool> m_crossBlock;
+		std::vector<uint32> m_slots;
+		uint32 m_numSlots;
+		/// slots stored to so far, while emitting
+		std::vector<bool> m_written;
+		/// values kept in locals get dense indices for the liveness sets
+		std::vector<uint32> m_homeIdx;
+		std::vector<uint32> m_homeIds;
+		/// slots of the native locals whose initial value is used
+		std::vector<uint32> m_localSlots;
+
+		VMCodeBlock* m_pCode;
+		uint32 m_curStack;
+		uint32 m_maxStack;
+	};
+
+	void IRFunction::Lowering::SplitCriticalEdges()
+	{
+		//phi copies go at the end of the predecessor, which must not branch anywhere else
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			IRBlock* pBlock = m_func.m_blocks[b];
+			if (pBlock->GetNumSuccessors() < 2)
+				continue;
+
+			for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+			{
+				IRBlock* pSucc = pBlock->GetSuccessorPtr(s);
+				if (pSucc->GetNumPredecessors() > 1 && pSucc->GetNumPhis() > 0)
+					m_func.SplitEdge(pBlock, s);
+			}
+		}
+	}
+
+	void IRFunction::Lowering::CountUses()
+	{
+		const uint32 numIds = m_func.GetMaxInstructionId();
+		m_numUses.assign(numIds, 0);
+		m_crossBlock.assign(numIds, false);
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+				{
+					const IRInstruction* pOp = pInst->GetOperandPtr(o);
+					++m_numUses[pOp->GetId()];
+					if (pInst->IsPhi() || pOp->GetBlockPtr() != pBlock)
+						m_crossBlock[pOp->GetId()] = true;
+				}
+			}
+		}
+	}
+
+	void IRFunction::Lowering::FindRematerializable()
+	{
+		m_remat.assign(m_func.GetMaxInstructionId(), false);
+
+		//field fetches can be repeated where the field still has the same value
+		std::vector<bool> fetchOk(m_func.GetMaxInstructionId(), true);
+		std::vector<IRInstructionPtrArray> availIn, availOut;
+		m_func.ComputeAvailableFieldFetches(availIn, availOut);
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			IRInstructionPtrArray avail = availIn[pBlock->GetId()];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+				{
+					IRInstruction* pOp = pInst->GetOperandPtr(o);
+					if (!pOp->IsFieldFetch())
+						continue;
+
+					//phi operands are read at the end of the predecessor
+					const IRInstructionPtrArray& at = pInst->IsPhi() ? availOut[pBlock->GetPredecessorPtr(o)->GetId()] : avail;
+					if (!std::binary_search(at.begin(), at.end(), pOp))
+						fetchOk[pOp->GetId()] = false;
+				}
+				UpdateAvailableFieldFetches(pInst, avail);
+			}
+		}
+
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				const uint32 opcode = pInst->GetOpcode();
+				if (pInst->IsConstant() || opcode == IRInstruction::IROP_PARAM || opcode == IRInstruction::IROP_LOCAL
+					|| (pInst->IsFieldFetch() && fetchOk[pInst->GetId()]))
+				{
+					m_remat[pInst->GetId()] = true;
+				}
+			}
+		}
+	}
+
+	void IRFunction::Lowering::OrderOperands()
+	{
+		//fetched operands are pushed right before the instruction, so an accumulation
+		//like s = s + e is cheaper as e + s, where e can stay on the stack
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			for (uint32 i=pBlock->GetNumPhis(); i<pBlock->GetNumInstructions(); ++i)
+			{
+				IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				if (IsBinaryOperation(pInst->GetOpcode()) && IsFetchable(pInst->GetOperandPtr(0)) && !IsFetchable(pInst->GetOperandPtr(1)))
+					pInst->SwapOperands();
+			}
+		}
+	}
+
+	uint32 IRFunction::Lowering::GetNumStackOperands(const IRInstruction* pInst) const
+	{
+		//operands that can be fetched are pushed right before the instruction, so only
+		//the ones in front of them have to be on the stack already
+		uint32 k = pInst->GetNumOperands();
+		while (k > 0 && IsFetchable(pInst->GetOperandPtr(k - 1)))
+			--k;
+		return k;
+	}
+
+	bool IRFunction::Lowering::ScheduleBlock(const IRBlock* pBlock, bool& changed)
+	{
+		IRInstructionPtrArray stack;
+		for (uint32 i=pBlock->GetNumPhis(); i<pBlock->GetNumInstructions(); ++i)
+		{
+			const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+			const uint32 k = GetNumStackOperands(pInst);
+
+			bool inOrder = stack.size() >= k;
+			for (uint32 o=0; inOrder && o<k; ++o)
+				inOrder = stack[stack.size() - k + o] == pInst->GetOperandPtr(o);
+
+			if (!inOrder)
+			{
+				//give up on keeping these on the stack
+				bool progress = false;
+				for (uint32 s=0; s<stack.size(); ++s)
+				{
+					progress = progress || !m_home[stack[s]->GetId()];
+					m_home[stack[s]->GetId()] = true;
+				}
+				for (uint32 o=0; o<k; ++o)
+				{
+					const IRInstruction* pOp = pInst->GetOperandPtr(o);
+					if (!IsFetchable(pOp))
+					{
+						m_home[pOp->GetId()] = true;
+						progress = true;
+					}
+				}
+
+				if (!progress)
+					return false;
+				changed = true;
+				return true;
+			}
+
+			stack.resize(stack.size() - k);
+			if (pInst->HasResult() && !IsFetchable(pInst) && m_numUses[pInst->GetId()] > 0)
+				stack.push_back((IRInstruction*) pInst);
+		}
+
+		//nothing is left on the stack at the end of a block
+		for (uint32 s=0; s<stack.size(); ++s)
+		{
+			m_home[stack[s]->GetId()] = true;
+			changed = true;
+		}
+
+		return true;
+	}
+
+	bool IRFunction::Lowering::ScheduleStack()
+	{
+		m_home.assign(m_func.GetMaxInstructionId(), false);
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				const uint32 id = pInst->GetId();
+				if (!pInst->HasResult() || m_remat[id])
+					continue;
+
+				if (pInst->IsPhi() || (m_numUses[id] > 0 && (m_numUses[id] != 1 || m_crossBlock[id])))
+					m_home[id] = true;
+			}
+		}
+
+		OrderOperands();
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			bool changed = true;
+			while (changed)
+			{
+				changed = false;
+				if (!ScheduleBlock(m_func.m_blocks[b], changed))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	void IRFunction::Lowering::AddInterference(const std::vector<bool>& live, uint32 homeIdx, std::vector<std::vector<uint32> >& interference) const
+	{
+		for (uint32 v=0; v<live.size(); ++v)
+		{
+			if (live[v] && v != homeIdx)
+			{
+				interference[homeIdx].push_back(v);
+				interference[v].push_back(homeIdx);
+			}
+		}
+	}
+
+	void IRFunction::Lowering::ScanLiveness(const IRBlock* pBlock, const std::vector<std::vector<bool> >& liveIn, std::vector<bool>& live,
+		std::vector<std::vector<uint32> >* pInterference) const
+	{
+		//live out: whatever the successors need, including the phi operands coming from here
+		live.assign(m_homeIds.size(), false);
+		for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+		{
+			const IRBlock* pSucc = pBlock->GetSuccessorPtr(s);
+			const std::vector<bool>& succIn = liveIn[pSucc->GetId()];
+			for (uint32 v=0; v<live.size(); ++v)
+			{
+				if (succIn[v])
+					live[v] = true;
+			}
+
+			const uint32 predIdx = pSucc->GetPredecessorIndex(pBlock);
+			for (uint32 i=0; i<pSucc->GetNumPhis(); ++i)
+			{
+				const uint32 homeIdx = m_homeIdx[pSucc->GetInstructionPtr(i)->GetOperandPtr(predIdx)->GetId()];
+				if (homeIdx != -1)
+					live[homeIdx] = true;
+			}
+		}
+
+		const uint32 numPhis = pBlock->GetNumPhis();
+		for (uint32 i=pBlock->GetNumInstructions(); i-->numPhis; )
+		{
+			const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+			const uint32 homeIdx = m_homeIdx[pInst->GetId()];
+			if (homeIdx != -1)
+			{
+				live[homeIdx] = false;
+				if (pInterference)
+					AddInterference(live, homeIdx, *pInterference);
+			}
+
+			for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+			{
+				const uint32 opIdx = m_homeIdx[pInst->GetOperandPtr(o)->GetId()];
+				if (opIdx != -1)
+					live[opIdx] = true;
+			}
+		}
+
+		//phis are written together on entry, while everything live into the block is alive as well
+		for (uint32 i=0; i<numPhis; ++i)
+			live[m_homeIdx[pBlock->GetInstructionPtr(i)->GetId()]] = true;
+		for (uint32 i=0; i<numPhis; ++i)
+		{
+			if (pInterference)
+				AddInterference(live, m_homeIdx[pBlock->GetInstructionPtr(i)->GetId()], *pInterference);
+		}
+		for (uint32 i=0; i<numPhis; ++i)
+			live[m_homeIdx[pBlock->GetInstructionPtr(i)->GetId()]] = false;
+	}
+
+	bool IRFunction::Lowering::AssignSlots(DataDeclarationCPtrArray& locals)
+	{
+		const uint32 numIds = m_func.GetMaxInstructionId();
+		const uint32 numBlocks = m_func.GetMaxBlockId();
+
+		//dense numbering of the values kept in locals
+		m_homeIdx.assign(numIds, -1);
+		m_homeIds.clear();
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				const uint32 id = pBlock->GetInstructionPtr(i)->GetId();
+				if (m_home[id])
+				{
+					m_homeIdx[id] = (uint32) m_homeIds.size();
+					m_homeIds.push_back(id);
+				}
+			}
+		}
+
+		//liveness, then one more scan to collect interferences
+		std::vector<std::vector<bool> > liveIn(numBlocks, std::vector<bool>(m_homeIds.size(), false));
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (uint32 b=(uint32) m_func.m_rpo.size(); b-->0; )
+			{
+				const IRBlock* pBlock = m_func.m_rpo[b];
+				std::vector<bool> live;
+				ScanLiveness(pBlock, liveIn, live, 0);
+				if (liveIn[pBlock->GetId()] != live)
+				{
+					liveIn[pBlock->GetId()].swap(live);
+					changed = true;
+				}
+			}
+		}
+
+		std::vector<std::vector<uint32> > interference(m_homeIds.size());
+		for (uint32 b=0; b<m_func.m_rpo.size(); ++b)
+		{
+			std::vector<bool> live;
+			ScanLiveness(m_func.m_rpo[b], liveIn, live, &interference);
+		}
+
+		//phis each value flows into
+		std::vector<IRInstructionPtrArray> phiUsers(numIds);
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			for (uint32 i=0; i<pBlock->GetNumPhis(); ++i)
+			{
+				IRInstruction* pPhi = pBlock->GetInstructionPtr(i);
+				for (uint32 o=0; o<pPhi->GetNumOperands(); ++o)
+					phiUsers[pPhi->GetOperandPtr(o)->GetId()].push_back(pPhi);
+			}
+		}
+
+		//greedy coloring, preferring the slot of a related phi so that copies disappear
+		std::vector<Slot> slots;
+		m_slots.assign(numIds, -1);
+		for (uint32 b=0; b<m_func.m_rpo.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_rpo[b];
+
+			//phis that can reuse the slot of an operand go first, before another phi takes it
+			IRInstructionPtrArray order;
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+				order.push_back(pBlock->GetInstructionPtr(i));
+			std::stable_partition(order.begin(), order.begin() + pBlock->GetNumPhis(), HasSlottedOperand(m_slots));
+
+			for (uint32 i=0; i<order.size(); ++i)
+			{
+				const IRInstruction* pInst = order[i];
+				if (!m_home[pInst->GetId()])
+					continue;
+
+				if (pInst->GetType() == dsr::VMDATATYPE_NATIVE && strlen(pInst->GetNativeType()) == 0)
+					return false;
+
+				std::vector<bool> taken(slots.size(), false);
+				const std::vector<uint32>& neighbours = interference[m_homeIdx[pInst->GetId()]];
+				for (uint32 n=0; n<neighbours.size(); ++n)
+				{
+					const uint32 neighbourSlot = m_slots[m_homeIds[neighbours[n]]];
+					if (neighbourSlot != -1)
+						taken[neighbourSlot] = true;
+				}
+
+				std::vector<uint32> preferred;
+				if (pInst->IsPhi())
+				{
+					for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+						preferred.push_back(m_slots[pInst->GetOperandPtr(o)->GetId()]);
+				}
+				const IRInstructionPtrArray& users = phiUsers[pInst->GetId()];
+				for (uint32 u=0; u<users.size(); ++u)
+					preferred.push_back(m_slots[users[u]->GetId()]);
+
+				uint32 slot = -1;
+				for (uint32 p=0; p<preferred.size() && slot == -1; ++p)
+				{
+					if (preferred[p] != -1 && !taken[preferred[p]])
+						slot = preferred[p];
+				}
+				for (uint32 s=0; s<slots.size() && slot == -1; ++s)
+				{
+					if (!taken[s])
+						slot = s;
+				}
+				if (slot != -1 && (slots[slot].m_type != pInst->GetType() || strcmp(slots[slot].m_nativeType, pInst->GetNativeType()) != 0))
+				{
+					//keep looking for one of the right type
+					slot = -1;
+					for (uint32 s=0; s<slots.size() && slot == -1; ++s)
+					{
+						if (!taken[s] && slots[s].m_type == pInst->GetType() && strcmp(slots[s].m_nativeType, pInst->GetNativeType()) == 0)
+							slot = s;
+					}
+				}
+
+				if (slot == -1)
+				{
+					Slot newSlot = { pInst->GetType(), pInst->GetNativeType() };
+					slot = (uint32) slots.size();
+					slots.push_back(newSlot);
+				}
+
+				m_slots[pInst->GetId()] = slot;
+			}
+		}
+
+		m_numSlots = (uint32) slots.size();
+		locals.clear();
+		for (uint32 s=0; s<slots.size(); ++s)
+		{
+			char name[32];
+			sprintf(name, "$%u", s);
+
+			DataDeclarationCPtr decl = new DataDeclaration();
+			decl->SetName(name);
+			decl->SetType(slots[s].m_type);
+			decl->SetNativeType(slots[s].m_nativeType);
+			decl->SetLine(0);
+			locals.push_back(decl);
+		}
+
+		//native locals that are read before being assigned keep their own, never written slot
+		m_localSlots.assign(m_func.m_locals.size(), -1);
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				if (pInst->GetOpcode() == IRInstruction::IROP_LOCAL && m_localSlots[pInst->GetValue()] == -1)
+				{
+					m_localSlots[pInst->GetValue()] = (uint32) locals.size();
+					locals.push_back(m_func.m_locals[pInst->GetValue()]);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void IRFunction::Lowering::EmitValue(const IRInstruction* pInst)
+	{
+		VMCodeBlock& code = *m_pCode;
+		const uint32 opcode = pInst->GetOpcode();
+		if (m_home[pInst->GetId()])
+			code.push_back(BuildCode(GetLocalFetchOpcode(pInst->GetType()), m_slots[pInst->GetId()]));
+		else if (opcode == IRInstruction::IROP_PARAM)
+			code.push_back(BuildCode(GetParamFetchOpcode(pInst->GetType()), pInst->GetValue()));
+		else if (opcode == IRInstruction::IROP_LOCAL)
+			code.push_back(BuildCode(dsr::VMI_FETCHLN, m_localSlots[pInst->GetValue()]));
+		else if (HasDataWord(opcode))
+		{
+			code.push_back(BuildCode(opcode));
+			code.push_back(pInst->GetValue());
+		}
+		else
+			code.push_back(BuildCode(opcode, pInst->GetValue()));
+		Push();
+	}
+
+	void IRFunction::Lowering::EmitPhiCopies(const IRBlock* pBlock, const IRBlock* pSucc, bool runsOnce)
+	{
+		const uint32 numPhis = pSucc->GetNumPhis();
+		if (numPhis == 0)
+			return;
+
+		//a parallel copy is easy on a stack machine: push all sources, then pop into the phis
+		const uint32 predIdx = pSucc->GetPredecessorIndex(pBlock);
+		std::vector<uint32> stores;
+		for (uint32 i=0; i<numPhis; ++i)
+		{
+			const IRInstruction* pPhi = pSucc->GetInstructionPtr(i);
+			const IRInstruction* pOp = pPhi->GetOperandPtr(predIdx);
+			if (m_home[pOp->GetId()] && m_slots[pOp->GetId()] == m_slots[pPhi->GetId()])
+				continue;
+
+			//the VM clears locals on entry
+			if (runsOnce && !m_written[m_slots[pPhi->GetId()]] && IsZero(pOp))
+				continue;
+
+			EmitValue(pOp);
+			stores.push_back(pPhi->GetId());
+		}
+
+		const IRInstructionPtrArray& instructions = m_func.m_instructions;
+		for (uint32 i=(uint32) stores.size(); i-->0; )
+		{
+			m_pCode->push_back(BuildCode(GetLocalStoreOpcode(instructions[stores[i]]->GetType()), m_slots[stores[i]]));
+			m_written[m_slots[stores[i]]] = true;
+			--m_curStack;
+		}
+	}
+
+	void IRFunction::Lowering::Emit(VMCodeBlock& code, uint32& maxStackSize)
+	{
+		m_pCode = &code;
+		m_curStack = 0;
+		m_maxStack = 0;
+		m_written.assign(m_numSlots, false);
+		code.clear();
+
+		//blocks that run once, one after the other, from the start of the function
+		uint32 numStraightBlocks = 1;
+		while (numStraightBlocks < m_func.m_blocks.size())
+		{
+			const IRBlock* pPrev = m_func.m_blocks[numStraightBlocks - 1];
+			const IRBlock* pBlock = m_func.m_blocks[numStraightBlocks];
+			if (pPrev->GetNumSuccessors() != 1 || pPrev->GetSuccessorPtr(0) != pBlock || pBlock->GetNumPredecessors() != 1)
+				break;
+			++numStraightBlocks;
+		}
+
+		std::vector<uint32> blockPos(m_func.GetMaxBlockId(), -1);
+		std::vector<std::pair<uint32, const IRBlock*> > fixups;
+		for (uint32 b=0; b<m_func.m_blocks.size(); ++b)
+		{
+			const IRBlock* pBlock = m_func.m_blocks[b];
+			const IRBlock* pNext = b + 1 < m_func.m_blocks.size() ? m_func.m_blocks[b + 1] : 0;
+			blockPos[pBlock->GetId()] = (uint32) code.size();
+
+			for (uint32 i=pBlock->GetNumPhis(); i<pBlock->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				const uint32 id = pInst->GetId();
+				const uint32 opcode = pInst->GetOpcode();
+				if (m_remat[id])
+					continue;
+
+				const uint32 k = GetNumStackOperands(pInst);
+				for (uint32 o=k; o<pInst->GetNumOperands(); ++o)
+					EmitValue(pInst->GetOperandPtr(o));
+				m_curStack -= pInst->GetNumOperands();
+
+				if (opcode == dsr::VMI_JMP)
+				{
+					EmitPhiCopies(pBlock, pBlock->GetSuccessorPtr(0), b < numStraightBlocks);
+					if (pBlock->GetSuccessorPtr(0) != pNext)
+					{
+						fixups.push_back(std::make_pair((uint32) code.size(), pBlock->GetSuccessorPtr(0)));
+						code.push_back(BuildCode(dsr::VMI_JMP));
+					}
+				}
+				else if (opcode == dsr::VMI_JZ)
+				{
+					fixups.push_back(std::make_pair((uint32) code.size(), pBlock->GetSuccessorPtr(1)));
+					code.push_back(BuildCode(dsr::VMI_JZ));
+					if (pBlock->GetSuccessorPtr(0) != pNext)
+					{
+						fixups.push_back(std::make_pair((uint32) code.size(), pBlock->GetSuccessorPtr(0)));
+						code.push_back(BuildCode(dsr::VMI_JMP));
+					}
+				}
+				else if (opcode != IRInstruction::IROP_COPY)
+				{
+					if (HasDataWord(opcode))
+					{
+						code.push_back(BuildCode(opcode));
+						code.push_back(pInst->GetValue());
+					}
+					else
+					{
+						code.push_back(BuildCode(opcode, pInst->GetValue()));
+					}
+				}
+
+				if (pInst->HasResult())
+				{
+					Push();
+					if (m_home[id])
+					{
+						code.push_back(BuildCode(GetLocalStoreOpcode(pInst->GetType()), m_slots[id]));
+						m_written[m_slots[id]] = true;
+						--m_curStack;
+					}
+					else if (m_numUses[id] == 0)
+					{
+						code.push_back(BuildCode(dsr::VMI_POP));
+						--m_curStack;
+					}
+				}
+			}
+		}
+
+		//blocks that turned out empty leave jumps to the next instruction behind
+		std::vector<uint32> newPos(code.size() + 1, 0);
+		std::vector<bool> removed(code.size(), false);
+		for (uint32 i=0; i<fixups.size(); ++i)
+		{
+			const uint32 pos = fixups[i].first;
+			if (ExtractVMInstruction(code[pos]) == dsr::VMI_JMP && blockPos[fixups[i].second->GetId()] == pos + 1)
+				removed[pos] = true;
+		}
+		uint32 numKept = 0;
+		for (uint32 pos=0; pos<code.size(); ++pos)
+		{
+			newPos[pos] = numKept;
+			if (!removed[pos])
+				code[numKept++] = code[pos];
+		}
+		newPos[code.size()] = numKept;
+		code.resize(numKept);
+
+		for (uint32 i=0; i<fixups.size(); ++i)
+		{
+			const uint32 pos = fixups[i].first;
+			if (!removed[pos])
+				code[newPos[pos]] = BuildCode(ExtractVMInstruction(code[newPos[pos]]), newPos[blockPos[fixups[i].second->GetId()]]);
+		}
+
+		assert(m_curStack == 0);
+		maxStackSize = m_maxStack;
+	}
+
+	bool IRFunction::Lowering::Lower(VMCodeBlock& code, uint32& maxStackSize, DataDeclarationCPtrArray& locals)
+	{
+		SplitCriticalEdges();
+		m_func.ComputeDominators();
+		CountUses();
+		FindRematerializable();
+		if (!ScheduleStack())
+			return false;
+		if (!AssignSlots(locals))
+			return false;
+
+		Emit(code, maxStackSize);
+		return true;
+	}
+
+	bool IRFunction::Lower(VMCodeBlock& code, uint32& maxStackSize, DataDeclarationCPtrArray& locals)
+	{
+		Lowering lowering(*this);
+		return lowering.Lower(code, maxStackSize, locals);
+	}
+}
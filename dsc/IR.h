@@ -0,0 +1,259 @@
+#if !defined(DSC_IR_H_)
+#define DSC_IR_H_
+
+#include <string>
+#include <vector>
+#include "DSRVMDataType.h"
+#include "DSRVMInstruction.h"
+#include "ScriptClass.h"
+
+namespace dsc
+{
+	class IRBlock;
+	class IRFunction;
+
+	/// instructions of the bytecode followed by a data word
+	bool HasDataWord(uint32 opcode);
+
+	//-------------------------------------------------------------------------------------
+	/// Call emitted by the function compiler.
+	/// The number of values a call pops and the type it pushes are not encoded in the
+	/// bytecode, so the compiler records them for the IR builder.
+	class IRCallSite
+	{
+	public:
+		IRCallSite(uint32 codePos, uint32 numArgs, uint32 retType, const char* retNativeType)
+		: m_codePos(codePos), m_numArgs(numArgs), m_retType(retType), m_retNativeType(retNativeType) {}
+
+		uint32 GetCodePos() const { return m_codePos; }
+		uint32 GetNumArgs() const { return m_numArgs; }
+		uint32 GetReturnType() const { return m_retType; }
+		const char* GetNativeReturnType() const { return m_retNativeType.c_str(); }
+
+	private:
+		uint32 m_codePos;
+		uint32 m_numArgs;
+		uint32 m_retType;
+		std::string m_retNativeType;
+	};
+
+	typedef std::vector<IRCallSite> IRCallSiteArray;
+
+	//-------------------------------------------------------------------------------------
+	/// Instruction of the SSA form.
+	/// Apart from a few IR only opcodes, instructions are the VM instructions with their
+	/// stack operands turned into explicit operands.  Loads and stores of locals and
+	/// parameters don't exist, they are resolved into SSA values.
+	class IRInstruction
+	{
+		DSC_NOCOPY(IRInstruction)
+	public:
+		typedef std::vector<IRInstruction*> IRInstructionPtrArray;
+
+		enum
+		{
+			IROP_PHI = 0x100,
+			IROP_COPY,		//value assigned to a variable
+			IROP_PARAM,		//value of parameter GetValue() on entry
+			IROP_LOCAL,		//value of native local GetValue() on entry
+		};
+
+		IRInstruction(uint32 id, uint32 opcode, uint32 value, uint32 type, const char* nativeType)
+		: m_id(id), m_opcode(opcode), m_value(value), m_type(type), m_nativeType(nativeType), m_pBlock(0) {}
+
+		uint32 GetId() const { return m_id; }
+		uint32 GetOpcode() const { return m_opcode; }
+		/// data offset, function index, jump free immediate or constant bits, depending on the opcode
+		uint32 GetValue() const { return m_value; }
+		/// dsr::VMDATATYPE_MAX for instructions that don't produce a value
+		uint32 GetType() const { return m_type; }
+		const char* GetNativeType() const { return m_nativeType; }
+		void SetType(uint32 type, const char* nativeType) { m_type = type; m_nativeType = nativeType; }
+		bool HasResult() const { return m_type != dsr::VMDATATYPE_MAX; }
+		IRBlock* GetBlockPtr() const { return m_pBlock; }
+		void SetBlockPtr(IRBlock* pBlock) { m_pBlock = pBlock; }
+
+		uint32 GetNumOperands() const { return (uint32) m_operands.size(); }
+		IRInstruction* GetOperandPtr(uint32 idx) const { return m_operands[idx]; }
+		void SetOperandPtr(uint32 idx, IRInstruction* pOperand) { m_operands[idx] = pOperand; }
+		void AddOperand(IRInstruction* pOperand) { m_operands.push_back(pOperand); }
+		void RemoveOperand(uint32 idx) { m_operands.erase(m_operands.begin() + idx); }
+		/// Reverses the operands of a binary operation, using the opcode that gives the
+		/// same result for them.  Returns false if there is no such opcode.
+		bool SwapOperands();
+
+		bool IsPhi() const { return m_opcode == IROP_PHI; }
+		bool IsCopy() const { return m_opcode == IROP_COPY; }
+		bool IsConstant() const;
+		bool IsTerminator() const;
+		bool IsFieldFetch() const;
+		bool IsFieldStore() const;
+		/// calls and NEW may run script code, which can change any data
+		bool IsCall() const;
+		/// integer division by zero faults, so these must not be executed speculatively
+		bool CanTrap() const;
+		/// no effect besides producing a value
+		bool HasSideEffects() const;
+
+	private:
+		uint32 m_id;
+		uint32 m_opcode;
+		uint32 m_value;
+		uint32 m_type;
+		const char* m_nativeType;
+		IRBlock* m_pBlock;
+		IRInstructionPtrArray m_operands;
+	};
+
+	typedef IRInstruction::IRInstructionPtrArray IRInstructionPtrArray;
+
+	//-------------------------------------------------------------------------------------
+	/// Basic block.  Phis come first and the last instruction is always JMP, JZ or RET.
+	/// JZ continues with successor 0 when the condition is true and with successor 1
+	/// when it is false.  Phi operands are in predecessor order.
+	class IRBlock
+	{
+		DSC_NOCOPY(IRBlock)
+	public:
+		typedef std::vector<IRBlock*> IRBlockPtrArray;
+
+		explicit IRBlock(uint32 id) : m_id(id), m_pIDom(0), m_rpoIdx(-1) {}
+
+		uint32 GetId() const { return m_id; }
+
+		uint32 GetNumInstructions() const { return (uint32) m_instructions.size(); }
+		IRInstruction* GetInstructionPtr(uint32 idx) const { return m_instructions[idx]; }
+		IRInstruction* GetTerminatorPtr() const { return m_instructions.back(); }
+		uint32 GetNumPhis() const;
+		void AddInstruction(IRInstruction* pInst);
+		/// inserts in front of the terminator
+		void InsertInstruction(IRInstruction* pInst);
+		/// inserts behind the last phi
+		void InsertPhi(IRInstruction* pPhi);
+		void RemoveInstruction(uint32 idx);
+
+		uint32 GetNumPredecessors() const { return (uint32) m_preds.size(); }
+		IRBlock* GetPredecessorPtr(uint32 idx) const { return m_preds[idx]; }
+		uint32 GetPredecessorIndex(const IRBlock* pBlock) const;
+		uint32 GetNumSuccessors() const { return (uint32) m_succs.size(); }
+		IRBlock* GetSuccessorPtr(uint32 idx) const { return m_succs[idx]; }
+
+		/// immediate dominator, 0 for the entry block.  valid after IRFunction::ComputeDominators()
+		IRBlock* GetIDomPtr() const { return m_pIDom; }
+		/// index in reverse post order
+		uint32 GetRPOIndex() const { return m_rpoIdx; }
+
+	private:
+		friend class IRFunction;
+
+		uint32 m_id;
+		IRInstructionPtrArray m_instructions;
+		IRBlockPtrArray m_preds;
+		IRBlockPtrArray m_succs;
+		IRBlock* m_pIDom;
+		uint32 m_rpoIdx;
+	};
+
+	typedef IRBlock::IRBlockPtrArray IRBlockPtrArray;
+
+	//-------------------------------------------------------------------------------------
+	/// Control flow graph in SSA form of one function.
+	/// Built from the bytecode the function compiler emits, so that type checking and
+	/// code generation stay in one place, and lowered back to bytecode after optimization.
+	class IRFunction
+	{
+		DSC_NOCOPY(IRFunction)
+	public:
+		typedef std::vector<dsr::VMBytecode> VMCodeBlock;
+		typedef std::vector<DataDeclarationCPtr> DataDeclarationCPtrArray;
+		typedef std::vector<DirectCall> DirectCallArray;
+
+		IRFunction();
+		~IRFunction();
+
+		/// Returns false if the code uses something the IR can't represent.
+		bool Build(const VMCodeBlock& code, const FunctionImplementation& funcImpl, const FunctionDeclaration& funcDecl,
+			const ScriptClassDeclaration& classDecl, const IRCallSiteArray& callSites);
+		/// Generates bytecode.  Locals are reallocated, so they are returned as well.
+		/// Returns false if a value can't be kept in a local.
+		bool Lower(VMCodeBlock& code, uint32& maxStackSize, DataDeclarationCPtrArray& locals);
+
+		/// class the function was built for
+		const ScriptClassDeclaration* GetScriptClassDeclarationPtr() const { return m_pClassDecl; }
+		/// Targets of VMI_CALLF_SELF_D and VMI_CALLF_PUSHED_D, by GetValue().  Starts out as the
+		/// table of the implementation, inlining only adds to it.
+		uint32 GetNumDirectCalls() const { return (uint32) m_directCalls.size(); }
+		const DirectCall& GetDirectCall(uint32 idx) const { return m_directCalls[idx]; }
+		uint32 AddDirectCall(const DirectCall& call);
+
+		/// blocks in code layout order, the first one is the entry
+		uint32 GetNumBlocks() const { return (uint32) m_blocks.size(); }
+		IRBlock* GetBlockPtr(uint32 idx) const { return m_blocks[idx]; }
+		/// number of instructions in all blocks
+		uint32 GetNumInstructions() const;
+		/// upper bound of instruction ids, for arrays indexed by GetId()
+		uint32 GetMaxInstructionId() const { return (uint32) m_instructions.size(); }
+
+		IRInstruction* CreateInstruction(uint32 opcode, uint32 value, uint32 type, const char* nativeType);
+		/// Replaces all uses of instruction i by replacements[i], if that is not 0.
+		/// Chains are followed, replaced instructions are removed.
+		void ReplaceInstructions(IRInstructionPtrArray& replacements);
+		/// Removes instructions whose value is never used and that have no side effects.
+		void RemoveDeadInstructions();
+
+		void ComputeDominators();
+		const IRBlockPtrArray& GetReversePostOrder() const { return m_rpo; }
+		bool Dominates(const IRBlock* pDom, const IRBlock* pBlock) const;
+		/// Inserts a block on the edge between pBlock and its successor succIdx.
+		IRBlock* SplitEdge(IRBlock* pBlock, uint32 succIdx);
+		/// Gives all predecessors of pHeader that are not in loop a common new successor,
+		/// which becomes the only one to enter the loop.  loop is indexed by block id.
+		IRBlock* InsertPreheader(IRBlock* pHeader, const std::vector<bool>& loop);
+		/// Points successor succIdx of pBlock at pNewSucc.  phiOperands are the values
+		/// the phis of pNewSucc get on the new edge, in phi order.
+		void RedirectEdge(IRBlock* pBlock, uint32 succIdx, IRBlock* pNewSucc, const IRInstructionPtrArray& phiOperands);
+		/// Replaces a call by a copy of the body of callee, whose parameters become the
+		/// arguments of the call.  callee is left as it was.
+		/// Returns the block that holds the code behind the call.
+		IRBlock* InlineCall(IRInstruction* pCall, const IRFunction& callee);
+		/// Appends pBlock to its only predecessor, which must have it as its only successor.
+		void MergeIntoPredecessor(IRBlock* pBlock);
+		/// Replaces the JMP pBlock ends with by the RET of its successor, which must
+		/// hold only phis and that RET.
+		void DuplicateReturn(IRBlock* pBlock);
+		/// Removes blocks that can't be reached from the entry any more.
+		void RemoveUnreachableBlocks();
+		/// Upper bound of block ids, for arrays indexed by GetId().
+		uint32 GetMaxBlockId() const { return m_nextBlockId; }
+
+		/// Field fetches whose field still has the fetched value at the start and end of
+		/// each block, sorted by address and indexed by block id.
+		void ComputeAvailableFieldFetches(std::vector<IRInstructionPtrArray>& availIn, std::vector<IRInstructionPtrArray>& availOut);
+		/// Updates a set of available fetches for one instruction.
+		static void UpdateAvailableFieldFetches(const IRInstruction* pInst, IRInstructionPtrArray& avail);
+
+	private:
+		class Builder;
+		class Lowering;
+		friend class Builder;
+		friend class Lowering;
+
+		IRBlock* CreateBlock();
+		void InsertBlockAfter(IRBlock* pBlock, const IRBlock* pPrev);
+		void InsertBlockBefore(IRBlock* pBlock, const IRBlock* pNext);
+		void AddEdge(IRBlock* pFrom, IRBlock* pTo);
+
+	private:
+		IRBlockPtrArray m_blocks;
+		IRBlockPtrArray m_allBlocks;
+		IRBlockPtrArray m_rpo;
+		IRInstructionPtrArray m_instructions;
+		uint32 m_nextBlockId;
+		/// declarations of the original locals
+		DataDeclarationCPtrArray m_locals;
+		DirectCallArray m_directCalls;
+		const ScriptClassDeclaration* m_pClassDecl;
+	};
+}
+
+#endif
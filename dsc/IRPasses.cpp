@@ -0,0 +1,767 @@
+#include <cassert>
+#include <algorithm>
+#include <map>
+#include <cstring>
+#include "StringUtils.h"
+#include "Timer.h"
+#include "IRPasses.h"
+
+namespace dsc
+{
+	//--------------------------------------------------------------------------------
+	void InliningPass::Run(IRFunction& func)
+	{
+		IRCalleeCPtrArray active;
+		InlineCalls(func, 0, active);
+	}
+
+	void InliningPass::InlineCalls(IRFunction& func, uint32 depth, IRCalleeCPtrArray& active)
+	{
+		if (depth >= m_limits.GetMaxDepth())
+			return;
+
+		const uint32 maxSize = func.GetNumInstructions() + m_limits.GetMaxGrowth();
+		for (uint32 b=0; b<func.GetNumBlocks(); ++b)
+		{
+			IRBlock* pBlock = func.GetBlockPtr(b);
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				const uint32 opcode = pInst->GetOpcode();
+				if (opcode != dsr::VMI_CALLF_SELF_D && opcode != dsr::VMI_CALLF_SUPER_G && opcode != dsr::VMI_CALLC_SELF_SUPER)
+					continue;
+
+				//recursion is left alone
+				const IRCallee* pCallee = m_resolver.GetCallee(func, *pInst);
+				if (!pCallee || std::find(active.begin(), active.end(), pCallee) != active.end())
+					continue;
+
+				IRFunction callee;
+				if (!callee.Build(pCallee->GetFunctionImplementation().GetVMCodeBlock(), pCallee->GetFunctionImplementation(),
+						pCallee->GetFunctionDeclaration(), pCallee->GetScriptClassDeclaration(), pCallee->GetCallSites()))
+					continue;
+				if (callee.GetNumInstructions() > m_limits.GetMaxCalleeSize())
+					continue;
+
+				//calls of the callee first, its super calls can't stay in another class
+				active.push_back(pCallee);
+				InlineCalls(callee, depth + 1, active);
+				active.pop_back();
+				if (!CanInline(func, callee) || func.GetNumInstructions() + callee.GetNumInstructions() > maxSize)
+					continue;
+
+				//go on behind the call, the copied calls have been looked at already
+				IRBlock* pCont = func.InlineCall(pInst, callee);
+				while (func.GetBlockPtr(b) != pCont)
+					++b;
+				pBlock = pCont;
+				i = -1;
+			}
+		}
+	}
+
+	bool InliningPass::CanInline(const IRFunction& func, const IRFunction& callee) const
+	{
+		const bool sameClass = func.GetScriptClassDeclarationPtr() == callee.GetScriptClassDeclarationPtr();
+		bool returns = false;
+		for (uint32 b=0; b<callee.GetNumBlocks(); ++b)
+		{
+			const IRBlock* pBlock = callee.GetBlockPtr(b);
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				const uint32 opcode = pBlock->GetInstructionPtr(i)->GetOpcode();
+
+				//the names of created classes are kept per function
+				if (opcode == dsr::VMI_NEW || opcode == dsr::VMI_ISN || opcode == dsr::VMI_CASTN)
+					return false;
+
+				//super is relative to the class of the code
+				if (!sameClass && (opcode == dsr::VMI_CALLF_SUPER_G || opcode == dsr::VMI_CALLC_SELF_SUPER))
+					return false;
+
+				if (opcode == dsr::VMI_RET)
+					returns = true;
+			}
+		}
+
+		//a callee that never returns, e.g. loops forever, leaves no value for the call
+		return returns;
+	}
+
+	//--------------------------------------------------------------------------------
+	void CopyPropagationPass::Run(IRFunction& func)
+	{
+		IRInstructionPtrArray replacements(func.GetMaxInstructionId(), (IRInstruction*) 0);
+		for (uint32 b=0; b<func.GetNumBlocks(); ++b)
+		{
+			const IRBlock* pBlock = func.GetBlockPtr(b);
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				if (pInst->IsCopy())
+					replacements[pInst->GetId()] = pInst->GetOperandPtr(0);
+			}
+		}
+		func.ReplaceInstructions(replacements);
+
+		//a phi that merges one value, besides itself, is that value.
+		//removing one can make others trivial.
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			replacements.assign(func.GetMaxInstructionId(), (IRInstruction*) 0);
+			for (uint32 b=0; b<func.GetNumBlocks(); ++b)
+			{
+				const IRBlock* pBlock = func.GetBlockPtr(b);
+				for (uint32 i=0; i<pBlock->GetNumPhis(); ++i)
+				{
+					IRInstruction* pPhi = pBlock->GetInstructionPtr(i);
+					IRInstruction* pSame = 0;
+					bool trivial = true;
+					for (uint32 o=0; o<pPhi->GetNumOperands() && trivial; ++o)
+					{
+						IRInstruction* pOp = pPhi->GetOperandPtr(o);
+						if (pOp == pPhi || pOp == pSame)
+							continue;
+						if (pSame)
+							trivial = false;
+						pSame = pOp;
+					}
+
+					//phis replaced by each other in the same round would form a cycle
+					if (!trivial || !pSame || replacements[pSame->GetId()])
+						continue;
+
+					replacements[pPhi->GetId()] = pSame;
+					changed = true;
+				}
+			}
+
+			if (changed)
+				func.ReplaceInstructions(replacements);
+		}
+	}
+
+	//--------------------------------------------------------------------------------
+	static uint32 GetSuccessorIndex(const IRBlock* pBlock, const IRBlock* pSucc)
+	{
+		for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+		{
+			if (pBlock->GetSuccessorPtr(s) == pSucc)
+				return s;
+		}
+		return -1;
+	}
+
+	/// values for the phis of pTo when it is entered from somewhere else than pFrom,
+	/// with the phis of pFrom resolved for its predecessor predIdx
+	static void GetBypassPhiOperands(const IRBlock* pFrom, uint32 predIdx, const IRBlock* pTo, IRInstructionPtrArray& ops)
+	{
+		ops.clear();
+		const uint32 fromIdx = pTo->GetPredecessorIndex(pFrom);
+		for (uint32 i=0; i<pTo->GetNumPhis(); ++i)
+		{
+			IRInstruction* pOp = pTo->GetInstructionPtr(i)->GetOperandPtr(fromIdx);
+			if (pOp->IsPhi() && pOp->GetBlockPtr() == pFrom)
+				pOp = pOp->GetOperandPtr(predIdx);
+			ops.push_back(pOp);
+		}
+	}
+
+	void JumpThreadingPass::Run(IRFunction& func)
+	{
+		//every change can make more possible, so start over after each one
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+
+			std::vector<uint32> numUses(func.GetMaxInstructionId(), 0);
+			for (uint32 b=0; b<func.GetNumBlocks(); ++b)
+			{
+				const IRBlock* pBlock = func.GetBlockPtr(b);
+				for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+				{
+					const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+					for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+						++numUses[pInst->GetOperandPtr(o)->GetId()];
+				}
+			}
+
+			for (uint32 b=1; b<func.GetNumBlocks() && !changed; ++b)
+			{
+				IRBlock* pBlock = func.GetBlockPtr(b);
+				changed = ThreadBlock(func, pBlock, numUses) || BypassBlock(func, pBlock) || MergeBlock(func, pBlock) || DuplicateReturn(func, pBlock);
+			}
+
+			if (changed)
+			{
+				func.RemoveUnreachableBlocks();
+				func.RemoveDeadInstructions();
+			}
+		}
+	}
+
+	bool JumpThreadingPass::MergeBlock(IRFunction& func, IRBlock* pBlock)
+	{
+		//what's left of a threaded block usually has one way in, from a block that only goes there
+		if (pBlock->GetNumPredecessors() != 1)
+			return false;
+		const IRBlock* pPred = pBlock->GetPredecessorPtr(0);
+		if (pPred == pBlock || pPred->GetNumSuccessors() != 1)
+			return false;
+
+		func.MergeIntoPredecessor(pBlock);
+		return true;
+	}
+
+	bool JumpThreadingPass::DuplicateReturn(IRFunction& func, IRBlock* pBlock)
+	{
+		//returning a merged value would store it in a local first, returning from each path doesn't
+		const IRInstruction* pTerm = pBlock->GetTerminatorPtr();
+		if (pTerm->GetOpcode() != dsr::VMI_RET || pBlock->GetNumInstructions() != pBlock->GetNumPhis() + 1)
+			return false;
+
+		for (uint32 p=0; p<pBlock->GetNumPredecessors(); ++p)
+		{
+			IRBlock* pPred = pBlock->GetPredecessorPtr(p);
+			if (pPred->GetTerminatorPtr()->GetOpcode() == dsr::VMI_JMP && pPred != func.GetBlockPtr(0))
+			{
+				func.DuplicateReturn(pPred);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool JumpThreadingPass::ThreadBlock(IRFunction& func, IRBlock* pBlock, const std::vector<uint32>& numUses)
+	{
+		//only phis and a branch on one of them
+		const IRInstruction* pTerm = pBlock->GetTerminatorPtr();
+		const uint32 numPhis = pBlock->GetNumPhis();
+		if (pTerm->GetOpcode() != dsr::VMI_JZ || pBlock->GetNumInstructions() != numPhis + 1)
+			return false;
+
+		const IRInstruction* pCond = pTerm->GetOperandPtr(0);
+		if (!pCond->IsPhi() || pCond->GetBlockPtr() != pBlock)
+			return false;
+
+		//paths that skip the block must not need its phis anywhere but in the successors
+		for (uint32 i=0; i<numPhis; ++i)
+		{
+			const IRInstruction* pPhi = pBlock->GetInstructionPtr(i);
+			uint32 numKnownUses = pPhi == pCond ? 1 : 0;
+			for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+			{
+				const IRBlock* pSucc = pBlock->GetSuccessorPtr(s);
+				const uint32 predIdx = pSucc->GetPredecessorIndex(pBlock);
+				for (uint32 j=0; j<pSucc->GetNumPhis(); ++j)
+				{
+					if (pSucc->GetInstructionPtr(j)->GetOperandPtr(predIdx) == pPhi)
+						++numKnownUses;
+				}
+			}
+			if (numKnownUses != numUses[pPhi->GetId()])
+				return false;
+		}
+
+		for (uint32 p=0; p<pBlock->GetNumPredecessors(); ++p)
+		{
+			const IRInstruction* pValue = pCond->GetOperandPtr(p);
+			if (pValue->GetOpcode() != dsr::VMI_PUSHB)
+				continue;
+
+			//JZ goes on with successor 0 when the condition is true
+			IRBlock* pPred = pBlock->GetPredecessorPtr(p);
+			IRBlock* pTarget = pBlock->GetSuccessorPtr(pValue->GetValue() != 0 ? 0 : 1);
+			if (pPred == pBlock || pTarget == pBlock || GetSuccessorIndex(pPred, pTarget) != -1)
+				continue;
+
+			IRInstructionPtrArray ops;
+			GetBypassPhiOperands(pBlock, p, pTarget, ops);
+			func.RedirectEdge(pPred, GetSuccessorIndex(pPred, pBlock), pTarget, ops);
+			return true;
+		}
+
+		return false;
+	}
+
+	bool JumpThreadingPass::BypassBlock(IRFunction& func, IRBlock* pBlock)
+	{
+		if (pBlock->GetNumInstructions() != 1 || pBlock->GetTerminatorPtr()->GetOpcode() != dsr::VMI_JMP)
+			return false;
+
+		IRBlock* pTarget = pBlock->GetSuccessorPtr(0);
+		for (uint32 p=0; p<pBlock->GetNumPredecessors(); ++p)
+		{
+			IRBlock* pPred = pBlock->GetPredecessorPtr(p);
+			if (pPred == pBlock || pTarget == pBlock || GetSuccessorIndex(pPred, pTarget) != -1)
+				continue;
+
+			IRInstructionPtrArray ops;
+			GetBypassPhiOperands(pBlock, p, pTarget, ops);
+			func.RedirectEdge(pPred, GetSuccessorIndex(pPred, pBlock), pTarget, ops);
+			return true;
+		}
+
+		return false;
+	}
+
+	//--------------------------------------------------------------------------------
+	void CommonSubexpressionPass::Run(IRFunction& func)
+	{
+		RemoveFieldFetches(func);
+		RemoveExpressions(func);
+	}
+
+	void CommonSubexpressionPass::RemoveFieldFetches(IRFunction& func)
+	{
+		std::vector<IRInstructionPtrArray> availIn, availOut;
+		func.ComputeAvailableFieldFetches(availIn, availOut);
+
+		IRInstructionPtrArray replacements(func.GetMaxInstructionId(), (IRInstruction*) 0);
+		for (uint32 b=0; b<func.GetNumBlocks(); ++b)
+		{
+			const IRBlock* pBlock = func.GetBlockPtr(b);
+			IRInstructionPtrArray avail = availIn[pBlock->GetId()];
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				if (pInst->IsFieldFetch())
+				{
+					for (uint32 a=0; a<avail.size(); ++a)
+					{
+						if (avail[a] != pInst && avail[a]->GetValue() == pInst->GetValue())
+						{
+							replacements[pInst->GetId()] = avail[a];
+							break;
+						}
+					}
+				}
+
+				IRFunction::UpdateAvailableFieldFetches(pInst, avail);
+			}
+		}
+
+		func.ReplaceInstructions(replacements);
+	}
+
+	static bool IsCommutative(uint32 opcode)
+	{
+		switch (opcode)
+		{
+		case dsr::VMI_MULII:
+		case dsr::VMI_MULFF:
+		case dsr::VMI_ADDII:
+		case dsr::VMI_ADDFF:
+		case dsr::VMI_EQII:
+		case dsr::VMI_EQFF:
+		case dsr::VMI_EQBB:
+		case dsr::VMI_AND:
+		case dsr::VMI_OR:
+			return true;
+		}
+
+		return false;
+	}
+
+	void CommonSubexpressionPass::RemoveExpressions(IRFunction& func)
+	{
+		typedef std::map<std::vector<uint32>, IRInstruction*> ExpressionMap;
+
+		func.ComputeDominators();
+		std::vector<IRBlockPtrArray> children(func.GetMaxBlockId());
+		for (uint32 b=1; b<func.GetNumBlocks(); ++b)
+		{
+			IRBlock* pBlock = func.GetBlockPtr(b);
+			if (pBlock->GetIDomPtr())
+				children[pBlock->GetIDomPtr()->GetId()].push_back(pBlock);
+		}
+
+		//expressions computed in a dominator are visible in the blocks it dominates
+		IRInstructionPtrArray replacements(func.GetMaxInstructionId(), (IRInstruction*) 0);
+		std::vector<uint32> weights(func.GetMaxInstructionId(), 1);
+		ExpressionMap expressions;
+		std::vector<ExpressionMap::iterator> scope;
+		std::vector<std::pair<IRBlock*, uint32> > stack;
+		std::vector<uint32> scopeSizes;
+		stack.push_back(std::make_pair(func.GetBlockPtr(0), 0u));
+		scopeSizes.push_back(0);
+		bool enter = true;
+		while (!stack.empty())
+		{
+			IRBlock* pBlock = stack.back().first;
+			if (enter)
+			{
+				for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+				{
+					IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+					if (!pInst->HasResult() || pInst->HasSideEffects() || pInst->GetOpcode() >= IRInstruction::IROP_PHI
+						|| pInst->IsConstant() || pInst->IsFieldFetch())
+					{
+						continue;
+					}
+
+					std::vector<uint32> key;
+					key.push_back(pInst->GetOpcode());
+					key.push_back(pInst->GetValue());
+					uint32 weight = 1;
+					for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+					{
+						const IRInstruction* pOp = pInst->GetOperandPtr(o);
+						while (replacements[pOp->GetId()])
+							pOp = replacements[pOp->GetId()];
+						key.push_back(pOp->GetId());
+						weight += weights[pOp->GetId()];
+					}
+					weights[pInst->GetId()] = std::min(weight, 256u);
+
+					//the result has to go through a local, which costs a store and a fetch per
+					//use.  that is more than recomputing something like !b.
+					if (weight < 3)
+						continue;
+					if (IsCommutative(pInst->GetOpcode()) && key[2] > key[3])
+						std::swap(key[2], key[3]);
+
+					std::pair<ExpressionMap::iterator, bool> res = expressions.insert(std::make_pair(key, pInst));
+					if (res.second)
+						scope.push_back(res.first);
+					else
+						replacements[pInst->GetId()] = res.first->second;
+				}
+			}
+
+			const IRBlockPtrArray& kids = children[pBlock->GetId()];
+			const uint32 childIdx = stack.back().second;
+			if (childIdx < kids.size())
+			{
+				++stack.back().second;
+				stack.push_back(std::make_pair(kids[childIdx], 0u));
+				scopeSizes.push_back((uint32) scope.size());
+				enter = true;
+				continue;
+			}
+
+			//leaving the block
+			while (scope.size() > scopeSizes.back())
+			{
+				expressions.erase(scope.back());
+				scope.pop_back();
+			}
+			scopeSizes.pop_back();
+			stack.pop_back();
+			enter = false;
+		}
+
+		func.ReplaceInstructions(replacements);
+	}
+
+	//--------------------------------------------------------------------------------
+	static void GetLoopBlocks(IRBlock* pHeader, const IRBlockPtrArray& latches, std::vector<bool>& loop, uint32 numBlocks)
+	{
+		loop.assign(numBlocks, false);
+		loop[pHeader->GetId()] = true;
+
+		IRBlockPtrArray work;
+		for (uint32 i=0; i<latches.size(); ++i)
+		{
+			if (!loop[latches[i]->GetId()])
+			{
+				loop[latches[i]->GetId()] = true;
+				work.push_back(latches[i]);
+			}
+		}
+
+		while (!work.empty())
+		{
+			IRBlock* pBlock = work.back();
+			work.pop_back();
+			for (uint32 p=0; p<pBlock->GetNumPredecessors(); ++p)
+			{
+				IRBlock* pPred = pBlock->GetPredecessorPtr(p);
+				if (!loop[pPred->GetId()])
+				{
+					loop[pPred->GetId()] = true;
+					work.push_back(pPred);
+				}
+			}
+		}
+	}
+
+	void LoopInvariantCodeMotionPass::Run(IRFunction& func)
+	{
+		func.ComputeDominators();
+
+		//back edges go to a block that dominates them
+		std::vector<IRBlockPtrArray> latches(func.GetMaxBlockId());
+		IRBlockPtrArray headers;
+		for (uint32 b=0; b<func.GetNumBlocks(); ++b)
+		{
+			IRBlock* pBlock = func.GetBlockPtr(b);
+			for (uint32 s=0; s<pBlock->GetNumSuccessors(); ++s)
+			{
+				IRBlock* pSucc = pBlock->GetSuccessorPtr(s);
+				if (!func.Dominates(pSucc, pBlock))
+					continue;
+
+				if (latches[pSucc->GetId()].empty())
+					headers.push_back(pSucc);
+				latches[pSucc->GetId()].push_back(pBlock);
+			}
+		}
+
+		//inner loops first, so that code can move out of several loops
+		std::vector<std::pair<uint32, IRBlock*> > loops;
+		for (uint32 h=0; h<headers.size(); ++h)
+		{
+			std::vector<bool> loop;
+			GetLoopBlocks(headers[h], latches[headers[h]->GetId()], loop, func.GetMaxBlockId());
+			loops.push_back(std::make_pair((uint32) std::count(loop.begin(), loop.end(), true), headers[h]));
+		}
+		std::stable_sort(loops.begin(), loops.end());
+
+		for (uint32 l=0; l<loops.size(); ++l)
+			HoistLoop(func, loops[l].second, latches[loops[l].second->GetId()]);
+	}
+
+	void LoopInvariantCodeMotionPass::HoistLoop(IRFunction& func, IRBlock* pHeader, const IRBlockPtrArray& latches)
+	{
+		std::vector<bool> loop;
+		GetLoopBlocks(pHeader, latches, loop, func.GetMaxBlockId());
+
+		//find or make the block in front of the loop
+		IRBlock* pPreheader = 0;
+		uint32 numOutside = 0;
+		for (uint32 p=0; p<pHeader->GetNumPredecessors(); ++p)
+		{
+			if (!loop[pHeader->GetPredecessorPtr(p)->GetId()])
+			{
+				pPreheader = pHeader->GetPredecessorPtr(p);
+				++numOutside;
+			}
+		}
+		assert(numOutside > 0);
+
+		if (numOutside > 1 || pPreheader->GetNumSuccessors() > 1)
+		{
+			pPreheader = func.InsertPreheader(pHeader, loop);
+			loop.resize(func.GetMaxBlockId(), false);
+		}
+		func.ComputeDominators();
+
+		//what the loop writes
+		bool hasCall = false;
+		std::vector<uint32> storedFields;
+		for (uint32 b=0; b<func.GetNumBlocks(); ++b)
+		{
+			const IRBlock* pBlock = func.GetBlockPtr(b);
+			if (!loop[pBlock->GetId()])
+				continue;
+
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				const IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				if (pInst->IsCall())
+					hasCall = true;
+				else if (pInst->IsFieldStore())
+					storedFields.push_back(pInst->GetValue());
+			}
+		}
+
+		//invariant instructions, in an order where operands come first
+		std::vector<bool> invariant(func.GetMaxInstructionId(), false);
+		IRInstructionPtrArray candidates;
+		const IRBlockPtrArray& rpo = func.GetReversePostOrder();
+		for (uint32 b=0; b<rpo.size(); ++b)
+		{
+			const IRBlock* pBlock = rpo[b];
+			if (!loop[pBlock->GetId()])
+				continue;
+
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				IRInstruction* pInst = pBlock->GetInstructionPtr(i);
+				if (!pInst->HasResult() || pInst->HasSideEffects() || pInst->CanTrap() || pInst->GetOpcode() >= IRInstruction::IROP_PHI
+					|| pInst->IsConstant())
+				{
+					continue;
+				}
+
+				if (pInst->IsFieldFetch() && (hasCall || std::find(storedFields.begin(), storedFields.end(), pInst->GetValue()) != storedFields.end()))
+					continue;
+
+				bool isInvariant = true;
+				for (uint32 o=0; o<pInst->GetNumOperands() && isInvariant; ++o)
+				{
+					const IRInstruction* pOp = pInst->GetOperandPtr(o);
+					isInvariant = !loop[pOp->GetBlockPtr()->GetId()] || invariant[pOp->GetId()];
+				}
+
+				if (isInvariant)
+				{
+					invariant[pInst->GetId()] = true;
+					candidates.push_back(pInst);
+				}
+			}
+		}
+
+		//a lone field fetch costs as much in a local as it does in the loop,
+		//so only computations and what they use are worth moving
+		std::vector<bool> hoist(func.GetMaxInstructionId(), false);
+		for (uint32 c=(uint32) candidates.size(); c-->0; )
+		{
+			const IRInstruction* pInst = candidates[c];
+			if (pInst->GetNumOperands() > 0)
+				hoist[pInst->GetId()] = true;
+
+			if (!hoist[pInst->GetId()])
+				continue;
+
+			for (uint32 o=0; o<pInst->GetNumOperands(); ++o)
+			{
+				if (invariant[pInst->GetOperandPtr(o)->GetId()])
+					hoist[pInst->GetOperandPtr(o)->GetId()] = true;
+			}
+		}
+
+		for (uint32 c=0; c<candidates.size(); ++c)
+		{
+			IRInstruction* pInst = candidates[c];
+			if (!hoist[pInst->GetId()])
+				continue;
+
+			IRBlock* pBlock = pInst->GetBlockPtr();
+			for (uint32 i=0; i<pBlock->GetNumInstructions(); ++i)
+			{
+				if (pBlock->GetInstructionPtr(i) == pInst)
+				{
+					pBlock->RemoveInstruction(i);
+					break;
+				}
+			}
+			pPreheader->InsertInstruction(pInst);
+		}
+	}
+
+	//--------------------------------------------------------------------------------
+	void OptimizerStats::Clear()
+	{
+		m_passes.clear();
+		m_numFunctions = 0;
+		m_numSkipped = 0;
+	}
+
+	OptimizerStats::PassStats& OptimizerStats::GetPassStats(const char* name)
+	{
+		for (uint32 i=0; i<m_passes.size(); ++i)
+		{
+			if (strcmp(m_passes[i].GetName(), name) == 0)
+				return m_passes[i];
+		}
+
+		m_passes.push_back(PassStats(name));
+		return m_passes.back();
+	}
+
+	void OptimizerStats::AddPass(const char* name, uint64 ticks, uint32 sizeBefore, uint32 sizeAfter)
+	{
+		GetPassStats(name).Add(1, ticks, sizeBefore, sizeAfter);
+	}
+
+	void OptimizerStats::Merge(const OptimizerStats& stats)
+	{
+		for (uint32 i=0; i<stats.m_passes.size(); ++i)
+		{
+			const PassStats& pass = stats.m_passes[i];
+			GetPassStats(pass.GetName()).Add(pass.GetNumRuns(), pass.GetTicks(), pass.GetSizeBefore(), pass.GetSizeAfter());
+		}
+
+		m_numFunctions += stats.m_numFunctions;
+		m_numSkipped += stats.m_numSkipped;
+	}
+
+	const std::string ToString(const OptimizerStats& stats)
+	{
+		std::string res = "optimized " + ToString(stats.GetNumFunctions() - stats.GetNumSkippedFunctions())
+			+ " of " + ToString(stats.GetNumFunctions()) + " functions\n";
+
+		const double ticksPerMs = (double) (int64) GetTicksPerSecond() / 1000.0;
+		for (uint32 i=0; i<stats.GetNumPasses(); ++i)
+		{
+			const OptimizerStats::PassStats& pass = stats.GetPassStats(i);
+			res += "  ";
+			res += pass.GetName();
+			res += ": " + ToString((double) (int64) pass.GetTicks() / ticksPerMs, 4) + " ms";
+			res += ", size " + ToString(pass.GetSizeBefore()) + " -> " + ToString(pass.GetSizeAfter()) + "\n";
+		}
+
+		return res;
+	}
+
+	//--------------------------------------------------------------------------------
+	PassManager::~PassManager()
+	{
+		for (uint32 i=0; i<m_passes.size(); ++i)
+			delete m_passes[i];
+	}
+
+	void PassManager::AddDefaultPasses()
+	{
+		AddPass(new CopyPropagationPass());
+		AddPass(new JumpThreadingPass());
+		AddPass(new CopyPropagationPass());
+		AddPass(new CommonSubexpressionPass());
+		AddPass(new LoopInvariantCodeMotionPass());
+		AddPass(new DeadCodeEliminationPass());
+	}
+
+	bool PassManager::Optimize(FunctionImplementation& funcImpl, VMCodeBlock& code, uint32& maxStackSize, const FunctionDeclaration& funcDecl,
+		const ScriptClassDeclaration& classDecl, const IRCallSiteArray& callSites)
+	{
+		//passes only run on functions that made it into the IR and back out again,
+		//so the numbers of skipped functions don't get mixed in
+		OptimizerStats stats;
+
+		uint64 start = GetTicks();
+		IRFunction func;
+		if (!func.Build(code, funcImpl, funcDecl, classDecl, callSites))
+		{
+			m_stats.AddFunction(false);
+			return false;
+		}
+		stats.AddPass("build", GetTicks() - start, (uint32) code.size(), func.GetNumInstructions());
+
+		for (uint32 i=0; i<m_passes.size(); ++i)
+		{
+			const uint32 sizeBefore = func.GetNumInstructions();
+			start = GetTicks();
+			m_passes[i]->Run(func);
+			stats.AddPass(m_passes[i]->GetName(), GetTicks() - start, sizeBefore, func.GetNumInstructions());
+		}
+
+		VMCodeBlock newCode;
+		uint32 newMaxStackSize = 0;
+		IRFunction::DataDeclarationCPtrArray locals;
+		const uint32 sizeBefore = func.GetNumInstructions();
+		start = GetTicks();
+		if (!func.Lower(newCode, newMaxStackSize, locals))
+		{
+			m_stats.AddFunction(false);
+			return false;
+		}
+		stats.AddPass("lower", GetTicks() - start, sizeBefore, (uint32) newCode.size());
+
+		code.swap(newCode);
+		maxStackSize = newMaxStackSize;
+		funcImpl.ClearLocalDataDeclarations();
+		for (uint32 i=0; i<locals.size(); ++i)
+			funcImpl.AddLocalDataDeclaration(locals[i]);
+		for (uint32 i=0; i<func.GetNumDirectCalls(); ++i)
+			funcImpl.AddDirectCall(func.GetDirectCall(i));
+
+		stats.AddFunction(true);
+		m_stats.Merge(stats);
+		return true;
+	}
+}
@@ -0,0 +1,248 @@
+#if !defined(DSC_IRPASSES_H_)
+#define DSC_IRPASSES_H_
+
+#include <string>
+#include <vector>
+#include "IR.h"
+
+namespace dsc
+{
+	//-------------------------------------------------------------------------------------
+	/// Optimization pass over the SSA form of a function.
+	/// Passes keep no state between functions, so one instance can be used for many.
+	class IRPass
+	{
+	public:
+		virtual ~IRPass() {}
+		virtual const char* GetName() const = 0;
+		virtual void Run(IRFunction& func) = 0;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Unoptimized function body, as the inliner builds it into the IR.
+	class IRCallee
+	{
+	public:
+		IRCallee(const FunctionImplementation* pFuncImpl, const FunctionDeclaration* pFuncDecl,
+			const ScriptClassDeclaration* pClassDecl, const IRCallSiteArray* pCallSites)
+		: m_pFuncImpl(pFuncImpl), m_pFuncDecl(pFuncDecl), m_pClassDecl(pClassDecl), m_pCallSites(pCallSites) {}
+
+		const FunctionImplementation& GetFunctionImplementation() const { return *m_pFuncImpl; }
+		const FunctionDeclaration& GetFunctionDeclaration() const { return *m_pFuncDecl; }
+		/// class whose source defines the function
+		const ScriptClassDeclaration& GetScriptClassDeclaration() const { return *m_pClassDecl; }
+		const IRCallSiteArray& GetCallSites() const { return *m_pCallSites; }
+
+	private:
+		const FunctionImplementation* m_pFuncImpl;
+		const FunctionDeclaration* m_pFuncDecl;
+		const ScriptClassDeclaration* m_pClassDecl;
+		const IRCallSiteArray* m_pCallSites;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Tells the inliner which function a call runs.
+	/// Used from several threads at once, so it must not change while optimizing.
+	class IRCallResolver
+	{
+	public:
+		virtual ~IRCallResolver() {}
+		/// Returns the function call always runs, or 0 if that isn't known at compile time.
+		virtual const IRCallee* GetCallee(const IRFunction& func, const IRInstruction& call) const = 0;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Budgets of the inliner.
+	class InlineLimits
+	{
+	public:
+		InlineLimits() : m_maxCalleeSize(24), m_maxDepth(3), m_maxGrowth(256) {}
+		InlineLimits(uint32 maxCalleeSize, uint32 maxDepth, uint32 maxGrowth)
+		: m_maxCalleeSize(maxCalleeSize), m_maxDepth(maxDepth), m_maxGrowth(maxGrowth) {}
+
+		/// largest function that is inlined, in IR instructions
+		uint32 GetMaxCalleeSize() const { return m_maxCalleeSize; }
+		/// levels of calls inlined into each other, 0 turns inlining off
+		uint32 GetMaxDepth() const { return m_maxDepth; }
+		/// IR instructions inlining may add to one function
+		uint32 GetMaxGrowth() const { return m_maxGrowth; }
+
+	private:
+		uint32 m_maxCalleeSize;
+		uint32 m_maxDepth;
+		uint32 m_maxGrowth;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Replaces calls of small functions whose target is known at compile time by the
+	/// body of the function.  Their parameters and locals become values of the caller.
+	class InliningPass : public IRPass
+	{
+	public:
+		InliningPass(const IRCallResolver& resolver, const InlineLimits& limits) : m_resolver(resolver), m_limits(limits) {}
+
+		virtual const char* GetName() const { return "inlining"; }
+		virtual void Run(IRFunction& func);
+
+	private:
+		typedef std::vector<const IRCallee*> IRCalleeCPtrArray;
+
+		void InlineCalls(IRFunction& func, uint32 depth, IRCalleeCPtrArray& active);
+		bool CanInline(const IRFunction& func, const IRFunction& callee) const;
+
+	private:
+		const IRCallResolver& m_resolver;
+		InlineLimits m_limits;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Removes variable assignments and phis that merge only one value.
+	class CopyPropagationPass : public IRPass
+	{
+	public:
+		virtual const char* GetName() const { return "copy propagation"; }
+		virtual void Run(IRFunction& func);
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Sends a branch on a value that is constant on some incoming paths, like the result
+	/// of && and ||, straight to its target on those paths.  Blocks that only jump are
+	/// bypassed, blocks left with a single way in are merged into it, and jumps to a
+	/// return of merged values return right away.
+	class JumpThreadingPass : public IRPass
+	{
+	public:
+		virtual const char* GetName() const { return "jump threading"; }
+		virtual void Run(IRFunction& func);
+
+	private:
+		bool ThreadBlock(IRFunction& func, IRBlock* pBlock, const std::vector<uint32>& numUses);
+		bool BypassBlock(IRFunction& func, IRBlock* pBlock);
+		bool MergeBlock(IRFunction& func, IRBlock* pBlock);
+		bool DuplicateReturn(IRFunction& func, IRBlock* pBlock);
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Reuses field fetches while the field can't have changed, and pure
+	/// expressions that were already computed on every path.
+	class CommonSubexpressionPass : public IRPass
+	{
+	public:
+		virtual const char* GetName() const { return "common subexpressions"; }
+		virtual void Run(IRFunction& func);
+
+	private:
+		void RemoveFieldFetches(IRFunction& func);
+		void RemoveExpressions(IRFunction& func);
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Moves computations that give the same value in every iteration in front of the loop.
+	class LoopInvariantCodeMotionPass : public IRPass
+	{
+	public:
+		virtual const char* GetName() const { return "loop invariant code motion"; }
+		virtual void Run(IRFunction& func);
+
+	private:
+		void HoistLoop(IRFunction& func, IRBlock* pHeader, const IRBlockPtrArray& latches);
+	};
+
+	//-------------------------------------------------------------------------------------
+	class DeadCodeEliminationPass : public IRPass
+	{
+	public:
+		virtual const char* GetName() const { return "dead code elimination"; }
+		virtual void Run(IRFunction& func) { func.RemoveDeadInstructions(); }
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Time spent in, and code size before and after, each stage of the optimizer.
+	/// Sizes are in IR instructions, except for the bytecode going into the
+	/// builder and coming out of lowering, which are counted in code words.
+	class OptimizerStats
+	{
+	public:
+		class PassStats
+		{
+		public:
+			PassStats(const char* name) : m_name(name), m_numRuns(0), m_ticks(0), m_sizeBefore(0), m_sizeAfter(0) {}
+
+			const char* GetName() const { return m_name.c_str(); }
+			uint32 GetNumRuns() const { return m_numRuns; }
+			uint64 GetTicks() const { return m_ticks; }
+			uint32 GetSizeBefore() const { return m_sizeBefore; }
+			uint32 GetSizeAfter() const { return m_sizeAfter; }
+
+			void Add(uint32 numRuns, uint64 ticks, uint32 sizeBefore, uint32 sizeAfter)
+			{
+				m_numRuns += numRuns;
+				m_ticks += ticks;
+				m_sizeBefore += sizeBefore;
+				m_sizeAfter += sizeAfter;
+			}
+
+		private:
+			std::string m_name;
+			uint32 m_numRuns;
+			uint64 m_ticks;
+			uint32 m_sizeBefore;
+			uint32 m_sizeAfter;
+		};
+
+		OptimizerStats() : m_numFunctions(0), m_numSkipped(0) {}
+
+		void Clear();
+		void AddPass(const char* name, uint64 ticks, uint32 sizeBefore, uint32 sizeAfter);
+		void AddFunction(bool optimized) { ++m_numFunctions; if (!optimized) ++m_numSkipped; }
+		void Merge(const OptimizerStats& stats);
+
+		uint32 GetNumPasses() const { return (uint32) m_passes.size(); }
+		const PassStats& GetPassStats(uint32 idx) const { return m_passes[idx]; }
+		uint32 GetNumFunctions() const { return m_numFunctions; }
+		/// functions left as they were, because the IR can't represent them
+		uint32 GetNumSkippedFunctions() const { return m_numSkipped; }
+
+	private:
+		PassStats& GetPassStats(const char* name);
+
+	private:
+		std::vector<PassStats> m_passes;
+		uint32 m_numFunctions;
+		uint32 m_numSkipped;
+	};
+
+	const std::string ToString(const OptimizerStats& stats);
+
+	//-------------------------------------------------------------------------------------
+	/// Runs a pipeline of passes over the bytecode of a function.
+	class PassManager
+	{
+		DSC_NOCOPY(PassManager)
+	public:
+		typedef std::vector<dsr::VMBytecode> VMCodeBlock;
+
+		PassManager() {}
+		~PassManager();
+
+		/// takes ownership of the pass
+		void AddPass(IRPass* pPass) { m_passes.push_back(pPass); }
+		void AddDefaultPasses();
+		uint32 GetNumPasses() const { return (uint32) m_passes.size(); }
+
+		/// Replaces the code, stack size and locals of funcImpl with optimized ones.
+		/// Functions the IR can't represent are left alone and false is returned.
+		bool Optimize(FunctionImplementation& funcImpl, VMCodeBlock& code, uint32& maxStackSize, const FunctionDeclaration& funcDecl,
+			const ScriptClassDeclaration& classDecl, const IRCallSiteArray& callSites);
+
+		const OptimizerStats& GetStats() const { return m_stats; }
+
+	private:
+		typedef std::vector<IRPass*> IRPassPtrArray;
+
+		IRPassPtrArray m_passes;
+		OptimizerStats m_stats;
+	};
+}
+
+#endif
@@ -1,24 +1,13 @@
-#include <stdarg.h>
 #include "Parser.h"
 #include "Scanner.h"
 #include "Compiler.h"
+#include "StringUtils.h"
 
 namespace dsc
 {
-	static const char* FORMAT(const char *fmt, ...)
-	{
-		static char str[1024];
-
-		va_list ap;
-		va_start(ap, fmt);
-		_vsnprintf(str, 1024, fmt, ap);
-		va_end(ap);
-
-		return str;
-	}
-
 	//--------------------------------------------------------------------------------
-	Parser::Parser()
+	Parser::Parser(SymbolTable& symbols)
+	: m_errorToken(TOKEN_ERROR, "", 0, 0), m_symbols(symbols), m_pArena(0)
 	{
 	}
 
@@ -36,7 +25,7 @@ namespace dsc
 			while (m_curTokenItt != m_tokens.end()
 				&& (CurToken().GetType() == TOKEN_LINE_COMMENT || CurToken().GetType() == TOKEN_BRACKETED_COMMENT))
 			{
-				m_comments.push_back(std::string(CurToken().GetSpelling()));
+				m_comments.push_back(CurToken().GetSpelling());
 				++m_curTokenItt;
 			}
 			return;
@@ -49,26 +38,26 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	Token Parser::PrevToken() const
+	const Token& Parser::PrevToken() const
 	{
 		return m_prevToken;
 	}
 
 
 	//--------------------------------------------------------------------------------
-	Token Parser::CurToken() const
+	const Token& Parser::CurToken() const
 	{
 		if (m_curTokenItt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 		else
 			return *m_curTokenItt;
 	}
 
 	//--------------------------------------------------------------------------------
-	Token Parser::NextToken() const
+	const Token& Parser::NextToken() const
 	{
 		if (m_curTokenItt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 
 		TokenList::const_iterator itt = m_curTokenItt;
 		++itt;
@@ -81,16 +70,16 @@ namespace dsc
 		}
 
 		if (itt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 		else
 			return *itt;
 	}
 
 	//--------------------------------------------------------------------------------
-	Token Parser::NextNextToken() const
+	const Token& Parser::NextNextToken() const
 	{
 		if (m_curTokenItt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 
 		TokenList::const_iterator itt = m_curTokenItt;
 
@@ -104,7 +93,7 @@ namespace dsc
 		}
 
 		if (itt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 
 		++itt;
 
@@ -116,16 +105,16 @@ namespace dsc
 		}
 
 		if (itt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 		else
 			return *itt;
 	}
 
 	//--------------------------------------------------------------------------------
-	Token Parser::NextNextNextToken() const
+	const Token& Parser::NextNextNextToken() const
 	{
 		if (m_curTokenItt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 
 		TokenList::const_iterator itt = m_curTokenItt;
 
@@ -139,7 +128,7 @@ namespace dsc
 		}
 
 		if (itt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 
 		++itt;
 
@@ -151,7 +140,7 @@ namespace dsc
 		}
 
 		if (itt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 
 		++itt;
 
@@ -163,7 +152,7 @@ namespace dsc
 		}
 
 		if (itt == m_tokens.end())
-			return Token(TOKEN_ERROR, "", 0, 0);
+			return m_errorToken;
 		else
 			return *itt;
 	}
@@ -177,7 +166,7 @@ namespace dsc
 		while (m_curTokenItt != m_tokens.end()
 			&& (CurToken().GetType() == TOKEN_LINE_COMMENT || CurToken().GetType() == TOKEN_BRACKETED_COMMENT))
 		{
-			m_comments.push_back(std::string(CurToken().GetSpelling()));
+			m_comments.push_back(CurToken().GetSpelling());
 			++m_curTokenItt;
 		}
 	}
@@ -195,11 +184,23 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	void Parser::ParseScriptClassName(std::string& className)
+	const char* Parser::ParseScriptClassName()
+	{
+		uint32 symbol = SymbolTable::INVALID_SYMBOL;
+		return ParseScriptClassName(symbol);
+	}
+
+	//--------------------------------------------------------------------------------
+	const char* Parser::ParseScriptClassName(uint32& symbol)
 	{
 		Accept(TOKEN_IDENTIFIER);
+		if (CurToken().GetType() != TOKEN_DOT)
+		{
+			symbol = PrevToken().GetSymbol();
+			return PrevToken().GetSpelling();
+		}
 
-		className = PrevToken().GetSpelling();
+		std::string className = PrevToken().GetSpelling();
 		while (CurToken().GetType() == TOKEN_DOT)
 		{
 			Accept(TOKEN_DOT);
@@ -208,16 +209,35 @@ namespace dsc
 			className += '.';
 			className += PrevToken().GetSpelling();
 		}
+
+		return m_cpScriptSource->Intern(className.c_str(), symbol);
+	}
+
+	//--------------------------------------------------------------------------------
+	CommentArray Parser::GetComments()
+	{
+		if (m_comments.empty())
+			return CommentArray();
+
+		return CommentArray::Copy(*m_pArena, &m_comments[0], (uint32) m_comments.size());
 	}
 
 	//--------------------------------------------------------------------------------
 	ScriptSourceCPtr Parser::ParseScript(const char* source)
 	{
 		m_tokens.clear();
-		m_cpScriptSource.set(new ScriptSource());
+		m_comments.clear();
+		m_operatorStack.clear();
+		m_memberStack.clear();
+		m_expressionStack.clear();
+		m_statementStack.clear();
+		m_dataStack.clear();
+		m_parameterStack.clear();
+		m_cpScriptSource.set(new ScriptSource(m_symbols));
+		m_pArena = &m_cpScriptSource->GetArena();
 
 		//scan source, and create a list of tokens
-		Scanner scanner(source);
+		Scanner scanner(source, m_symbols);
 		while (!scanner.Done())
 		{
 			Token tok = scanner.Scan();
@@ -237,9 +257,7 @@ namespace dsc
 
 			Accept(TOKEN_IMPORT);
 
-			std::string importClass;
-			ParseScriptClassName(importClass);
-			m_cpScriptSource->AddImportClass(importClass.c_str());
+			m_cpScriptSource->AddImportClass(ParseScriptClassName());
 
 			Accept(TOKEN_SEMICOLON);
 		}
@@ -247,7 +265,7 @@ namespace dsc
 		//add class comments
 		for (uint32 i=0; i<m_comments.size(); ++i)
 		{
-			m_cpScriptSource->AddComment(m_comments[i].c_str());
+			m_cpScriptSource->AddComment(m_comments[i]);
 		}
 
 		//check if native script
@@ -257,13 +275,18 @@ namespace dsc
 			m_cpScriptSource->SetNative(true);
 		}
 
+		//check if final script
+		if (CurToken().GetType() == TOKEN_FINAL)
+		{
+			Accept(TOKEN_FINAL);
+			m_cpScriptSource->SetFinal();
+		}
+
 		//verify script keyword
 		Accept(TOKEN_CLASS);
 
 		//get script name
-		std::string className;
-		ParseScriptClassName(className);
-		m_cpScriptSource->SetName(className.c_str());
+		m_cpScriptSource->SetName(ParseScriptClassName());
 
 		//get super script
 		if (CurToken().GetType() == TOKEN_EXTENDS)
@@ -271,9 +294,7 @@ namespace dsc
 			Accept(TOKEN_EXTENDS);
 
 			//get parent script name
-			std::string superClassName;
-			ParseScriptClassName(superClassName);
-			m_cpScriptSource->SetSuper(superClassName.c_str());
+			m_cpScriptSource->SetSuper(ParseScriptClassName());
 		}
 
 		//opening '{'
@@ -288,13 +309,13 @@ namespace dsc
 			if (distSemicolon <= distOpenBracket)
 			{
 				//data
-				DataSrcCPtr data = ParseClassData();
+				const DataSrc* data = ParseClassData();
 				m_cpScriptSource->AddDataMember(data);
 			}
 			else
 			{
 				//function
-				FunctionSrcCPtr fnc = ParseFunction();
+				const FunctionSrc* fnc = ParseFunction();
 
 				if (fnc->IsConstructor())
 					m_cpScriptSource->AddConstructor(fnc);
@@ -311,25 +332,20 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	DataSrcCPtr Parser::ParseClassData()
+	DataSrc* Parser::ParseClassData()
 	{
-		DataSrcCPtr res = new DataSrc();
+		DataSrc* res = new (*m_pArena) DataSrc();
 		res->SetLine(CurToken().GetLine());
 
 		//add data comments
-		for (uint32 i=0; i<m_comments.size(); ++i)
-		{
-			res->AddComment(m_comments[i].c_str());
-		}
+		res->SetComments(GetComments());
 
 		//get data type
-		std::string className;
-		ParseScriptClassName(className);
-		res->SetType(className.c_str());
+		res->SetType(ParseScriptClassName());
 
 		//get variable name
 		Accept(TOKEN_IDENTIFIER);
-		res->SetName(PrevToken().GetSpelling());
+		res->SetName(PrevToken().GetSpelling(), PrevToken().GetSymbol());
 
 		//get ;
 		m_comments.clear();
@@ -339,25 +355,20 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	DataSrcCPtr Parser::ParseLocalData()
+	DataSrc* Parser::ParseLocalData()
 	{
-		DataSrcCPtr res = new DataSrc();
+		DataSrc* res = new (*m_pArena) DataSrc();
 		res->SetLine(CurToken().GetLine());
 
 		//add data comments
-		for (uint32 i=0; i<m_comments.size(); ++i)
-		{
-			res->AddComment(m_comments[i].c_str());
-		}
+		res->SetComments(GetComments());
 
 		//get data type
-		std::string className;
-		ParseScriptClassName(className);
-		res->SetType(className.c_str());
+		res->SetType(ParseScriptClassName());
 
 		//get variable name
 		Accept(TOKEN_IDENTIFIER);
-		res->SetName(PrevToken().GetSpelling());
+		res->SetName(PrevToken().GetSpelling(), PrevToken().GetSymbol());
 
 		if (CurToken().GetType() == TOKEN_SEMICOLON)
 		{
@@ -371,7 +382,7 @@ namespace dsc
 		Accept(TOKEN_ASSIGN);
 
 		// get initializer
-		ExpressionSrcCPtr expr = ParseExpression();
+		const ExpressionSrc* expr = ParseExpression();
 		res->SetExpression(expr);
 
 		//get ;
@@ -381,51 +392,57 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	FunctionSrcCPtr Parser::ParseFunction()
+	FunctionSrc* Parser::ParseFunction()
 	{
-		FunctionSrcCPtr res = new FunctionSrc();
+		FunctionSrc* res = new (*m_pArena) FunctionSrc();
 		res->SetLine(CurToken().GetLine());
 
 		//add function comments
-		for (uint32 i=0; i<m_comments.size(); ++i)
+		res->SetComments(GetComments());
+
+		//check if final function
+		if (CurToken().GetType() == TOKEN_FINAL)
 		{
-			res->AddComment(m_comments[i].c_str());
+			Accept(TOKEN_FINAL);
+			res->SetFinal();
 		}
 
 		//get return type
-		std::string returnClass;
-		ParseScriptClassName(returnClass);
+		uint32 returnClassSymbol = SymbolTable::INVALID_SYMBOL;
+		const char* returnClass = ParseScriptClassName(returnClassSymbol);
 		if (CurToken().GetType() == TOKEN_OPEN_BRACKET)
 		{
 			//constructor
-			if (strcmp(returnClass.c_str(), m_cpScriptSource->GetName()) != 0)
+			if (strcmp(returnClass, m_cpScriptSource->GetName()) != 0)
 				throw CompilerException(FORMAT("No return value specified.  Class %s, line %u.", m_cpScriptSource->GetName(), CurToken().GetLine()));
+			if (res->IsFinal())
+				throw CompilerException(FORMAT("Constructors can't be final.  Class %s, line %u.", m_cpScriptSource->GetName(), CurToken().GetLine()));
 			res->SetReturnType("void");
-			res->SetName(returnClass.c_str());
+			res->SetName(returnClass, returnClassSymbol);
 			res->SetConstructor();
 		}
 		else
 		{
-			res->SetReturnType(returnClass.c_str());
+			res->SetReturnType(returnClass);
 
 			//get funcion name
 			Accept(TOKEN_IDENTIFIER);
-			res->SetName(PrevToken().GetSpelling());
+			res->SetName(PrevToken().GetSpelling(), PrevToken().GetSymbol());
 		}
 
 		//opening '('
 		Accept(TOKEN_OPEN_BRACKET);
 
 		// function parameters
+		const uint32 firstParameter = (uint32) m_parameterStack.size();
 		if (CurToken().GetType() != TOKEN_CLOSE_BRACKET)
 		{
 			//get first parameter type
-			std::string paramClass;
-			ParseScriptClassName(paramClass);
+			const char* paramClass = ParseScriptClassName();
 
 			//get first parameter name
 			Accept(TOKEN_IDENTIFIER);
-			res->PushParameter(paramClass.c_str(), PrevToken().GetSpelling(), PrevToken().GetLine());
+			m_parameterStack.push_back(FunctionParameterSrc(paramClass, PrevToken().GetSpelling(), PrevToken().GetSymbol(), PrevToken().GetLine()));
 
 			//get the rest of the parameters
 			while (CurToken().GetType() == TOKEN_COMMA)
@@ -433,14 +450,14 @@ namespace dsc
 				Accept(TOKEN_COMMA);
 
 				//get parameter type
-				std::string paramClass;
-				ParseScriptClassName(paramClass);
+				const char* paramClass = ParseScriptClassName();
 
 				//get parameter name
 				Accept(TOKEN_IDENTIFIER);
-				res->PushParameter(paramClass.c_str(), PrevToken().GetSpelling(), PrevToken().GetLine());
+				m_parameterStack.push_back(FunctionParameterSrc(paramClass, PrevToken().GetSpelling(), PrevToken().GetSymbol(), PrevToken().GetLine()));
 			}
 		}
+		res->SetParameters(FunctionSrc::FunctionParameterArray::Pop(*m_pArena, m_parameterStack, firstParameter));
 
 		//closing ')'
 		Accept(TOKEN_CLOSE_BRACKET);
@@ -470,16 +487,18 @@ namespace dsc
 		if (CurToken().GetType() != TOKEN_CLOSE_CURLY_BRACKET)
 		{
 			//get data members
+			const uint32 firstLocal = (uint32) m_dataStack.size();
 			while (IsLocalData())
 			{
-				DataSrcCPtr data = ParseLocalData();
-				res->AddLocalDataMember(data);
+				const DataSrc* data = ParseLocalData();
+				m_dataStack.push_back(data);
 			}
+			res->SetLocals(FunctionSrc::DataSrcPtrArray::Pop(*m_pArena, m_dataStack, firstLocal));
 
 			//parse base constructor if needed
 			if (res->IsConstructor() && strlen(m_cpScriptSource->GetSuper()) > 0)
 			{
-				FunctionCallSrcCPtr fncCall = ParseFunctionCall();
+				const FunctionCallSrc* fncCall = ParseFunctionCall();
 				if (strcmp(fncCall->GetName(), "super") != 0)
 				{
 					throw CompilerException(FORMAT("Super's constructor has to be the first statement in the constructor.  Class %s, line %u.",
@@ -489,7 +508,7 @@ namespace dsc
 			}
 
 			//get statement block
-			StatementSrcCPtr statement = ParseStatementBlock();
+			const StatementSrc* statement = ParseStatementBlock();
 			res->SetStatement(statement);
 		}
 
@@ -501,7 +520,7 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	StatementSrcCPtr Parser::ParseStatement()
+	StatementSrc* Parser::ParseStatement()
 	{
 		uint32 line = CurToken().GetLine();
 
@@ -515,15 +534,15 @@ namespace dsc
 				Accept(TOKEN_OPEN_BRACKET);
 
 				//expression
-				ExpressionSrcCPtr cpExpression = ParseExpression();
+				const ExpressionSrc* pExpression = ParseExpression();
 
 				//closing ')'
 				Accept(TOKEN_CLOSE_BRACKET);
 
 				//statement block
-				StatementSrcCPtr statement = ParseStatement();
+				const StatementSrc* statement = ParseStatement();
 
-				StatementSrcCPtr res(new StWhile(cpExpression, statement));
+				StatementSrc* res = new (*m_pArena) StWhile(pExpression, statement);
 				res->SetLine(line);
 				return res;
 			}
@@ -537,16 +556,16 @@ namespace dsc
 				Accept(TOKEN_OPEN_BRACKET);
 
 				//expression
-				ExpressionSrcCPtr cpExpression = ParseExpression();
+				const ExpressionSrc* pExpression = ParseExpression();
 
 				//closing ')'
 				Accept(TOKEN_CLOSE_BRACKET);
 
 				//statement block
-				StatementSrcCPtr trueStatement = ParseStatement();
+				const StatementSrc* trueStatement = ParseStatement();
 
 				//check for else
-				StatementSrcCPtr falseStatement = 0;
+				const StatementSrc* falseStatement = 0;
 				if (CurToken().GetType() == TOKEN_ELSE)
 				{
 					Accept(TOKEN_ELSE);
@@ -555,7 +574,7 @@ namespace dsc
 					falseStatement = ParseStatement();
 				}
 
-				StatementSrcCPtr res(new StIf(cpExpression, trueStatement, falseStatement));
+				StatementSrc* res = new (*m_pArena) StIf(pExpression, trueStatement, falseStatement);
 				res->SetLine(line);
 				return res;
 			}
@@ -565,7 +584,7 @@ namespace dsc
 			{
 				Accept(TOKEN_RETURN);
 
-				ExpressionSrcCPtr retVal = 0;
+				const ExpressionSrc* retVal = 0;
 				if (CurToken().GetType() == TOKEN_SEMICOLON)
 				{
 					//no return value
@@ -579,7 +598,7 @@ namespace dsc
 					Accept(TOKEN_SEMICOLON);
 				}
 
-				StatementSrcCPtr res(new StReturn(retVal));
+				StatementSrc* res = new (*m_pArena) StReturn(retVal);
 				res->SetLine(line);
 				return res;
 			}
@@ -588,7 +607,7 @@ namespace dsc
 		case TOKEN_OPEN_CURLY_BRACKET:
 			{
 				Accept(TOKEN_OPEN_CURLY_BRACKET);
-				StatementSrcCPtr res = ParseStatementBlock();
+				StatementSrc* res = ParseStatementBlock();
 
 				Accept(TOKEN_CLOSE_CURLY_BRACKET);
 
@@ -599,15 +618,15 @@ namespace dsc
 		case TOKEN_SUPER:
 			{
 				//super function call
-				FunctionCallSrcCPtr function = ParseFunctionCall();
+				FunctionCallSrc* function = ParseFunctionCall();
 
 				while (CurToken().GetType() == TOKEN_DOT)
 				{
-					FunctionCallSrcCPtr function2 = ParseFunctionCall();
+					FunctionCallSrc* function2 = ParseFunctionCall();
 					function->AddFncCall(function2);
 				}
 
-				StatementSrcCPtr res(new StFunctionCall(function));
+				StatementSrc* res = new (*m_pArena) StFunctionCall(function);
 				res->SetLine(line);
 
 				Accept(TOKEN_SEMICOLON);
@@ -620,15 +639,15 @@ namespace dsc
 			{
 				//function call
 				assert(IsFunctionCall());
-				FunctionCallSrcCPtr function = ParseFunctionCall();
+				FunctionCallSrc* function = ParseFunctionCall();
 
 				while (CurToken().GetType() == TOKEN_DOT)
 				{
-					FunctionCallSrcCPtr function2 = ParseFunctionCall();
+					FunctionCallSrc* function2 = ParseFunctionCall();
 					function->AddFncCall(function2);
 				}
 
-				StatementSrcCPtr res(new StFunctionCall(function));
+				StatementSrc* res = new (*m_pArena) StFunctionCall(function);
 				res->SetLine(line);
 
 				Accept(TOKEN_SEMICOLON);
@@ -646,15 +665,15 @@ namespace dsc
 					{
 						//function call
 						assert(IsFunctionCall());
-						FunctionCallSrcCPtr function = ParseFunctionCall();
+						FunctionCallSrc* function = ParseFunctionCall();
 
 						while (CurToken().GetType() == TOKEN_DOT)
 						{
-							FunctionCallSrcCPtr function2 = ParseFunctionCall();
+							FunctionCallSrc* function2 = ParseFunctionCall();
 							function->AddFncCall(function2);
 						}
 
-						StatementSrcCPtr res(new StFunctionCall(function));
+						StatementSrc* res = new (*m_pArena) StFunctionCall(function);
 						res->SetLine(line);
 
 						Accept(TOKEN_SEMICOLON);
@@ -667,15 +686,16 @@ namespace dsc
 					{
 						//assignment statement
 						Accept(TOKEN_IDENTIFIER);
-						std::string vname = PrevToken().GetSpelling();
+						const char* vname = PrevToken().GetSpelling();
+						const uint32 vsymbol = PrevToken().GetSymbol();
 
 						Accept(TOKEN_ASSIGN);
 
-						ExpressionSrcCPtr cpExpression = ParseExpression();
+						const ExpressionSrc* pExpression = ParseExpression();
 
 						Accept(TOKEN_SEMICOLON);
 
-						StatementSrcCPtr res(new StAssign(vname, cpExpression));
+						StatementSrc* res = new (*m_pArena) StAssign(vname, vsymbol, pExpression);
 						res->SetLine(line);
 						return res;
 					}
@@ -703,51 +723,54 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	StatementSrcCPtr Parser::ParseStatementBlock()
+	StatementSrc* Parser::ParseStatementBlock()
 	{
-		StBlockCPtr cpBlock(new StBlock());
-		cpBlock->SetLine(CurToken().GetLine());
+		StBlock* pBlock = new (*m_pArena) StBlock();
+		pBlock->SetLine(CurToken().GetLine());
 
+		const uint32 first = (uint32) m_statementStack.size();
 		while (CurToken().GetType() != TOKEN_CLOSE_CURLY_BRACKET)
 		{
-			StatementSrcCPtr cpStatement = ParseStatement();
-			cpBlock->AddStatement(cpStatement);
+			const StatementSrc* pStatement = ParseStatement();
+			m_statementStack.push_back(pStatement);
 		}
+		pBlock->SetStatements(StBlock::StatementSrcPtrArray::Pop(*m_pArena, m_statementStack, first));
 
-		return StatementSrcCPtr(cpBlock.get());
+		return pBlock;
 	}
 
 	//--------------------------------------------------------------------------------
-	ExpressionSrcCPtr Parser::ParseExpression()
+	ExpressionSrc* Parser::ParseExpression()
 	{
-		ExpressionSrcCPtr res = new ExpressionSrc();
+		ExpressionSrc* res = new (*m_pArena) ExpressionSrc();
 		res->SetLine(CurToken().GetLine());
 
-		std::list<Token> stack;
+		//operators and members of the enclosing expressions stay below these
+		const uint32 firstOperator = (uint32) m_operatorStack.size();
+		const uint32 firstMember = (uint32) m_memberStack.size();
 
-		while (true)
+		bool done = false;
+		while (!done)
 		{
 			if (CurToken().GetType() == TOKEN_SEMICOLON)
 			{
-				while (!stack.empty())
+				while (m_operatorStack.size() > firstOperator)
 				{
-					Token tok = stack.back();
-					stack.pop_back();
-					res->Push(tok);
+					m_memberStack.push_back(m_operatorStack.back());
+					m_operatorStack.pop_back();
 				}
 
-				return res;
+				done = true;
 			}
 			else if (CurToken().GetType() == TOKEN_COMMA)
 			{
-				while (!stack.empty())
+				while (m_operatorStack.size() > firstOperator)
 				{
-					Token tok = stack.back();
-					stack.pop_back();
-					res->Push(tok);
+					m_memberStack.push_back(m_operatorStack.back());
+					m_operatorStack.pop_back();
 				}
 
-				return res;
+				done = true;
 			}
 			else if (CurToken().GetType() == TOKEN_EOF)
 			{
@@ -757,87 +780,86 @@ namespace dsc
 			}
 			else if (IsFunctionCall())
 			{
-				FunctionCallSrcCPtr function = ParseFunctionCall();
+				FunctionCallSrc* function = ParseFunctionCall();
 
 				while (CurToken().GetType() == TOKEN_DOT)
 				{
 					assert(IsFunctionCall());
-					FunctionCallSrcCPtr function2 = ParseFunctionCall();
+					FunctionCallSrc* function2 = ParseFunctionCall();
 					function->AddFncCall(function2);
 				}
 
-				res->Push(function);
+				m_memberStack.push_back(function);
 			}
 			else if (CurToken().GetType() == TOKEN_CLOSE_BRACKET)
 			{
-				if (stack.empty())
+				if (m_operatorStack.size() == firstOperator)
 				{
-					return res;
+					done = true;
 				}
 				else
 				{
-					Token topOfStack = stack.back();
-					stack.pop_back();
+					Token topOfStack = m_operatorStack.back();
+					m_operatorStack.pop_back();
 
 					while (topOfStack.GetType() != TOKEN_OPEN_BRACKET)
 					{
-						if (stack.empty())
-						{
-							res->Push(topOfStack);
-							return res;
-						}
-						else
+						m_memberStack.push_back(topOfStack);
+						if (m_operatorStack.size() == firstOperator)
 						{
-							res->Push(topOfStack);
-							topOfStack = stack.back();
-							stack.pop_back();
+							done = true;
+							break;
 						}
+
+						topOfStack = m_operatorStack.back();
+						m_operatorStack.pop_back();
 					}
+
+					if (!done)
+						Accept(CurToken().GetType());
 				}
-				Accept(CurToken().GetType());
 			}
 			else if (CurToken().GetType() == TOKEN_OPEN_BRACKET)
 			{
-				stack.push_back(CurToken());
+				m_operatorStack.push_back(CurToken());
 				Accept(CurToken().GetType());
 			}
+			else if (CurToken().GetType() == TOKEN_IS || CurToken().GetType() == TOKEN_AS)
+			{
+				//postfix, applies to the operand before it, the class name goes with the token
+				const Token op = CurToken();
+				Accept(op.GetType());
+				uint32 symbol = SymbolTable::INVALID_SYMBOL;
+				const char* className = ParseScriptClassName(symbol);
+				m_memberStack.push_back(Token(op.GetType(), symbol, className, op.GetLine(), op.GetCol()));
+			}
 			else if (IsOperator(CurToken().GetType()))
 			{
-				if (!stack.empty())
+				while (m_operatorStack.size() > firstOperator
+					&& GetOperatorPriority(CurToken().GetType()) <= GetOperatorPriority(m_operatorStack.back().GetType()))
 				{
-					Token topOfStack = stack.back();
-					while (topOfStack.GetType() != TOKEN_ERROR && GetOperatorPriority(CurToken().GetType()) <= GetOperatorPriority(topOfStack.GetType()))
-					{
-						stack.pop_back();
-						res->Push(topOfStack);
-
-						if (stack.empty())
-							topOfStack = Token(TOKEN_ERROR, "", 0, 0);
-						else
-							topOfStack = stack.back();
-					}
+					m_memberStack.push_back(m_operatorStack.back());
+					m_operatorStack.pop_back();
 				}
 
-				stack.push_back(CurToken());
+				m_operatorStack.push_back(CurToken());
 				Accept(CurToken().GetType());
 			}
 			else
 			{
-				res->Push(CurToken());
+				m_memberStack.push_back(CurToken());
 				Accept(CurToken().GetType());
 			}
 		}
 
-		assert(false);
-		throw CompilerException(FORMAT("Invalid expression.  Class %s, line %u.",
-			m_cpScriptSource->GetName(), res->GetLine()));
-		return 0;
+		res->SetMembers(ExpressionSrc::ExpressionMemberArray::Pop(*m_pArena, m_memberStack, firstMember));
+		return res;
 	}
 
 	//--------------------------------------------------------------------------------
-	FunctionCallSrcCPtr Parser::ParseFunctionCall()
+	FunctionCallSrc* Parser::ParseFunctionCall()
 	{
-		FunctionCallSrcCPtr res = new FunctionCallSrc();
+		FunctionCallSrc* res = new (*m_pArena) FunctionCallSrc();
 		res->SetLine(CurToken().GetLine());
 
 		bool superConstructor = false;
@@ -852,14 +874,14 @@ namespace dsc
 			}
 			else
 			{
-				res->SetName("super");
+				res->SetName(PrevToken().GetSpelling(), PrevToken().GetSymbol());
 				superConstructor = true;
 			}
 		}
 		else if (CurToken().GetType() == TOKEN_IDENTIFIER && NextToken().GetType() == TOKEN_DOT)
 		{
 			Accept(TOKEN_IDENTIFIER);
-			res->SetInstance(PrevToken().GetSpelling());
+			res->SetInstance(PrevToken().GetSpelling(), PrevToken().GetSymbol());
 			Accept(TOKEN_DOT);
 		}
 		else if (CurToken().GetType() == TOKEN_NEW)
@@ -870,9 +892,9 @@ namespace dsc
 
 		if (res->IsNew())
 		{
-			std::string className;
-			ParseScriptClassName(className);
-			res->SetName(className.c_str());
+			uint32 symbol = SymbolTable::INVALID_SYMBOL;
+			const char* className = ParseScriptClassName(symbol);
+			res->SetName(className, symbol);
 		}
 		else if (superConstructor)
 		{
@@ -881,22 +903,24 @@ namespace dsc
 		{
 			//get name
 			Accept(TOKEN_IDENTIFIER);
-			res->SetName(PrevToken().GetSpelling());
+			res->SetName(PrevToken().GetSpelling(), PrevToken().GetSymbol());
 		}
 
 		//opening '('
 		Accept(TOKEN_OPEN_BRACKET);
 
 		//get parameters
+		const uint32 firstParameter = (uint32) m_expressionStack.size();
 		while (CurToken().GetType() != TOKEN_CLOSE_BRACKET)
 		{
 			//get expression
-			ExpressionSrcCPtr expr = ParseExpression();
-			res->PushParameter(expr);
+			const ExpressionSrc* expr = ParseExpression();
+			m_expressionStack.push_back(expr);
 
 			if (CurToken().GetType() != TOKEN_CLOSE_BRACKET)
 				Accept(TOKEN_COMMA);
 		}
+		res->SetParameters(FunctionCallSrc::ExpressionSrcPtrArray::Pop(*m_pArena, m_expressionStack, firstParameter));
 
 		Accept(TOKEN_CLOSE_BRACKET);
 
@@ -10,21 +10,24 @@ namespace dsc
 	{
 		DSC_NOCOPY(Parser)
 
-		typedef std::list<Token> TokenList;
+		typedef std::vector<Token> TokenList;
 	public:
-		Parser();
+		/// names of the parsed scripts are interned in symbols
+		explicit Parser(SymbolTable& symbols);
 		ScriptSourceCPtr ParseScript(const char* source);
 		void GetCurrentLocation(uint32& line, uint32& col) const;
 
 	private:
-		DataSrcCPtr ParseClassData();
-		DataSrcCPtr ParseLocalData();
-		FunctionSrcCPtr ParseFunction();
-		StatementSrcCPtr ParseStatement();
-		StatementSrcCPtr ParseStatementBlock();
-		ExpressionSrcCPtr ParseExpression();
-		FunctionCallSrcCPtr ParseFunctionCall();
-		void ParseScriptClassName(std::string& name);
+		DataSrc* ParseClassData();
+		DataSrc* ParseLocalData();
+		FunctionSrc* ParseFunction();
+		StatementSrc* ParseStatement();
+		StatementSrc* ParseStatementBlock();
+		ExpressionSrc* ParseExpression();
+		FunctionCallSrc* ParseFunctionCall();
+		const char* ParseScriptClassName();
+		const char* ParseScriptClassName(uint32& symbol);
+		CommentArray GetComments();
 
 		int32 GetOperatorPriority(uint32 tokenType) const;
 		bool IsFunctionCall() const;
@@ -34,19 +37,32 @@ namespace dsc
 		uint32 GetDistTo(uint32 tokenType) const;
 		void ResetTokenItt();
 		void Accept(uint32 tokenType);
-		Token PrevToken() const;
-		Token CurToken() const;
-		Token NextToken() const;
-		Token NextNextToken() const;
-		Token NextNextNextToken() const;
+		const Token& PrevToken() const;
+		const Token& CurToken() const;
+		const Token& NextToken() const;
+		const Token& NextNextToken() const;
+		const Token& NextNextNextToken() const;
 
 	private:
 		Token m_prevToken;
+		/// returned when looking past the end of the token list
+		Token m_errorToken;
 		TokenList m_tokens;
 		TokenList::const_iterator m_curTokenItt;
 
+		SymbolTable& m_symbols;
 		ScriptSourceCPtr m_cpScriptSource;
-		std::vector<std::string> m_comments;
+		AstArena* m_pArena;
+		std::vector<const char*> m_comments;
+
+		// children are collected here while their parent is parsed, and then copied
+		// into the arena in one piece.  nested nodes push above their parent's entries.
+		std::vector<Token> m_operatorStack;
+		std::vector<ExpressionSrc::ExpressionMember> m_memberStack;
+		std::vector<const ExpressionSrc*> m_expressionStack;
+		std::vector<const StatementSrc*> m_statementStack;
+		std::vector<const DataSrc*> m_dataStack;
+		std::vector<FunctionParameterSrc> m_parameterStack;
 	};
 }
 
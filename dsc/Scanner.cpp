@@ -1,16 +1,26 @@
 #include <cassert>
 #include "Scanner.h"
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define DSC_SCANNER_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 namespace dsc
 {
 	//--------------------------------------------------------------------------------
-	Scanner::Scanner(const char* source)
+	Scanner::Scanner(const char* source, SymbolTable& symbols)
+	: m_symbols(symbols)
 	{
 		assert(source);
 
 		m_source = source;
-		m_curString[0] = '\0';
-		m_curStringIdx = 0;
+		m_tokenStart = 0;
+		m_tokenEnd = 0;
+		m_tokenSymbol = SymbolTable::INVALID_SYMBOL;
 		m_curIdx = 0;
 		m_curLine = 1;
 		m_curCol = 1;
@@ -21,88 +31,172 @@ namespace dsc
 		m_prevTokenType = TOKEN_ERROR;
 	}
 
+	//--------------------------------------------------------------------------------
+	enum
+	{
+		CC_LETTER = 1,
+		CC_DIGIT = 2,
+		CC_WHITESPACE = 4,
+		CC_SYMBOL = 8,
+	};
+
+#define L CC_LETTER
+#define D CC_DIGIT
+#define W CC_WHITESPACE
+#define S CC_SYMBOL
+	static const uint8 s_charClass[256] =
+	{
+		0, 0, 0, 0, 0, 0, 0, 0, 0, W, W, 0, 0, W, 0, 0,	//00
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//10
+		W, S, 0, 0, 0, S, S, 0, S, S, S, S, S, S, S, S,	//20
+		D, D, D, D, D, D, D, D, D, D, S, S, S, S, S, 0,	//30
+		0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,	//40
+		L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, L,	//50
+		0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,	//60
+		L, L, L, L, L, L, L, L, L, L, L, S, S, S, 0, 0,	//70
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//80
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//90
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//A0
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//B0
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//C0
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//D0
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//E0
+		0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	//F0
+	};
+#undef L
+#undef D
+#undef W
+#undef S
+
 	//--------------------------------------------------------------------------------
 	static inline bool IsLetter(char c)
 	{
-		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z' || (c == '_'));
+		return (s_charClass[(uint8) c] & CC_LETTER) != 0;
 	}
 
 	//--------------------------------------------------------------------------------
 	static inline bool IsDigit(char c)
 	{
-		return (c >= '0' && c <= '9');
+		return (s_charClass[(uint8) c] & CC_DIGIT) != 0;
+	}
+
+	//--------------------------------------------------------------------------------
+	static inline bool IsLetterOrDigit(char c)
+	{
+		return (s_charClass[(uint8) c] & (CC_LETTER | CC_DIGIT)) != 0;
 	}
 
 	//--------------------------------------------------------------------------------
 	static inline bool IsWhitespace(char c)
 	{
-		return (c == '\r' || c == '\n' || c == ' ' || c == '\t');
+		return (s_charClass[(uint8) c] & CC_WHITESPACE) != 0;
 	}
 
 	//--------------------------------------------------------------------------------
 	static inline bool IsSymbol(char c)
 	{
-		switch (c)
-		{
-		case '/':
-		case '*':
-		case '-':
-		case '+':
-		case '%':
-		case '=':
-		case '<':
-		case '>':
-		case '.':
-		case ':':
-		case '(':
-		case ')':
-		case '{':
-		case '}':
-		case '&':
-		case '|':
-		case '!':
-		case ',':
-		case ';':
-			return true;
+		return (s_charClass[(uint8) c] & CC_SYMBOL) != 0;
+	}
 
-		default:
-			return false;
+#if defined(DSC_SCANNER_SSE2)
+	//--------------------------------------------------------------------------------
+	//16 byte block helpers.  masks have bit i set for byte i.
+	static inline uint32 FirstZeroBit(uint32 mask)
+	{
+		//bit 16 is always clear in mask, so the result is 16 if all 16 bits are set
+		const uint32 inv = ~mask & 0x1FFFF;
+#if defined(_MSC_VER)
+		unsigned long idx;
+		_BitScanForward(&idx, inv);
+		return (uint32) idx;
+#else
+		return (uint32) __builtin_ctz(inv);
+#endif
+	}
+
+	static inline uint32 LastSetBit(uint32 mask)
+	{
+		assert(mask != 0);
+#if defined(_MSC_VER)
+		unsigned long idx;
+		_BitScanReverse(&idx, mask);
+		return (uint32) idx;
+#else
+		return (uint32) (31 - __builtin_clz(mask));
+#endif
+	}
+
+	static inline uint32 CountBits(uint32 mask)
+	{
+		mask = mask - ((mask >> 1) & 0x55555555);
+		mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+		mask = (mask + (mask >> 4)) & 0x0F0F0F0F;
+		return (mask * 0x01010101) >> 24;
+	}
+
+	static inline __m128i EqualMask(__m128i v, char c)
+	{
+		return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+	}
+
+	static inline __m128i RangeMask(__m128i v, char lo, char hi)
+	{
+		//signed compare, so bytes >= 0x80 are never in range
+		return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+	}
+#endif
+
+	//--------------------------------------------------------------------------------
+	//number of identifier characters (letters, digits) at the start of [p, end)
+	static inline uint32 IdentifierRunLength(const char* p, const char* end)
+	{
+		const char* start = p;
+
+#if defined(DSC_SCANNER_SSE2)
+		while (end - p >= 16)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*) p);
+			__m128i m = _mm_or_si128(RangeMask(v, 'a', 'z'), RangeMask(v, 'A', 'Z'));
+			m = _mm_or_si128(m, RangeMask(v, '0', '9'));
+			m = _mm_or_si128(m, EqualMask(v, '_'));
+
+			const uint32 n = FirstZeroBit((uint32) _mm_movemask_epi8(m));
+			p += n;
+			if (n < 16)
+				return (uint32) (p - start);
 		}
+#endif
+
+		while (p < end && IsLetterOrDigit(*p))
+			++p;
+
+		return (uint32) (p - start);
 	}
 
 	//--------------------------------------------------------------------------------
-	static inline uint32 GetTokenType(const char* str)
+	//number of characters at the start of [p, end) that are none of the stop characters
+	static inline uint32 RunLengthUntil(const char* p, const char* end, char stop0, char stop1, char stop2)
 	{
-		//figure out whether given string is an identifier or a keyword
-
-		if (strcmp(str, "class") == 0)
-			return TOKEN_CLASS;
-		else if (strcmp(str, "super") == 0)
-			return TOKEN_SUPER;
-		else if (strcmp(str, "true") == 0)
-			return TOKEN_TRUE;
-		else if (strcmp(str, "false") == 0)
-			return TOKEN_FALSE;
-		else if (strcmp(str, "native") == 0)
-			return TOKEN_NATIVE;
-		else if (strcmp(str, "while") == 0)
-			return TOKEN_WHILE;
-		else if (strcmp(str, "if") == 0)
-			return TOKEN_IF;
-		else if (strcmp(str, "else") == 0)
-			return TOKEN_ELSE;
-		else if (strcmp(str, "return") == 0)
-			return TOKEN_RETURN;
-		else if (strcmp(str, "import") == 0)
-			return TOKEN_IMPORT;
-		else if (strcmp(str, "new") == 0)
-			return TOKEN_NEW;
-		else if (strcmp(str, "extends") == 0)
-			return TOKEN_EXTENDS;
-		else if (strcmp(str, "null") == 0)
-			return TOKEN_NULL;
-		else
-			return TOKEN_IDENTIFIER;
+		const char* start = p;
+
+#if defined(DSC_SCANNER_SSE2)
+		while (end - p >= 16)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*) p);
+			__m128i m = _mm_or_si128(EqualMask(v, stop0), EqualMask(v, stop1));
+			m = _mm_or_si128(m, EqualMask(v, stop2));
+
+			const uint32 n = FirstZeroBit(~(uint32) _mm_movemask_epi8(m) & 0xFFFF);
+			p += n;
+			if (n < 16)
+				return (uint32) (p - start);
+		}
+#endif
+
+		while (p < end && *p != stop0 && *p != stop1 && *p != stop2)
+			++p;
+
+		return (uint32) (p - start);
 	}
 
 	//--------------------------------------------------------------------------------
@@ -121,12 +215,12 @@ namespace dsc
 			++m_curCol;
 		}
 
-		m_curString[m_curStringIdx] = CurChar();
-		++m_curStringIdx;
 		++m_curIdx;
 
 		if (m_curIdx > m_sourceLen)
 			m_curIdx = m_sourceLen;
+
+		m_tokenEnd = m_curIdx;
 	}
 
 	//--------------------------------------------------------------------------------
@@ -149,6 +243,10 @@ namespace dsc
 
 		if (m_curIdx > m_sourceLen)
 			m_curIdx = m_sourceLen;
+
+		//leading characters that are ignored are not part of the token
+		if (m_tokenStart == m_tokenEnd)
+			m_tokenStart = m_tokenEnd = m_curIdx;
 	}
 
 	//--------------------------------------------------------------------------------
@@ -172,7 +270,8 @@ namespace dsc
 	//--------------------------------------------------------------------------------
 	uint32 Scanner::ScanToken()
 	{
-		ClearCurString();
+		m_tokenStart = m_tokenEnd = m_curIdx;
+		m_tokenSymbol = SymbolTable::INVALID_SYMBOL;
 
 		//if source is empty, return EOF
 		if (m_sourceLen == 0)
@@ -185,9 +284,15 @@ namespace dsc
 		{
 			ScanIdentifier();
 
-			//check whether identifier or a keyword
-			m_curString[m_curStringIdx] = '\0';
-			return GetTokenType(m_curString);
+			//check whether identifier or a keyword.  keyword symbols are the keyword indices.
+			const int32 keyword = FindKeyword(m_source + m_tokenStart, m_tokenEnd - m_tokenStart);
+			if (keyword != -1)
+			{
+				m_tokenSymbol = (uint32) keyword;
+				return GetKeywordTokenType(keyword);
+			}
+
+			return TOKEN_IDENTIFIER;
 		}
 		else if (CurChar() == '\"')
 		{
@@ -226,16 +331,62 @@ namespace dsc
 	//--------------------------------------------------------------------------------
 	void Scanner::ScanWhitespace()
 	{
+#if defined(DSC_SCANNER_SSE2)
+		assert(m_tokenStart == m_tokenEnd);
+		while (m_curIdx + 16 <= m_sourceLen)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*) (m_source + m_curIdx));
+			const uint32 newlines = (uint32) _mm_movemask_epi8(EqualMask(v, '\n'));
+			const uint32 returns = (uint32) _mm_movemask_epi8(EqualMask(v, '\r'));
+			const uint32 spaces = (uint32) _mm_movemask_epi8(_mm_or_si128(EqualMask(v, ' '), EqualMask(v, '\t')));
+
+			const uint32 n = FirstZeroBit(newlines | returns | spaces);
+			const uint32 run = (1 << n) - 1;
+
+			//same line and column rules as IgnoreIt()
+			const uint32 runNewlines = newlines & run;
+			if (runNewlines)
+			{
+				const uint32 last = LastSetBit(runNewlines);
+				m_curLine += CountBits(runNewlines);
+				m_curCol = 1 + CountBits(spaces & run & ~((2 << last) - 1));
+			}
+			else
+			{
+				m_curCol += CountBits(spaces & run);
+			}
+
+			m_curIdx += n;
+			m_tokenStart = m_tokenEnd = m_curIdx;
+
+			if (n < 16)
+				return;
+		}
+#endif
+
 		while (IsWhitespace(CurChar()))
 			IgnoreIt();
 	}
 
+	//--------------------------------------------------------------------------------
+	void Scanner::TakeRun(uint32 length)
+	{
+		//run must not contain line breaks
+		m_curIdx += length;
+		m_curCol += length;
+		m_tokenEnd = m_curIdx;
+	}
+
 	//--------------------------------------------------------------------------------
 	uint32 Scanner::ScanStringLiteral()
 	{
 		IgnoreIt();	//take opening "
 		while (CurChar() != '\0' && CurChar() != '\"')
-			TakeIt();
+		{
+			TakeRun(RunLengthUntil(m_source + m_curIdx, m_source + m_sourceLen, '\"', '\n', '\r'));
+			if (CurChar() != '\0' && CurChar() != '\"')
+				TakeIt();
+		}
 
 		if (CurChar() == '\0')
 			return TOKEN_ERROR;
@@ -249,8 +400,7 @@ namespace dsc
 	uint32 Scanner::ScanIdentifier()
 	{
 		TakeIt();	//take first letter
-		while (IsLetter(CurChar()) || IsDigit(CurChar()))
-			TakeIt();
+		TakeRun(IdentifierRunLength(m_source + m_curIdx, m_source + m_sourceLen));
 
 		if (CurChar() == '\0')
 			return TOKEN_ERROR;
@@ -267,11 +417,6 @@ namespace dsc
 		if (CurChar() != '.')
 			return TOKEN_INTEGER_LITERAL;
 
-		if (m_curStringIdx == 0)
-		{
-			InsertChar('0');
-		}
-
 		TakeIt();	//take '.'
 
 		if (!IsDigit(CurChar()))
@@ -440,7 +585,9 @@ namespace dsc
 
 		while (CurChar() != '\0' && !(CurChar() == '*' && NextChar() == '/'))
 		{
-			TakeIt();
+			TakeRun(RunLengthUntil(m_source + m_curIdx, m_source + m_sourceLen, '*', '\n', '\r'));
+			if (CurChar() != '\0' && !(CurChar() == '*' && NextChar() == '/'))
+				TakeIt();
 		}
 
 		if (CurChar() == '\0' || NextChar() == '\0')
@@ -458,27 +605,11 @@ namespace dsc
 		IgnoreIt();	//take first /
 		IgnoreIt();	//take second /
 
-		while (CurChar() != '\n' && CurChar() != '\r' && CurChar() != '\0')
-			TakeIt();
+		TakeRun(RunLengthUntil(m_source + m_curIdx, m_source + m_sourceLen, '\n', '\r', '\0'));
 
 		return TOKEN_LINE_COMMENT;
 	}
 
-	//--------------------------------------------------------------------------------
-	void Scanner::ClearCurString()
-	{
-		m_curStringIdx = 0;
-	}
-
-	//--------------------------------------------------------------------------------
-	void Scanner::InsertChar(char c)
-	{
-		assert((m_curStringIdx + 1) < 1024);
-
-		m_curString[m_curStringIdx] = c;
-		++m_curStringIdx;
-	}
-
 	//--------------------------------------------------------------------------------
 	Token Scanner::Scan()
 	{
@@ -487,9 +618,14 @@ namespace dsc
 		if (tokenType != TOKEN_BRACKETED_COMMENT && tokenType != TOKEN_LINE_COMMENT)
 			m_prevTokenType = tokenType;
 
-		m_curString[m_curStringIdx] = '\0';
+		//keywords skip the table, other scripts may be adding to it
+		const char* spelling = 0;
+		if (m_tokenSymbol == SymbolTable::INVALID_SYMBOL)
+			spelling = m_symbols.Intern(m_source + m_tokenStart, m_tokenEnd - m_tokenStart, m_tokenSymbol);
+		else
+			spelling = GetKeywordSpelling(m_tokenSymbol);
 
-		return Token(tokenType, m_curString, m_curLine, m_curCol);
+		return Token(tokenType, m_tokenSymbol, spelling, m_curLine, m_curCol);
 	}
 
 	//--------------------------------------------------------------------------------
@@ -2,6 +2,7 @@
 #define DSC_SCANNER_H_
 
 #include "Token.h"
+#include "SymbolTable.h"
 #include "ClassUtils.h"
 
 namespace dsc
@@ -10,20 +11,19 @@ namespace dsc
 	{
 		DSC_NOCOPY(Scanner)
 	public:
-		Scanner(const char* source);
+		/// Token spellings are interned in symbols, which has to outlive the tokens.
+		Scanner(const char* source, SymbolTable& symbols);
 		Token Scan();
 		bool Done();
 
 	private:
 		void TakeIt();
 		void IgnoreIt();
+		void TakeRun(uint32 length);
 
 		char CurChar() const;
 		char NextChar() const;
 
-		void ClearCurString();
-		void InsertChar(char c);
-
 		//Scan helpers
 		void ScanWhitespace();
 		uint32 ScanToken();
@@ -39,8 +39,11 @@ namespace dsc
 
 	private:
 		const char* m_source;
-		char m_curString[1024];
-		uint32 m_curStringIdx;
+		SymbolTable& m_symbols;
+		/// span of the current token in the source
+		uint32 m_tokenStart;
+		uint32 m_tokenEnd;
+		uint32 m_tokenSymbol;
 		uint32 m_curIdx;
 		uint32 m_curLine;
 		uint32 m_curCol;
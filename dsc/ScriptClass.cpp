@@ -1,6 +1,7 @@
 #include <stdarg.h>
 #include "ScriptClass.h"
 #include "Compiler.h"
+#include "CppBackend.h"
 
 namespace dsc
 {
@@ -23,7 +24,7 @@ namespace dsc
 		if (!m_superName.empty())
 		{
 			uint32 numSuperIdx = 0;
-			const ScriptClassDeclaration* pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superName.c_str());
+			const ScriptClassDeclaration* pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superSymbol);
 			numSuperIdx = pSuper->GetNumFunctions();
 			if (idx < numSuperIdx)
 				return pSuper->GetFunctionDeclarationPtr(idx);
@@ -79,7 +80,7 @@ namespace dsc
 		const ScriptClassDeclaration* pSuper = 0;
 		if (!m_superName.empty())
 		{
-			pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superName.c_str());
+			pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superSymbol);
 			numSuperIdx = pSuper->GetNumFunctions();
 		}
 
@@ -95,12 +96,34 @@ namespace dsc
 		return -1;
 	}
 
+	int32 ScriptClassDeclaration::GetFunctionIndex(uint32 funcSymbol) const
+	{
+		uint32 numSuperIdx = 0;
+		const ScriptClassDeclaration* pSuper = 0;
+		if (!m_superName.empty())
+		{
+			pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superSymbol);
+			numSuperIdx = pSuper->GetNumFunctions();
+		}
+
+		for (uint32 i=0; i<m_funcDecls.size(); ++i)
+		{
+			if (m_funcDecls[i]->GetSymbol() == funcSymbol)
+				return i + numSuperIdx;
+		}
+
+		if (pSuper)
+			return pSuper->GetFunctionIndex(funcSymbol);
+
+		return -1;
+	}
+
 	uint32 ScriptClassDeclaration::GetNumFunctions() const
 	{
 		if (m_superName.empty())
 			return (uint32) m_funcDecls.size();
 
-		const ScriptClassDeclaration* pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superName.c_str());
+		const ScriptClassDeclaration* pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superSymbol);
 		return (uint32) (pSuper->GetNumFunctions() + m_funcDecls.size());
 	}
 
@@ -109,7 +132,7 @@ namespace dsc
 		if (m_superName.empty())
 			return (uint32) m_dataDecls.size();
 
-		const ScriptClassDeclaration* pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superName.c_str());
+		const ScriptClassDeclaration* pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superSymbol);
 		return (uint32) (pSuper->GetNumData() + m_dataDecls.size());
 	}
 
@@ -119,7 +142,7 @@ namespace dsc
 		if (!m_superName.empty())
 		{
 			uint32 numSuperIdx = 0;
-			const ScriptClassDeclaration* pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superName.c_str());
+			const ScriptClassDeclaration* pSuper = CompilerPtr()->GetScriptClassDeclarationPtr(m_superSymbol);
 			numSuperIdx = pSuper->GetNumData();
 			if (idx < numSuperIdx)
 				return pSuper->GetDataDeclarationPtr(idx);
@@ -135,7 +158,7 @@ namespace dsc
 		assert(idx < GetNumNonSuperFunctions());
 		FunctionDeclarationCPtrArray funcDecls = m_funcDecls;
 		m_funcDecls.clear();
-		m_funcDecls.reserve(m_funcDecls.size()-1);
+		m_funcDecls.reserve(funcDecls.size()-1);
 		for (uint32 i=0; i<funcDecls.size(); ++i)
 		{
 			if (i != idx)
@@ -143,10 +166,39 @@ namespace dsc
 		}
 	}
 
+	bool ScriptClassDeclaration::DefinesFunction(uint32 idx) const
+	{
+		assert(idx < GetNumFunctions());
+
+		if (idx >= GetNumFunctions() - GetNumNonSuperFunctions())
+			return true;
+
+		for (uint32 i=0; i<m_overrides.size(); ++i)
+		{
+			if (m_overrides[i] == idx)
+				return true;
+		}
+
+		return false;
+	}
+
+	void ScriptClassDeclaration::SetFunctionOverridden(uint32 idx)
+	{
+		assert(idx < GetNumFunctions());
+		if (m_overridden.size() <= idx)
+			m_overridden.resize(idx + 1, false);
+		m_overridden[idx] = true;
+	}
+
 	void ScriptClass::CreateFile(std::vector<uint8>& file) const
 	{
 	}
 
+	void ScriptClass::CreateCppFile(std::string& source) const
+	{
+		CppBackend::Translate(this, source);
+	}
+
 	uint32 FunctionImplementation::AddNewClassName(const char* name)
 	{
 		for (uint32 i=0; i<m_newClasses.size(); ++i)
@@ -158,4 +210,16 @@ namespace dsc
 		m_newClasses.push_back(name);
 		return (uint32) m_newClasses.size() - 1;
 	}
+
+	uint32 FunctionImplementation::AddDirectCall(const DirectCall& call)
+	{
+		for (uint32 i=0; i<m_directCalls.size(); ++i)
+		{
+			if (m_directCalls[i] == call)
+				return i;
+		}
+
+		m_directCalls.push_back(call);
+		return (uint32) m_directCalls.size() - 1;
+	}
 }
\ No newline at end of file
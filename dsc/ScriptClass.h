@@ -6,6 +6,7 @@
 #include <list>
 #include "CountedPtr.h"
 #include "DSRVMInstruction.h"
+#include "SymbolTable.h"
 
 namespace dsc
 {
@@ -25,10 +26,14 @@ namespace dsc
 	class DataDeclaration : public CountedResource
 	{
 	public:
+		DataDeclaration() : m_symbol(SymbolTable::INVALID_SYMBOL), m_type(0), m_line(0) {}
 		const char* GetNativeType() const { return m_nativeType.c_str(); }
 		uint32 GetType() const { return m_type; }
 		const char* GetName() const { return m_name.c_str(); }
 		void SetName(const char* name) { m_name = name; }
+		/// symbol of the name in the compiler's symbol table, for lookups while compiling
+		uint32 GetSymbol() const { return m_symbol; }
+		void SetSymbol(uint32 symbol) { m_symbol = symbol; }
 		void SetType(uint32 type) { m_type = type; }
 		void SetNativeType(const char* nt) { m_nativeType = nt; }
 		void SetLine(uint32 line) { m_line = line; }
@@ -36,6 +41,7 @@ namespace dsc
 
 	private:
 		std::string m_name;
+		uint32 m_symbol;
 		std::string m_nativeType;
 		uint32 m_type;
 		uint32 m_line;
@@ -45,6 +51,7 @@ namespace dsc
 	class FunctionDeclaration : public CountedResource
 	{
 	public:
+		FunctionDeclaration() : m_retType(0), m_symbol(SymbolTable::INVALID_SYMBOL), m_line(0), m_final(false) {}
 		uint32 GetReturnType() const { return m_retType; }
 		const char* GetNativeReturnType() const { return m_retNativeType.c_str(); }
 		uint32 GetNumParameters() const { return (uint32) m_params.size(); }
@@ -53,10 +60,16 @@ namespace dsc
 		const char* GetName() const { return m_name.c_str(); }
 		void AddParameter(DataDeclaration* pParam) { m_params.push_back(pParam); }
 		void SetName(const char* name) { m_name = name; }
+		/// symbol of the name in the compiler's symbol table, for lookups while compiling
+		uint32 GetSymbol() const { return m_symbol; }
+		void SetSymbol(uint32 symbol) { m_symbol = symbol; }
 		void SetReturnNativeType(const char* nt) { m_retNativeType = nt; }
 		void SetReturnType(uint32 type) { m_retType = type; }
 		void SetLine(uint32 line) { m_line = line; }
 		uint32 GetLine() const { return m_line; }
+		/// final functions can't be overridden
+		void SetFinal(bool final) { m_final = final; }
+		bool IsFinal() const { return m_final; }
 
 	private:
 		typedef std::vector<DataDeclarationCPtr> ParameterDeclarationCPtrArray;
@@ -66,8 +79,10 @@ namespace dsc
 		std::string m_retNativeType;
 		std::string m_scriptClass;
 		std::string m_name;
+		uint32 m_symbol;
 		ParameterDeclarationCPtrArray m_params;
 		uint32 m_line;
+		bool m_final;
 	};
 
 	//---------------------------------------------------------
@@ -76,11 +91,16 @@ namespace dsc
 	public:
 		typedef std::vector<DataDeclaration> DataDeclarationArray;
 
+		ScriptClassDeclaration() : m_symbol(SymbolTable::INVALID_SYMBOL), m_superSymbol(SymbolTable::INVALID_SYMBOL), m_native(false), m_final(false) {}
 		const char* GetName() const { return m_name.c_str(); }
 		const char* GetSuperClassName() const { return m_superName.c_str(); }
+		/// symbols of the names in the compiler's symbol table, for lookups while compiling
+		uint32 GetSymbol() const { return m_symbol; }
+		uint32 GetSuperClassSymbol() const { return m_superSymbol; }
 		const FunctionDeclaration* GetFunctionDeclarationPtr(uint32 idx) const;
 		int32 GetConstructorIndex(const DataDeclarationArray& params) const;
 		int32 GetFunctionIndex(const char* funcName) const;
+		int32 GetFunctionIndex(uint32 funcSymbol) const;
 		uint32 GetNumFunctions() const;
 		uint32 GetNumConstructors() const { return (uint32) m_ctorDecls.size(); }
 		uint32 GetNumData() const;
@@ -89,11 +109,24 @@ namespace dsc
 		uint32 GetNumNonSuperFunctions() const { return (uint32) m_funcDecls.size(); }
 		const FunctionDeclaration* GetNonSuperFunctionDeclarationPtr(uint32 idx) const { return m_funcDecls[idx]; }
 		void RemoveNonSuperFunctionDeclaration(uint32 idx);
+		/// the class defines super class function idx again
+		void AddOverride(uint32 idx) { m_overrides.push_back(idx); }
+		/// true if the class has code for function idx, its own or an override
+		bool DefinesFunction(uint32 idx) const;
+		/// Set by the class hierarchy analysis, when a loaded class derived from this one
+		/// defines function idx again.  Calls of the other functions can be bound at compile time.
+		void SetFunctionOverridden(uint32 idx);
+		bool IsFunctionOverridden(uint32 idx) const { return idx < m_overridden.size() && m_overridden[idx]; }
+		/// final classes can't be extended
+		void SetFinal(bool final) { m_final = final; }
+		bool IsFinal() const { return m_final; }
 
 		void AddComment(const char* comment) { m_comments.push_back(comment); }
 		void SetName(const char* name) { m_name = name; }
 		void SetNative(bool native) { m_native = native; }
 		void SetSuperClassName(const char* super) { m_superName = super; }
+		void SetSymbol(uint32 symbol) { m_symbol = symbol; }
+		void SetSuperClassSymbol(uint32 symbol) { m_superSymbol = symbol; }
 		void AddDataDeclaration(DataDeclaration* pData) { m_dataDecls.push_back(pData); }
 		void AddFunctionDeclaration(FunctionDeclaration* pFunc) { m_funcDecls.push_back(pFunc); pFunc->SetScriptClassName(GetName()); }
 		void AddConstructorDeclaration(FunctionDeclaration* pFunc) { m_ctorDecls.push_back(pFunc); pFunc->SetScriptClassName(GetName()); }
@@ -106,11 +139,33 @@ namespace dsc
 	private:
 		std::string m_name;
 		std::string m_superName;
+		uint32 m_symbol;
+		uint32 m_superSymbol;
 		bool m_native;
+		bool m_final;
 		StringArray m_comments;
 		DataDeclarationCPtrArray m_dataDecls;
 		FunctionDeclarationCPtrArray m_funcDecls;
 		FunctionDeclarationCPtrArray m_ctorDecls;
+		std::vector<uint32> m_overrides;
+		std::vector<bool> m_overridden;
+	};
+
+	//---------------------------------------------------------
+	/// Function a call is bound to at compile time.  The call runs the implementation
+	/// class GetClassName() has for function GetFunctionIndex(), without a vtable lookup.
+	class DirectCall
+	{
+	public:
+		DirectCall(const char* className, uint32 funcIdx) : m_className(className), m_funcIdx(funcIdx) {}
+
+		const char* GetClassName() const { return m_className.c_str(); }
+		uint32 GetFunctionIndex() const { return m_funcIdx; }
+		bool operator==(const DirectCall& other) const { return m_funcIdx == other.m_funcIdx && m_className == other.m_className; }
+
+	private:
+		std::string m_className;
+		uint32 m_funcIdx;
 	};
 
 	//---------------------------------------------------------
@@ -121,20 +176,31 @@ namespace dsc
 
 		uint32 GetNumLocals() const { return (uint32) m_locals.size(); }
 		const DataDeclaration* GetLocalDataDeclarationPtr(uint32 i) const { return m_locals[i]; }
+		const VMCodeBlock& GetVMCodeBlock() const { return m_code; }
 		void SetVMCodeBlock(const VMCodeBlock& code) { m_code = code; }
+		uint32 GetMaxStackSize() const { return m_maxStackSize; }
 		void SetMaxStackSize(uint32 size) { m_maxStackSize = size; }
 		void AddLocalDataDeclaration(DataDeclaration* pData) { m_locals.push_back(pData); }
+		void ClearLocalDataDeclarations() { m_locals.clear(); }
 		uint32 AddNewClassName(const char* name);
+		uint32 GetNumNewClassNames() const { return (uint32) m_newClasses.size(); }
+		const char* GetNewClassName(uint32 idx) const { return m_newClasses[idx].c_str(); }
+		/// targets of VMI_CALLF_SELF_D and VMI_CALLF_PUSHED_D
+		uint32 AddDirectCall(const DirectCall& call);
+		uint32 GetNumDirectCalls() const { return (uint32) m_directCalls.size(); }
+		const DirectCall& GetDirectCall(uint32 idx) const { return m_directCalls[idx]; }
 
 	private:
 		typedef std::vector<DataDeclarationCPtr> DataDeclarationCPtrArray;
 		typedef std::vector<std::string> StringArray;
+		typedef std::vector<DirectCall> DirectCallArray;
 
 	private:
 		DataDeclarationCPtrArray m_locals;
 		VMCodeBlock m_code;
 		uint32 m_maxStackSize;
 		StringArray m_newClasses;
+		DirectCallArray m_directCalls;
 	};
 
 	//---------------------------------------------------------
@@ -146,9 +212,11 @@ namespace dsc
 			m_declaration = (ScriptClassDeclaration*) pDeclaration;
 		}
 
-		void AddFunctionImplementation(FunctionImplementation* pFuncImpl)
+		/// funcIdx is the function's index in the vtable
+		void AddFunctionImplementation(FunctionImplementation* pFuncImpl, uint32 funcIdx)
 		{
 			m_funcImpls.push_back(pFuncImpl);
+			m_funcIdxs.push_back(funcIdx);
 		}
 
 		void AddConstructorImplementation(FunctionImplementation* pFuncImpl)
@@ -157,6 +225,16 @@ namespace dsc
 		}
 
 		void CreateFile(std::vector<uint8>& file) const;
+		/// C++ translation of the functions, for building them into the runtime, see CppBackend
+		void CreateCppFile(std::string& source) const;
+
+		const ScriptClassDeclaration* GetScriptDeclarationPtr() const { return m_declaration; }
+		/// functions the class's source defines, native ones without code
+		uint32 GetNumFunctionImplementations() const { return (uint32) m_funcImpls.size(); }
+		const FunctionImplementation* GetFunctionImplementationPtr(uint32 idx) const { return m_funcImpls[idx]; }
+		uint32 GetFunctionIndex(uint32 idx) const { return m_funcIdxs[idx]; }
+		uint32 GetNumConstructorImplementations() const { return (uint32) m_ctorImpls.size(); }
+		const FunctionImplementation* GetConstructorImplementationPtr(uint32 idx) const { return m_ctorImpls[idx]; }
 
 	private:
 		typedef std::vector<FunctionImplementationCPtr> FunctionImplementationCPtrArray;
@@ -164,6 +242,7 @@ namespace dsc
 	private:
 		ScriptClassDeclarationCPtr m_declaration;
 		FunctionImplementationCPtrArray m_funcImpls;
+		std::vector<uint32> m_funcIdxs;
 		FunctionImplementationCPtrArray m_ctorImpls;
 	};
 }
@@ -69,16 +69,11 @@ namespace dsc
 	{
 	}
 
-	ExpressionSrc::ExpressionMember::ExpressionMember(FunctionCallSrc* fncCall)
+	ExpressionSrc::ExpressionMember::ExpressionMember(const FunctionCallSrc* fncCall)
 	: m_token(TOKEN_ERROR, "", 0, 0), m_fncCall(fncCall)
 	{
 	}
 
-	void ExpressionSrc::Push(const Token& tok)
-	{
-		m_members.push_back(tok);
-	}
-
 	void ExpressionSrc::SetLine(uint32 line)
 	{
 		m_line = line;
@@ -89,26 +84,19 @@ namespace dsc
 		return m_line;
 	}
 
-	void ExpressionSrc::Push(FunctionCallSrc* fnc)
-	{
-		m_members.push_back(fnc);
-	}
-
 	const std::string ExpressionSrc::ToString() const
 	{
 		std::string res = "";
 
-		uint32 i=0;
-		for (ExpressionMemberList::const_iterator itt = m_members.begin(); itt != m_members.end(); ++itt)
+		for (uint32 i=0; i<m_members.GetSize(); ++i)
 		{
-			const ExpressionMember& em = *itt;
+			const ExpressionMember& em = m_members[i];
 			if (em.GetFunctionCallSrcPtr())
 				res += dsc::ToString(*em.GetFunctionCallSrcPtr());
 			else
 				res += em.GetToken().GetSpelling();
 
-			++i;
-			if (i < m_members.size())
+			if (i + 1 < m_members.GetSize())
 				res += " ";
 		}
 
@@ -121,14 +109,10 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	void FunctionCallSrc::SetName(const char* name)
+	void FunctionCallSrc::SetName(const char* name, uint32 symbol)
 	{
 		m_name = name;
-	}
-
-	void FunctionCallSrc::PushParameter(ExpressionSrc* expr)
-	{
-		m_parameters.push_back(expr);
+		m_nameSymbol = symbol;
 	}
 
 	void FunctionCallSrc::SetLine(uint32 line)
@@ -143,12 +127,10 @@ namespace dsc
 		res += m_name;
 		res += "(";
 
-		uint32 i=0;
-		for (ExpressionSrcCPtrList::const_iterator itt = m_parameters.begin(); itt != m_parameters.end(); ++itt)
+		for (uint32 i=0; i<m_parameters.GetSize(); ++i)
 		{
-			res += dsc::ToString(**itt);
-			++i;
-			if (i < m_parameters.size())
+			res += dsc::ToString(*m_parameters[i]);
+			if (i + 1 < m_parameters.GetSize())
 				res += ", ";
 		}
 		res += ")";
@@ -170,7 +152,7 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	StWhile::StWhile(ExpressionSrc* condition, StatementSrc* statement)
+	StWhile::StWhile(const ExpressionSrc* condition, const StatementSrc* statement)
 	: StatementSrc(ST_WHILE), m_condition(condition), m_statement(statement)
 	{
 	}
@@ -193,7 +175,7 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	StIf::StIf(ExpressionSrc* condition, StatementSrc* trueStatement, StatementSrc* falseStatement)
+	StIf::StIf(const ExpressionSrc* condition, const StatementSrc* trueStatement, const StatementSrc* falseStatement)
 	: StatementSrc(ST_IF), m_condition(condition), m_trueStatement(trueStatement),
 	  m_falseStatement(falseStatement)
 	{
@@ -223,7 +205,7 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	StReturn::StReturn(ExpressionSrc* retVal)
+	StReturn::StReturn(const ExpressionSrc* retVal)
 	: StatementSrc(ST_RETURN), m_returnValue(retVal)
 	{
 	}
@@ -252,7 +234,7 @@ namespace dsc
 		return res;
 	}
 	//--------------------------------------------------------------------------------
-	StFunctionCall::StFunctionCall(FunctionCallSrc* fncCall)
+	StFunctionCall::StFunctionCall(const FunctionCallSrc* fncCall)
 	: StatementSrc(ST_FUNCTIONCALL), m_fncCall(fncCall)
 	{
 	}
@@ -273,8 +255,8 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	StAssign::StAssign(std::string& vname, ExpressionSrc* expression)
-	: StatementSrc(ST_ASSIGN), m_vname(vname), m_expression(expression)
+	StAssign::StAssign(const char* vname, uint32 symbol, const ExpressionSrc* expression)
+	: StatementSrc(ST_ASSIGN), m_vname(vname), m_symbol(symbol), m_expression(expression)
 	{
 	}
 
@@ -301,9 +283,10 @@ namespace dsc
 		m_type = type;
 	}
 
-	void DataSrc::SetName(const char* name)
+	void DataSrc::SetName(const char* name, uint32 symbol)
 	{
 		m_vname = name;
+		m_symbol = symbol;
 	}
 
 	void DataSrc::SetLine(uint32 line)
@@ -329,19 +312,19 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	FunctionParameterSrc::FunctionParameterSrc(const char* type, const char* name, uint32 line)
-	: m_type(type), m_name(name), m_line(line)
+	FunctionParameterSrc::FunctionParameterSrc(const char* type, const char* name, uint32 symbol, uint32 line)
+	: m_type(type), m_name(name), m_symbol(symbol), m_line(line)
 	{
 	}
 
 	const char* FunctionParameterSrc::GetName() const
 	{
-		return m_name.c_str();
+		return m_name;
 	}
 
 	const char* FunctionParameterSrc::GetType() const
 	{
-		return m_type.c_str();
+		return m_type;
 	}
 
 	const std::string FunctionParameterSrc::ToString() const
@@ -366,9 +349,10 @@ namespace dsc
 		m_returnType = type;
 	}
 
-	void FunctionSrc::SetName(const char* name)
+	void FunctionSrc::SetName(const char* name, uint32 symbol)
 	{
 		m_name = name;
+		m_symbol = symbol;
 	}
 
 	void FunctionSrc::SetLine(uint32 line)
@@ -376,30 +360,23 @@ namespace dsc
 		m_line = line;
 	}
 
-	void FunctionSrc::PushParameter(const char* type, const char* name, uint32 line)
-	{
-		m_parameters.push_back(FunctionParameterSrc(type, name, line));
-	}
-
 	void FunctionSrc::SetNative(bool native)
 	{
 		m_native = native;
 	}
 
-	void FunctionSrc::SetStatement(StatementSrc* statement)
+	void FunctionSrc::SetStatement(const StatementSrc* statement)
 	{
 		m_statement = statement;
 	}
 
-	void FunctionSrc::AddLocalDataMember(DataSrc* data)
-	{
-		m_locals.push_back(data);
-	}
-
 	const std::string FunctionSrc::ToString() const
 	{
 		std::string res = "";
 
+		if (m_final)
+			res += "final ";
+
 		//return type
 		res += m_returnType;
 
@@ -410,12 +387,10 @@ namespace dsc
 
 		//parameters
 		res += "(";
-		uint32 i = 0;
-		for (FunctionParameterList::const_iterator ittP = m_parameters.begin(); ittP != m_parameters.end(); ++ittP)
+		for (uint32 i=0; i<m_parameters.GetSize(); ++i)
 		{
-			res += dsc::ToString(*ittP);
-			++i;
-			if (i < m_parameters.size())
+			res += dsc::ToString(m_parameters[i]);
+			if (i + 1 < m_parameters.GetSize())
 				res += ", ";
 		}
 		res += ")";
@@ -429,9 +404,9 @@ namespace dsc
 			res += "\r\n{\r\n";
 
 			//locals
-			for (DataSrcList::const_iterator ittD = m_locals.begin(); ittD != m_locals.end(); ++ittD)
+			for (uint32 i=0; i<m_locals.GetSize(); ++i)
 			{
-				res += dsc::ToString(**ittD);
+				res += dsc::ToString(*m_locals[i]);
 				res += "\r\n";
 			}
 
@@ -460,10 +435,6 @@ namespace dsc
 		m_line = 0;
 	}
 
-	StatementSrc::~StatementSrc()
-	{
-	}
-
 	void StatementSrc::SetLine(uint32 line)
 	{
 		m_line = line;
@@ -487,12 +458,6 @@ namespace dsc
 	{
 	}
 
-	void StBlock::AddStatement(StatementSrc* cpStatement)
-	{
-		assert(cpStatement);
-		m_statements.push_back(cpStatement);
-	}
-
 	void StBlock::Visit(StatementSrcVisitor& visitor) const
 	{
 		return visitor.VisitBlock(*this);
@@ -503,9 +468,9 @@ namespace dsc
 		std::string res = "";
 
 		res += "{\r\n";
-		for (StatementList::const_iterator itt = m_statements.begin(); itt != m_statements.end(); ++itt)
+		for (uint32 i=0; i<m_statements.GetSize(); ++i)
 		{
-			res += dsc::ToString(**itt);
+			res += dsc::ToString(*m_statements[i]);
 			res += "\r\n";
 		}
 		res += "}";
@@ -514,29 +479,46 @@ namespace dsc
 	}
 
 	//--------------------------------------------------------------------------------
-	ScriptSource::ScriptSource()
+	ScriptSource::ScriptSource(SymbolTable& symbols)
+	: m_pSymbols(&symbols)
 	{
+		m_name = "";
+		m_nameSymbol = SymbolTable::INVALID_SYMBOL;
+		m_super = "";
+		m_superSymbol = SymbolTable::INVALID_SYMBOL;
 		m_native = false;
+		m_final = false;
+	}
+
+	const char* ScriptSource::Intern(const char* str)
+	{
+		uint32 symbol = SymbolTable::INVALID_SYMBOL;
+		return Intern(str, symbol);
+	}
+
+	const char* ScriptSource::Intern(const char* str, uint32& symbol)
+	{
+		return m_pSymbols->Intern(str, (uint32) strlen(str), symbol);
 	}
 
 	void ScriptSource::SetName(const char* name)
 	{
-		m_name = name;
+		m_name = Intern(name, m_nameSymbol);
 	}
 
 	const char* ScriptSource::GetName() const
 	{
-		return m_name.c_str();
+		return m_name;
 	}
 
 	void ScriptSource::SetSuper(const char* super)
 	{
-		m_super = super;
+		m_super = Intern(super, m_superSymbol);
 	}
 
 	const char* ScriptSource::GetSuper() const
 	{
-		return m_super.c_str();
+		return m_super;
 	}
 
 	void ScriptSource::SetNative(bool native)
@@ -549,24 +531,26 @@ namespace dsc
 		return m_native;
 	}
 
-	void ScriptSource::AddDataMember(DataSrc* data)
+	void ScriptSource::AddDataMember(const DataSrc* data)
 	{
 		m_data.push_back(data);
 	}
 
-	void ScriptSource::AddFunction(FunctionSrc* fnc)
+	void ScriptSource::AddFunction(const FunctionSrc* fnc)
 	{
 		m_functions.push_back(fnc);
 	}
 
-	void ScriptSource::AddConstructor(FunctionSrc* fnc)
+	void ScriptSource::AddConstructor(const FunctionSrc* fnc)
 	{
 		m_constructors.push_back(fnc);
 	}
 
 	void ScriptSource::AddImportClass(const char* import)
 	{
-		if (std::find(m_importClasses.begin(), m_importClasses.end(), std::string(import)) == m_importClasses.end())
+		//interned, so equal names are the same pointer
+		import = Intern(import);
+		if (std::find(m_importClasses.begin(), m_importClasses.end(), import) == m_importClasses.end())
 		{
 			m_importClasses.push_back(import);
 		}
@@ -577,10 +561,10 @@ namespace dsc
 		std::string res = "";
 
 		//include files
-		for (StringList::const_iterator ittI = m_importClasses.begin(); ittI != m_importClasses.end(); ++ittI)
+		for (uint32 i=0; i<m_importClasses.size(); ++i)
 		{
 			res += "import ";
-			res += *ittI;
+			res += m_importClasses[i];
 			res += "\r\n";
 		}
 
@@ -589,7 +573,7 @@ namespace dsc
 		res += m_name;
 
 		//super
-		if (m_super.size() > 0)
+		if (m_super[0] != '\0')
 		{
 			res += " : ";
 			res += m_super;
@@ -599,17 +583,17 @@ namespace dsc
 		res += "{\r\n";
 
 		//data
-		for (DataSrcList::const_iterator ittD = m_data.begin(); ittD != m_data.end(); ++ittD)
+		for (uint32 i=0; i<m_data.size(); ++i)
 		{
-			res += dsc::ToString(**ittD);
+			res += dsc::ToString(*m_data[i]);
 			res += "\r\n";
 		}
 		res += "\r\n";
 
 		//functions
-		for (FunctionSrcList::const_iterator ittF = m_functions.begin(); ittF != m_functions.end(); ++ittF)
+		for (uint32 i=0; i<m_functions.size(); ++i)
 		{
-			res += dsc::ToString(**ittF);
+			res += dsc::ToString(*m_functions[i]);
 			res += "\r\n";
 		}
 		res += "\r\n";
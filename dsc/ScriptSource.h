@@ -1,9 +1,10 @@
 #if !defined(DSC_SCRIPTSOURCE_H_)
 #define DSC_SCRIPTSOURCE_H_
 
-#include <list>
 #include <vector>
 #include "Token.h"
+#include "SymbolTable.h"
+#include "AstArena.h"
 #include "CountedPtr.h"
 #include "ClassUtils.h"
 
@@ -22,26 +23,14 @@ namespace dsc
 	class StAssign;
 	class StBlock;
 
-	typedef CountedPtr<ExpressionSrc> ExpressionSrcCPtr;
-	typedef CountedPtr<FunctionCallSrc> FunctionCallSrcCPtr;
-	typedef CountedPtr<StatementSrc> StatementSrcCPtr;
-	typedef CountedPtr<DataSrc> DataSrcCPtr;
-	typedef CountedPtr<FunctionSrc> FunctionSrcCPtr;
 	typedef CountedPtr<ScriptSource> ScriptSourceCPtr;
-	typedef CountedPtr<StBlock> StBlockCPtr;
 
-	template <class T>
-	const T& GetListElement(const std::list<T>& listA, uint32 idx)
-	{
-		assert(idx < listA.size());
-		std::list<T>::const_iterator it = listA.begin();
-		for (uint32 i=0; i<idx; ++i)
-			++it;
-		return *it;
-	}
+	// The syntax tree below a ScriptSource lives in the script's AstArena and is freed
+	// with it.  Nodes hold plain pointers to each other, and their strings are token
+	// spellings or ScriptSource::Intern() results, so they own nothing themselves.
 
 	//-------------------------------------------------------------------------------------
-	class ExpressionSrc : public CountedResource
+	class ExpressionSrc : public AstNode
 	{
 		DSC_NOCOPY(ExpressionSrc)
 	public:
@@ -50,73 +39,76 @@ namespace dsc
 		public:
 			ExpressionMember();
 			ExpressionMember(const Token& token);
-			ExpressionMember(FunctionCallSrc* fncCall);
+			ExpressionMember(const FunctionCallSrc* fncCall);
 
 			const FunctionCallSrc* GetFunctionCallSrcPtr() const { return m_fncCall; }
-			Token GetToken() const { return m_token; }
+			const Token& GetToken() const { return m_token; }
 
 		private:
 			Token m_token;
-			FunctionCallSrcCPtr m_fncCall;
+			const FunctionCallSrc* m_fncCall;
 		};
-		typedef std::list<ExpressionMember> ExpressionMemberList;
+		typedef AstArray<ExpressionMember> ExpressionMemberArray;
 		friend const std::string ToString(const ExpressionSrc& s);
 
 		ExpressionSrc() { m_line = 0; }
-		void Push(const Token& tok);
-		void Push(FunctionCallSrc* fnc);
+		void SetMembers(const ExpressionMemberArray& members) { m_members = members; }
 		void SetLine(uint32 line);
 		uint32 GetLine() const;
-		uint32 GetNumExpressionMembers() const { return (uint32) m_members.size(); }
-		const ExpressionMember* GetExpressionMemberPtr(uint32 idx) const { return &GetListElement(m_members, idx); }
+		uint32 GetNumExpressionMembers() const { return m_members.GetSize(); }
+		const ExpressionMember* GetExpressionMemberPtr(uint32 idx) const { return &m_members[idx]; }
 
 	private:
-		virtual const std::string ToString() const;
+		const std::string ToString() const;
 
 	private:
-		ExpressionMemberList m_members;
+		ExpressionMemberArray m_members;
 		uint32 m_line;
 	};
 
 	//-------------------------------------------------------------------------------------
-	class FunctionCallSrc : public CountedResource
+	class FunctionCallSrc : public AstNode
 	{
 		DSC_NOCOPY(FunctionCallSrc)
 	public:
-		typedef std::list<ExpressionSrcCPtr> ExpressionSrcCPtrList;
+		typedef AstArray<const ExpressionSrc*> ExpressionSrcPtrArray;
 		friend const std::string ToString(const FunctionCallSrc& s);
 
-		FunctionCallSrc() { m_super = false; m_new = false; m_line = 0; }
-		void SetName(const char* name);
-		void PushParameter(ExpressionSrc* expr);
+		FunctionCallSrc() { m_name = ""; m_nameSymbol = SymbolTable::INVALID_SYMBOL; m_instanceName = ""; m_instanceSymbol = SymbolTable::INVALID_SYMBOL; m_super = false; m_new = false; m_line = 0; m_nextFncCall = 0; }
+		void SetName(const char* name, uint32 symbol);
+		void SetParameters(const ExpressionSrcPtrArray& parameters) { m_parameters = parameters; }
 		void SetLine(uint32 line);
 		void SetSuper() { m_super = true; }
-		void SetInstance(const char* instanceName) { m_instanceName = instanceName; }
+		void SetInstance(const char* instanceName, uint32 symbol) { m_instanceName = instanceName; m_instanceSymbol = symbol; }
 		void SetNew() { m_new = true; }
 		void AddFncCall(FunctionCallSrc* fnc);
 
-		const char* GetName() const { return m_name.c_str(); }
+		const char* GetName() const { return m_name; }
+		uint32 GetNameSymbol() const { return m_nameSymbol; }
 		uint32 GetLine() const { return m_line; }
 		bool IsSuper() const { return m_super; }
 		bool IsNew() const { return m_new; }
-		bool IsBaseConstructor() const { return strcmp(m_name.c_str(), "super") == 0; }
-		uint32 GetNumParameters() const { return (uint32) m_parameters.size(); }
-		const ExpressionSrc* GetParameterExpressionSrcPtr(uint32 idx) const { return GetListElement(m_parameters, idx); }
-		const char* GetVarName() const { return m_instanceName.c_str(); }
-		bool IsVarCall() const { return !m_instanceName.empty(); }
+		bool IsBaseConstructor() const { return strcmp(m_name, "super") == 0; }
+		uint32 GetNumParameters() const { return m_parameters.GetSize(); }
+		const ExpressionSrc* GetParameterExpressionSrcPtr(uint32 idx) const { return m_parameters[idx]; }
+		const char* GetVarName() const { return m_instanceName; }
+		uint32 GetVarNameSymbol() const { return m_instanceSymbol; }
+		bool IsVarCall() const { return m_instanceName[0] != '\0'; }
 		const FunctionCallSrc* GetNextFncCallSrcPtr() const { return m_nextFncCall; }
 
 	private:
-		virtual const std::string ToString() const;
+		const std::string ToString() const;
 
 	private:
-		std::string m_name;
-		ExpressionSrcCPtrList m_parameters;
+		const char* m_name;
+		uint32 m_nameSymbol;
+		ExpressionSrcPtrArray m_parameters;
 		uint32 m_line;
 		bool m_super;
 		bool m_new;
-		std::string m_instanceName;
-		FunctionCallSrcCPtr m_nextFncCall;
+		const char* m_instanceName;
+		uint32 m_instanceSymbol;
+		FunctionCallSrc* m_nextFncCall;
 	};
 
 	//-------------------------------------------------------------------------------------
@@ -132,7 +124,7 @@ namespace dsc
 	};
 
 	//-------------------------------------------------------------------------------------
-	class StatementSrc : public CountedResource
+	class StatementSrc : public AstNode
 	{
 		DSC_NOCOPY(StatementSrc)
 	public:
@@ -151,7 +143,6 @@ namespace dsc
 		};
 
 		StatementSrc(StatementType type);
-		virtual ~StatementSrc();
 		virtual void Visit(StatementSrcVisitor& visitor) const = 0;
 		void SetLine(uint32 line);
 		uint32 GetLine() const { return m_line; }
@@ -173,19 +164,19 @@ namespace dsc
 	{
 		DSC_NOCOPY(StBlock)
 	public:
-		typedef std::list<StatementSrcCPtr> StatementList;
+		typedef AstArray<const StatementSrc*> StatementSrcPtrArray;
 
 		StBlock();
-		void AddStatement(StatementSrc* cpStatement);
+		void SetStatements(const StatementSrcPtrArray& statements) { m_statements = statements; }
 		virtual void Visit(StatementSrcVisitor& visitor) const;
-		uint32 GetNumStatements() const { return (uint32) m_statements.size(); }
-		const StatementSrc* GetStatementSrcPtr(uint32 idx) const { return GetListElement(m_statements, idx); }
+		uint32 GetNumStatements() const { return m_statements.GetSize(); }
+		const StatementSrc* GetStatementSrcPtr(uint32 idx) const { return m_statements[idx]; }
 
 	private:
 		virtual const std::string ToString() const;
 
 	private:
-		StatementList m_statements;
+		StatementSrcPtrArray m_statements;
 	};
 
 	//--------------------------------------------------------------------------------
@@ -193,7 +184,7 @@ namespace dsc
 	{
 		DSC_NOCOPY(StWhile)
 	public:
-		StWhile(ExpressionSrc* condition, StatementSrc* statement);
+		StWhile(const ExpressionSrc* condition, const StatementSrc* statement);
 		virtual void Visit(StatementSrcVisitor& visitor) const;
 		const ExpressionSrc* GetConditionExpressionSrcPtr() const { return m_condition; }
 		const StatementSrc* GetStatementSrcPtr() const { return m_statement; }
@@ -202,8 +193,8 @@ namespace dsc
 		virtual const std::string ToString() const;
 
 	private:
-		ExpressionSrcCPtr m_condition;
-		StatementSrcCPtr m_statement;
+		const ExpressionSrc* m_condition;
+		const StatementSrc* m_statement;
 	};
 	
 	//--------------------------------------------------------------------------------
@@ -211,7 +202,7 @@ namespace dsc
 	{
 		DSC_NOCOPY(StIf)
 	public:
-		StIf(ExpressionSrc* condition, StatementSrc* trueStatement, StatementSrc* falseStatement);
+		StIf(const ExpressionSrc* condition, const StatementSrc* trueStatement, const StatementSrc* falseStatement);
 		virtual void Visit(StatementSrcVisitor& visitor) const;
 		const ExpressionSrc* GetConditionExpressionSrcPtr() const { return m_condition; }
 		const StatementSrc* GetTrueStatementSrcPtr() const { return m_trueStatement; }
@@ -221,9 +212,9 @@ namespace dsc
 		virtual const std::string ToString() const;
 
 	private:
-		ExpressionSrcCPtr m_condition;
-		StatementSrcCPtr m_trueStatement;
-		StatementSrcCPtr m_falseStatement;
+		const ExpressionSrc* m_condition;
+		const StatementSrc* m_trueStatement;
+		const StatementSrc* m_falseStatement;
 	};
 
 	//--------------------------------------------------------------------------------
@@ -231,7 +222,7 @@ namespace dsc
 	{
 		DSC_NOCOPY(StReturn)
 	public:
-		StReturn(ExpressionSrc* retVal);
+		StReturn(const ExpressionSrc* retVal);
 		virtual void Visit(StatementSrcVisitor& visitor) const;
 		const ExpressionSrc* GetReturnValueExpressionSrcPtr() const { return m_returnValue; }
 
@@ -239,7 +230,7 @@ namespace dsc
 		virtual const std::string ToString() const;
 
 	private:
-		ExpressionSrcCPtr m_returnValue;
+		const ExpressionSrc* m_returnValue;
 	};
 
 	//--------------------------------------------------------------------------------
@@ -247,7 +238,7 @@ namespace dsc
 	{
 		DSC_NOCOPY(StFunctionCall)
 	public:
-		StFunctionCall(FunctionCallSrc* fncCall);
+		StFunctionCall(const FunctionCallSrc* fncCall);
 		virtual void Visit(StatementSrcVisitor& visitor) const;
 		const FunctionCallSrc* GetFunctionCallSrcPtr() const { return m_fncCall; }
 
@@ -255,7 +246,7 @@ namespace dsc
 		virtual const std::string ToString() const;
 
 	private:
-		FunctionCallSrcCPtr m_fncCall;
+		const FunctionCallSrc* m_fncCall;
 	};
 
 	//--------------------------------------------------------------------------------
@@ -263,48 +254,54 @@ namespace dsc
 	{
 		DSC_NOCOPY(StAssign)
 	public:
-		StAssign(std::string& vname, ExpressionSrc* expression);
+		StAssign(const char* vname, uint32 symbol, const ExpressionSrc* expression);
 		virtual void Visit(StatementSrcVisitor& visitor) const;
-		const char* GetVariableName() const { return m_vname.c_str(); }
+		const char* GetVariableName() const { return m_vname; }
+		uint32 GetVariableSymbol() const { return m_symbol; }
 		const ExpressionSrc* GetExpressionSrcPtr() const { return m_expression; }
 
 	private:
 		virtual const std::string ToString() const;
 
 	private:
-		std::string m_vname;
-		ExpressionSrcCPtr m_expression;
+		const char* m_vname;
+		uint32 m_symbol;
+		const ExpressionSrc* m_expression;
 	};
 
 	//-------------------------------------------------------------------------------------
-	class DataSrc : public CountedResource
+	typedef AstArray<const char*> CommentArray;
+
+	//-------------------------------------------------------------------------------------
+	class DataSrc : public AstNode
 	{
 		DSC_NOCOPY(DataSrc)
 	public:
-		typedef std::list<Token> TokenList;
 		friend const std::string ToString(const DataSrc& s);
 
-		DataSrc() { m_line = 0; }
+		DataSrc() { m_type = ""; m_vname = ""; m_symbol = SymbolTable::INVALID_SYMBOL; m_line = 0; m_expr = 0; }
 		void SetType(const char* type);
-		void SetName(const char* name);
+		void SetName(const char* name, uint32 symbol);
 		void SetLine(uint32 line);
-		void SetExpression(ExpressionSrc* pExpr) { m_expr = pExpr; }
+		void SetExpression(const ExpressionSrc* pExpr) { m_expr = pExpr; }
 
-		const char* GetName() const { return m_vname.c_str(); }
+		const char* GetName() const { return m_vname; }
+		uint32 GetSymbol() const { return m_symbol; }
 		uint32 GetLine() const { return m_line; }
-		void AddComment(const char* comment) { m_comment.push_back(comment); }
-		const char* GetType() const { return m_type.c_str(); }
+		void SetComments(const CommentArray& comments) { m_comments = comments; }
+		const char* GetType() const { return m_type; }
 		const ExpressionSrc* GetExpressionSrcPtr() const { return m_expr; }
 
 	private:
 		const std::string ToString() const;
 
 	private:
-		std::string m_type;
-		std::string m_vname;
+		const char* m_type;
+		const char* m_vname;
+		uint32 m_symbol;
 		uint32 m_line;
-		std::vector<std::string> m_comment;
-		ExpressionSrcCPtr m_expr;
+		CommentArray m_comments;
+		const ExpressionSrc* m_expr;
 	};
 
 	//-------------------------------------------------------------------------------------
@@ -313,8 +310,9 @@ namespace dsc
 	public:
 		friend const std::string ToString(const FunctionParameterSrc& s);
 
-		FunctionParameterSrc(const char* type, const char* name, uint32 line); 
+		FunctionParameterSrc(const char* type, const char* name, uint32 symbol, uint32 line);
 		const char* GetName() const;
+		uint32 GetSymbol() const { return m_symbol; }
 		const char* GetType() const;
 		uint32 GetLine() const { return m_line; }
 
@@ -322,57 +320,63 @@ namespace dsc
 		const std::string ToString() const;
 
 	private:
-		std::string m_type;
-		std::string m_name;
+		const char* m_type;
+		const char* m_name;
+		uint32 m_symbol;
 		uint32 m_line;
 	};
-	typedef std::list<FunctionParameterSrc> FunctionParameterList;
 
 	//-------------------------------------------------------------------------------------
-	class FunctionSrc : public CountedResource
+	class FunctionSrc : public AstNode
 	{
 		DSC_NOCOPY(FunctionSrc)
 	public:
-		typedef std::list<DataSrcCPtr> DataSrcList;
+		typedef AstArray<FunctionParameterSrc> FunctionParameterArray;
+		typedef AstArray<const DataSrc*> DataSrcPtrArray;
 		friend const std::string ToString(const FunctionSrc& s);
 
-		FunctionSrc() { m_native = false; m_constructor = false; m_line = 0; }
+		FunctionSrc() { m_returnType = ""; m_name = ""; m_symbol = SymbolTable::INVALID_SYMBOL; m_native = false; m_statement = 0; m_constructor = false; m_line = 0; m_baseConstructorCall = 0; m_final = false; }
 		void SetReturnType(const char* type);
-		void SetName(const char* name);
-		void PushParameter(const char* type, const char* name, uint32 line);
+		void SetName(const char* name, uint32 symbol);
+		void SetParameters(const FunctionParameterArray& parameters) { m_parameters = parameters; }
 		void SetNative(bool native);
-		void SetStatement(StatementSrc* statement);
-		void AddLocalDataMember(DataSrc* data);
+		void SetStatement(const StatementSrc* statement);
+		void SetLocals(const DataSrcPtrArray& locals) { m_locals = locals; }
 		void SetLine(uint32 line);
 		void SetConstructor() { m_constructor = true; }
-		void SetBaseConstructor(FunctionCallSrc* statement) { m_baseConstructorCall = statement; }
+		void SetBaseConstructor(const FunctionCallSrc* statement) { m_baseConstructorCall = statement; }
 		const FunctionCallSrc* GetBaseConstructor() const { return m_baseConstructorCall; }
-		const char* GetName() const { return m_name.c_str(); }
+		const char* GetName() const { return m_name; }
+		uint32 GetSymbol() const { return m_symbol; }
 		uint32 GetLine() const { return m_line; }
-		void AddComment(const char* comment) { m_comment.push_back(comment); }
-		const FunctionParameterSrc* GetFunctionParameterSrcPtr(uint32 i) const { return &GetListElement(m_parameters, i); }
-		uint32 GetNumParameters() const { return (uint32) m_parameters.size(); }
-		const char* GetReturnType() const { return m_returnType.c_str(); }
+		void SetComments(const CommentArray& comments) { m_comments = comments; }
+		const FunctionParameterSrc* GetFunctionParameterSrcPtr(uint32 i) const { return &m_parameters[i]; }
+		uint32 GetNumParameters() const { return m_parameters.GetSize(); }
+		const char* GetReturnType() const { return m_returnType; }
 		bool IsNative() const { return m_native; }
 		const StatementSrc* GetStatementSrcPtr() const { return m_statement; }
-		uint32 GetNumLocals() const { return (uint32) m_locals.size(); }
-		const DataSrc* GetLocalDataSrcPtr(uint32 i) const { return GetListElement(m_locals, i); }
+		uint32 GetNumLocals() const { return m_locals.GetSize(); }
+		const DataSrc* GetLocalDataSrcPtr(uint32 i) const { return m_locals[i]; }
 		bool IsConstructor() const { return m_constructor; }
+		void SetFinal() { m_final = true; }
+		bool IsFinal() const { return m_final; }
 
 	private:
 		const std::string ToString() const;
 
 	private:
-		std::string m_returnType;
-		std::string m_name;
-		FunctionParameterList m_parameters;
+		const char* m_returnType;
+		const char* m_name;
+		uint32 m_symbol;
+		FunctionParameterArray m_parameters;
 		bool m_native;
-		StatementSrcCPtr m_statement;
-		DataSrcList m_locals;
+		const StatementSrc* m_statement;
+		DataSrcPtrArray m_locals;
 		uint32 m_line;
-		std::vector<std::string> m_comment;
+		CommentArray m_comments;
 		bool m_constructor;
-		FunctionCallSrcCPtr m_baseConstructorCall;
+		const FunctionCallSrc* m_baseConstructorCall;
+		bool m_final;
 	};
 
 	//-------------------------------------------------------------------------------------
@@ -380,46 +384,64 @@ namespace dsc
 	{
 		DSC_NOCOPY(ScriptSource)
 	public:
-		typedef std::list<DataSrcCPtr> DataSrcList;
-		typedef std::list<FunctionSrcCPtr> FunctionSrcList;
-		typedef std::list<std::string> StringList;
+		typedef std::vector<const DataSrc*> DataSrcPtrArray;
+		typedef std::vector<const FunctionSrc*> FunctionSrcPtrArray;
+		typedef std::vector<const char*> StringArray;
 		friend const std::string ToString(const ScriptSource& s);
 
-		ScriptSource();
+		/// names are interned in symbols, which is shared with the other scripts of a compile
+		explicit ScriptSource(SymbolTable& symbols);
 		void SetName(const char* name);
 		const char* GetName() const;
+		uint32 GetNameSymbol() const { return m_nameSymbol; }
 		void SetSuper(const char* super);
 		const char* GetSuper() const;
+		uint32 GetSuperSymbol() const { return m_superSymbol; }
 		void SetNative(bool native);
 		bool IsNative() const;
-		void AddDataMember(DataSrc* data);
-		void AddFunction(FunctionSrc* fnc);
-		void AddConstructor(FunctionSrc* fnc);
+		void SetFinal() { m_final = true; }
+		bool IsFinal() const { return m_final; }
+		void AddDataMember(const DataSrc* data);
+		void AddFunction(const FunctionSrc* fnc);
+		void AddConstructor(const FunctionSrc* fnc);
 		void AddImportClass(const char* script);
-		void AddComment(const char* comment) { m_comment.push_back(comment); }
+		void AddComment(const char* comment) { m_comment.push_back(Intern(comment)); }
 		uint32 GetNumComments() const { return (uint32) m_comment.size(); }
-		const char* GetComment(uint32 i) const { return m_comment[i].c_str(); }
+		const char* GetComment(uint32 i) const { return m_comment[i]; }
 		uint32 GetNumData() const { return (uint32) m_data.size(); }
-		const DataSrc* GetDataSrcPtr(uint32 i) const { return GetListElement(m_data, i); }
+		const DataSrc* GetDataSrcPtr(uint32 i) const { return m_data[i]; }
 		uint32 GetNumFunctions() const { return (uint32) m_functions.size(); }
-		const FunctionSrc* GetFunctionSrcPtr(uint32 i) const { return GetListElement(m_functions, i); }
+		const FunctionSrc* GetFunctionSrcPtr(uint32 i) const { return m_functions[i]; }
 		uint32 GetNumImportClasses() const { return (uint32) m_importClasses.size(); }
-		const char* GetImportClass(uint32 i) const { return GetListElement(m_importClasses, i).c_str(); }
+		const char* GetImportClass(uint32 i) const { return m_importClasses[i]; }
 		uint32 GetNumConstructors() const { return (uint32) m_constructors.size(); }
-		const FunctionSrc* GetConstructorFunctionSrcPtr(uint32 i) const { return GetListElement(m_constructors, i); }
+		const FunctionSrc* GetConstructorFunctionSrcPtr(uint32 i) const { return m_constructors[i]; }
+		/// identifiers, keywords and literals; token spellings point in here
+		SymbolTable& GetSymbolTable() { return *m_pSymbols; }
+		const SymbolTable& GetSymbolTable() const { return *m_pSymbols; }
+		/// returns a copy of str that lives as long as the symbol table
+		const char* Intern(const char* str);
+		const char* Intern(const char* str, uint32& symbol);
+		/// syntax tree nodes of this script are allocated here
+		AstArena& GetArena() { return m_arena; }
 
 	private:
 		const std::string ToString() const;
 
 	private:
-		std::vector<std::string> m_comment;
-		std::string m_name;
-		std::string	m_super;
-		DataSrcList m_data;
-		FunctionSrcList m_functions;
-		FunctionSrcList m_constructors;
-		StringList m_importClasses;
+		SymbolTable* m_pSymbols;
+		AstArena m_arena;
+		StringArray m_comment;
+		const char* m_name;
+		uint32 m_nameSymbol;
+		const char* m_super;
+		uint32 m_superSymbol;
+		DataSrcPtrArray m_data;
+		FunctionSrcPtrArray m_functions;
+		FunctionSrcPtrArray m_constructors;
+		StringArray m_importClasses;
 		bool m_native;
+		bool m_final;
 	};
 
 	//-------------------------------------------------------------------------------------
@@ -1,8 +1,25 @@
+#include <stdarg.h>
+#include <stdio.h>
 #include "StringUtils.h"
 #include "BaseTypes.h"
 
 namespace dsc
 {
+	//--------------------------------------------------------------------
+	//scripts are parsed and compiled on several threads, so no static buffer here
+	std::string FORMAT(const char* fmt, ...)
+	{
+		char str[1024];
+
+		va_list ap;
+		va_start(ap, fmt);
+		_vsnprintf(str, 1024, fmt, ap);
+		va_end(ap);
+		str[1023] = '\0';
+
+		return str;
+	}
+
 	//--------------------------------------------------------------------
 	const std::string ToString(double d, int nDigits)
 	{
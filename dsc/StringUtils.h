@@ -16,6 +16,9 @@ namespace dsc
 	const std::string ToString(unsigned short us, int radix = 10);
 	const std::string ToString(bool b);
 
+	//printf style formatting, the result is cut at 1023 characters
+	std::string FORMAT(const char* fmt, ...);
+
 	//string utility fncs
 	void Downcase(std::string& a);
 	void Upcase(std::string& a);
@@ -0,0 +1,152 @@
+#include <cassert>
+#include <cstring>
+#include "Token.h"
+#include "SymbolTable.h"
+
+namespace dsc
+{
+	static const uint32 BLOCK_SIZE = 4096;
+
+	//--------------------------------------------------------------------------------
+	SymbolTable::SymbolTable()
+	: m_blockUsed(BLOCK_SIZE), m_numKeywords(0)
+	{
+		m_slots.resize(256, INVALID_SYMBOL);
+
+		//keyword symbols are the keyword indices, so the scanner can skip the hash for them
+		for (uint32 i=0; i<GetNumKeywords(); ++i)
+		{
+			const char* spelling = GetKeywordSpelling(i);
+			uint32 symbol = INVALID_SYMBOL;
+			Intern(spelling, (uint32) strlen(spelling), symbol);
+			assert(symbol == i);
+			m_symbols[symbol].m_tokenType = GetKeywordTokenType(i);
+		}
+		m_numKeywords = (uint32) m_symbols.size();
+	}
+
+	//--------------------------------------------------------------------------------
+	SymbolTable::~SymbolTable()
+	{
+		for (uint32 i=0; i<m_blocks.size(); ++i)
+			delete[] m_blocks[i];
+	}
+
+	//--------------------------------------------------------------------------------
+	uint32 SymbolTable::Hash(const char* str, uint32 length)
+	{
+		//FNV-1a
+		uint32 hash = 2166136261u;
+		for (uint32 i=0; i<length; ++i)
+		{
+			hash ^= (uint8) str[i];
+			hash *= 16777619u;
+		}
+
+		return hash;
+	}
+
+	//--------------------------------------------------------------------------------
+	uint32 SymbolTable::FindSlot(const char* str, uint32 length, uint32 hash) const
+	{
+		const uint32 mask = (uint32) m_slots.size() - 1;
+		uint32 slot = hash & mask;
+		while (true)
+		{
+			const uint32 symbol = m_slots[slot];
+			if (symbol == INVALID_SYMBOL)
+				return slot;
+
+			const Symbol& sym = m_symbols[symbol];
+			if (sym.m_hash == hash && sym.m_length == length && memcmp(sym.m_str, str, length) == 0)
+				return slot;
+
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	//--------------------------------------------------------------------------------
+	uint32 SymbolTable::Find(const char* str, uint32 length) const
+	{
+		return m_slots[FindSlot(str, length, Hash(str, length))];
+	}
+
+	//--------------------------------------------------------------------------------
+	const char* SymbolTable::Intern(const char* str, uint32 length, uint32& symbol)
+	{
+		ScopedLock lock(m_lock);
+
+		const uint32 hash = Hash(str, length);
+		uint32 slot = FindSlot(str, length, hash);
+		if (m_slots[slot] != INVALID_SYMBOL)
+		{
+			symbol = m_slots[slot];
+			return m_symbols[symbol].m_str;
+		}
+
+		//keep the load factor below one half
+		if ((m_symbols.size() + 1) * 2 > m_slots.size())
+		{
+			Grow();
+			slot = FindSlot(str, length, hash);
+		}
+
+		Symbol sym;
+		sym.m_str = Store(str, length);
+		sym.m_length = length;
+		sym.m_hash = hash;
+		sym.m_tokenType = TOKEN_IDENTIFIER;
+
+		symbol = (uint32) m_symbols.size();
+		m_symbols.push_back(sym);
+		m_slots[slot] = symbol;
+
+		return sym.m_str;
+	}
+
+	//--------------------------------------------------------------------------------
+	const char* SymbolTable::Store(const char* str, uint32 length)
+	{
+		char* pDest = 0;
+		if (length + 1 > BLOCK_SIZE / 4)
+		{
+			//long spellings get a block of their own.  the last block stays the one being filled.
+			pDest = new char[length + 1];
+			m_blocks.insert(m_blocks.begin(), pDest);
+		}
+		else
+		{
+			if (m_blockUsed + length + 1 > BLOCK_SIZE)
+			{
+				m_blocks.push_back(new char[BLOCK_SIZE]);
+				m_blockUsed = 0;
+			}
+
+			pDest = m_blocks.back() + m_blockUsed;
+			m_blockUsed += length + 1;
+		}
+
+		memcpy(pDest, str, length);
+		pDest[length] = '\0';
+
+		return pDest;
+	}
+
+	//--------------------------------------------------------------------------------
+	void SymbolTable::Grow()
+	{
+		const uint32 numSlots = (uint32) m_slots.size() * 2;
+		m_slots.clear();
+		m_slots.resize(numSlots, INVALID_SYMBOL);
+
+		const uint32 mask = (uint32) m_slots.size() - 1;
+		for (uint32 i=0; i<m_symbols.size(); ++i)
+		{
+			uint32 slot = m_symbols[i].m_hash & mask;
+			while (m_slots[slot] != INVALID_SYMBOL)
+				slot = (slot + 1) & mask;
+
+			m_slots[slot] = i;
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#if !defined(DSC_SYMBOLTABLE_H_)
+#define DSC_SYMBOLTABLE_H_
+
+#include <vector>
+#include "ClassUtils.h"
+#include "BaseTypes.h"
+#include "ThreadPool.h"
+
+namespace dsc
+{
+	//-------------------------------------------------------------------------------------
+	/// Intern table for identifiers, keywords and literals.
+	/// Each distinct spelling is stored once and gets a small integer symbol id, so
+	/// names can be compared by id.  Spellings stay valid for the lifetime of the table.
+	/// Keywords are added up front, so the symbol of a keyword is its keyword index
+	/// (see FindKeyword()) and it remembers its token type.
+	/// One table is shared by all scripts of a compile, which are parsed on several
+	/// threads.  Intern() locks, the lookups don't and may only run once nothing is
+	/// interned anymore.
+	class SymbolTable
+	{
+		DSC_NOCOPY(SymbolTable)
+	public:
+		enum
+		{
+			INVALID_SYMBOL = 0xFFFFFFFF,
+		};
+
+		SymbolTable();
+		~SymbolTable();
+
+		/// Returns the stored spelling of str, adding it if needed, and its symbol.
+		const char* Intern(const char* str, uint32 length, uint32& symbol);
+		/// Returns INVALID_SYMBOL if the spelling was never interned.
+		uint32 Find(const char* str, uint32 length) const;
+
+		uint32 GetNumSymbols() const { return (uint32) m_symbols.size(); }
+		const char* GetSpelling(uint32 symbol) const { return m_symbols[symbol].m_str; }
+		uint32 GetLength(uint32 symbol) const { return m_symbols[symbol].m_length; }
+		bool IsKeyword(uint32 symbol) const { return symbol < m_numKeywords; }
+		/// TOKEN_IDENTIFIER unless the symbol is a keyword
+		uint32 GetTokenType(uint32 symbol) const { return m_symbols[symbol].m_tokenType; }
+
+	private:
+		struct Symbol
+		{
+			const char* m_str;
+			uint32 m_length;
+			uint32 m_hash;
+			uint32 m_tokenType;
+		};
+
+		static uint32 Hash(const char* str, uint32 length);
+		uint32 FindSlot(const char* str, uint32 length, uint32 hash) const;
+		const char* Store(const char* str, uint32 length);
+		void Grow();
+
+	private:
+		std::vector<Symbol> m_symbols;
+		/// open addressing hash, holds symbol ids
+		std::vector<uint32> m_slots;
+		/// storage for the spellings, never moved
+		std::vector<char*> m_blocks;
+		uint32 m_blockUsed;
+		uint32 m_numKeywords;
+		CriticalSection m_lock;
+	};
+}
+
+#endif
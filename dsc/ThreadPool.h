@@ -0,0 +1,82 @@
+#if !defined(DSC_THREADPOOL_H_)
+#define DSC_THREADPOOL_H_
+
+#include <vector>
+#include "ClassUtils.h"
+#include "BaseTypes.h"
+
+namespace dsc
+{
+	//-------------------------------------------------------------------------------------
+	/// Unit of work executed by the ThreadPool.
+	/// Execute() runs on an arbitrary thread and must not throw.
+	class ThreadTask
+	{
+	public:
+		virtual ~ThreadTask() {}
+		virtual void Execute() = 0;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Mutual exclusion lock for data shared between tasks.
+	class CriticalSection
+	{
+		DSC_NOCOPY(CriticalSection)
+	public:
+		CriticalSection();
+		~CriticalSection();
+
+		void Enter();
+		void Leave();
+
+	private:
+		class CriticalSectionImpl;
+
+		CriticalSectionImpl* m_pImpl;
+	};
+
+	//-------------------------------------------------------------------------------------
+	class ScopedLock
+	{
+		DSC_NOCOPY(ScopedLock)
+	public:
+		explicit ScopedLock(CriticalSection& cs) : m_cs(cs) { m_cs.Enter(); }
+		~ScopedLock() { m_cs.Leave(); }
+
+	private:
+		CriticalSection& m_cs;
+	};
+
+	//-------------------------------------------------------------------------------------
+	/// Fixed set of worker threads that execute batches of independent tasks.
+	/// The calling thread takes part in the work, so a pool with one thread
+	/// runs everything on the caller without creating any workers.
+	class ThreadPool
+	{
+		DSC_NOCOPY(ThreadPool)
+	public:
+		typedef std::vector<ThreadTask*> ThreadTaskPtrArray;
+
+		/// numThreads == 0 uses one thread per processor
+		explicit ThreadPool(uint32 numThreads = 0);
+		~ThreadPool();
+
+		uint32 GetNumThreads() const { return m_numThreads; }
+
+		/// Execute all tasks and return once every one of them is done.
+		void Run(const ThreadTaskPtrArray& tasks);
+		/// Add a task to the batch that is currently running.
+		/// Only valid from within ThreadTask::Execute(); Run() waits for added tasks as well.
+		void Add(ThreadTask* pTask);
+
+	private:
+		class ThreadPoolImpl;
+
+		uint32 m_numThreads;
+		ThreadPoolImpl* m_pImpl;
+	};
+
+	uint32 GetNumProcessors();
+}
+
+#endif
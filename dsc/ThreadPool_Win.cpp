@@ -0,0 +1,212 @@
+#include <windows.h>
+#include <cassert>
+#include <deque>
+#include "ThreadPool.h"
+
+namespace dsc
+{
+	uint32 GetNumProcessors()
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+
+		if (info.dwNumberOfProcessors < 1)
+			return 1;
+
+		return (uint32) info.dwNumberOfProcessors;
+	}
+
+	//--------------------------------------------------------------------------------
+	class CriticalSection::CriticalSectionImpl
+	{
+	public:
+		CriticalSectionImpl() { InitializeCriticalSection(&m_cs); }
+		~CriticalSectionImpl() { DeleteCriticalSection(&m_cs); }
+
+		CRITICAL_SECTION m_cs;
+	};
+
+	CriticalSection::CriticalSection()
+	{
+		m_pImpl = new CriticalSectionImpl();
+	}
+
+	CriticalSection::~CriticalSection()
+	{
+		delete m_pImpl;
+	}
+
+	void CriticalSection::Enter()
+	{
+		EnterCriticalSection(&m_pImpl->m_cs);
+	}
+
+	void CriticalSection::Leave()
+	{
+		LeaveCriticalSection(&m_pImpl->m_cs);
+	}
+
+	//--------------------------------------------------------------------------------
+	class ThreadPool::ThreadPoolImpl
+	{
+	public:
+		ThreadPoolImpl(uint32 numWorkers)
+		: m_numPending(0), m_numBusy(0), m_quit(0)
+		{
+			//every queued task releases the task semaphore once.  when the batch is
+			//done, it is released once per thread to let everybody leave the batch.
+			m_batchSemaphore = CreateSemaphore(0, 0, 0x7FFFFFFF, 0);
+			m_taskSemaphore = CreateSemaphore(0, 0, 0x7FFFFFFF, 0);
+			m_doneEvent = CreateEvent(0, TRUE, FALSE, 0);
+			assert(m_batchSemaphore && m_taskSemaphore && m_doneEvent);
+
+			for (uint32 i=0; i<numWorkers; ++i)
+			{
+				HANDLE h = CreateThread(0, 0, WorkerProc, this, 0, 0);
+				assert(h);
+				if (h)
+					m_threads.push_back(h);
+			}
+		}
+
+		~ThreadPoolImpl()
+		{
+			InterlockedExchange(&m_quit, 1);
+			if (!m_threads.empty())
+			{
+				ReleaseSemaphore(m_batchSemaphore, (LONG) m_threads.size(), 0);
+				WaitForMultipleObjects((DWORD) m_threads.size(), &m_threads[0], TRUE, INFINITE);
+			}
+
+			for (uint32 i=0; i<m_threads.size(); ++i)
+				CloseHandle(m_threads[i]);
+
+			CloseHandle(m_batchSemaphore);
+			CloseHandle(m_taskSemaphore);
+			CloseHandle(m_doneEvent);
+		}
+
+		void Run(const ThreadTaskPtrArray& tasks)
+		{
+			if (tasks.empty())
+				return;
+
+			{
+				ScopedLock lock(m_lock);
+				assert(m_numPending == 0 && m_queue.empty());
+				m_queue.insert(m_queue.end(), tasks.begin(), tasks.end());
+				m_numPending = (uint32) tasks.size();
+			}
+			ReleaseSemaphore(m_taskSemaphore, (LONG) tasks.size(), 0);
+
+			if (!m_threads.empty())
+			{
+				//wake up the workers
+				m_numBusy = (LONG) m_threads.size();
+				ResetEvent(m_doneEvent);
+				ReleaseSemaphore(m_batchSemaphore, (LONG) m_threads.size(), 0);
+			}
+
+			//calling thread works too
+			ExecuteTasks();
+
+			if (!m_threads.empty())
+				WaitForSingleObject(m_doneEvent, INFINITE);
+		}
+
+		void Add(ThreadTask* pTask)
+		{
+			{
+				ScopedLock lock(m_lock);
+				assert(m_numPending > 0);
+				m_queue.push_back(pTask);
+				++m_numPending;
+			}
+			ReleaseSemaphore(m_taskSemaphore, 1, 0);
+		}
+
+	private:
+		static DWORD WINAPI WorkerProc(LPVOID pParam)
+		{
+			ThreadPoolImpl* pImpl = (ThreadPoolImpl*) pParam;
+
+			while (true)
+			{
+				WaitForSingleObject(pImpl->m_batchSemaphore, INFINITE);
+				if (pImpl->m_quit)
+					break;
+
+				pImpl->ExecuteTasks();
+
+				if (InterlockedDecrement(&pImpl->m_numBusy) == 0)
+					SetEvent(pImpl->m_doneEvent);
+			}
+
+			return 0;
+		}
+
+		void ExecuteTasks()
+		{
+			while (true)
+			{
+				WaitForSingleObject(m_taskSemaphore, INFINITE);
+
+				ThreadTask* pTask = 0;
+				{
+					ScopedLock lock(m_lock);
+					if (m_queue.empty())
+						break;	//batch is done
+
+					pTask = m_queue.front();
+					m_queue.pop_front();
+				}
+
+				pTask->Execute();
+
+				bool batchDone = false;
+				{
+					ScopedLock lock(m_lock);
+					assert(m_numPending > 0);
+					batchDone = --m_numPending == 0;
+				}
+
+				if (batchDone)
+					ReleaseSemaphore(m_taskSemaphore, (LONG) m_threads.size() + 1, 0);
+			}
+		}
+
+	private:
+		std::vector<HANDLE> m_threads;
+		HANDLE m_batchSemaphore;
+		HANDLE m_taskSemaphore;
+		HANDLE m_doneEvent;
+		CriticalSection m_lock;
+		std::deque<ThreadTask*> m_queue;
+		/// queued and executing tasks of the current batch
+		uint32 m_numPending;
+		volatile LONG m_numBusy;
+		volatile LONG m_quit;
+	};
+
+	//--------------------------------------------------------------------------------
+	ThreadPool::ThreadPool(uint32 numThreads)
+	{
+		m_numThreads = numThreads > 0 ? numThreads : GetNumProcessors();
+		m_pImpl = new ThreadPoolImpl(m_numThreads - 1);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		delete m_pImpl;
+	}
+
+	void ThreadPool::Run(const ThreadTaskPtrArray& tasks)
+	{
+		m_pImpl->Run(tasks);
+	}
+
+	void ThreadPool::Add(ThreadTask* pTask)
+	{
+		m_pImpl->Add(pTask);
+	}
+}
@@ -0,0 +1,13 @@
+#if !defined(DSC_TIMER_H_)
+#define DSC_TIMER_H_
+
+#include "BaseTypes.h"
+
+namespace dsc
+{
+	/// High resolution time stamp, for compile time statistics.
+	uint64 GetTicks();
+	uint64 GetTicksPerSecond();
+}
+
+#endif
@@ -0,0 +1,19 @@
+#include <windows.h>
+#include "Timer.h"
+
+namespace dsc
+{
+	uint64 GetTicks()
+	{
+		LARGE_INTEGER ticks;
+		QueryPerformanceCounter(&ticks);
+		return (uint64) ticks.QuadPart;
+	}
+
+	uint64 GetTicksPerSecond()
+	{
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		return (uint64) freq.QuadPart;
+	}
+}
@@ -1,36 +1,98 @@
 #include <cassert>
+#include <cstring>
 #include "Token.h"
 
 namespace dsc
 {
-	Token::Token()
-	: m_type(TOKEN_ERROR), m_spelling(""), m_line(0), m_col(0)
+	struct KeywordInfo
+	{
+		const char* m_spelling;
+		uint32 m_length;
+		uint32 m_tokenType;
+	};
+
+	static const KeywordInfo s_keywords[] =
 	{
+		{ "class", 5, TOKEN_CLASS },
+		{ "super", 5, TOKEN_SUPER },
+		{ "true", 4, TOKEN_TRUE },
+		{ "false", 5, TOKEN_FALSE },
+		{ "native", 6, TOKEN_NATIVE },
+		{ "while", 5, TOKEN_WHILE },
+		{ "if", 2, TOKEN_IF },
+		{ "else", 4, TOKEN_ELSE },
+		{ "return", 6, TOKEN_RETURN },
+		{ "import", 6, TOKEN_IMPORT },
+		{ "new", 3, TOKEN_NEW },
+		{ "extends", 7, TOKEN_EXTENDS },
+		{ "null", 4, TOKEN_NULL },
+		{ "final", 5, TOKEN_FINAL },
+		{ "is", 2, TOKEN_IS },
+		{ "as", 2, TOKEN_AS },
+	};
+
+	static const uint32 NUM_KEYWORDS = sizeof(s_keywords) / sizeof(s_keywords[0]);
+	static const int8 NO_KEYWORD = -1;
+
+	//keyword index by (3 * first char + 11 * last char) & 31.  collision free for the keywords above;
+	//when adding a keyword, pick new multipliers so that this stays true.
+	static const int8 s_keywordHash[32] =
+	{
+		11, 4, NO_KEYWORD, NO_KEYWORD, NO_KEYWORD, NO_KEYWORD, 7, 10,
+		NO_KEYWORD, 3, NO_KEYWORD, NO_KEYWORD, 14, NO_KEYWORD, 12, NO_KEYWORD,
+		8, NO_KEYWORD, NO_KEYWORD, 2, 15, NO_KEYWORD, 13, 9,
+		NO_KEYWORD, NO_KEYWORD, 0, NO_KEYWORD, 5, 6, NO_KEYWORD, 1,
+	};
+
+	uint32 GetNumKeywords()
+	{
+		return NUM_KEYWORDS;
 	}
 
-	Token::Token(uint32 type, const char* spelling, uint32 line, uint32 col)
-	: m_type(type), m_spelling(spelling), m_line(line), m_col(col)
+	const char* GetKeywordSpelling(uint32 idx)
 	{
+		assert(idx < NUM_KEYWORDS);
+		return s_keywords[idx].m_spelling;
 	}
 
-	uint32 Token::GetType() const
+	uint32 GetKeywordTokenType(uint32 idx)
 	{
-		return m_type;
+		assert(idx < NUM_KEYWORDS);
+		return s_keywords[idx].m_tokenType;
 	}
 
-	uint32 Token::GetLine() const
+	int32 FindKeyword(const char* str, uint32 length)
+	{
+		if (length < 2 || length > 7)
+			return -1;
+
+		const uint32 hash = (3 * (uint8) str[0] + 11 * (uint8) str[length - 1]) & 31;
+		const int32 idx = s_keywordHash[hash];
+		if (idx == NO_KEYWORD)
+			return -1;
+
+		const KeywordInfo& kw = s_keywords[idx];
+		if (kw.m_length != length || memcmp(kw.m_spelling, str, length) != 0)
+			return -1;
+
+		return idx;
+	}
+
+	Token::Token()
+	: m_type(TOKEN_ERROR), m_symbol(SymbolTable::INVALID_SYMBOL), m_spelling(""), m_line(0), m_col(0)
 	{
-		return m_line;
 	}
 
-	uint32 Token::GetCol() const
+	Token::Token(uint32 type, const char* spelling, uint32 line, uint32 col)
+	: m_type(type), m_symbol(SymbolTable::INVALID_SYMBOL), m_spelling(spelling), m_line(line), m_col(col)
 	{
-		return m_col;
+		assert(spelling);
 	}
 
-	const char* Token::GetSpelling() const
+	Token::Token(uint32 type, uint32 symbol, const char* spelling, uint32 line, uint32 col)
+	: m_type(type), m_symbol(symbol), m_spelling(spelling), m_line(line), m_col(col)
 	{
-		return m_spelling.c_str();
+		assert(spelling);
 	}
 
 	const std::string TokenTypeToString(uint32 type)
@@ -55,6 +117,8 @@ namespace dsc
 			return "else";
 		case TOKEN_RETURN:
 			return "return";
+		case TOKEN_IMPORT:
+			return "import";
 		case TOKEN_IDENTIFIER:
 			return "identifier";
 		case TOKEN_EOF:
@@ -123,6 +187,12 @@ namespace dsc
 			return "new";
 		case TOKEN_NULL:
 			return "null";
+		case TOKEN_FINAL:
+			return "final";
+		case TOKEN_IS:
+			return "is";
+		case TOKEN_AS:
+			return "as";
 		default:
 			assert(false);
 			return "";
@@ -3,6 +3,7 @@
 
 #include <string>
 #include "BaseTypes.h"
+#include "SymbolTable.h"
 
 namespace dsc
 {
@@ -50,6 +51,9 @@ namespace dsc
 		TOKEN_SEMICOLON,
 		TOKEN_NEW,
 		TOKEN_NULL,
+		TOKEN_FINAL,
+		TOKEN_IS,
+		TOKEN_AS,
 
 		//comments
 		TOKEN_BRACKETED_COMMENT,
@@ -59,24 +63,39 @@ namespace dsc
 		TOKEN_ERROR,
 	};
 
+	/// Small, cheap to copy token.
+	/// The spelling is not owned: it points into the SymbolTable the token was
+	/// scanned with (or at a string that outlives the token), so tokens must not
+	/// outlive the compile that scanned them.
 	class Token
 	{
 	public:
 		Token();
 		Token(uint32 type, const char* spelling, uint32 line, uint32 col);
-		uint32 GetType() const;
-		const char* GetSpelling() const;
-		uint32 GetLine() const;
-		uint32 GetCol() const;
+		Token(uint32 type, uint32 symbol, const char* spelling, uint32 line, uint32 col);
+		uint32 GetType() const { return m_type; }
+		/// SymbolTable::INVALID_SYMBOL for tokens that were not scanned
+		uint32 GetSymbol() const { return m_symbol; }
+		const char* GetSpelling() const { return m_spelling; }
+		uint32 GetLine() const { return m_line; }
+		uint32 GetCol() const { return m_col; }
 
 	private:
 		uint32 m_type;
-		std::string m_spelling;
+		uint32 m_symbol;
+		const char* m_spelling;
 		uint32 m_line;
 		uint32 m_col;
 	};
 
 	const std::string TokenTypeToString(uint32 type);
+
+	/// Keywords, indexed the same way as their symbols in every SymbolTable.
+	uint32 GetNumKeywords();
+	const char* GetKeywordSpelling(uint32 idx);
+	uint32 GetKeywordTokenType(uint32 idx);
+	/// Perfect hash lookup.  Returns -1 if the string is not a keyword.
+	int32 FindKeyword(const char* str, uint32 length);
 	const std::string ToString(const Token& tok);
 }
 
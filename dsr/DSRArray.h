@@ -2,6 +2,8 @@
 #if !defined(DSR_ARRAY_H)
 #define DSR_ARRAY_H
 
+//placement new for arrays of built in types
+#include <new>
 #include "DSRPlatform.h"
 #include "DSRBaseTypes.h"
 #include "DSRMemory.h"
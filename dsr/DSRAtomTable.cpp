@@ -0,0 +1,84 @@
+#include <string.h>
+#include <ctype.h>
+#include "DSRAtomTable.h"
+
+namespace dsr
+{
+	AtomTable::AtomTable()
+	: m_numAtoms(0)
+	{
+	}
+
+	AtomTable::~AtomTable()
+	{
+		for (uint32 i=0; i<m_numAtoms; ++i)
+			Memory::Free(m_names[i]);
+	}
+
+	Atom AtomTable::Add(const char* name)
+	{
+		DSR_ASSERT(name);
+		if ((m_numAtoms + 1) * 2 > m_slots.size())
+			Grow();
+
+		const uint32 slot = FindSlot(name, Hash(name));
+		if (m_slots[slot] != NULL_ATOM)
+			return m_slots[slot];
+
+		const size_t len = strlen(name);
+		char* pName = (char*) Memory::Alloc(len + 1);
+		strcpy(pName, name);
+		m_names[m_numAtoms] = pName;
+
+		//atom n names m_names[n-1], so that 0 stays free
+		++m_numAtoms;
+		m_slots[slot] = m_numAtoms;
+		return m_numAtoms;
+	}
+
+	Atom AtomTable::Find(const char* name) const
+	{
+		DSR_ASSERT(name);
+		if (m_slots.empty())
+			return NULL_ATOM;
+		return m_slots[FindSlot(name, Hash(name))];
+	}
+
+	uint32 AtomTable::Hash(const char* name)
+	{
+		//FNV-1a of the lower case name
+		uint32 hash = 2166136261u;
+		for (const char* p=name; *p; ++p)
+		{
+			hash ^= (uint32) tolower((unsigned char) *p);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	uint32 AtomTable::FindSlot(const char* name, uint32 hash) const
+	{
+		const uint32 mask = m_slots.size() - 1;
+		uint32 slot = hash & mask;
+		while (m_slots[slot] != NULL_ATOM && stricmp(m_names[m_slots[slot] - 1], name) != 0)
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	void AtomTable::Grow()
+	{
+		const uint32 size = m_slots.size() > 0 ? m_slots.size() * 2 : 64;
+
+		//names keep their atoms, only the slots move
+		CharPtrArray names(size / 2);
+		for (uint32 i=0; i<m_numAtoms; ++i)
+			names[i] = m_names[i];
+		m_names = names;
+
+		m_slots.resize(size);
+		for (uint32 i=0; i<size; ++i)
+			m_slots[i] = NULL_ATOM;
+		for (uint32 i=0; i<m_numAtoms; ++i)
+			m_slots[FindSlot(m_names[i], Hash(m_names[i]))] = i + 1;
+	}
+}
@@ -0,0 +1,147 @@
+
+#if !defined(DSR_ATOMTABLE_H_)
+#define DSR_ATOMTABLE_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRArray.h"
+
+namespace dsr
+{
+	/// Id of an interned name.  Names that only differ in case have the same atom, as
+	/// script names are case insensitive.
+	typedef uint32 Atom;
+
+	enum
+	{
+		NULL_ATOM = 0,
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Names of the runtime, each stored once, see ScriptManager::GetAtomTable.  Looking up
+	/// a name hashes it once, after that the atom compares and hashes as a number.
+	class AtomTable
+	{
+		DSR_NOCOPY(AtomTable)
+	public:
+		DSR_NEWDELETE(AtomTable)
+
+		AtomTable();
+		~AtomTable();
+
+		/// atom of name, added if it's new
+		Atom Add(const char* name);
+		/// atom of name, NULL_ATOM if it was never added
+		Atom Find(const char* name) const;
+		/// name as it was first added
+		const char* GetName(Atom atom) const { DSR_ASSERT(atom != NULL_ATOM && atom <= m_numAtoms); return m_names[atom - 1]; }
+		uint32 GetNumAtoms() const { return m_numAtoms; }
+
+	private:
+		static uint32 Hash(const char* name);
+		/// slot of name, or the empty slot it goes to
+		uint32 FindSlot(const char* name, uint32 hash) const;
+		void Grow();
+
+	private:
+		typedef Array<char*> CharPtrArray;
+		typedef Array<Atom> AtomArray;
+
+		CharPtrArray m_names;
+		/// open addressed, a power of two in size, NULL_ATOM where empty
+		AtomArray m_slots;
+		uint32 m_numAtoms;
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Values by atom, for lookups of names that were interned when the map was filled.
+	/// Entries are only added, Clear empties the map.
+	template <class T> class AtomMap
+	{
+		DSR_NOCOPY(AtomMap)
+	public:
+		DSR_NEWDELETE(AtomMap)
+
+		AtomMap() : m_numEntries(0) {}
+
+		uint32 GetNumEntries() const { return m_numEntries; }
+		/// false until the first Reserve or Set, and after Clear
+		bool IsBuilt() const { return !m_entries.empty(); }
+
+		/// makes room for numEntries entries
+		void Reserve(uint32 numEntries)
+		{
+			while (m_entries.size() < numEntries * 2 || m_entries.empty())
+				Grow();
+		}
+
+		/// adds or replaces the value of atom
+		void Set(Atom atom, const T& value)
+		{
+			DSR_ASSERT(atom != NULL_ATOM);
+			if ((m_numEntries + 1) * 2 > m_entries.size())
+				Grow();
+
+			Entry& entry = m_entries[FindSlot(atom)];
+			if (entry.atom == NULL_ATOM)
+			{
+				entry.atom = atom;
+				++m_numEntries;
+			}
+			entry.value = value;
+		}
+
+		/// value of atom, 0 if it has none
+		const T* Find(Atom atom) const
+		{
+			if (m_entries.empty() || atom == NULL_ATOM)
+				return 0;
+			const Entry& entry = m_entries[FindSlot(atom)];
+			return entry.atom != NULL_ATOM ? &entry.value : 0;
+		}
+
+		void Clear()
+		{
+			m_entries.clear();
+			m_numEntries = 0;
+		}
+
+	private:
+		struct Entry
+		{
+			Entry() : atom(NULL_ATOM), value() {}
+			Atom atom;
+			T value;
+		};
+
+		uint32 FindSlot(Atom atom) const
+		{
+			//atoms are handed out in order, the multiply spreads them
+			const uint32 mask = m_entries.size() - 1;
+			uint32 slot = (atom * 2654435761u) & mask;
+			while (m_entries[slot].atom != NULL_ATOM && m_entries[slot].atom != atom)
+				slot = (slot + 1) & mask;
+			return slot;
+		}
+
+		void Grow()
+		{
+			Array<Entry> old(m_entries);
+			m_entries.resize(old.size() > 0 ? old.size() * 2 : 8);
+			m_numEntries = 0;
+			for (uint32 i=0; i<old.size(); ++i)
+			{
+				if (old[i].atom != NULL_ATOM)
+					Set(old[i].atom, old[i].value);
+			}
+		}
+
+	private:
+		Array<Entry> m_entries;
+		uint32 m_numEntries;
+	};
+}
+
+#endif
@@ -0,0 +1,341 @@
+#include "DSRCollector.h"
+
+#include "DSRScriptInstance.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptManager.h"
+#include "DSRVMStack.h"
+
+namespace dsr
+{
+	namespace
+	{
+		enum
+		{
+			/// group count of the instances found live by Collector::Check
+			LIVE = 0xffffffff,
+		};
+
+		void Push(Array<ScriptInstance*>& array, uint32& size, ScriptInstance* pInstance)
+		{
+			//grow by doubling
+			if (size == array.size())
+			{
+				Array<ScriptInstance*> grown(size > 0 ? size * 2 : 64);
+				for (uint32 i=0; i<size; ++i)
+					grown[i] = array[i];
+				array = grown;
+			}
+
+			array[size++] = pInstance;
+		}
+
+		/// references to the instance's handle, 1 if only the instance holds it
+		uint32 GetNumReferences(ScriptInstance* pInstance)
+		{
+			return (uint32) pInstance->GetHandlePtr()->NumReferences();
+		}
+	}
+
+	Collector::Collector()
+	: m_pFirstInstance(0), m_numInstances(0), m_pFirstStack(0), m_pCursor(0), m_epoch(0), m_passEpoch(0),
+		m_numNodes(0), m_numLive(0), m_numRefs(0)
+	{
+	}
+
+	Collector::~Collector()
+	{
+		//the ScriptManager frees them while their classes are still around
+		DSR_ASSERT(!m_pFirstInstance);
+	}
+
+	void Collector::Add(ScriptInstance* pInstance)
+	{
+		DSR_ASSERT(pInstance);
+		DSR_ASSERT(!pInstance->m_collectable);
+
+		//scripts hold it from now on, it's not left to the ScriptManager
+		ScriptManagerPtr()->Remove(pInstance);
+
+		pInstance->m_collectable = true;
+		pInstance->m_collectMark = 0;
+		pInstance->m_collectCount = 0;
+		pInstance->m_pPrevCollectable = 0;
+		pInstance->m_pNextCollectable = m_pFirstInstance;
+		if (m_pFirstInstance)
+			m_pFirstInstance->m_pPrevCollectable = pInstance;
+		m_pFirstInstance = pInstance;
+		++m_numInstances;
+	}
+
+	void Collector::Remove(ScriptInstance* pInstance)
+	{
+		DSR_ASSERT(pInstance->m_collectable);
+		DSR_ASSERT(m_numInstances > 0);
+
+		if (m_pCursor == pInstance)
+			m_pCursor = pInstance->m_pNextCollectable;
+
+		if (pInstance->m_pPrevCollectable)
+			pInstance->m_pPrevCollectable->m_pNextCollectable = pInstance->m_pNextCollectable;
+		else
+			m_pFirstInstance = pInstance->m_pNextCollectable;
+		if (pInstance->m_pNextCollectable)
+			pInstance->m_pNextCollectable->m_pPrevCollectable = pInstance->m_pPrevCollectable;
+
+		pInstance->m_collectable = false;
+		pInstance->m_pPrevCollectable = 0;
+		pInstance->m_pNextCollectable = 0;
+		--m_numInstances;
+	}
+
+	void Collector::Add(VMStack* pStack)
+	{
+		DSR_ASSERT(pStack);
+		DSR_ASSERT(!pStack->m_pPrevStack && pStack != m_pFirstStack);
+
+		pStack->m_pPrevStack = 0;
+		pStack->m_pNextStack = m_pFirstStack;
+		if (m_pFirstStack)
+			m_pFirstStack->m_pPrevStack = pStack;
+		m_pFirstStack = pStack;
+	}
+
+	void Collector::Remove(VMStack* pStack)
+	{
+		if (pStack->m_pPrevStack)
+			pStack->m_pPrevStack->m_pNextStack = pStack->m_pNextStack;
+		else
+			m_pFirstStack = pStack->m_pNextStack;
+		if (pStack->m_pNextStack)
+			pStack->m_pNextStack->m_pPrevStack = pStack->m_pPrevStack;
+
+		pStack->m_pPrevStack = 0;
+		pStack->m_pNextStack = 0;
+	}
+
+	void Collector::ClearFrames(ScriptInstance* pInstance)
+	{
+		ScriptManagerPtr()->GetVMStack().ClearInstance(pInstance);
+		for (VMStack* pStack = m_pFirstStack; pStack && pInstance->m_numFrames > 0; pStack = pStack->m_pNextStack)
+			pStack->ClearInstance(pInstance);
+	}
+
+	uint32 Collector::Step(uint32 maxVisits)
+	{
+		DSR_ASSERT(maxVisits > 0);
+		++m_stats.numSteps;
+		if (!m_pCursor)
+			BeginPass();
+
+		const uint32 numFreed = m_stats.numFreed;
+		uint32 numVisits = 0;
+		while (m_pCursor && numVisits < maxVisits)
+		{
+			ScriptInstance* pInstance = m_pCursor;
+			if (pInstance->m_numFrames > 0)
+			{
+				//a frame runs on it
+				m_pCursor = pInstance->m_pNextCollectable;
+				++numVisits;
+			}
+			else if (GetNumReferences(pInstance) == 1)
+			{
+				numVisits += Free(pInstance, maxVisits - numVisits);
+			}
+			else if (pInstance->m_collectMark >= m_passEpoch)
+			{
+				//found live by an earlier check of this pass
+				m_pCursor = pInstance->m_pNextCollectable;
+				++numVisits;
+			}
+			else
+			{
+				const uint32 numChecked = Check(pInstance, maxVisits - numVisits);
+				if (numChecked > 0)
+				{
+					numVisits += numChecked;
+				}
+				else if (numVisits > 0)
+				{
+					//the next step checks it with all of its visits
+					break;
+				}
+				else
+				{
+					++m_stats.numTooLarge;
+					numVisits = maxVisits;
+				}
+
+				if (m_pCursor == pInstance)
+					m_pCursor = pInstance->m_pNextCollectable;
+			}
+		}
+
+		if (!m_pCursor)
+			++m_stats.numPasses;
+
+		m_stats.numVisited += numVisits;
+		return m_stats.numFreed - numFreed;
+	}
+
+	uint32 Collector::Collect()
+	{
+		//finishes the pass in progress, then passes until one finds nothing.  Instances a
+		//pass frees can leave others it already visited unreachable.
+		uint32 numFreed = Step(0xffffffff);
+		for (;;)
+		{
+			const uint32 numPassFreed = Step(0xffffffff);
+			numFreed += numPassFreed;
+			if (numPassFreed == 0)
+				break;
+		}
+
+		return numFreed;
+	}
+
+	void Collector::FreeAll()
+	{
+		while (m_pFirstInstance)
+			delete m_pFirstInstance;
+	}
+
+	void Collector::BeginPass()
+	{
+		//start the marks over long before they could wrap
+		if (m_epoch > 0x7fffffff)
+		{
+			for (ScriptInstance* pInstance = m_pFirstInstance; pInstance; pInstance = pInstance->m_pNextCollectable)
+				pInstance->m_collectMark = 0;
+			m_epoch = 0;
+		}
+
+		m_passEpoch = NextEpoch();
+		m_pCursor = m_pFirstInstance;
+	}
+
+	uint32 Collector::Free(ScriptInstance* pInstance, uint32 maxFrees)
+	{
+		//the mark keeps two references from queueing an instance twice
+		const uint32 epoch = NextEpoch();
+		pInstance->m_collectMark = epoch;
+		m_numNodes = 0;
+		Push(m_nodes, m_numNodes, pInstance);
+
+		uint32 numFreed = 0;
+		while (m_numNodes > 0 && numFreed < maxFrees)
+		{
+			ScriptInstance* pFree = m_nodes[--m_numNodes];
+			GetReferences(pFree);
+			delete pFree;
+			++numFreed;
+
+			//instances left for the cursor once maxFrees is reached
+			for (uint32 i=0; i<m_numRefs; ++i)
+			{
+				ScriptInstance* pRef = m_refs[i];
+				if (pRef->m_collectMark != epoch && pRef->m_numFrames == 0 && GetNumReferences(pRef) == 1)
+				{
+					pRef->m_collectMark = epoch;
+					Push(m_nodes, m_numNodes, pRef);
+				}
+			}
+		}
+
+		m_stats.numFreed += numFreed;
+		return numFreed;
+	}
+
+	uint32 Collector::Check(ScriptInstance* pStart, uint32 maxVisits)
+	{
+		//the group, pStart and the instances it reaches that aren't known to be live, each
+		//with the number of references it has from within the group
+		const uint32 epoch = NextEpoch();
+		pStart->m_collectMark = epoch;
+		pStart->m_collectCount = 0;
+		m_numNodes = 0;
+		Push(m_nodes, m_numNodes, pStart);
+		for (uint32 n=0; n<m_numNodes; ++n)
+		{
+			GetReferences(m_nodes[n]);
+			for (uint32 i=0; i<m_numRefs; ++i)
+			{
+				ScriptInstance* pRef = m_refs[i];
+				if (pRef->m_collectMark == epoch)
+				{
+					++pRef->m_collectCount;
+				}
+				else if (pRef->m_collectMark < m_passEpoch && pRef->m_numFrames == 0)
+				{
+					if (m_numNodes == maxVisits)
+					{
+						for (uint32 j=0; j<m_numNodes; ++j)
+							m_nodes[j]->m_collectMark = 0;
+						return 0;
+					}
+
+					pRef->m_collectMark = epoch;
+					pRef->m_collectCount = 1;
+					Push(m_nodes, m_numNodes, pRef);
+				}
+			}
+		}
+
+		//the ones also referenced from outside keep those they reach
+		m_numLive = 0;
+		for (uint32 n=0; n<m_numNodes; ++n)
+		{
+			ScriptInstance* pNode = m_nodes[n];
+			if (GetNumReferences(pNode) - 1 > pNode->m_collectCount)
+			{
+				pNode->m_collectCount = LIVE;
+				Push(m_live, m_numLive, pNode);
+			}
+		}
+
+		while (m_numLive > 0)
+		{
+			GetReferences(m_live[--m_numLive]);
+			for (uint32 i=0; i<m_numRefs; ++i)
+			{
+				ScriptInstance* pRef = m_refs[i];
+				if (pRef->m_collectMark == epoch && pRef->m_collectCount != LIVE)
+				{
+					pRef->m_collectCount = LIVE;
+					Push(m_live, m_numLive, pRef);
+				}
+			}
+		}
+
+		//the rest only hold each other
+		const uint32 numChecked = m_numNodes;
+		uint32 numFreed = 0;
+		for (uint32 n=0; n<numChecked; ++n)
+		{
+			if (m_nodes[n]->m_collectCount != LIVE)
+				m_nodes[numFreed++] = m_nodes[n];
+		}
+		for (uint32 n=0; n<numFreed; ++n)
+			delete m_nodes[n];
+
+		m_stats.numFreed += numFreed;
+		m_stats.numFreedInCycles += numFreed;
+		return numChecked;
+	}
+
+	void Collector::GetReferences(ScriptInstance* pInstance)
+	{
+		m_numRefs = 0;
+		const ScriptClass* pClass = pInstance->GetScriptClassPtr();
+		for (uint32 i=0; i<pClass->GetNumData(); ++i)
+		{
+			if (!pClass->GetDataTypePtr(i)->GetVMDataType().IsNative())
+				continue;
+
+			ScriptInstanceHandle* pHandle = *((ScriptInstanceHandle**)(&pInstance->GetInstanceData()[i]));
+			ScriptInstance* pRef = pHandle->get();
+			if (pRef && pRef->m_collectable)
+				Push(m_refs, m_numRefs, pRef);
+		}
+	}
+}
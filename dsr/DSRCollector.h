@@ -0,0 +1,124 @@
+
+#if !defined(DSR_COLLECTOR_H_)
+#define DSR_COLLECTOR_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRArray.h"
+
+namespace dsr
+{
+	class ScriptInstance;
+	class VMStack;
+
+	//------------------------------------------------------------------------------------
+	/// Work of a Collector, since it was created.
+	class CollectorStats
+	{
+	public:
+		DSR_NEWDELETE(CollectorStats)
+
+		CollectorStats()
+		: numSteps(0), numPasses(0), numVisited(0), numFreed(0), numFreedInCycles(0), numTooLarge(0)
+		{
+		}
+
+		uint32 numSteps;
+		/// passes over all the instances completed
+		uint32 numPasses;
+		uint32 numVisited;
+		uint32 numFreed;
+		/// of the instances freed, those only other instances held, e.g. in cycles
+		uint32 numFreedInCycles;
+		/// instances whose references were more than a step could check, left to Collect
+		uint32 numTooLarge;
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Frees the instances scripts create with new, once no script, host or instance
+	/// created by the host holds them anymore.  An instance held only by its own handle is
+	/// freed right away, with the instances only it held.  The ones held otherwise are
+	/// checked with the instances they reference: those only referenced from within the
+	/// group are freed together, so instances referencing each other don't keep each other.
+	///
+	/// The host runs the collector between calls into scripts.  Each step visits at most
+	/// the number of instances it's given, continuing the pass over all instances where the
+	/// last step stopped, so a pause is bounded.  Instances the frames of a VMStack run on
+	/// are kept, each instance counts its frames.
+	class Collector
+	{
+		DSR_NOCOPY(Collector)
+	public:
+		DSR_NEWDELETE(Collector)
+
+		enum
+		{
+			DEFAULT_STEP_VISITS = 256,
+		};
+
+		Collector();
+		~Collector();
+
+		/// Takes over an instance a script created, called by the VM.
+		void Add(ScriptInstance* pInstance);
+		/// Should only get called by ScriptInstance
+		void Remove(ScriptInstance* pInstance);
+
+		/// Stack whose frames can outlive the instances they run on, e.g. a suspended
+		/// ScriptTask's.  The ScriptManager's is always searched.
+		void Add(VMStack* pStack);
+		void Remove(VMStack* pStack);
+		/// Should only get called by ScriptInstance, the frames running on the instance
+		/// run on none anymore
+		void ClearFrames(ScriptInstance* pInstance);
+
+		/// Frees the unreachable instances among the next maxVisits the pass visits.
+		/// Returns the number freed.
+		uint32 Step(uint32 maxVisits = DEFAULT_STEP_VISITS);
+		/// Frees every unreachable instance, however long it takes.  Returns the number freed.
+		uint32 Collect();
+		/// frees all instances, reachable or not.  For shutdown.
+		void FreeAll();
+
+		/// instances scripts created that aren't freed yet
+		uint32 GetNumInstances() const { return m_numInstances; }
+		const CollectorStats& GetStats() const { return m_stats; }
+
+	private:
+		void BeginPass();
+		uint32 NextEpoch() { return ++m_epoch; }
+		/// frees pInstance and the instances only it held, up to maxFrees, returns how many
+		uint32 Free(ScriptInstance* pInstance, uint32 maxFrees);
+		/// Frees the group of instances pStart reaches that aren't referenced from outside it,
+		/// marks the rest live for this pass.  Returns the instances checked, 0 if more than
+		/// maxVisits would have been.
+		uint32 Check(ScriptInstance* pStart, uint32 maxVisits);
+		/// adds the instances pInstance's data reference to m_refs
+		void GetReferences(ScriptInstance* pInstance);
+
+	private:
+		typedef Array<ScriptInstance*> ScriptInstancePtrArray;
+
+		ScriptInstance* m_pFirstInstance;
+		uint32 m_numInstances;
+		VMStack* m_pFirstStack;
+		/// instance the pass continues at, 0 between passes
+		ScriptInstance* m_pCursor;
+		uint32 m_epoch;
+		/// instances marked with this epoch or a later one are live for this pass
+		uint32 m_passEpoch;
+		/// instances being checked or freed, those of them found live, and the references
+		/// of one
+		ScriptInstancePtrArray m_nodes;
+		uint32 m_numNodes;
+		ScriptInstancePtrArray m_live;
+		uint32 m_numLive;
+		ScriptInstancePtrArray m_refs;
+		uint32 m_numRefs;
+		CollectorStats m_stats;
+	};
+}
+
+#endif
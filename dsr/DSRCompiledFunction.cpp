@@ -0,0 +1,23 @@
+
+#include "DSRCompiledFunction.h"
+#include "DSRVMStack.h"
+
+namespace dsr
+{
+	bool CallCompiled(const FunctionImplementation* pCallee, ScriptInstance* pInstance, VMDataArray& args, VMData* retVal)
+	{
+		DSR_ASSERT(pCallee);
+		DSR_ASSERT(pInstance);
+
+		//the flag may be left over from an earlier call, only this one counts
+		VMStack& vmStack = ScriptManagerPtr()->GetVMStack();
+		const bool overflowed = vmStack.HasOverflowed();
+		vmStack.m_overflowed = false;
+
+		pCallee->Call(pInstance, args, retVal);
+
+		const bool failed = vmStack.HasOverflowed();
+		vmStack.m_overflowed = overflowed || failed;
+		return !failed;
+	}
+}
@@ -0,0 +1,47 @@
+
+#if !defined(DSR_COMPILEDFUNCTION_H_)
+#define DSR_COMPILEDFUNCTION_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRMemory.h"
+#include "DSRFunction.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptInstance.h"
+#include "DSRScriptManager.h"
+#include "DSRVMData.h"
+
+namespace dsr
+{
+	//------------------------------------------------------------------------------------
+	/// C++ translation of a scripted function, generated by dsc.  Tables of them are
+	/// registered with ScriptManager::Add.  The translation runs in place of the bytecode of
+	/// function fnIdx of the named class, as long as the loaded bytecode hashes to codeHash,
+	/// so a class reloaded with other code runs its bytecode again.
+	class CompiledFunction
+	{
+	public:
+		DSR_NEWDELETE(CompiledFunction)
+
+		const char* className;
+		uint32 fnIdx;
+		uint32 codeHash;
+		NativeFunctionImplementation::NativeScriptFunction* pFnc;
+		/// set to the implementation the translation runs for, it finds callees through it
+		const ScriptedFunctionImplementation** ppImpl;
+	};
+
+	/// Calls from translated code.  A translated callee nested deeper than
+	/// VMStack::MAX_TRANSLATED_DEPTH runs its bytecode instead.  False if the call
+	/// overflowed the VMStack, the translation returns right away then, like the aborted
+	/// bytecode would.
+	bool CallCompiled(const FunctionImplementation* pCallee, ScriptInstance* pInstance, VMDataArray& args, VMData* retVal);
+
+	/// float constants of translated code, by their bits
+	DSR_INLINE float CompiledFloat(uint32 bits)
+	{
+		return *((float*) &bits);
+	}
+}
+
+#endif
@@ -0,0 +1,84 @@
+
+#if !defined(DSR_DATAACCESSOR_H_)
+#define DSR_DATAACCESSOR_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRMemory.h"
+#include "DSRAtomTable.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptInstance.h"
+
+namespace dsr
+{
+	//------------------------------------------------------------------------------------
+	/// Number or bool data of a script class, found by name once.  Reads and writes the
+	/// data of the class's instances, and of its subclasses' instances, which keep it at the
+	/// same index.
+	class DataAccessor
+	{
+	public:
+		DSR_NEWDELETE(DataAccessor)
+
+		DataAccessor() : m_pClass(0), m_dataIdx(0), m_type(VMDATATYPE_INT) {}
+
+		/// false if pClass has no int, float or bool data dataName
+		bool Prepare(const ScriptClass* pClass, const char* dataName)
+		{
+			DSR_ASSERT(pClass);
+			return PrepareIndex(pClass, pClass->GetDataTypeIndex(dataName));
+		}
+
+		bool Prepare(const ScriptClass* pClass, Atom dataName)
+		{
+			DSR_ASSERT(pClass);
+			return PrepareIndex(pClass, pClass->GetDataTypeIndex(dataName));
+		}
+
+		bool IsPrepared() const { return m_pClass != 0; }
+		const ScriptClass* GetScriptClassPtr() const { return m_pClass; }
+		uint32 GetDataIndex() const { DSR_ASSERT(m_pClass); return m_dataIdx; }
+		VMDataTypeEnum GetType() const { DSR_ASSERT(m_pClass); return m_type; }
+
+		int32 GetInt(const ScriptInstance* pInstance) const { DSR_ASSERT(m_type == VMDATATYPE_INT); return *GetDataPtr(pInstance); }
+		float GetFloat(const ScriptInstance* pInstance) const { DSR_ASSERT(m_type == VMDATATYPE_FLOAT); return *((const float*) GetDataPtr(pInstance)); }
+		bool GetBool(const ScriptInstance* pInstance) const { DSR_ASSERT(m_type == VMDATATYPE_BOOL); return *GetDataPtr(pInstance) != 0; }
+
+		void Set(ScriptInstance* pInstance, int32 val) const { DSR_ASSERT(m_type == VMDATATYPE_INT); *GetDataPtr(pInstance) = val; }
+		void Set(ScriptInstance* pInstance, float val) const { DSR_ASSERT(m_type == VMDATATYPE_FLOAT); *GetDataPtr(pInstance) = *((int32*) &val); }
+		void Set(ScriptInstance* pInstance, bool val) const { DSR_ASSERT(m_type == VMDATATYPE_BOOL); *GetDataPtr(pInstance) = val ? 1 : 0; }
+
+	private:
+		bool PrepareIndex(const ScriptClass* pClass, int32 dataIdx)
+		{
+			m_pClass = 0;
+			if (dataIdx < 0)
+				return false;
+
+			//instance handles are reference counted, they stay with the scripts
+			const VMDataType type = pClass->GetDataTypePtr(dataIdx)->GetVMDataType();
+			if (type.IsNative())
+				return false;
+
+			m_pClass = pClass;
+			m_dataIdx = (uint32) dataIdx;
+			m_type = type.GetVMDataTypeEnum();
+			return true;
+		}
+
+		int32* GetDataPtr(const ScriptInstance* pInstance) const
+		{
+			DSR_ASSERT(m_pClass);
+			DSR_ASSERT(pInstance);
+			DSR_ASSERT(pInstance->GetScriptClassPtr()->IsA(m_pClass));
+			return const_cast<int32*>(pInstance->GetInstanceData()) + m_dataIdx;
+		}
+
+	private:
+		const ScriptClass* m_pClass;
+		uint32 m_dataIdx;
+		VMDataTypeEnum m_type;
+	};
+}
+
+#endif
@@ -0,0 +1,228 @@
+#include "DSREventDispatcher.h"
+
+#include "DSRScriptManager.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptInstance.h"
+#include "DSRNativeBinding.h"
+
+namespace dsr
+{
+	namespace
+	{
+		/// makes room for size elements, growing by doubling
+		template <class T> void Reserve(Array<T>& array, uint32 used, uint32 size)
+		{
+			if (size <= array.size())
+				return;
+
+			uint32 newSize = array.size() > 0 ? array.size() * 2 : 16;
+			while (newSize < size)
+				newSize *= 2;
+
+			Array<T> grown(newSize);
+			for (uint32 i=0; i<used; ++i)
+				grown[i] = array[i];
+			array = grown;
+		}
+	}
+
+	EventDispatcher::EventDispatcher()
+	: m_numEvents(0), m_built(false), m_numClasses(0), m_numPosted(0), m_numArgs(0), m_dispatching(false),
+		m_resetPending(false)
+	{
+	}
+
+	EventDispatcher::~EventDispatcher()
+	{
+		Reset();
+	}
+
+	uint32 EventDispatcher::AddEvent(const char* name, uint32 numArgs, const VMDataTypeEnum* pArgTypes)
+	{
+		DSR_ASSERT(name);
+		DSR_ASSERT(numArgs <= MAX_ARGS);
+		DSR_ASSERT(numArgs == 0 || pArgTypes);
+
+		const Atom atom = ScriptManagerPtr()->GetAtomTable().Add(name);
+		for (uint32 i=0; i<m_numEvents; ++i)
+		{
+			if (m_events[i].name == atom)
+			{
+				DSR_ASSERT(m_events[i].numArgs == numArgs);
+				return i;
+			}
+		}
+
+		Reserve(m_events, m_numEvents, m_numEvents + 1);
+		Event& event = m_events[m_numEvents];
+		event.name = atom;
+		event.numArgs = numArgs;
+		for (uint32 i=0; i<numArgs; ++i)
+		{
+			DSR_ASSERT(pArgTypes[i] == VMDATATYPE_INT || pArgTypes[i] == VMDATATYPE_FLOAT || pArgTypes[i] == VMDATATYPE_BOOL);
+			event.argTypes[i] = pArgTypes[i];
+		}
+
+		//the classes get a slot for it
+		Reset();
+		return m_numEvents++;
+	}
+
+	const FunctionImplementation* EventDispatcher::GetHandlerPtr(const ScriptClass* pClass, uint32 eventId)
+	{
+		DSR_ASSERT(eventId < m_numEvents);
+		if (!m_built)
+			Build();
+
+		for (uint32 c=0; c<m_numClasses; ++c)
+		{
+			if (m_classes[c]->pClass == pClass)
+				return m_classes[c]->handlers[eventId];
+		}
+
+		return 0;
+	}
+
+	void EventDispatcher::Post(uint32 eventId, const VMData* pArgs)
+	{
+		DSR_ASSERT(eventId < m_numEvents);
+		const Event& event = m_events[eventId];
+		DSR_ASSERT(event.numArgs == 0 || pArgs);
+
+		Reserve(m_posted, m_numPosted, m_numPosted + 1);
+		m_posted[m_numPosted].eventId = eventId;
+		m_posted[m_numPosted].firstArg = m_numArgs;
+		++m_numPosted;
+
+		Reserve(m_args, m_numArgs, m_numArgs + event.numArgs);
+		for (uint32 i=0; i<event.numArgs; ++i)
+		{
+			DSR_ASSERT(pArgs[i].GetVMDataType().GetVMDataTypeEnum() == event.argTypes[i]);
+			m_args[m_numArgs++] = pArgs[i];
+		}
+	}
+
+	uint32 EventDispatcher::Dispatch()
+	{
+		DSR_ASSERT(!m_dispatching);
+		if (!m_built)
+			Build();
+		m_dispatching = true;
+
+		//the events handlers post go after these
+		const uint32 numPosted = m_numPosted;
+		uint32 numCalls = 0;
+		VMData args[MAX_ARGS];
+		VMData result;
+		for (uint32 c=0; c<m_numClasses; ++c)
+		{
+			const ClassHandlers& classHandlers = *m_classes[c];
+			const ClassHeap& classHeap = classHandlers.pClass->GetClassHeap();
+			if (classHeap.GetNumInstances() == 0)
+				continue;
+
+			//the instances there are now, handlers may create or delete some
+			const uint32 numInstances = classHeap.GetNumInstances();
+			Reserve(m_instances, 0, numInstances);
+			for (uint32 i=0; i<numInstances; ++i)
+				m_instances[i] = classHeap.GetInstancePtr(i)->GetHandlePtr();
+
+			for (uint32 p=0; p<numPosted; ++p)
+			{
+				const Posted posted = m_posted[p];
+				const FunctionImplementation* pHandler = classHandlers.handlers[posted.eventId];
+				if (!pHandler)
+					continue;
+
+				//posting can move the queued arguments
+				const uint32 numArgs = m_events[posted.eventId].numArgs;
+				for (uint32 i=0; i<numArgs; ++i)
+					args[i] = m_args[posted.firstArg + i];
+
+				for (uint32 i=0; i<numInstances; ++i)
+				{
+					ScriptInstance* pInstance = m_instances[i]->get();
+					if (!pInstance)
+						continue;
+
+					pHandler->CallSpan(pInstance, args, numArgs, &result);
+					++numCalls;
+				}
+			}
+
+			for (uint32 i=0; i<numInstances; ++i)
+				m_instances[i] = 0;
+		}
+
+		//classes or events added meanwhile
+		m_dispatching = false;
+		if (m_resetPending)
+			Reset();
+
+		//keep the events posted meanwhile
+		const uint32 firstArg = numPosted < m_numPosted ? m_posted[numPosted].firstArg : m_numArgs;
+		for (uint32 i=numPosted; i<m_numPosted; ++i)
+		{
+			m_posted[i - numPosted] = m_posted[i];
+			m_posted[i - numPosted].firstArg -= firstArg;
+		}
+		for (uint32 i=firstArg; i<m_numArgs; ++i)
+			m_args[i - firstArg] = m_args[i];
+		for (uint32 i=m_numArgs - firstArg; i<m_numArgs; ++i)
+			m_args[i].Clear();
+		m_numPosted -= numPosted;
+		m_numArgs -= firstArg;
+
+		return numCalls;
+	}
+
+	void EventDispatcher::Reset()
+	{
+		//Dispatch still uses the handlers
+		m_resetPending = m_dispatching;
+		if (m_dispatching)
+			return;
+
+		for (uint32 c=0; c<m_numClasses; ++c)
+			delete m_classes[c];
+		m_classes.clear();
+		m_numClasses = 0;
+		m_built = false;
+	}
+
+	void EventDispatcher::Build()
+	{
+		Reset();
+
+		const List<ScriptClass*>& classes = ScriptManagerPtr()->m_scriptClasses;
+		for (List<ScriptClass*>::const_iterator it = classes.begin(); it != classes.end(); ++it)
+		{
+			ClassHandlers* pClassHandlers = 0;
+			for (uint32 e=0; e<m_numEvents; ++e)
+			{
+				const FunctionImplementation* pHandler = FindHandler(*it, m_events[e]);
+				if (!pHandler)
+					continue;
+
+				if (!pClassHandlers)
+				{
+					pClassHandlers = new ClassHandlers(*it, m_numEvents);
+					Reserve(m_classes, m_numClasses, m_numClasses + 1);
+					m_classes[m_numClasses++] = pClassHandlers;
+				}
+				pClassHandlers->handlers[e] = pHandler;
+			}
+		}
+
+		m_built = true;
+	}
+
+	const FunctionImplementation* EventDispatcher::FindHandler(const ScriptClass* pClass, const Event& event) const
+	{
+		const int32 fncIdx = pClass->GetFunctionVTableIndex(event.name);
+		if (fncIdx < 0 || !NativeBinding::Matches(*pClass->GetFunctionDefinitionPtr(fncIdx), VMDATATYPE_VOID, event.numArgs, event.argTypes))
+			return 0;
+
+		return pClass->GetFunctionImplementationPtr(fncIdx);
+	}
+}
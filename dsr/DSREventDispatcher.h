@@ -0,0 +1,122 @@
+
+#if !defined(DSR_EVENTDISPATCHER_H_)
+#define DSR_EVENTDISPATCHER_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRArray.h"
+#include "DSRVMData.h"
+#include "DSRVMDataType.h"
+#include "DSRAtomTable.h"
+#include "DSRHandleTypedefs.h"
+
+namespace dsr
+{
+	class ScriptClass;
+	class FunctionImplementation;
+
+	//------------------------------------------------------------------------------------
+	/// Broadcasts events to all instances with a handler for them, e.g. OnDamage(int).  A
+	/// handler is a void function named like the event, with the event's argument types.
+	/// The handler of each class is looked up once, classes without any aren't visited.
+	///
+	/// The host posts events, Dispatch then delivers the queued ones a class at a time: the
+	/// instances of a class get all the events it handles before the next class's do, so
+	/// the same handlers run one after the other.  Each instance gets the events in the order
+	/// they were posted.  Events posted by handlers wait for the next Dispatch, and so do
+	/// instances they create.  Instances they delete don't get the remaining events.
+	/// Events and classes added by handlers get their handlers after the Dispatch.
+	class EventDispatcher
+	{
+		DSR_NOCOPY(EventDispatcher)
+	public:
+		DSR_NEWDELETE(EventDispatcher)
+
+		enum
+		{
+			MAX_ARGS = 6,
+		};
+
+		EventDispatcher();
+		~EventDispatcher();
+
+		/// Id of the event handled by the functions named name.  Arguments are int, float
+		/// or bool.  Adding a name again returns the same id.
+		uint32 AddEvent(const char* name, uint32 numArgs = 0, const VMDataTypeEnum* pArgTypes = 0);
+		uint32 GetNumEvents() const { return m_numEvents; }
+		/// handler of the event the instances of pClass run, 0 if they don't have one
+		const FunctionImplementation* GetHandlerPtr(const ScriptClass* pClass, uint32 eventId);
+
+		/// Queues an event with the number of arguments it was added with
+		void Post(uint32 eventId, const VMData* pArgs = 0);
+		uint32 GetNumPosted() const { return m_numPosted; }
+		/// Delivers the events posted so far.  Returns the number of handlers called.  Not
+		/// reentrant, handlers may not dispatch.
+		uint32 Dispatch();
+
+		/// Classes were added or removed, the handlers are looked up again, after the Dispatch
+		/// if it's running.  Should only get called by ScriptManager
+		void Reset();
+
+	private:
+		class Event
+		{
+		public:
+			DSR_NEWDELETE(Event)
+
+			Event() : name(NULL_ATOM), numArgs(0) {}
+
+			Atom name;
+			uint32 numArgs;
+			VMDataTypeEnum argTypes[MAX_ARGS];
+		};
+
+		/// handler of each event, for a class with at least one
+		class ClassHandlers
+		{
+			DSR_NOCOPY(ClassHandlers)
+		public:
+			DSR_NEWDELETE(ClassHandlers)
+
+			ClassHandlers(const ScriptClass* pClass, uint32 numEvents) : pClass(pClass), handlers(numEvents) {}
+
+			const ScriptClass* pClass;
+			Array<const FunctionImplementation*> handlers;
+		};
+
+		class Posted
+		{
+		public:
+			DSR_NEWDELETE(Posted)
+
+			Posted() : eventId(0), firstArg(0) {}
+
+			uint32 eventId;
+			uint32 firstArg;
+		};
+
+		void Build();
+		const FunctionImplementation* FindHandler(const ScriptClass* pClass, const Event& event) const;
+
+	private:
+		Array<Event> m_events;
+		uint32 m_numEvents;
+		/// the classes with handlers, filled on the first use after a Reset
+		bool m_built;
+		Array<ClassHandlers*> m_classes;
+		uint32 m_numClasses;
+		/// events posted and their arguments, one after the other
+		Array<Posted> m_posted;
+		uint32 m_numPosted;
+		VMDataArray m_args;
+		uint32 m_numArgs;
+		/// the instances of the class Dispatch is at
+		Array<ScriptInstanceHandleCPtr> m_instances;
+		bool m_dispatching;
+		bool m_resetPending;
+	};
+}
+
+#endif
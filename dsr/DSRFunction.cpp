@@ -1,18 +1,56 @@
 
 #include "DSRFunction.h"
 
+#include "DSRCompiledFunction.h"
+#include "DSRNativeBinding.h"
 #include "DSRHandleTypedefs.h"
 #include "DSRVMData.h"
 #include "DSRScriptInstance.h"
 #include "DSRScriptClass.h"
 #include "DSRScriptManager.h"
+#include "DSRVMStack.h"
 
 namespace dsr
 {
+	NativeFunctionImplementation::~NativeFunctionImplementation()
+	{
+		delete m_pBinding;
+	}
+
 	void NativeFunctionImplementation::Call(ScriptInstance* pInstance, VMDataArray& args, VMData* retVal) const
 	{
-		DSR_ASSERT(m_nativeFnc);
-		m_nativeFnc(pInstance, args, retVal);
+		if (m_nativeFnc)
+		{
+			m_nativeFnc(pInstance, args, retVal);
+			return;
+		}
+
+		CallSpan(pInstance, args.size() > 0 ? &args[0] : 0, args.size(), retVal);
+	}
+
+	void NativeFunctionImplementation::CallSpan(ScriptInstance* pInstance, const VMData* pArgs, uint32 numArgs, VMData* pResult) const
+	{
+		DSR_ASSERT(numArgs == GetFunctionDefinitionPtr()->GetNumArgs());
+		if (m_spanFnc)
+		{
+			m_spanFnc(pInstance, pArgs, numArgs, pResult);
+		}
+		else if (m_pBinding)
+		{
+			m_pBinding->Call(pInstance, pArgs, pResult);
+		}
+		else
+		{
+			DSR_ASSERT(m_nativeFnc);
+			VMDataArray args;
+			args.resize(numArgs);
+			for (uint32 i=0; i<numArgs; ++i)
+				args[i] = pArgs[i];
+
+			VMData retVal;
+			m_nativeFnc(pInstance, args, &retVal);
+			*pResult = retVal;
+		}
 	}
 
 	//-------------------------------------------------------------------------
@@ -53,56 +91,232 @@ namespace dsr
 		*pStack = data;
 	}
 
+	ScriptedFunctionImplementation::ScriptedFunctionImplementation()
+	: m_maxStackSize(0), m_pCompiledFnc(0)
+#if DSR_JIT
+	, m_numCalls(0), m_pJitFnc(0)
+#endif
+	{
+	}
+
 	void ScriptedFunctionImplementation::Call(ScriptInstance* pInstance, VMDataArray& args, VMData* retVal) const
+	{
+		CallSpan(pInstance, args.size() > 0 ? &args[0] : 0, args.size(), retVal);
+	}
+
+	void ScriptedFunctionImplementation::CallSpan(ScriptInstance* pInstance, const VMData* pArgs, uint32 numArgs, VMData* pResult) const
+	{
+		DSR_ASSERT(pInstance);
+		DSR_ASSERT(GetFunctionDefinitionPtr()->GetNumArgs() == numArgs);
+		DSR_ASSERT(pResult);
+
+		//the host or a native function calls in, the frame goes on top of the running ones
+		VMStack& vmStack = ScriptManagerPtr()->GetVMStack();
+		if (m_pCompiledFnc && vmStack.CanRunTranslated())
+		{
+			//the translation's frame only counts toward the limits.  nested too deep, the
+			//bytecode runs below
+			if (!vmStack.PushFrame(this, pInstance, vmStack.GetNumValues(), 0, 0))
+				return;
+
+			VMDataArray args;
+			args.resize(numArgs);
+			for (uint32 i=0; i<numArgs; ++i)
+				args[i] = pArgs[i];
+
+			++vmStack.m_translatedDepth;
+			m_pCompiledFnc(pInstance, args, pResult);
+			--vmStack.m_translatedDepth;
+			vmStack.PopFrame();
+			return;
+		}
+#if DSR_JIT
+		//the Jit pushes the compiled function's frame.  past its depth the bytecode runs
+		if (GetJitFunction() && ScriptManagerPtr()->GetJit().CanInvoke())
+		{
+			const FunctionDefinition* pDef = GetFunctionDefinitionPtr();
+			uint32 rawArgs[Jit::MAX_ARGS];
+			for (uint32 i=0; i<numArgs; ++i)
+				rawArgs[i] = Jit::ToRaw(pArgs[i]);
+
+			uint32 result;
+			if (ScriptManagerPtr()->GetJit().Invoke(this, pInstance, rawArgs, &result))
+				Jit::FromRaw(result, pDef->GetReturnVMDataType(), pResult);
+			return;
+		}
+#endif
+		if (!Enter(vmStack, pInstance, pArgs, numArgs))
+			return;
+
+		Execute(vmStack, vmStack.GetNumFrames() - 1, pResult);
+		DSR_ASSERT(!vmStack.IsSuspended());
+	}
+
+	void ScriptedFunctionImplementation::Start(VMStack& vmStack, ScriptInstance* pInstance, VMDataArray& args, VMData* retVal) const
 	{
 		DSR_ASSERT(pInstance);
 		DSR_ASSERT(GetFunctionDefinitionPtr()->GetNumArgs() == args.size());
 		DSR_ASSERT(retVal);
+		DSR_ASSERT(vmStack.GetNumFrames() == 0);
 
-		uint32 pc = 0;
-		DSR_ASSERT(pc >= 0 && pc < m_vmcode.size());
+		if (!Enter(vmStack, pInstance, args.size() > 0 ? &args[0] : 0, args.size()))
+			return;
+
+		Execute(vmStack, 0, retVal);
+	}
+
+	void ScriptedFunctionImplementation::Resume(VMStack& vmStack, VMData* retVal)
+	{
+		DSR_ASSERT(vmStack.IsSuspended());
+		DSR_ASSERT(retVal);
+
+		vmStack.m_suspended = false;
+		Execute(vmStack, 0, retVal);
+	}
+
+	uint32 ScriptedFunctionImplementation::GetCodeHash() const
+	{
+		//same words dsc hashes when it translates the function
+		uint32 hash = VMCODEHASH_SEED;
+		for (uint32 i=0; i<m_vmcode.size(); ++i)
+			hash = HashVMCode(hash, m_vmcode[i]);
+
+		const FunctionDefinition* pDef = GetFunctionDefinitionPtr();
+		hash = HashVMCode(hash, pDef->GetReturnVMDataType().GetVMDataTypeEnum());
+		hash = HashVMCode(hash, pDef->GetNumArgs());
+		for (uint32 i=0; i<pDef->GetNumArgs(); ++i)
+			hash = HashVMCode(hash, pDef->GetArgVMDataType(i).GetVMDataTypeEnum());
+		hash = HashVMCode(hash, m_locals.size());
+		for (uint32 i=0; i<m_locals.size(); ++i)
+			hash = HashVMCode(hash, m_locals[i].GetVMDataTypeEnum());
+		return hash;
+	}
+
+#if DSR_JIT
+	JitFunction* ScriptedFunctionImplementation::GetJitFunction() const
+	{
+		//compiled once, whether it worked or not.  translated functions don't need it.
+		if (m_pCompiledFnc)
+			return 0;
+
+		const uint32 threshold = ScriptManagerPtr()->GetJit().GetThreshold();
+		if (m_numCalls < threshold && ++m_numCalls == threshold)
+			m_pJitFnc = ScriptManagerPtr()->GetJit().Compile(this);
+		return m_pJitFnc;
+	}
+#endif
+
+	VMFrame* ScriptedFunctionImplementation::Enter(VMStack& vmStack, ScriptInstance* pInstance, const VMData* pArgs, uint32 numArgs) const
+	{
+		const uint32 base = vmStack.GetNumValues();
+		VMFrame* pFrame = PushFrame(vmStack, pInstance, base);
+		if (pFrame)
+		{
+			VMData* pFrameArgs = vmStack.GetValuePtr(base);
+			for (uint32 i=0; i<numArgs; ++i)
+				pFrameArgs[i] = pArgs[i];
+		}
+		return pFrame;
+	}
+
+	VMFrame* ScriptedFunctionImplementation::PushFrame(VMStack& vmStack, ScriptInstance* pInstance, uint32 base) const
+	{
+		const uint32 numData = GetFunctionDefinitionPtr()->GetNumArgs() + m_locals.size();
+		VMFrame* pFrame = vmStack.PushFrame(this, pInstance, base, numData, numData + m_maxStackSize);
+		if (pFrame)
+			InitLocals(vmStack.GetValuePtr(base + GetFunctionDefinitionPtr()->GetNumArgs()));
+		return pFrame;
+	}
 
-		//create & initialize local data
-		VMDataArray locals;
-		locals.resize(m_locals.size());
+	VMFrame* ScriptedFunctionImplementation::ReplaceFrame(VMStack& vmStack) const
+	{
+		const uint32 numData = GetFunctionDefinitionPtr()->GetNumArgs() + m_locals.size();
+		VMFrame* pFrame = vmStack.ReplaceFrame(this, numData, numData + m_maxStackSize);
+		if (pFrame)
+			InitLocals(vmStack.GetValuePtr(pFrame->GetBase() + GetFunctionDefinitionPtr()->GetNumArgs()));
+		return pFrame;
+	}
+
+	const ScriptClass* ScriptedFunctionImplementation::GetNewClassPtr(uint32 idx) const
+	{
+		DSR_ASSERT(idx < GetNumNewClassNames());
+		if (m_newClasses.empty())
+			m_newClasses.resize(GetNumNewClassNames());
+
+		if (!m_newClasses[idx])
+			m_newClasses[idx] = ScriptManagerPtr()->GetScriptClassPtr(GetNewClassName(idx));
+		DSR_ASSERT(m_newClasses[idx]);
+		return m_newClasses[idx];
+	}
+
+	void ScriptedFunctionImplementation::InitLocals(VMData* pLocals) const
+	{
 		for (uint32 i=0; i<m_locals.size(); ++i)
 		{
 			switch (m_locals[i].GetVMDataTypeEnum())
 			{
 			case VMDATATYPE_NATIVE:
-				locals[i].Set(new ScriptInstanceHandle(0), m_locals[i]);
+				pLocals[i].Set(new ScriptInstanceHandle(0), m_locals[i]);
 				break;
 			case VMDATATYPE_FLOAT:
-				locals[i].Set(0.0f);
+				pLocals[i].Set(0.0f);
 				break;
 			case VMDATATYPE_INT:
-				locals[i].Set(0);
+				pLocals[i].Set(0);
 				break;
 			case VMDATATYPE_BOOL:
-				locals[i].Set(false);
+				pLocals[i].Set(false);
 				break;
 			default:
 				DSR_ASSERT(false);
 				break;
 			}
 		}
+	}
 
-		//create stack
-		VMDataArray stack;
-		stack.resize(m_maxStackSize);
+	void ScriptedFunctionImplementation::Execute(VMStack& vmStack, uint32 entryFrame, VMData* retVal)
+	{
+		DSR_ASSERT(entryFrame < vmStack.GetNumFrames());
+		DSR_ASSERT(!vmStack.IsSuspended());
+		DSR_ASSERT(retVal);
 
-		//get data stack ptr
+		//registers of the running frame
+		VMFrame* pFrame = 0;
+		const ScriptedFunctionImplementation* pImpl = 0;
+		const VMCodeBlock* pCode = 0;
+		ScriptInstance* pInstance = 0;
+		const ScriptClass* pExecutingST = 0;
+		VMData* pArgs = 0;
+		VMData* pLocals = 0;
 		VMData* pDataStack = 0;
-		if (!stack.empty())
-			pDataStack = &stack[0];
+		uint32 pc = 0;
 
-		//get instance's script type
-		const ScriptClass* pExecutingST = pInstance->GetScriptClassPtr();
+		//function a call instruction continues with, and how
+		const FunctionImplementation* pCallee = 0;
+		ScriptInstance* pCalleeInstance = 0;
+		uint32 numCalleeArgs = 0;
+		bool tailCall = false;
 
-		bool done = false;
-		while (!done)
+		bool loadFrame = true;
+		while (true)
 		{
-			VMBytecode curCode = m_vmcode[pc];
+			if (loadFrame)
+			{
+				//switch to the frame on top, after a call or a return
+				pFrame = &vmStack.GetTopFrame();
+				pImpl = pFrame->m_pImpl;
+				pCode = &pImpl->m_vmcode;
+				pInstance = pFrame->m_pInstance;
+				pExecutingST = pInstance->GetScriptClassPtr();
+				pArgs = vmStack.GetValuePtr(pFrame->m_base);
+				pLocals = pArgs + pImpl->GetFunctionDefinitionPtr()->GetNumArgs();
+				pDataStack = vmStack.GetValuePtr(pFrame->m_top);
+				pc = pFrame->m_pc;
+				loadFrame = false;
+			}
+
+			DSR_ASSERT(pc >= 0 && pc < pCode->size());
+			VMBytecode curCode = (*pCode)[pc];
 
 			switch (ExtractVMInstruction(curCode))
 			{
@@ -112,10 +326,10 @@ namespace dsr
 			case VMI_CALLC_PUSHED_G:
 				{
 					++pc;
-					DSR_ASSERT(pc >= 0 && pc < m_vmcode.size());
+					DSR_ASSERT(pc >= 0 && pc < pCode->size());
 
 					//get con idx
-					const uint32 fnIdx = m_vmcode[pc];
+					const uint32 fnIdx = (*pCode)[pc];
 
 					//pop value of the stack
 					VMData val = *pDataStack;
@@ -127,89 +341,42 @@ namespace dsr
 					DSR_ASSERT(pPushedT);
 					DSR_ASSERT(pPushedI && pPushedI->GetScriptClassPtr()->IsA(pPushedT));
 
-					//get num args
+					//call constructor
 					DSR_ASSERT(fnIdx < pPushedT->GetNumConstructors());
-					const uint32 numArgs = pPushedT->GetConstructorDefinitionPtr(fnIdx)->GetNumArgs();
-
-					//get args
-					VMDataArray args;
-					args.resize(numArgs);
-					VMData* pArgs = pDataStack - numArgs + 1;
-					DSR_ASSERT(!stack.empty() && pArgs >= &stack[0]);
-					for (uint32 i=0; i<numArgs; ++i)
-					{
-						args[i] = *pArgs;
-						++pArgs;
-					}
-
-					//set return value
-					VMData retVal;
-
-					//call function
-					pPushedI->CallConstructor(fnIdx, args, &retVal);
-
-					//pop parameters off the stack
-					Pop(pDataStack, numArgs);
-
-					//push return value on the stack
-					Push(pDataStack, retVal);
+					pCallee = pPushedI->GetScriptClassPtr()->GetConstructorImplementationPtr(fnIdx);
+					pCalleeInstance = pPushedI;
+					numCalleeArgs = pPushedT->GetConstructorDefinitionPtr(fnIdx)->GetNumArgs();
 				}
 				break;
 
 			case VMI_CALLC_SELF_SUPER:
 				{
 					++pc;
-					DSR_ASSERT(pc >= 0 && pc < m_vmcode.size());
+					DSR_ASSERT(pc >= 0 && pc < pCode->size());
 
 					//get super script type
-					ScriptClass* pSuperScriptClass = GetScriptClassPtr()->GetSuperPtr();
+					ScriptClass* pSuperScriptClass = pImpl->GetScriptClassPtr()->GetSuperPtr();
 					DSR_ASSERT(pSuperScriptClass);
 
 					//get fn idx
-					const uint32 fnIdx = m_vmcode[pc];
+					const uint32 fnIdx = (*pCode)[pc];
 					DSR_ASSERT(fnIdx < pSuperScriptClass->GetNumConstructors());
 
-					//get function
-					const FunctionDefinition* pFncDef = pSuperScriptClass->GetConstructorDefinitionPtr(fnIdx);
-					const FunctionImplementation* pFncImp = pSuperScriptClass->GetConstructorImplementationPtr(fnIdx);
-					DSR_ASSERT(pFncDef);
-					DSR_ASSERT(pFncImp);
-
-					//get num args
-					const uint32 numArgs = pFncDef->GetNumArgs();
-
-					//get args
-					VMDataArray args;
-					args.resize(numArgs);
-					VMData* pArgs = pDataStack - numArgs + 1;
-					DSR_ASSERT(!stack.empty() && pArgs >= &stack[0]);
-					for (uint32 i=0; i<numArgs; ++i)
-					{
-						args[i] = *pArgs;
-						++pArgs;
-					}
-
-					//set return value
-					VMData retVal;
-
-					//call function
-					pInstance->CallFunction(pFncImp, args, &retVal);
-
-					//pop parameters off the stack
-					Pop(pDataStack, numArgs);
-
-					//push return value on the stack
-					Push(pDataStack, retVal);
+					//call constructor
+					pCallee = pSuperScriptClass->GetConstructorImplementationPtr(fnIdx);
+					DSR_ASSERT(pCallee);
+					pCalleeInstance = pInstance;
+					numCalleeArgs = pSuperScriptClass->GetConstructorDefinitionPtr(fnIdx)->GetNumArgs();
 				}
 				break;
 
 			case VMI_CALLF_PUSHED_G:
 				{
 					++pc;
-					DSR_ASSERT(pc >= 0 && pc < m_vmcode.size());
+					DSR_ASSERT(pc >= 0 && pc < pCode->size());
 
 					//get fn idx
-					const uint32 fnIdx = m_vmcode[pc];
+					const uint32 fnIdx = (*pCode)[pc];
 
 					//pop value of the stack
 					VMData val = *pDataStack;
@@ -225,29 +392,17 @@ namespace dsr
 					DSR_ASSERT(fnIdx < pPushedT->GetNumFunctions());
 					const uint32 numArgs = pPushedT->GetFunctionDefinitionPtr(fnIdx)->GetNumArgs();
 
-					//get args
-					VMDataArray args;
-					args.resize(numArgs);
-					VMData* pArgs = pDataStack - numArgs + 1;
-					DSR_ASSERT(!stack.empty() && pArgs >= &stack[0]);
-					for (uint32 i=0; i<numArgs; ++i)
-					{
-						args[i] = *pArgs;
-						++pArgs;
-					}
-
-					//set return value
-					VMData retVal;
-
 					//call function
 					if (pPushedI)
 					{
-						//get function
-						pPushedI->CallFunction(fnIdx, args, &retVal);
+						pCallee = pPushedI->GetScriptClassPtr()->GetFunctionImplementationPtr(fnIdx);
+						pCalleeInstance = pPushedI;
+						numCalleeArgs = numArgs;
 					}
 					else
 					{
 						//script instance is 0, just fill in default 0 values
+						VMData retVal;
 						if (pPushedT->GetFunctionDefinitionPtr(fnIdx)->GetReturnVMDataType().IsNative())
 						{
 							retVal.Set(new ScriptInstanceHandle(0), pPushedT->GetFunctionDefinitionPtr(fnIdx)->GetReturnVMDataType());
@@ -256,113 +411,131 @@ namespace dsr
 						{
 							retVal.Set(0);
 						}
-					}
 
-					//pop parameters off the stack
-					Pop(pDataStack, numArgs);
+						//pop parameters off the stack
+						Pop(pDataStack, numArgs);
 
-					//push return value on the stack
-					Push(pDataStack, retVal);
+						//push return value on the stack
+						Push(pDataStack, retVal);
+					}
 				}
 				break;
 
 			case VMI_CALLF_SELF_G:
+			case VMI_TAILCALLF_SELF_G:
 				{
 					++pc;
-					DSR_ASSERT(pc >= 0 && pc < m_vmcode.size());
+					DSR_ASSERT(pc >= 0 && pc < pCode->size());
 
 					//get fn idx
-					const uint32 fnIdx = m_vmcode[pc];
+					const uint32 fnIdx = (*pCode)[pc];
 					DSR_ASSERT(fnIdx < pExecutingST->GetNumFunctions());
 
-					//get function
-					const FunctionDefinition* pFncDef = pExecutingST->GetFunctionDefinitionPtr(fnIdx);
-					DSR_ASSERT(pFncDef);
-
-					//get num args
-					const uint32 numArgs = pFncDef->GetNumArgs();
-
-					//get a pointer to the first parameter
-					//get args
-					VMDataArray args;
-					args.resize(numArgs);
-					VMData* pArgs = pDataStack - numArgs + 1;
-					DSR_ASSERT(!stack.empty() && pArgs >= &stack[0]);
-					for (uint32 i=0; i<numArgs; ++i)
-					{
-						args[i] = *pArgs;
-						++pArgs;
-					}
-
-					//set return value
-					VMData retVal;
-
 					//call function
-					pInstance->CallFunction(fnIdx, args, &retVal);
-
-					//pop parameters off the stack
-					Pop(pDataStack, numArgs);
-
-					//push return value on the stack
-					Push(pDataStack, retVal);
+					pCallee = pExecutingST->GetFunctionImplementationPtr(fnIdx);
+					DSR_ASSERT(pCallee);
+					pCalleeInstance = pInstance;
+					numCalleeArgs = pExecutingST->GetFunctionDefinitionPtr(fnIdx)->GetNumArgs();
+					tailCall = (ExtractVMInstruction(curCode) == VMI_TAILCALLF_SELF_G);
 				}
 				break;
 
 			case VMI_CALLF_SUPER_G:
+			case VMI_TAILCALLF_SUPER_G:
 				{
 					++pc;
-					DSR_ASSERT(pc >= 0 && pc < m_vmcode.size());
+					DSR_ASSERT(pc >= 0 && pc < pCode->size());
 
 					//get super script type
-					ScriptClass* pSuperScriptClass = GetScriptClassPtr()->GetSuperPtr();
+					ScriptClass* pSuperScriptClass = pImpl->GetScriptClassPtr()->GetSuperPtr();
 					DSR_ASSERT(pSuperScriptClass);
 
 					//get fn idx
-					const uint32 fnIdx = m_vmcode[pc];
+					const uint32 fnIdx = (*pCode)[pc];
 					DSR_ASSERT(fnIdx < pSuperScriptClass->GetNumFunctions());
 
-					//get function
-					const FunctionDefinition* pFncDef = pSuperScriptClass->GetFunctionDefinitionPtr(fnIdx);
-					const FunctionImplementation* pFncImp = pSuperScriptClass->GetFunctionImplementationPtr(fnIdx);
-					DSR_ASSERT(pFncDef);
-					DSR_ASSERT(pFncImp);
+					//call function
+					pCallee = pSuperScriptClass->GetFunctionImplementationPtr(fnIdx);
+					DSR_ASSERT(pCallee);
+					pCalleeInstance = pInstance;
+					numCalleeArgs = pSuperScriptClass->GetFunctionDefinitionPtr(fnIdx)->GetNumArgs();
+					tailCall = (ExtractVMInstruction(curCode) == VMI_TAILCALLF_SUPER_G);
+				}
+				break;
 
-					//get num args
-					const uint32 numArgs = pFncDef->GetNumArgs();
+			case VMI_CALLF_SELF_D:
+			case VMI_TAILCALLF_SELF_D:
+				{
+					++pc;
+					DSR_ASSERT(pc >= 0 && pc < pCode->size());
 
-					//get args
-					VMDataArray args;
-					args.resize(numArgs);
-					VMData* pArgs = pDataStack - numArgs + 1;
-					DSR_ASSERT(!stack.empty() && pArgs >= &stack[0]);
-					for (uint32 i=0; i<numArgs; ++i)
-					{
-						args[i] = *pArgs;
-						++pArgs;
-					}
+					//get function, no vtable lookup
+					const uint32 callIdx = (*pCode)[pc];
+					DSR_ASSERT(callIdx < pImpl->GetNumDirectCalls());
 
-					//set return value
-					VMData retVal;
+					//call function
+					pCallee = pImpl->GetDirectCallPtr(callIdx);
+					DSR_ASSERT(pCallee);
+					pCalleeInstance = pInstance;
+					numCalleeArgs = pCallee->GetFunctionDefinitionPtr()->GetNumArgs();
+					tailCall = (ExtractVMInstruction(curCode) == VMI_TAILCALLF_SELF_D);
+				}
+				break;
+
+			case VMI_CALLF_PUSHED_D:
+				{
+					++pc;
+					DSR_ASSERT(pc >= 0 && pc < pCode->size());
+
+					//get function, no vtable lookup
+					const uint32 callIdx = (*pCode)[pc];
+					DSR_ASSERT(callIdx < pImpl->GetNumDirectCalls());
+					const FunctionImplementation* pFncImp = pImpl->GetDirectCallPtr(callIdx);
+					DSR_ASSERT(pFncImp);
+					const FunctionDefinition* pFncDef = pFncImp->GetFunctionDefinitionPtr();
+
+					//pop value of the stack
+					VMData val = *pDataStack;
+					Pop(pDataStack);
+
+					//get instance
+					ScriptInstance* pPushedI = GetScriptInstancePtr(val);
 
 					//call function
-					pInstance->CallFunction(pFncImp, args, &retVal);
+					if (pPushedI)
+					{
+						pCallee = pFncImp;
+						pCalleeInstance = pPushedI;
+						numCalleeArgs = pFncDef->GetNumArgs();
+					}
+					else
+					{
+						//script instance is 0, just fill in default 0 values
+						VMData retVal;
+						if (pFncDef->GetReturnVMDataType().IsNative())
+						{
+							retVal.Set(new ScriptInstanceHandle(0), pFncDef->GetReturnVMDataType());
+						}
+						else
+						{
+							retVal.Set(0);
+						}
 
-					//pop parameters off the stack
-					Pop(pDataStack, numArgs);
+						//pop parameters off the stack
+						Pop(pDataStack, pFncDef->GetNumArgs());
 
-					//push return value on the stack
-					Push(pDataStack, retVal);
+						//push return value on the stack
+						Push(pDataStack, retVal);
+					}
 				}
 				break;
-
 			case VMI_NEW:
 				{
 					uint32 classNameIdx = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(classNameIdx < GetNumNewClassNames());
-					const ScriptClass* pClass = ScriptManagerPtr()->GetScriptClassPtr(GetNewClassName(classNameIdx));
-					DSR_ASSERT(pClass);
+					const ScriptClass* pClass = pImpl->GetNewClassPtr(classNameIdx);
 					ScriptInstance* pInst = pClass->CreateInstance();
 					DSR_ASSERT(pInst);
+					ScriptManagerPtr()->GetCollector().Add(pInst);
 
 					VMDataType dataType(pClass);
 					VMData data(pInst->GetHandlePtr(), dataType);
@@ -372,16 +545,53 @@ namespace dsr
 				}
 				break;
 
+			case VMI_ISN:
+				{
+					const ScriptClass* pClass = pImpl->GetNewClassPtr(ExtractUnsignedValue(curCode));
+					const ScriptInstance* pInst = pDataStack->GetScriptInstanceHandlePtr()->get();
+					const bool res = pInst && pInst->GetScriptClassPtr()->IsA(pClass);
+					pDataStack->Set(res);
+				}
+				break;
+
+			case VMI_CASTN:
+				{
+					//the instance keeps its handle, null gets a handle of its own
+					const ScriptClass* pClass = pImpl->GetNewClassPtr(ExtractUnsignedValue(curCode));
+					ScriptInstanceHandle* pHandle = pDataStack->GetScriptInstanceHandlePtr();
+					const ScriptInstance* pInst = pHandle->get();
+					if (pInst && pInst->GetScriptClassPtr()->IsA(pClass))
+						pDataStack->Set(pHandle, VMDataType(pClass));
+					else
+						pDataStack->Set(new ScriptInstanceHandle(0), VMDataType(pClass));
+				}
+				break;
+
 			case VMI_RET:
 				{
 					//get return value from the top of the stack
-					*retVal = *pDataStack;
+					VMData ret = *pDataStack;
 
 					//pop stack
 					Pop(pDataStack);
+					DSR_ASSERT(pDataStack == pLocals + pImpl->m_locals.size() - 1);
+
+					//pop frame
+					const uint32 base = pFrame->m_base;
+					const bool entry = (vmStack.GetNumFrames() - 1 == entryFrame);
+					vmStack.PopFrame();
 
 					//we are done
-					done = true;
+					if (entry)
+					{
+						*retVal = ret;
+						return;
+					}
+
+					//the caller continues with the return value in place of the arguments
+					*vmStack.GetValuePtr(base) = ret;
+					vmStack.GetTopFrame().m_top = base;
+					loadFrame = true;
 				}
 				break;
 
@@ -461,12 +671,12 @@ namespace dsr
 					VMData val = *pDataStack;
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
 
-					DSR_ASSERT(locals[dataOffset].GetVMDataType().GetVMDataTypeEnum()
+					DSR_ASSERT(pLocals[dataOffset].GetVMDataType().GetVMDataTypeEnum()
 						== val.GetVMDataType().GetVMDataTypeEnum());
 					DSR_ASSERT(!val.GetVMDataType().IsNative()
-						|| val.GetVMDataType().GetScriptClassPtr()->IsA(locals[dataOffset].GetVMDataType().GetScriptClassPtr()));
+						|| val.GetVMDataType().GetScriptClassPtr()->IsA(pLocals[dataOffset].GetVMDataType().GetScriptClassPtr()));
 
-					locals[dataOffset] = val;
+					pLocals[dataOffset] = val;
 					Pop(pDataStack);
 				}
 				break;
@@ -479,11 +689,11 @@ namespace dsr
 					VMData val = *pDataStack;
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
 
-					DSR_ASSERT(args[dataOffset].GetVMDataType().GetVMDataTypeEnum() == val.GetVMDataType().GetVMDataTypeEnum());
+					DSR_ASSERT(pArgs[dataOffset].GetVMDataType().GetVMDataTypeEnum() == val.GetVMDataType().GetVMDataTypeEnum());
 					DSR_ASSERT(!val.GetVMDataType().IsNative()
-						|| val.GetVMDataType().GetScriptClassPtr()->IsA(args[dataOffset].GetVMDataType().GetScriptClassPtr()));
+						|| val.GetVMDataType().GetScriptClassPtr()->IsA(pArgs[dataOffset].GetVMDataType().GetScriptClassPtr()));
 
-					args[dataOffset] = val;
+					pArgs[dataOffset] = val;
 					Pop(pDataStack);
 				}
 				break;
@@ -540,78 +750,78 @@ namespace dsr
 			case VMI_FETCHLF:
 				{
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(locals[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_FLOAT);
-					Push(pDataStack, locals[dataOffset]);
+					DSR_ASSERT(pLocals[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_FLOAT);
+					Push(pDataStack, pLocals[dataOffset]);
 				}
 				break;
 
 			case VMI_FETCHLI:
 				{
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(locals[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_INT);
-					Push(pDataStack, locals[dataOffset]);
+					DSR_ASSERT(pLocals[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_INT);
+					Push(pDataStack, pLocals[dataOffset]);
 				}
 				break;
 
 			case VMI_FETCHLB:
 				{
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(locals[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_BOOL);
-					Push(pDataStack, locals[dataOffset]);
+					DSR_ASSERT(pLocals[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_BOOL);
+					Push(pDataStack, pLocals[dataOffset]);
 				}
 				break;
 
 			case VMI_FETCHLN:
 				{
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(locals[dataOffset].GetVMDataType().IsNative());
-					Push(pDataStack, locals[dataOffset]);
+					DSR_ASSERT(pLocals[dataOffset].GetVMDataType().IsNative());
+					Push(pDataStack, pLocals[dataOffset]);
 				}
 				break;
 
 			case VMI_FETCHPF:
 				{
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(args[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_FLOAT);
-					Push(pDataStack, args[dataOffset]);
+					DSR_ASSERT(pArgs[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_FLOAT);
+					Push(pDataStack, pArgs[dataOffset]);
 				}
 				break;
 
 			case VMI_FETCHPI:
 				{
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(args[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_INT);
-					Push(pDataStack, args[dataOffset]);
+					DSR_ASSERT(pArgs[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_INT);
+					Push(pDataStack, pArgs[dataOffset]);
 				}
 				break;
 
 			case VMI_FETCHPB:
 				{
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(args[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_BOOL);
-					Push(pDataStack, args[dataOffset]);
+					DSR_ASSERT(pArgs[dataOffset].GetVMDataType().GetVMDataTypeEnum() == VMDATATYPE_BOOL);
+					Push(pDataStack, pArgs[dataOffset]);
 				}
 				break;
 
 			case VMI_FETCHPN:
 				{
 					const uint32 dataOffset = ExtractUnsignedValue(curCode);
-					DSR_ASSERT(args[dataOffset].GetVMDataType().IsNative());
-					Push(pDataStack, args[dataOffset]);
+					DSR_ASSERT(pArgs[dataOffset].GetVMDataType().IsNative());
+					Push(pDataStack, pArgs[dataOffset]);
 				}
 				break;
 
 			case VMI_PUSHF:
 				{
 					++pc;
-					Push(pDataStack, VMData(*((float*)&(m_vmcode[pc]))));
+					Push(pDataStack, VMData(*((float*)&((*pCode)[pc]))));
 				}
 				break;
 
 			case VMI_PUSHI:
 				{
 					++pc;
-					Push(pDataStack, VMData(*((int32*)&(m_vmcode[pc]))));
+					Push(pDataStack, VMData(*((int32*)&((*pCode)[pc]))));
 				}
 				break;
 
@@ -1050,14 +1260,120 @@ namespace dsr
 				{
 					//unimplemented instruction
 					DSR_ASSERT(false);
-					done = true;
+					vmStack.Abort(entryFrame);
+					return;
 				}
 				break;
 			};
 
 			++pc;
-		}
 
-		DSR_ASSERT(pDataStack == 0 || pDataStack == &stack[0]);
+			//script calls switch frames here, native ones return right away
+			if (pCallee)
+			{
+				VMData* pFirstArg = pDataStack - numCalleeArgs + 1;
+				if (pCallee->IsNative())
+				{
+					//call function, scripts it calls run on top of this frame.
+					//a tail call's VMI_RET comes next and returns the result.
+					pFrame->m_pc = pc;
+					pFrame->m_top = (uint32) (pDataStack - vmStack.GetValuePtr(0));
+
+					//the args are read where they are, the result goes to the first one's
+					//slot, which the frame reserves even without args
+					pCallee->CallSpan(pCalleeInstance, pFirstArg, numCalleeArgs, pFirstArg);
+					while (pDataStack > pFirstArg)
+						Pop(pDataStack);
+					pDataStack = pFirstArg;
+
+					//the native function suspended the scripts, they continue from here
+					if (vmStack.IsSuspended())
+					{
+						pFrame->m_top = (uint32) (pDataStack - vmStack.GetValuePtr(0));
+						return;
+					}
+				}
+				else if (&vmStack == &ScriptManagerPtr()->GetVMStack()
+					&& static_cast<const ScriptedFunctionImplementation*>(pCallee)->GetCompiledFunction()
+					&& vmStack.CanRunTranslated())
+				{
+					//translated callees run natively, up to the VMStack's depth.  an overflow
+					//in them aborts these scripts as well
+					VMDataArray args;
+					args.resize(numCalleeArgs);
+					for (uint32 i=0; i<numCalleeArgs; ++i)
+						args[i] = pFirstArg[i];
+
+					pFrame->m_pc = pc;
+					pFrame->m_top = (uint32) (pDataStack - vmStack.GetValuePtr(0));
+					VMData retVal;
+					if (!CallCompiled(pCallee, pCalleeInstance, args, &retVal))
+					{
+						vmStack.Abort(entryFrame);
+						return;
+					}
+
+					Pop(pDataStack, numCalleeArgs);
+					Push(pDataStack, retVal);
+				}
+#if DSR_JIT
+				else if (&vmStack == &ScriptManagerPtr()->GetVMStack()
+					&& static_cast<const ScriptedFunctionImplementation*>(pCallee)->GetJitFunction()
+					&& ScriptManagerPtr()->GetJit().CanInvoke())
+				{
+					//compiled callees run on the native stack, up to the Jit's depth.  a tail
+					//call's VMI_RET returns the result
+					uint32 args[Jit::MAX_ARGS];
+					for (uint32 i=0; i<numCalleeArgs; ++i)
+						args[i] = Jit::ToRaw(pFirstArg[i]);
+
+					pFrame->m_pc = pc;
+					pFrame->m_top = (uint32) (pDataStack - vmStack.GetValuePtr(0));
+					uint32 result;
+					if (!ScriptManagerPtr()->GetJit().Invoke(pCallee, pCalleeInstance, args, &result))
+					{
+						vmStack.Abort(entryFrame);
+						return;
+					}
+
+					Pop(pDataStack, numCalleeArgs);
+					VMData retVal;
+					Jit::FromRaw(result, pCallee->GetFunctionDefinitionPtr()->GetReturnVMDataType(), &retVal);
+					Push(pDataStack, retVal);
+				}
+#endif
+				else if (tailCall)
+				{
+					//the callee takes over the frame, arguments first
+					DSR_ASSERT(pCalleeInstance == pInstance);
+					for (uint32 i=0; i<numCalleeArgs; ++i)
+						pArgs[i] = pFirstArg[i];
+					for (VMData* pData = pArgs + numCalleeArgs; pData <= pDataStack; ++pData)
+						pData->Clear();
+
+					if (!static_cast<const ScriptedFunctionImplementation*>(pCallee)->ReplaceFrame(vmStack))
+					{
+						vmStack.Abort(entryFrame);
+						return;
+					}
+					loadFrame = true;
+				}
+				else
+				{
+					//the arguments on top of the stack start the callee's frame
+					pFrame->m_pc = pc;
+					const uint32 base = (uint32) (pFirstArg - vmStack.GetValuePtr(0));
+					if (!static_cast<const ScriptedFunctionImplementation*>(pCallee)->PushFrame(vmStack, pCalleeInstance, base))
+					{
+						vmStack.Abort(entryFrame);
+						return;
+					}
+					loadFrame = true;
+				}
+
+				pCallee = 0;
+				tailCall = false;
+			}
+		}
 	}
 }
\ No newline at end of file
@@ -6,11 +6,15 @@
 #include "DSRDataType.h"
 #include "DSRVMInstruction.h"
 #include "DSRVMData.h"
+#include "DSRJit.h"
 
 namespace dsr
 {
 	class ScriptInstance;
+	class NativeBinding;
 	class VMData;
+	class VMFrame;
+	class VMStack;
 
 	//------------------------------------------------------------------------------------
 	class FunctionDefinition
@@ -37,8 +41,12 @@ namespace dsr
 	public:
 		DSR_NEWDELETE(FunctionImplementation)
 
+		FunctionImplementation() : m_scriptClass(0), m_funcDef(0) {}
 		virtual ~FunctionImplementation() {}
 		virtual void Call(ScriptInstance* pInstance, VMDataArray& args, VMData* retVal) const = 0;
+		/// Call without an args array, with numArgs arguments from pArgs.  pResult can be
+		/// pArgs[0].
+		virtual void CallSpan(ScriptInstance* pInstance, const VMData* pArgs, uint32 numArgs, VMData* pResult) const = 0;
 		virtual bool IsNative() const = 0;
 		const ScriptClass* GetScriptClassPtr() const { return m_scriptClass; }
 		const FunctionDefinition* GetFunctionDefinitionPtr() const { return m_funcDef; }
@@ -55,18 +63,43 @@ namespace dsr
 	public:
 		DSR_NEWDELETE(NativeFunctionImplementation)
 		typedef void NativeScriptFunction(ScriptInstance* pInst, VMDataArray& args, VMData* retVal);
+		/// Reads numArgs arguments from pArgs where the caller has them, on the operand stack
+		/// for scripts, and sets pResult.  pResult can be pArgs[0], so the arguments have to be
+		/// read before the result is set.
+		typedef void NativeSpanFunction(ScriptInstance* pInst, const VMData* pArgs, uint32 numArgs, VMData* pResult);
 
+		NativeFunctionImplementation() : m_nativeFnc(0), m_spanFnc(0), m_pBinding(0) {}
+		virtual ~NativeFunctionImplementation();
 		virtual void Call(ScriptInstance* pInstance, VMDataArray& args, VMData* retVal) const;
+		/// only a NativeScriptFunction gets its arguments copied
+		virtual void CallSpan(ScriptInstance* pInstance, const VMData* pArgs, uint32 numArgs, VMData* pResult) const;
 		virtual bool IsNative() const { return true; }
 		void SetNativeScriptFunction(NativeScriptFunction* pFnc)
 		{
 			DSR_ASSERT(pFnc);
-			DSR_ASSERT(!m_nativeFnc);
+			DSR_ASSERT(!m_nativeFnc && !m_spanFnc && !m_pBinding);
 			m_nativeFnc = pFnc;
 		}
+		void SetNativeSpanFunction(NativeSpanFunction* pFnc)
+		{
+			DSR_ASSERT(pFnc);
+			DSR_ASSERT(!m_nativeFnc && !m_spanFnc && !m_pBinding);
+			m_spanFnc = pFnc;
+		}
+		/// takes over pBinding, see BindNative
+		void SetNativeBinding(NativeBinding* pBinding)
+		{
+			DSR_ASSERT(pBinding);
+			DSR_ASSERT(!m_nativeFnc && !m_spanFnc && !m_pBinding);
+			m_pBinding = pBinding;
+		}
+		/// typed binding the function calls, 0 if it calls a NativeScriptFunction
+		const NativeBinding* GetNativeBinding() const { return m_pBinding; }
 
 	private:
 		NativeScriptFunction* m_nativeFnc;
+		NativeSpanFunction* m_spanFnc;
+		NativeBinding* m_pBinding;
 	};
 
 	//------------------------------------------------------------------------------------
@@ -76,17 +109,63 @@ namespace dsr
 	public:
 		DSR_NEWDELETE(ScriptedFunctionImplementation)
 
+		ScriptedFunctionImplementation();
 		virtual void Call(ScriptInstance* pInstance, VMDataArray& args, VMData* retVal) const;
+		/// the arguments are copied into the function's frame
+		virtual void CallSpan(ScriptInstance* pInstance, const VMData* pArgs, uint32 numArgs, VMData* pResult) const;
 		virtual bool IsNative() const { return false; }
+		/// Same as Call, on vmStack, which has no frames.  Returns early if a native function
+		/// the scripts call suspends them, see VMStack::IsSuspended.
+		void Start(VMStack& vmStack, ScriptInstance* pInstance, VMDataArray& args, VMData* retVal) const;
+		/// continues the scripts suspended on vmStack, until they return or suspend again
+		static void Resume(VMStack& vmStack, VMData* retVal);
+		const VMCodeBlock& GetVMCodeBlock() const { return m_vmcode; }
+		uint32 GetNumLocals() const { return m_locals.size(); }
+		uint32 GetMaxStackSize() const { return m_maxStackSize; }
+		VMDataType GetLocalVMDataType(uint32 idx) const { return m_locals[idx]; }
+		uint32 GetNumDirectCalls() const { return m_directCalls.size(); }
+		/// implementation call directcall[idx] runs
+		const FunctionImplementation* GetDirectCallPtr(uint32 idx) const { return m_directCalls[idx]; }
+		/// hash of the bytecode and types, see CompiledFunction
+		uint32 GetCodeHash() const;
+		/// C++ translation running in place of the bytecode, 0 if there is none
+		NativeFunctionImplementation::NativeScriptFunction* GetCompiledFunction() const { return m_pCompiledFnc; }
+#if DSR_JIT
+		/// counts a call, the machine code once the function is compiled
+		JitFunction* GetJitFunction() const;
+#endif
 
 	private:
+		friend class ScriptClass;
+		typedef Array<const FunctionImplementation*> FunctionImplementationCPtrArray;
+
+		/// pushes a frame for a call with the arguments from base on, 0 if it doesn't fit
+		VMFrame* PushFrame(VMStack& vmStack, ScriptInstance* pInstance, uint32 base) const;
+		/// takes over the frame on top for a tail call, its arguments already in place
+		VMFrame* ReplaceFrame(VMStack& vmStack) const;
+		void InitLocals(VMData* pLocals) const;
+		/// pushes a frame for a call from native code, 0 if it doesn't fit
+		VMFrame* Enter(VMStack& vmStack, ScriptInstance* pInstance, const VMData* pArgs, uint32 numArgs) const;
+		/// runs the frame on top and the scripts it calls, until frame entryFrame returns
+		static void Execute(VMStack& vmStack, uint32 entryFrame, VMData* retVal);
 		const char* GetNewClassName(uint32 idx) const;
 		uint32 GetNumNewClassNames() const;
+		/// class newstring[idx] names, looked up on its first use
+		const ScriptClass* GetNewClassPtr(uint32 idx) const;
+		void SetCompiledFunction(NativeFunctionImplementation::NativeScriptFunction* pFnc) { m_pCompiledFnc = pFnc; }
 
 	private:
 		VMCodeBlock m_vmcode;
 		uint32 m_maxStackSize;
 		VMDataTypeArray m_locals;
+		/// implementations the compiler bound calls to, resolved when the class is loaded
+		FunctionImplementationCPtrArray m_directCalls;
+		NativeFunctionImplementation::NativeScriptFunction* m_pCompiledFnc;
+		mutable Array<const ScriptClass*> m_newClasses;
+#if DSR_JIT
+		mutable uint32 m_numCalls;
+		mutable JitFunction* m_pJitFnc;
+#endif
 	};
 }
 
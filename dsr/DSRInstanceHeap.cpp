@@ -0,0 +1,243 @@
+#include "DSRInstanceHeap.h"
+
+#include "DSRScriptInstance.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptManager.h"
+
+namespace dsr
+{
+	//------------------------------------------------------------------------------------
+	ClassHeap::ClassHeap()
+	: m_numInstances(0), m_numData(0), m_end(0), m_firstFree(0), m_numRegions(0), m_pHeap(0),
+		m_pPrev(0), m_pNext(0)
+	{
+	}
+
+	ClassHeap::~ClassHeap()
+	{
+		//the instances are deleted before their class, and with them the regions
+		DSR_ASSERT(!m_numInstances);
+		DSR_ASSERT(!m_numRegions);
+		if (m_pHeap)
+			m_pHeap->Remove(this);
+	}
+
+	//------------------------------------------------------------------------------------
+	InstanceHeap::InstanceHeap()
+	: m_enabled(false), m_pFirstClassHeap(0), m_numClassHeaps(0), m_pCursor(0), m_numInstances(0),
+		m_numRegions(0), m_numMoves(0)
+	{
+	}
+
+	InstanceHeap::~InstanceHeap()
+	{
+		DSR_ASSERT(!m_pFirstClassHeap);
+	}
+
+	void InstanceHeap::Alloc(ScriptInstance* pInstance)
+	{
+		DSR_ASSERT(pInstance->m_heapSlot == NO_SLOT);
+
+		const ScriptClass* pClass = pInstance->GetScriptClassPtr();
+		ClassHeap& classHeap = pClass->m_classHeap;
+		classHeap.m_numData = pClass->GetNumData();
+
+		//grow by doubling
+		if (classHeap.m_numInstances == classHeap.m_instances.size())
+		{
+			Array<ScriptInstance*> grown(classHeap.m_numInstances > 0 ? classHeap.m_numInstances * 2 : 16);
+			for (uint32 i=0; i<classHeap.m_numInstances; ++i)
+				grown[i] = classHeap.m_instances[i];
+			classHeap.m_instances = grown;
+		}
+		pInstance->m_classIdx = classHeap.m_numInstances;
+		classHeap.m_instances[classHeap.m_numInstances++] = pInstance;
+
+		if (!m_enabled || classHeap.m_numData == 0)
+		{
+			pInstance->m_instanceData = new int32[classHeap.m_numData];
+			return;
+		}
+
+		if (!classHeap.m_pHeap)
+			Add(&classHeap);
+
+		//the lowest region with a free slot, or where one was freed
+		uint32 regionIdx = classHeap.m_firstFree;
+		while (regionIdx < classHeap.m_end && classHeap.m_regions[regionIdx] &&
+			classHeap.m_regions[regionIdx]->numUsed == ClassHeap::REGION_SLOTS)
+		{
+			++regionIdx;
+		}
+		classHeap.m_firstFree = regionIdx;
+
+		if (regionIdx == classHeap.m_end)
+		{
+			//grow by doubling
+			if (regionIdx == classHeap.m_regions.size())
+			{
+				Array<ClassHeap::Region*> grown(regionIdx > 0 ? regionIdx * 2 : 8);
+				for (uint32 i=0; i<regionIdx; ++i)
+					grown[i] = classHeap.m_regions[i];
+				classHeap.m_regions = grown;
+			}
+
+			++classHeap.m_end;
+		}
+
+		if (!classHeap.m_regions[regionIdx])
+		{
+			classHeap.m_regions[regionIdx] = new ClassHeap::Region(classHeap.m_numData);
+			++classHeap.m_numRegions;
+			++m_numRegions;
+		}
+
+		ClassHeap::Region& region = *classHeap.m_regions[regionIdx];
+		const uint32 slot = regionIdx * ClassHeap::REGION_SLOTS + region.firstFree;
+		region.Set(region.firstFree, pInstance);
+		pInstance->m_heapSlot = slot;
+		pInstance->m_instanceData = classHeap.GetDataPtr(slot);
+		++m_numInstances;
+	}
+
+	void InstanceHeap::Free(ScriptInstance* pInstance)
+	{
+		ClassHeap& classHeap = pInstance->GetScriptClassPtr()->m_classHeap;
+		DSR_ASSERT(classHeap.m_instances[pInstance->m_classIdx] == pInstance);
+
+		//the last instance of the class takes its index
+		ScriptInstance* pLast = classHeap.m_instances[--classHeap.m_numInstances];
+		classHeap.m_instances[pInstance->m_classIdx] = pLast;
+		pLast->m_classIdx = pInstance->m_classIdx;
+		classHeap.m_instances[classHeap.m_numInstances] = 0;
+
+		if (pInstance->m_heapSlot == NO_SLOT)
+		{
+			delete [] pInstance->m_instanceData;
+			pInstance->m_instanceData = 0;
+			return;
+		}
+
+		const uint32 regionIdx = pInstance->m_heapSlot / ClassHeap::REGION_SLOTS;
+		classHeap.m_regions[regionIdx]->Clear(pInstance->m_heapSlot % ClassHeap::REGION_SLOTS);
+		if (regionIdx < classHeap.m_firstFree)
+			classHeap.m_firstFree = regionIdx;
+		--m_numInstances;
+		Release(classHeap, regionIdx);
+
+		pInstance->m_heapSlot = NO_SLOT;
+		pInstance->m_instanceData = 0;
+	}
+
+	void InstanceHeap::Add(ClassHeap* pClassHeap)
+	{
+		DSR_ASSERT(!pClassHeap->m_pHeap);
+
+		pClassHeap->m_pHeap = this;
+		pClassHeap->m_pPrev = 0;
+		pClassHeap->m_pNext = m_pFirstClassHeap;
+		if (m_pFirstClassHeap)
+			m_pFirstClassHeap->m_pPrev = pClassHeap;
+		m_pFirstClassHeap = pClassHeap;
+		++m_numClassHeaps;
+	}
+
+	void InstanceHeap::Remove(ClassHeap* pClassHeap)
+	{
+		DSR_ASSERT(pClassHeap->m_pHeap == this);
+
+		if (m_pCursor == pClassHeap)
+			m_pCursor = pClassHeap->m_pNext;
+
+		if (pClassHeap->m_pPrev)
+			pClassHeap->m_pPrev->m_pNext = pClassHeap->m_pNext;
+		else
+			m_pFirstClassHeap = pClassHeap->m_pNext;
+		if (pClassHeap->m_pNext)
+			pClassHeap->m_pNext->m_pPrev = pClassHeap->m_pPrev;
+
+		pClassHeap->m_pHeap = 0;
+		pClassHeap->m_pPrev = 0;
+		pClassHeap->m_pNext = 0;
+		--m_numClassHeaps;
+	}
+
+	uint32 InstanceHeap::Compact(uint32 maxMoves)
+	{
+		//no script may be running, the VM keeps the data of the instance it runs on
+		DSR_ASSERT(ScriptManagerPtr()->GetVMStack().GetNumFrames() == 0);
+
+		//each class at most once, the cursor stays on the one the budget ran out in
+		uint32 numMoves = 0;
+		for (uint32 i=0; i<m_numClassHeaps && numMoves < maxMoves; ++i)
+		{
+			if (!m_pCursor)
+				m_pCursor = m_pFirstClassHeap;
+
+			numMoves += Compact(*m_pCursor, maxMoves - numMoves);
+			if (numMoves < maxMoves)
+				m_pCursor = m_pCursor->m_pNext;
+		}
+
+		m_numMoves += numMoves;
+		return numMoves;
+	}
+
+	uint32 InstanceHeap::Compact(ClassHeap& classHeap, uint32 maxMoves)
+	{
+		//the last instance of the last region moves to the lowest free slot, until there's
+		//none below the last region
+		uint32 numMoves = 0;
+		while (numMoves < maxMoves && classHeap.m_end > 0)
+		{
+			uint32 toIdx = classHeap.m_firstFree;
+			while (toIdx < classHeap.m_end && (!classHeap.m_regions[toIdx] ||
+				classHeap.m_regions[toIdx]->numUsed == ClassHeap::REGION_SLOTS))
+			{
+				++toIdx;
+			}
+
+			//the last region is never empty
+			const uint32 fromIdx = classHeap.m_end - 1;
+			if (toIdx >= fromIdx)
+				break;
+
+			ClassHeap::Region& from = *classHeap.m_regions[fromIdx];
+			ClassHeap::Region& to = *classHeap.m_regions[toIdx];
+			uint32 fromSlot = ClassHeap::REGION_SLOTS - 1;
+			while (!from.owners[fromSlot])
+				--fromSlot;
+			const uint32 toSlot = to.firstFree;
+
+			const uint32 numData = classHeap.m_numData;
+			for (uint32 i=0; i<numData; ++i)
+				to.data[toSlot * numData + i] = from.data[fromSlot * numData + i];
+
+			ScriptInstance* pInstance = from.owners[fromSlot];
+			from.Clear(fromSlot);
+			to.Set(toSlot, pInstance);
+			pInstance->m_heapSlot = toIdx * ClassHeap::REGION_SLOTS + toSlot;
+			pInstance->m_instanceData = classHeap.GetDataPtr(pInstance->m_heapSlot);
+			Release(classHeap, fromIdx);
+			++numMoves;
+		}
+
+		return numMoves;
+	}
+
+	void InstanceHeap::Release(ClassHeap& classHeap, uint32 regionIdx)
+	{
+		if (classHeap.m_regions[regionIdx]->numUsed > 0)
+			return;
+
+		delete classHeap.m_regions[regionIdx];
+		classHeap.m_regions[regionIdx] = 0;
+		--classHeap.m_numRegions;
+		--m_numRegions;
+
+		while (classHeap.m_end > 0 && !classHeap.m_regions[classHeap.m_end - 1])
+			--classHeap.m_end;
+		if (classHeap.m_firstFree > classHeap.m_end)
+			classHeap.m_firstFree = classHeap.m_end;
+	}
+}
@@ -0,0 +1,175 @@
+
+#if !defined(DSR_INSTANCEHEAP_H_)
+#define DSR_INSTANCEHEAP_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRArray.h"
+
+namespace dsr
+{
+	class ScriptInstance;
+	class InstanceHeap;
+
+	//------------------------------------------------------------------------------------
+	/// Instances of one class, not those of the classes derived from it, one after the other.
+	/// Once the InstanceHeap is enabled, their data is kept in regions of REGION_SLOTS
+	/// instances each.  Each ScriptClass has one, the InstanceHeap fills it.
+	class ClassHeap
+	{
+		DSR_NOCOPY(ClassHeap)
+	public:
+		DSR_NEWDELETE(ClassHeap)
+
+		enum
+		{
+			REGION_SLOTS = 64,
+		};
+
+		ClassHeap();
+		~ClassHeap();
+
+		uint32 GetNumInstances() const { return m_numInstances; }
+		/// in no particular order, deleting an instance moves the last one to its index
+		ScriptInstance* GetInstancePtr(uint32 idx) const { DSR_ASSERT(idx < m_numInstances); return m_instances[idx]; }
+
+		/// regions allocated, room for REGION_SLOTS instances each
+		uint32 GetNumRegions() const { return m_numRegions; }
+		/// Region indices in use, some may have no region.  A region has the data of its
+		/// slots one after the other, GetNumData values each, so data i of all its instances
+		/// is read at a stride of GetNumData from data i of the first slot.
+		uint32 GetNumRegionIndices() const { return m_end; }
+		uint32 GetNumData() const { return m_numData; }
+		/// data of the region's slots, 0 if it has none
+		int32* GetRegionData(uint32 regionIdx) { DSR_ASSERT(regionIdx < m_end); return m_regions[regionIdx] ? &m_regions[regionIdx]->data[0] : 0; }
+		const int32* GetRegionData(uint32 regionIdx) const { DSR_ASSERT(regionIdx < m_end); return m_regions[regionIdx] ? &m_regions[regionIdx]->data[0] : 0; }
+		/// instance in each of the region's slots, 0 where it's free, 0 if it has none
+		ScriptInstance* const* GetRegionInstances(uint32 regionIdx) const { DSR_ASSERT(regionIdx < m_end); return m_regions[regionIdx] ? &m_regions[regionIdx]->owners[0] : 0; }
+
+	private:
+		friend class InstanceHeap;
+
+		class Region
+		{
+			DSR_NOCOPY(Region)
+		public:
+			DSR_NEWDELETE(Region)
+
+			explicit Region(uint32 numData)
+			: data(numData * REGION_SLOTS), owners(REGION_SLOTS), numUsed(0), firstFree(0)
+			{
+			}
+
+			Array<int32> data;
+			/// instance in each slot, 0 where it's free
+			Array<ScriptInstance*> owners;
+			uint32 numUsed;
+			/// no slot below it is free
+			uint32 firstFree;
+
+			void Set(uint32 slot, ScriptInstance* pOwner)
+			{
+				DSR_ASSERT(!owners[slot]);
+				owners[slot] = pOwner;
+				++numUsed;
+				while (firstFree < REGION_SLOTS && owners[firstFree])
+					++firstFree;
+			}
+
+			void Clear(uint32 slot)
+			{
+				DSR_ASSERT(owners[slot]);
+				owners[slot] = 0;
+				--numUsed;
+				if (slot < firstFree)
+					firstFree = slot;
+			}
+		};
+
+		int32* GetDataPtr(uint32 slot) { return &m_regions[slot / REGION_SLOTS]->data[(slot % REGION_SLOTS) * m_numData]; }
+
+	private:
+		/// m_numInstances in use
+		Array<ScriptInstance*> m_instances;
+		uint32 m_numInstances;
+		uint32 m_numData;
+		/// 0 where a region was freed, m_end indices in use
+		Array<Region*> m_regions;
+		uint32 m_end;
+		/// no region below it has a free slot
+		uint32 m_firstFree;
+		uint32 m_numRegions;
+		/// the InstanceHeap's list of heaps with regions
+		InstanceHeap* m_pHeap;
+		ClassHeap* m_pPrev;
+		ClassHeap* m_pNext;
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Keeps the instances of each class in its ClassHeap.  Once it's enabled, it also keeps
+	/// their data there, in regions per class instead of an allocation per instance.  Scripts only reach instances through their handles,
+	/// and the VM gets the data from the instance on every access, so the data can move:
+	/// Compact moves the data of the instances in a class's last regions into the free slots
+	/// of its first ones, and frees the regions left empty.  Churn then doesn't leave the
+	/// data of the instances spread over mostly empty memory.
+	///
+	/// The host compacts between calls into scripts, a step moves at most the number of
+	/// instances it's given and the next one continues where it stopped.  A pointer from
+	/// ScriptInstance::GetInstanceData isn't valid anymore after a step.
+	class InstanceHeap
+	{
+		DSR_NOCOPY(InstanceHeap)
+	public:
+		DSR_NEWDELETE(InstanceHeap)
+
+		enum
+		{
+			DEFAULT_STEP_MOVES = 256,
+			/// slot of the instances with data of their own
+			NO_SLOT = 0xffffffff,
+		};
+
+		InstanceHeap();
+		~InstanceHeap();
+
+		/// Instances created from now on keep their data here.  Off by default.
+		void SetEnabled(bool enabled) { m_enabled = enabled; }
+		bool IsEnabled() const { return m_enabled; }
+
+		/// Gives pInstance its data and adds it to its class, called by ScriptInstance
+		void Alloc(ScriptInstance* pInstance);
+		void Free(ScriptInstance* pInstance);
+		/// Should only get called by ClassHeap
+		void Remove(ClassHeap* pClassHeap);
+
+		/// Moves the data of at most maxMoves instances to lower free slots of their class.
+		/// Returns the number moved, less than maxMoves once all classes are compact.
+		uint32 Compact(uint32 maxMoves = DEFAULT_STEP_MOVES);
+
+		/// instances with their data here
+		uint32 GetNumInstances() const { return m_numInstances; }
+		uint32 GetNumRegions() const { return m_numRegions; }
+		/// instances moved since the heap was created
+		uint32 GetNumMoves() const { return m_numMoves; }
+
+	private:
+		void Add(ClassHeap* pClassHeap);
+		uint32 Compact(ClassHeap& classHeap, uint32 maxMoves);
+		/// frees the region if it's empty, and the trailing indices left without one
+		void Release(ClassHeap& classHeap, uint32 regionIdx);
+
+	private:
+		bool m_enabled;
+		ClassHeap* m_pFirstClassHeap;
+		uint32 m_numClassHeaps;
+		/// class heap the next step compacts
+		ClassHeap* m_pCursor;
+		uint32 m_numInstances;
+		uint32 m_numRegions;
+		uint32 m_numMoves;
+	};
+}
+
+#endif
@@ -0,0 +1,1215 @@
+
+#include "DSRJit.h"
+
+#if DSR_JIT
+
+#include "DSRJitMemory.h"
+#include "DSRArray.h"
+#include "DSRFunction.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptInstance.h"
+#include "DSRScriptManager.h"
+#include "DSRVMInstruction.h"
+#include "DSRVMStack.h"
+
+namespace dsr
+{
+	//-------------------------------------------------------------------------
+	JitCodeHeap::JitCodeHeap()
+	: m_pChunks(0), m_numBytes(0)
+	{
+	}
+
+	JitCodeHeap::~JitCodeHeap()
+	{
+		while (m_pChunks)
+		{
+			Chunk* pChunk = m_pChunks;
+			m_pChunks = pChunk->pNext;
+			JitFreePages(pChunk->pPages, pChunk->size);
+			delete pChunk;
+		}
+	}
+
+	void* JitCodeHeap::Add(const uint8* pCode, uint32 size)
+	{
+		//functions start 16 byte aligned
+		const uint32 alignedSize = (size + 15) & ~15;
+
+		Chunk* pChunk = m_pChunks;
+		if (!pChunk || pChunk->used + alignedSize > pChunk->size)
+		{
+			const uint32 pageSize = JitGetPageSize();
+			uint32 chunkSize = 16 * pageSize;
+			if (chunkSize < alignedSize)
+				chunkSize = (alignedSize + pageSize - 1) / pageSize * pageSize;
+
+			uint8* pPages = (uint8*) JitAllocPages(chunkSize);
+			if (!pPages)
+				return 0;
+
+			pChunk = new Chunk();
+			pChunk->pPages = pPages;
+			pChunk->size = chunkSize;
+			pChunk->used = 0;
+			pChunk->pNext = m_pChunks;
+			m_pChunks = pChunk;
+		}
+		else if (!JitProtectPages(pChunk->pPages, pChunk->size, false))
+		{
+			return 0;
+		}
+
+		uint8* pDest = pChunk->pPages + pChunk->used;
+		for (uint32 i=0; i<size; ++i)
+			pDest[i] = pCode[i];
+		pChunk->used += alignedSize;
+		m_numBytes += alignedSize;
+
+		if (!JitProtectPages(pChunk->pPages, pChunk->size, true))
+			return 0;
+		return pDest;
+	}
+
+	//-------------------------------------------------------------------------
+	enum
+	{
+		JITREG_RAX = 0,
+		JITREG_RCX,
+		JITREG_RDX,
+		JITREG_RBX,
+		JITREG_RSP,
+		JITREG_RBP,
+		JITREG_RSI,
+		JITREG_RDI,
+		JITREG_R8,
+		JITREG_R9,
+		JITREG_R10,
+		JITREG_R11,
+		JITREG_R12,
+		JITREG_R13,
+		JITREG_R14,
+		JITREG_R15,
+	};
+
+	//registers for the arguments of compiled functions and of the runtime calls they make
+#if defined(_WIN64)
+	static const uint32 s_argRegs[4] = { JITREG_RCX, JITREG_RDX, JITREG_R8, JITREG_R9 };
+	static const uint32 s_shadowSpace = 32;
+#else
+	static const uint32 s_argRegs[4] = { JITREG_RDI, JITREG_RSI, JITREG_RDX, JITREG_RCX };
+	static const uint32 s_shadowSpace = 0;
+#endif
+
+	//callee saved registers holding the lowest operand stack slots
+	static const uint32 s_slotRegs[] = { JITREG_RBX, JITREG_R12, JITREG_R13, JITREG_R14, JITREG_R15 };
+	static const uint32 s_numSlotRegs = sizeof(s_slotRegs) / sizeof(s_slotRegs[0]);
+
+	//condition codes
+	enum
+	{
+		JITCC_E = 0x4,
+		JITCC_NE = 0x5,
+		JITCC_AE = 0x3,
+		JITCC_A = 0x7,
+		JITCC_NP = 0xB,
+		JITCC_L = 0xC,
+		JITCC_GE = 0xD,
+		JITCC_LE = 0xE,
+		JITCC_G = 0xF,
+	};
+
+	//-------------------------------------------------------------------------
+	/// x86-64 encoder for the few instructions the templates use.  32 bit operations,
+	/// except where noted.
+	class JitAssembler
+	{
+		DSR_NOCOPY(JitAssembler)
+	public:
+		DSR_NEWDELETE(JitAssembler)
+
+		JitAssembler() : m_code(256), m_size(0) {}
+
+		const uint8* GetCode() const { return m_code.begin(); }
+		uint32 GetSize() const { return m_size; }
+
+		void Byte(uint32 b)
+		{
+			if (m_size == m_code.size())
+			{
+				Array<uint8> code(m_size * 2);
+				for (uint32 i=0; i<m_size; ++i)
+					code[i] = m_code[i];
+				m_code = code;
+			}
+			m_code[m_size++] = (uint8) b;
+		}
+
+		void Dword(uint32 d)
+		{
+			Byte(d);
+			Byte(d >> 8);
+			Byte(d >> 16);
+			Byte(d >> 24);
+		}
+
+		void Qword(uint64 q)
+		{
+			Dword((uint32) q);
+			Dword((uint32) (q >> 32));
+		}
+
+		void PatchDword(uint32 pos, uint32 d)
+		{
+			m_code[pos] = (uint8) d;
+			m_code[pos + 1] = (uint8) (d >> 8);
+			m_code[pos + 2] = (uint8) (d >> 16);
+			m_code[pos + 3] = (uint8) (d >> 24);
+		}
+
+		/// rel32 at pos to target
+		void PatchRel(uint32 pos, uint32 target) { PatchDword(pos, target - (pos + 4)); }
+
+		void Rex(bool wide, uint32 reg, uint32 rm)
+		{
+			const uint32 rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+			if (rex != 0x40)
+				Byte(rex);
+		}
+
+		void ModRM(uint32 reg, uint32 rm) { Byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+
+		void ModRMMem(uint32 reg, uint32 base, int32 disp)
+		{
+			Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+			if ((base & 7) == JITREG_RSP)
+				Byte(0x24);
+			Dword((uint32) disp);
+		}
+
+		/// op reg, rm
+		void Op(uint32 op, uint32 reg, uint32 rm) { Rex(false, reg, rm); Byte(op); ModRM(reg, rm); }
+		void Op0F(uint32 op, uint32 reg, uint32 rm) { Rex(false, reg, rm); Byte(0x0F); Byte(op); ModRM(reg, rm); }
+
+		void MovRegReg(uint32 dst, uint32 src) { if (dst != src) Op(0x89, src, dst); }
+		void MovRegMem(uint32 dst, uint32 base, int32 disp) { Rex(false, dst, base); Byte(0x8B); ModRMMem(dst, base, disp); }
+		void MovMemReg(uint32 base, int32 disp, uint32 src) { Rex(false, src, base); Byte(0x89); ModRMMem(src, base, disp); }
+		void MovRegImm(uint32 dst, uint32 imm) { Rex(false, 0, dst); Byte(0xB8 + (dst & 7)); Dword(imm); }
+		/// 64 bit
+		void MovRegImm64(uint32 dst, uint64 imm) { Rex(true, 0, dst); Byte(0xB8 + (dst & 7)); Qword(imm); }
+		void MovRegReg64(uint32 dst, uint32 src) { Rex(true, src, dst); Byte(0x89); ModRM(src, dst); }
+		void MovRegMem64(uint32 dst, uint32 base, int32 disp) { Rex(true, dst, base); Byte(0x8B); ModRMMem(dst, base, disp); }
+		void MovMemReg64(uint32 base, int32 disp, uint32 src) { Rex(true, src, base); Byte(0x89); ModRMMem(src, base, disp); }
+		void LeaRegMem64(uint32 dst, uint32 base, int32 disp) { Rex(true, dst, base); Byte(0x8D); ModRMMem(dst, base, disp); }
+
+		void Add(uint32 dst, uint32 src) { Op(0x01, src, dst); }
+		void Sub(uint32 dst, uint32 src) { Op(0x29, src, dst); }
+		void And(uint32 dst, uint32 src) { Op(0x21, src, dst); }
+		void Or(uint32 dst, uint32 src) { Op(0x09, src, dst); }
+		void Xor(uint32 dst, uint32 src) { Op(0x31, src, dst); }
+		void Cmp(uint32 lhs, uint32 rhs) { Op(0x39, rhs, lhs); }
+		void Test(uint32 lhs, uint32 rhs) { Op(0x85, rhs, lhs); }
+		void Imul(uint32 dst, uint32 src) { Op0F(0xAF, dst, src); }
+		void Neg(uint32 reg) { Op(0xF7, 3, reg); }
+		/// edx:eax / reg
+		void Idiv(uint32 reg) { Byte(0x99); Op(0xF7, 7, reg); }
+		void XorEaxImm(uint32 imm) { Byte(0x35); Dword(imm); }
+		/// al = cc, for al and cl
+		void Setcc(uint32 cc, uint32 reg) { Byte(0x0F); Byte(0x90 + cc); ModRM(0, reg); }
+		void AndAlCl() { Byte(0x20); Byte(0xC8); }
+		void MovzxEaxAl() { Byte(0x0F); Byte(0xB6); Byte(0xC0); }
+
+		void MovdXmmReg(uint32 xmm, uint32 reg) { Byte(0x66); Op0F(0x6E, xmm, reg); }
+		void MovdRegXmm(uint32 reg, uint32 xmm) { Byte(0x66); Op0F(0x7E, xmm, reg); }
+		void Cvtsi2ss(uint32 xmm, uint32 reg) { Byte(0xF3); Op0F(0x2A, xmm, reg); }
+		/// addss 0x58, mulss 0x59, subss 0x5C, divss 0x5E
+		void ArithSS(uint32 op, uint32 dst, uint32 src) { Byte(0xF3); Op0F(op, dst, src); }
+		void Ucomiss(uint32 lhs, uint32 rhs) { Op0F(0x2E, lhs, rhs); }
+
+		void Push(uint32 reg) { Rex(false, 0, reg); Byte(0x50 + (reg & 7)); }
+		void Pop(uint32 reg) { Rex(false, 0, reg); Byte(0x58 + (reg & 7)); }
+		void SubRsp(uint32 imm) { Byte(0x48); Byte(0x81); Byte(0xEC); Dword(imm); }
+		void AddRsp(uint32 imm) { Byte(0x48); Byte(0x81); Byte(0xC4); Dword(imm); }
+		void CallRax() { Byte(0xFF); Byte(0xD0); }
+		void Ret() { Byte(0xC3); }
+		/// cmp byte [reg], 0
+		void CmpByteMemZero(uint32 reg) { Rex(false, 0, reg); Byte(0x80); Byte(0x38 | (reg & 7)); Byte(0); }
+
+		/// jumps with a rel32 to patch, returns its position
+		uint32 Jmp() { Byte(0xE9); Dword(0); return m_size - 4; }
+		uint32 Jcc(uint32 cc) { Byte(0x0F); Byte(0x80 + cc); Dword(0); return m_size - 4; }
+
+	private:
+		Array<uint8> m_code;
+		uint32 m_size;
+	};
+
+	//-------------------------------------------------------------------------
+	DSR_INLINE VMInstruction JitExtractVMInstruction(VMBytecode code)
+	{
+		return (code >> 24);
+	}
+
+	DSR_INLINE uint32 JitExtractUnsignedValue(VMBytecode code)
+	{
+		return code & 0x00FFFFFF;
+	}
+
+	static bool JitHasDataWord(VMInstruction inst)
+	{
+		switch (inst)
+		{
+		case VMI_CALLF_SELF_G:
+		case VMI_CALLF_SUPER_G:
+		case VMI_CALLF_PUSHED_G:
+		case VMI_CALLC_PUSHED_G:
+		case VMI_CALLC_SELF_SUPER:
+		case VMI_PUSHF:
+		case VMI_PUSHI:
+		case VMI_CALLF_SELF_D:
+		case VMI_CALLF_PUSHED_D:
+		case VMI_TAILCALLF_SELF_G:
+		case VMI_TAILCALLF_SUPER_G:
+		case VMI_TAILCALLF_SELF_D:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	/// compiled code only handles raw values
+	static bool JitCanCall(const FunctionDefinition* pDef)
+	{
+		if (pDef->GetNumArgs() > Jit::MAX_ARGS || pDef->GetReturnVMDataType().IsNative())
+			return false;
+		for (uint32 i=0; i<pDef->GetNumArgs(); ++i)
+		{
+			if (pDef->GetArgVMDataType(i).IsNative())
+				return false;
+		}
+		return true;
+	}
+
+	/// where a call instruction goes: a function known at compile time, or one looked up
+	/// in the instance's vtable
+	class JitCallTarget
+	{
+	public:
+		DSR_NEWDELETE(JitCallTarget)
+
+		const FunctionImplementation* pCallee;
+		const FunctionDefinition* pDef;
+		uint32 fnIdx;
+		bool tail;
+	};
+
+	//-------------------------------------------------------------------------
+	/// Emits the templates of one function.  The operand stack's depth is known at every
+	/// instruction, so each slot has a fixed home.
+	class JitFunctionCompiler
+	{
+		DSR_NOCOPY(JitFunctionCompiler)
+	public:
+		DSR_NEWDELETE(JitFunctionCompiler)
+
+		JitFunctionCompiler(Jit* pJit, const ScriptedFunctionImplementation* pImpl, const uint8* pFailed)
+		: m_pJit(pJit), m_pImpl(pImpl), m_code(pImpl->GetVMCodeBlock()), m_pFailed(pFailed),
+			m_depths(m_code.size()), m_offsets(m_code.size()), m_fixups(m_code.size()), m_numFixups(0), m_numExits(0),
+			m_maxDepth(0), m_maxCallArgs(0)
+		{
+		}
+
+		bool Compile()
+		{
+			if (!Analyze())
+				return false;
+
+			Layout();
+			EmitPrologue();
+
+			for (uint32 pc=0; pc<m_code.size(); pc += JitHasDataWord(JitExtractVMInstruction(m_code[pc])) ? 2 : 1)
+			{
+				m_offsets[pc] = m_asm.GetSize();
+				if (m_depths[pc] >= 0)
+					EmitInstruction(pc, (uint32) m_depths[pc]);
+			}
+
+			EmitEpilogue();
+
+			for (uint32 i=0; i<m_numFixups; ++i)
+			{
+				const Fixup& fixup = m_fixups[i];
+				m_asm.PatchRel(fixup.pos, m_offsets[fixup.targetPc]);
+			}
+			return true;
+		}
+
+		const uint8* GetCode() const { return m_asm.GetCode(); }
+		uint32 GetSize() const { return m_asm.GetSize(); }
+
+	private:
+		static bool GetCallTarget(const ScriptedFunctionImplementation* pImpl, VMInstruction inst, uint32 operand, JitCallTarget* pTarget)
+		{
+			pTarget->pCallee = 0;
+			pTarget->pDef = 0;
+			pTarget->fnIdx = operand;
+			pTarget->tail = (inst == VMI_TAILCALLF_SELF_G || inst == VMI_TAILCALLF_SUPER_G || inst == VMI_TAILCALLF_SELF_D);
+
+			switch (inst)
+			{
+			case VMI_CALLF_SELF_G:
+			case VMI_TAILCALLF_SELF_G:
+				{
+					//overrides share the definition
+					const ScriptClass* pClass = pImpl->GetScriptClassPtr();
+					if (operand >= pClass->GetNumFunctions())
+						return false;
+					pTarget->pDef = pClass->GetFunctionDefinitionPtr(operand);
+				}
+				break;
+
+			case VMI_CALLF_SUPER_G:
+			case VMI_TAILCALLF_SUPER_G:
+				{
+					const ScriptClass* pSuper = pImpl->GetScriptClassPtr()->GetSuperPtr();
+					if (!pSuper || operand >= pSuper->GetNumFunctions())
+						return false;
+					pTarget->pCallee = pSuper->GetFunctionImplementationPtr(operand);
+				}
+				break;
+
+			case VMI_CALLF_SELF_D:
+			case VMI_TAILCALLF_SELF_D:
+				{
+					if (operand >= pImpl->GetNumDirectCalls())
+						return false;
+					pTarget->pCallee = pImpl->GetDirectCallPtr(operand);
+				}
+				break;
+
+			default:
+				return false;
+			}
+
+			if (pTarget->pCallee)
+				pTarget->pDef = pTarget->pCallee->GetFunctionDefinitionPtr();
+			return pTarget->pDef && JitCanCall(pTarget->pDef);
+		}
+
+		/// operand stack slots an instruction pops and pushes, false if compiled code can't
+		/// run it
+		static bool GetStackEffect(const ScriptedFunctionImplementation* pImpl, const VMCodeBlock& code, uint32 pc, uint32* pPops, uint32* pPushes)
+		{
+			const VMInstruction inst = JitExtractVMInstruction(code[pc]);
+			*pPops = 0;
+			*pPushes = 0;
+
+			switch (inst)
+			{
+			case VMI_NOP:
+			case VMI_JMP:
+				break;
+
+			case VMI_RET:
+			case VMI_JZ:
+			case VMI_POP:
+			case VMI_STORESF:
+			case VMI_STORESI:
+			case VMI_STORESB:
+			case VMI_STORELF:
+			case VMI_STORELI:
+			case VMI_STORELB:
+			case VMI_STOREPF:
+			case VMI_STOREPI:
+			case VMI_STOREPB:
+				*pPops = 1;
+				break;
+
+			case VMI_FETCHSF:
+			case VMI_FETCHSI:
+			case VMI_FETCHSB:
+			case VMI_FETCHLF:
+			case VMI_FETCHLI:
+			case VMI_FETCHLB:
+			case VMI_FETCHPF:
+			case VMI_FETCHPI:
+			case VMI_FETCHPB:
+			case VMI_PUSHF:
+			case VMI_PUSHI:
+			case VMI_PUSHB:
+				*pPushes = 1;
+				break;
+
+			case VMI_NEGF:
+			case VMI_NEGI:
+			case VMI_NOT:
+				*pPops = 1;
+				*pPushes = 1;
+				break;
+
+			case VMI_DIVII: case VMI_DIVFF: case VMI_DIVFI: case VMI_DIVIF:
+			case VMI_MULII: case VMI_MULFF: case VMI_MULFI: case VMI_MULIF:
+			case VMI_SUBII: case VMI_SUBFF: case VMI_SUBFI: case VMI_SUBIF:
+			case VMI_ADDII: case VMI_ADDFF: case VMI_ADDFI: case VMI_ADDIF:
+			case VMI_MOD:
+			case VMI_EQII: case VMI_EQFF: case VMI_EQFI: case VMI_EQIF: case VMI_EQBB:
+			case VMI_LTEQII: case VMI_LTEQFF: case VMI_LTEQFI: case VMI_LTEQIF:
+			case VMI_LTII: case VMI_LTFF: case VMI_LTFI: case VMI_LTIF:
+			case VMI_GTEQII: case VMI_GTEQFF: case VMI_GTEQFI: case VMI_GTEQIF:
+			case VMI_GTII: case VMI_GTFF: case VMI_GTFI: case VMI_GTIF:
+			case VMI_AND:
+			case VMI_OR:
+				*pPops = 2;
+				*pPushes = 1;
+				break;
+
+			case VMI_CALLF_SELF_G:
+			case VMI_CALLF_SUPER_G:
+			case VMI_CALLF_SELF_D:
+			case VMI_TAILCALLF_SELF_G:
+			case VMI_TAILCALLF_SUPER_G:
+			case VMI_TAILCALLF_SELF_D:
+				{
+					JitCallTarget target;
+					if (pc + 1 >= code.size() || !GetCallTarget(pImpl, inst, code[pc + 1], &target))
+						return false;
+					*pPops = target.pDef->GetNumArgs();
+					*pPushes = 1;
+				}
+				break;
+
+			default:
+				return false;
+			}
+
+			return true;
+		}
+
+		/// depth of the operand stack before every reachable instruction
+		bool Analyze()
+		{
+			for (uint32 pc=0; pc<m_code.size(); ++pc)
+				m_depths[pc] = -1;
+			if (m_code.size() == 0)
+				return false;
+			m_depths[0] = 0;
+
+			const uint32 numArgs = m_pImpl->GetFunctionDefinitionPtr()->GetNumArgs();
+			uint32 pc = 0;
+			while (pc < m_code.size())
+			{
+				const VMInstruction inst = JitExtractVMInstruction(m_code[pc]);
+				const uint32 next = pc + (JitHasDataWord(inst) ? 2 : 1);
+				const int32 depth = m_depths[pc];
+				if (depth < 0)
+				{
+					pc = next;
+					continue;
+				}
+
+				uint32 pops, pushes;
+				if (!GetStackEffect(m_pImpl, m_code, pc, &pops, &pushes) || (uint32) depth < pops)
+					return false;
+				const int32 after = depth - (int32) pops + (int32) pushes;
+				if ((uint32) after > m_maxDepth)
+					m_maxDepth = (uint32) after;
+
+				//operands in range
+				const uint32 operand = JitExtractUnsignedValue(m_code[pc]);
+				switch (inst)
+				{
+				case VMI_STORESF: case VMI_STORESI: case VMI_STORESB:
+				case VMI_FETCHSF: case VMI_FETCHSI: case VMI_FETCHSB:
+					if (operand >= m_pImpl->GetScriptClassPtr()->GetNumData())
+						return false;
+					break;
+				case VMI_STORELF: case VMI_STORELI: case VMI_STORELB:
+				case VMI_FETCHLF: case VMI_FETCHLI: case VMI_FETCHLB:
+					if (operand >= m_pImpl->GetNumLocals())
+						return false;
+					break;
+				case VMI_STOREPF: case VMI_STOREPI: case VMI_STOREPB:
+				case VMI_FETCHPF: case VMI_FETCHPI: case VMI_FETCHPB:
+					if (operand >= numArgs)
+						return false;
+					break;
+				default:
+					break;
+				}
+
+				if (pops > m_maxCallArgs && (inst == VMI_CALLF_SELF_G || inst == VMI_CALLF_SUPER_G || inst == VMI_CALLF_SELF_D
+					|| inst == VMI_TAILCALLF_SELF_G || inst == VMI_TAILCALLF_SUPER_G || inst == VMI_TAILCALLF_SELF_D))
+					m_maxCallArgs = pops;
+
+				//successors agree on the depth.  a backward jump can only go where the code
+				//already got to.
+				if (inst == VMI_JMP || inst == VMI_JZ)
+				{
+					if (operand >= m_code.size() || (operand <= pc && m_depths[operand] < 0))
+						return false;
+					if (!SetDepth(operand, after))
+						return false;
+				}
+				if (inst != VMI_JMP && inst != VMI_RET && next < m_code.size())
+				{
+					if (!SetDepth(next, after))
+						return false;
+				}
+
+				pc = next;
+			}
+			return true;
+		}
+
+		bool SetDepth(uint32 pc, int32 depth)
+		{
+			if (m_depths[pc] < 0)
+				m_depths[pc] = depth;
+			return m_depths[pc] == depth;
+		}
+
+		/// native stack frame: shadow space, outgoing arguments, arguments, locals, spilled
+		/// slots and the instance
+		void Layout()
+		{
+			const uint32 numSpilled = m_maxDepth > s_numSlotRegs ? m_maxDepth - s_numSlotRegs : 0;
+			m_outOffset = s_shadowSpace;
+			m_argOffset = m_outOffset + m_maxCallArgs * 4;
+			m_localOffset = m_argOffset + m_pImpl->GetFunctionDefinitionPtr()->GetNumArgs() * 4;
+			m_spillOffset = m_localOffset + m_pImpl->GetNumLocals() * 4;
+			m_instanceOffset = (m_spillOffset + numSpilled * 4 + 7) & ~7;
+
+			//6 pushes and the return address leave rsp 8 off 16 byte alignment
+			m_frameSize = m_instanceOffset + 8;
+			if ((m_frameSize & 15) != 8)
+				m_frameSize += 8;
+		}
+
+		void EmitPrologue()
+		{
+			m_asm.Push(JITREG_RBX);
+			m_asm.Push(JITREG_RBP);
+			m_asm.Push(JITREG_R12);
+			m_asm.Push(JITREG_R13);
+			m_asm.Push(JITREG_R14);
+			m_asm.Push(JITREG_R15);
+			m_asm.SubRsp(m_frameSize);
+
+			m_asm.MovMemReg64(JITREG_RSP, m_instanceOffset, s_argRegs[2]);
+			m_asm.MovRegReg64(JITREG_RBP, s_argRegs[1]);
+
+			for (uint32 i=0; i<m_pImpl->GetFunctionDefinitionPtr()->GetNumArgs(); ++i)
+			{
+				m_asm.MovRegMem(JITREG_RAX, s_argRegs[0], i * 4);
+				m_asm.MovMemReg(JITREG_RSP, m_argOffset + i * 4, JITREG_RAX);
+			}
+
+			//locals start out as 0, 0.0f or false, all 0 bits
+			m_asm.Xor(JITREG_RAX, JITREG_RAX);
+			for (uint32 i=0; i<m_pImpl->GetNumLocals(); ++i)
+				m_asm.MovMemReg(JITREG_RSP, m_localOffset + i * 4, JITREG_RAX);
+		}
+
+		void EmitEpilogue()
+		{
+			//failed calls return 0
+			m_failOffset = m_asm.GetSize();
+			m_asm.Xor(JITREG_RAX, JITREG_RAX);
+
+			m_exitOffset = m_asm.GetSize();
+			m_asm.AddRsp(m_frameSize);
+			m_asm.Pop(JITREG_R15);
+			m_asm.Pop(JITREG_R14);
+			m_asm.Pop(JITREG_R13);
+			m_asm.Pop(JITREG_R12);
+			m_asm.Pop(JITREG_RBP);
+			m_asm.Pop(JITREG_RBX);
+			m_asm.Ret();
+
+			for (uint32 i=0; i<m_numExits; ++i)
+				m_asm.PatchRel(m_exits[i].pos, m_exits[i].fail ? m_failOffset : m_exitOffset);
+		}
+
+		void LoadSlot(uint32 reg, uint32 slot)
+		{
+			if (slot < s_numSlotRegs)
+				m_asm.MovRegReg(reg, s_slotRegs[slot]);
+			else
+				m_asm.MovRegMem(reg, JITREG_RSP, m_spillOffset + (slot - s_numSlotRegs) * 4);
+		}
+
+		void StoreSlot(uint32 slot, uint32 reg)
+		{
+			if (slot < s_numSlotRegs)
+				m_asm.MovRegReg(s_slotRegs[slot], reg);
+			else
+				m_asm.MovMemReg(JITREG_RSP, m_spillOffset + (slot - s_numSlotRegs) * 4, reg);
+		}
+
+		void AddFixup(uint32 pos, uint32 targetPc)
+		{
+			DSR_ASSERT(m_numFixups < m_fixups.size());
+			m_fixups[m_numFixups].pos = pos;
+			m_fixups[m_numFixups].targetPc = targetPc;
+			++m_numFixups;
+		}
+
+		void AddExit(uint32 pos, bool fail)
+		{
+			if (m_numExits == m_exits.size())
+			{
+				Array<Exit> exits(m_numExits > 0 ? m_numExits * 2 : 16);
+				for (uint32 i=0; i<m_numExits; ++i)
+					exits[i] = m_exits[i];
+				m_exits = exits;
+			}
+			m_exits[m_numExits].pos = pos;
+			m_exits[m_numExits].fail = fail;
+			++m_numExits;
+		}
+
+		/// eax = slot a, ecx = slot b
+		void LoadOperands(uint32 depth)
+		{
+			LoadSlot(JITREG_RAX, depth - 2);
+			LoadSlot(JITREG_RCX, depth - 1);
+		}
+
+		/// xmm0 and xmm1 from eax and ecx, each a float or an int to convert
+		void LoadFloatOperands(bool intLhs, bool intRhs)
+		{
+			if (intLhs)
+				m_asm.Cvtsi2ss(0, JITREG_RAX);
+			else
+				m_asm.MovdXmmReg(0, JITREG_RAX);
+			if (intRhs)
+				m_asm.Cvtsi2ss(1, JITREG_RCX);
+			else
+				m_asm.MovdXmmReg(1, JITREG_RCX);
+		}
+
+		void EmitFloatArith(uint32 depth, uint32 op, bool intLhs, bool intRhs)
+		{
+			LoadOperands(depth);
+			LoadFloatOperands(intLhs, intRhs);
+			m_asm.ArithSS(op, 0, 1);
+			m_asm.MovdRegXmm(JITREG_RAX, 0);
+			StoreSlot(depth - 2, JITREG_RAX);
+		}
+
+		/// cc after ucomiss, swapped to compare b with a
+		void EmitFloatCompare(uint32 depth, uint32 cc, bool swap, bool intLhs, bool intRhs)
+		{
+			LoadOperands(depth);
+			LoadFloatOperands(intLhs, intRhs);
+			if (swap)
+				m_asm.Ucomiss(1, 0);
+			else
+				m_asm.Ucomiss(0, 1);
+			m_asm.Setcc(cc, JITREG_RAX);
+			m_asm.MovzxEaxAl();
+			StoreSlot(depth - 2, JITREG_RAX);
+		}
+
+		void EmitFloatEquals(uint32 depth, bool intLhs, bool intRhs)
+		{
+			//unordered sets ZF too
+			LoadOperands(depth);
+			LoadFloatOperands(intLhs, intRhs);
+			m_asm.Ucomiss(0, 1);
+			m_asm.Setcc(JITCC_E, JITREG_RAX);
+			m_asm.Setcc(JITCC_NP, JITREG_RCX);
+			m_asm.AndAlCl();
+			m_asm.MovzxEaxAl();
+			StoreSlot(depth - 2, JITREG_RAX);
+		}
+
+		void EmitIntCompare(uint32 depth, uint32 cc)
+		{
+			LoadOperands(depth);
+			m_asm.Cmp(JITREG_RAX, JITREG_RCX);
+			m_asm.Setcc(cc, JITREG_RAX);
+			m_asm.MovzxEaxAl();
+			StoreSlot(depth - 2, JITREG_RAX);
+		}
+
+		void EmitCall(uint32 pc, uint32 depth)
+		{
+			JitCallTarget target;
+			GetCallTarget(m_pImpl, JitExtractVMInstruction(m_code[pc]), m_code[pc + 1], &target);
+			const uint32 numArgs = target.pDef->GetNumArgs();
+
+			for (uint32 i=0; i<numArgs; ++i)
+			{
+				LoadSlot(JITREG_RAX, depth - numArgs + i);
+				m_asm.MovMemReg(JITREG_RSP, m_outOffset + i * 4, JITREG_RAX);
+			}
+
+			//Jit::Call*(pJit, pInstance, pArgs, callee or vtable index)
+			m_asm.MovRegImm64(s_argRegs[0], (uint64) (size_t) m_pJit);
+			m_asm.MovRegMem64(s_argRegs[1], JITREG_RSP, m_instanceOffset);
+			m_asm.LeaRegMem64(s_argRegs[2], JITREG_RSP, m_outOffset);
+			void* pHelper;
+			if (target.pCallee)
+			{
+				m_asm.MovRegImm64(s_argRegs[3], (uint64) (size_t) target.pCallee);
+				pHelper = target.tail ? (void*) &Jit::TailCallStatic : (void*) &Jit::CallStatic;
+			}
+			else
+			{
+				m_asm.MovRegImm64(s_argRegs[3], (uint64) target.fnIdx);
+				pHelper = target.tail ? (void*) &Jit::TailCallVirtual : (void*) &Jit::CallVirtual;
+			}
+			m_asm.MovRegImm64(JITREG_RAX, (uint64) (size_t) pHelper);
+			m_asm.CallRax();
+
+			//a tail call returns right away, Jit::Invoke makes the call
+			if (target.tail)
+			{
+				AddExit(m_asm.Jmp(), false);
+				return;
+			}
+
+			m_asm.MovRegImm64(JITREG_RCX, (uint64) (size_t) m_pFailed);
+			m_asm.CmpByteMemZero(JITREG_RCX);
+			AddExit(m_asm.Jcc(JITCC_NE), true);
+			StoreSlot(depth - numArgs, JITREG_RAX);
+		}
+
+		void EmitInstruction(uint32 pc, uint32 depth)
+		{
+			const VMBytecode curCode = m_code[pc];
+			const uint32 operand = JitExtractUnsignedValue(curCode);
+
+			switch (JitExtractVMInstruction(curCode))
+			{
+			case VMI_NOP:
+				break;
+
+			case VMI_RET:
+				LoadSlot(JITREG_RAX, depth - 1);
+				AddExit(m_asm.Jmp(), false);
+				break;
+
+			case VMI_JMP:
+				AddFixup(m_asm.Jmp(), operand);
+				break;
+
+			case VMI_JZ:
+				LoadSlot(JITREG_RAX, depth - 1);
+				m_asm.Test(JITREG_RAX, JITREG_RAX);
+				AddFixup(m_asm.Jcc(JITCC_E), operand);
+				break;
+
+			case VMI_STORESF:
+			case VMI_STORESI:
+			case VMI_STORESB:
+				LoadSlot(JITREG_RAX, depth - 1);
+				m_asm.MovMemReg(JITREG_RBP, operand * 4, JITREG_RAX);
+				break;
+
+			case VMI_STORELF:
+			case VMI_STORELI:
+			case VMI_STORELB:
+				LoadSlot(JITREG_RAX, depth - 1);
+				m_asm.MovMemReg(JITREG_RSP, m_localOffset + operand * 4, JITREG_RAX);
+				break;
+
+			case VMI_STOREPF:
+			case VMI_STOREPI:
+			case VMI_STOREPB:
+				LoadSlot(JITREG_RAX, depth - 1);
+				m_asm.MovMemReg(JITREG_RSP, m_argOffset + operand * 4, JITREG_RAX);
+				break;
+
+			case VMI_FETCHSF:
+			case VMI_FETCHSI:
+				m_asm.MovRegMem(JITREG_RAX, JITREG_RBP, operand * 4);
+				StoreSlot(depth, JITREG_RAX);
+				break;
+
+			case VMI_FETCHSB:
+				m_asm.MovRegMem(JITREG_RAX, JITREG_RBP, operand * 4);
+				m_asm.Test(JITREG_RAX, JITREG_RAX);
+				m_asm.Setcc(JITCC_NE, JITREG_RAX);
+				m_asm.MovzxEaxAl();
+				StoreSlot(depth, JITREG_RAX);
+				break;
+
+			case VMI_FETCHLF:
+			case VMI_FETCHLI:
+			case VMI_FETCHLB:
+				m_asm.MovRegMem(JITREG_RAX, JITREG_RSP, m_localOffset + operand * 4);
+				StoreSlot(depth, JITREG_RAX);
+				break;
+
+			case VMI_FETCHPF:
+			case VMI_FETCHPI:
+			case VMI_FETCHPB:
+				m_asm.MovRegMem(JITREG_RAX, JITREG_RSP, m_argOffset + operand * 4);
+				StoreSlot(depth, JITREG_RAX);
+				break;
+
+			case VMI_PUSHF:
+			case VMI_PUSHI:
+				m_asm.MovRegImm(JITREG_RAX, m_code[pc + 1]);
+				StoreSlot(depth, JITREG_RAX);
+				break;
+
+			case VMI_PUSHB:
+				m_asm.MovRegImm(JITREG_RAX, operand != 0 ? 1 : 0);
+				StoreSlot(depth, JITREG_RAX);
+				break;
+
+			case VMI_POP:
+				break;
+
+			case VMI_NEGF:
+				LoadSlot(JITREG_RAX, depth - 1);
+				m_asm.XorEaxImm(0x80000000);
+				StoreSlot(depth - 1, JITREG_RAX);
+				break;
+
+			case VMI_NEGI:
+				LoadSlot(JITREG_RAX, depth - 1);
+				m_asm.Neg(JITREG_RAX);
+				StoreSlot(depth - 1, JITREG_RAX);
+				break;
+
+			case VMI_NOT:
+				LoadSlot(JITREG_RAX, depth - 1);
+				m_asm.XorEaxImm(1);
+				StoreSlot(depth - 1, JITREG_RAX);
+				break;
+
+			case VMI_DIVII:
+				LoadOperands(depth);
+				m_asm.Idiv(JITREG_RCX);
+				StoreSlot(depth - 2, JITREG_RAX);
+				break;
+
+			case VMI_MOD:
+				LoadOperands(depth);
+				m_asm.Idiv(JITREG_RCX);
+				StoreSlot(depth - 2, JITREG_RDX);
+				break;
+
+			case VMI_MULII:
+				LoadOperands(depth);
+				m_asm.Imul(JITREG_RAX, JITREG_RCX);
+				StoreSlot(depth - 2, JITREG_RAX);
+				break;
+
+			case VMI_SUBII:
+				LoadOperands(depth);
+				m_asm.Sub(JITREG_RAX, JITREG_RCX);
+				StoreSlot(depth - 2, JITREG_RAX);
+				break;
+
+			case VMI_ADDII:
+				LoadOperands(depth);
+				m_asm.Add(JITREG_RAX, JITREG_RCX);
+				StoreSlot(depth - 2, JITREG_RAX);
+				break;
+
+			case VMI_DIVFF: EmitFloatArith(depth, 0x5E, false, false); break;
+			case VMI_DIVFI: EmitFloatArith(depth, 0x5E, false, true); break;
+			case VMI_DIVIF: EmitFloatArith(depth, 0x5E, true, false); break;
+			case VMI_MULFF: EmitFloatArith(depth, 0x59, false, false); break;
+			case VMI_MULFI: EmitFloatArith(depth, 0x59, false, true); break;
+			case VMI_MULIF: EmitFloatArith(depth, 0x59, true, false); break;
+			case VMI_SUBFF: EmitFloatArith(depth, 0x5C, false, false); break;
+			case VMI_SUBFI: EmitFloatArith(depth, 0x5C, false, true); break;
+			case VMI_SUBIF: EmitFloatArith(depth, 0x5C, true, false); break;
+			case VMI_ADDFF: EmitFloatArith(depth, 0x58, false, false); break;
+			case VMI_ADDFI: EmitFloatArith(depth, 0x58, false, true); break;
+			case VMI_ADDIF: EmitFloatArith(depth, 0x58, true, false); break;
+
+			case VMI_EQII: EmitIntCompare(depth, JITCC_E); break;
+			case VMI_EQBB: EmitIntCompare(depth, JITCC_E); break;
+			case VMI_LTEQII: EmitIntCompare(depth, JITCC_LE); break;
+			case VMI_LTII: EmitIntCompare(depth, JITCC_L); break;
+			case VMI_GTEQII: EmitIntCompare(depth, JITCC_GE); break;
+			case VMI_GTII: EmitIntCompare(depth, JITCC_G); break;
+
+			case VMI_EQFF: EmitFloatEquals(depth, false, false); break;
+			case VMI_EQFI: EmitFloatEquals(depth, false, true); break;
+			case VMI_EQIF: EmitFloatEquals(depth, true, false); break;
+
+			//a < b and a <= b as b > a and b >= a, which are false when unordered
+			case VMI_LTEQFF: EmitFloatCompare(depth, JITCC_AE, true, false, false); break;
+			case VMI_LTEQFI: EmitFloatCompare(depth, JITCC_AE, true, false, true); break;
+			case VMI_LTEQIF: EmitFloatCompare(depth, JITCC_AE, true, true, false); break;
+			case VMI_LTFF: EmitFloatCompare(depth, JITCC_A, true, false, false); break;
+			case VMI_LTFI: EmitFloatCompare(depth, JITCC_A, true, false, true); break;
+			case VMI_LTIF: EmitFloatCompare(depth, JITCC_A, true, true, false); break;
+			case VMI_GTEQFF: EmitFloatCompare(depth, JITCC_AE, false, false, false); break;
+			case VMI_GTEQFI: EmitFloatCompare(depth, JITCC_AE, false, false, true); break;
+			case VMI_GTEQIF: EmitFloatCompare(depth, JITCC_AE, false, true, false); break;
+			case VMI_GTFF: EmitFloatCompare(depth, JITCC_A, false, false, false); break;
+			case VMI_GTFI: EmitFloatCompare(depth, JITCC_A, false, false, true); break;
+			case VMI_GTIF: EmitFloatCompare(depth, JITCC_A, false, true, false); break;
+
+			case VMI_AND:
+				LoadOperands(depth);
+				m_asm.And(JITREG_RAX, JITREG_RCX);
+				StoreSlot(depth - 2, JITREG_RAX);
+				break;
+
+			case VMI_OR:
+				LoadOperands(depth);
+				m_asm.Or(JITREG_RAX, JITREG_RCX);
+				StoreSlot(depth - 2, JITREG_RAX);
+				break;
+
+			case VMI_CALLF_SELF_G:
+			case VMI_CALLF_SUPER_G:
+			case VMI_CALLF_SELF_D:
+			case VMI_TAILCALLF_SELF_G:
+			case VMI_TAILCALLF_SUPER_G:
+			case VMI_TAILCALLF_SELF_D:
+				EmitCall(pc, depth);
+				break;
+
+			default:
+				//Analyze let only the instructions above through
+				DSR_ASSERT(false);
+				break;
+			}
+		}
+
+	private:
+		class Fixup
+		{
+		public:
+			DSR_NEWDELETE(Fixup)
+
+			uint32 pos;
+			uint32 targetPc;
+		};
+
+		class Exit
+		{
+		public:
+			DSR_NEWDELETE(Exit)
+
+			uint32 pos;
+			bool fail;
+		};
+
+		Jit* m_pJit;
+		const ScriptedFunctionImplementation* m_pImpl;
+		const VMCodeBlock& m_code;
+		const uint8* m_pFailed;
+		JitAssembler m_asm;
+		Array<int32> m_depths;
+		/// machine code offset of each instruction
+		Array<uint32> m_offsets;
+		/// jumps to instructions, at most one per instruction
+		Array<Fixup> m_fixups;
+		uint32 m_numFixups;
+		/// jumps to the epilogue
+		Array<Exit> m_exits;
+		uint32 m_numExits;
+		uint32 m_maxDepth;
+		uint32 m_maxCallArgs;
+		uint32 m_outOffset;
+		uint32 m_argOffset;
+		uint32 m_localOffset;
+		uint32 m_spillOffset;
+		uint32 m_instanceOffset;
+		uint32 m_frameSize;
+		uint32 m_failOffset;
+		uint32 m_exitOffset;
+	};
+
+	//-------------------------------------------------------------------------
+	Jit::Jit()
+	: m_threshold(DEFAULT_THRESHOLD)
+	{
+		m_state.failed = 0;
+		m_state.depth = 0;
+		m_state.pTailCallee = 0;
+	}
+
+	JitFunction* Jit::Compile(const ScriptedFunctionImplementation* pImpl)
+	{
+		DSR_ASSERT(pImpl);
+
+		//arguments and locals hold raw values
+		if (!JitCanCall(pImpl->GetFunctionDefinitionPtr()))
+			return 0;
+		for (uint32 i=0; i<pImpl->GetNumLocals(); ++i)
+		{
+			if (pImpl->GetLocalVMDataType(i).IsNative())
+				return 0;
+		}
+
+		JitFunctionCompiler compiler(this, pImpl, &m_state.failed);
+		if (!compiler.Compile())
+			return 0;
+
+		return (JitFunction*) m_codeHeap.Add(compiler.GetCode(), compiler.GetSize());
+	}
+
+	bool Jit::Invoke(const FunctionImplementation* pCallee, ScriptInstance* pInstance, const uint32* pArgs, uint32* pResult)
+	{
+		DSR_ASSERT(pCallee);
+		DSR_ASSERT(pInstance);
+		DSR_ASSERT(pResult);
+
+		//tail calls of compiled functions continue here, at the same depth
+		VMStack& vmStack = ScriptManagerPtr()->GetVMStack();
+		uint32 args[MAX_ARGS];
+		while (true)
+		{
+			JitFunction* pFnc = 0;
+			if (!pCallee->IsNative() && CanInvoke())
+				pFnc = static_cast<const ScriptedFunctionImplementation*>(pCallee)->GetJitFunction();
+			if (!pFnc)
+				return CallInterpreted(pCallee, pInstance, pArgs, pResult);
+
+			//the frame only counts toward the limits, and keeps the instance
+			const ScriptedFunctionImplementation* pImpl = static_cast<const ScriptedFunctionImplementation*>(pCallee);
+			if (vmStack.PushFrame(pImpl, pInstance, vmStack.GetNumValues(), 0, 0))
+			{
+				++m_state.depth;
+				*pResult = pFnc(pArgs, pInstance->GetInstanceData(), pInstance);
+				--m_state.depth;
+				vmStack.PopFrame();
+			}
+			else
+			{
+				Fail();
+			}
+
+			//compiled callers return one after the other, the outermost clears the flag
+			if (m_state.failed)
+			{
+				m_state.pTailCallee = 0;
+				if (m_state.depth == 0)
+					m_state.failed = 0;
+				return false;
+			}
+
+			if (!m_state.pTailCallee)
+				return true;
+
+			pCallee = m_state.pTailCallee;
+			m_state.pTailCallee = 0;
+			for (uint32 i=0; i<pCallee->GetFunctionDefinitionPtr()->GetNumArgs(); ++i)
+				args[i] = m_state.tailArgs[i];
+			pArgs = args;
+		}
+	}
+
+	uint32 Jit::ToRaw(const VMData& data)
+	{
+		switch (data.GetVMDataType().GetVMDataTypeEnum())
+		{
+		case VMDATATYPE_FLOAT:
+			{
+				const float val = data.GetFloat();
+				return *((uint32*) &val);
+			}
+		case VMDATATYPE_BOOL:
+			return data.GetBool() ? 1 : 0;
+		case VMDATATYPE_INT:
+			return (uint32) data.GetInt();
+		default:
+			DSR_ASSERT(false);
+			return 0;
+		}
+	}
+
+	void Jit::FromRaw(uint32 raw, VMDataType type, VMData* pData)
+	{
+		switch (type.GetVMDataTypeEnum())
+		{
+		case VMDATATYPE_FLOAT:
+			pData->Set(*((float*) &raw));
+			break;
+		case VMDATATYPE_BOOL:
+			pData->Set(raw != 0);
+			break;
+		default:
+			DSR_ASSERT(!type.IsNative());
+			pData->Set((int32) raw);
+			break;
+		}
+	}
+
+	uint32 Jit::CallStatic(Jit* pJit, ScriptInstance* pInstance, const uint32* pArgs, const FunctionImplementation* pCallee)
+	{
+		return pJit->Call(pCallee, pInstance, pArgs);
+	}
+
+	uint32 Jit::CallVirtual(Jit* pJit, ScriptInstance* pInstance, const uint32* pArgs, size_t fnIdx)
+	{
+		return pJit->Call(pInstance->GetScriptClassPtr()->GetFunctionImplementationPtr((uint32) fnIdx), pInstance, pArgs);
+	}
+
+	uint32 Jit::TailCallStatic(Jit* pJit, ScriptInstance* pInstance, const uint32* pArgs, const FunctionImplementation* pCallee)
+	{
+		pJit->SetTailCall(pCallee, pArgs);
+		return 0;
+	}
+
+	uint32 Jit::TailCallVirtual(Jit* pJit, ScriptInstance* pInstance, const uint32* pArgs, size_t fnIdx)
+	{
+		pJit->SetTailCall(pInstance->GetScriptClassPtr()->GetFunctionImplementationPtr((uint32) fnIdx), pArgs);
+		return 0;
+	}
+
+	uint32 Jit::Call(const FunctionImplementation* pCallee, ScriptInstance* pInstance, const uint32* pArgs)
+	{
+		DSR_ASSERT(pCallee);
+
+		//a failed call sets the flag compiled code checks
+		uint32 result = 0;
+		Invoke(pCallee, pInstance, pArgs, &result);
+		return result;
+	}
+
+	void Jit::SetTailCall(const FunctionImplementation* pCallee, const uint32* pArgs)
+	{
+		DSR_ASSERT(pCallee);
+		DSR_ASSERT(!m_state.pTailCallee);
+
+		m_state.pTailCallee = pCallee;
+		for (uint32 i=0; i<pCallee->GetFunctionDefinitionPtr()->GetNumArgs(); ++i)
+			m_state.tailArgs[i] = pArgs[i];
+	}
+
+	bool Jit::CallInterpreted(const FunctionImplementation* pCallee, ScriptInstance* pInstance, const uint32* pArgs, uint32* pResult)
+	{
+		const FunctionDefinition* pDef = pCallee->GetFunctionDefinitionPtr();
+		VMStack& vmStack = ScriptManagerPtr()->GetVMStack();
+		const bool overflowed = vmStack.HasOverflowed();
+
+		//the args go to the callee from here, without an args array
+		DSR_ASSERT(pDef->GetNumArgs() <= MAX_ARGS);
+		VMData args[MAX_ARGS];
+		for (uint32 i=0; i<pDef->GetNumArgs(); ++i)
+			FromRaw(pArgs[i], pDef->GetArgVMDataType(i), &args[i]);
+
+		VMData retVal;
+		pCallee->CallSpan(pInstance, args, pDef->GetNumArgs(), &retVal);
+		if (!overflowed && vmStack.HasOverflowed())
+		{
+			Fail();
+			return false;
+		}
+
+		*pResult = ToRaw(retVal);
+		return true;
+	}
+
+	void Jit::Fail()
+	{
+		m_state.failed = 1;
+		ScriptManagerPtr()->GetVMStack().m_overflowed = true;
+	}
+}
+
+#endif
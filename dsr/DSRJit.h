@@ -0,0 +1,137 @@
+
+#if !defined(DSR_JIT_H_)
+#define DSR_JIT_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRVMData.h"
+
+#if DSR_JIT
+
+namespace dsr
+{
+	class ScriptInstance;
+	class FunctionImplementation;
+	class ScriptedFunctionImplementation;
+	class JitFunctionCompiler;
+
+	/// Compiled scripted function.  Arguments and result are raw 32 bit values, floats
+	/// as their bits and bools as 0 or 1.
+	typedef uint32 JitFunction(const uint32* pArgs, int32* pInstanceData, ScriptInstance* pInstance);
+
+	//------------------------------------------------------------------------------------
+	/// Executable memory for compiled functions, allocated in chunks of pages.  A chunk is
+	/// only writable while code is copied into it.
+	class JitCodeHeap
+	{
+		DSR_NOCOPY(JitCodeHeap)
+	public:
+		DSR_NEWDELETE(JitCodeHeap)
+
+		JitCodeHeap();
+		~JitCodeHeap();
+
+		/// copies code in, 0 if there's no memory left
+		void* Add(const uint8* pCode, uint32 size);
+		uint32 GetNumBytes() const { return m_numBytes; }
+
+	private:
+		class Chunk
+		{
+		public:
+			DSR_NEWDELETE(Chunk)
+
+			uint8* pPages;
+			uint32 size;
+			uint32 used;
+			Chunk* pNext;
+		};
+
+		Chunk* m_pChunks;
+		uint32 m_numBytes;
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Baseline compiler from a scripted function's bytecode to x86-64 machine code.  Every
+	/// instruction becomes a fixed template.  Operand stack slots are assigned at compile
+	/// time, the lowest ones to registers and the rest to the native stack frame.
+	///
+	/// Functions over numbers and bools get compiled once they've been called often
+	/// enough.  Calls, except those of instances on the operand stack, go through the
+	/// runtime.  Functions using native types, new or instance calls stay interpreted, as
+	/// does everything when the threshold is 0.  Compiled functions only run on the
+	/// ScriptManager's VMStack, script tasks always interpret so they can be suspended.
+	class Jit
+	{
+		DSR_NOCOPY(Jit)
+	public:
+		DSR_NEWDELETE(Jit)
+
+		enum
+		{
+			DEFAULT_THRESHOLD = 1000,
+			MAX_ARGS = 16,
+			/// compiled calls nested on the native stack, deeper callees are interpreted
+			MAX_DEPTH = 128,
+		};
+
+		Jit();
+
+		/// calls of a function before it's compiled, 0 turns compiling off
+		void SetThreshold(uint32 threshold) { m_threshold = threshold; }
+		uint32 GetThreshold() const { return m_threshold; }
+		const JitCodeHeap& GetCodeHeap() const { return m_codeHeap; }
+
+		/// machine code for pImpl, 0 if it uses something compiled code doesn't support
+		JitFunction* Compile(const ScriptedFunctionImplementation* pImpl);
+		/// Calls pCallee, compiled or not, with raw arguments.  A compiled callee gets an
+		/// empty VM frame, which counts toward the VMStack's limits and keeps its instance.
+		/// Past MAX_DEPTH the callee is interpreted, and so are the calls it makes.  False
+		/// if the call overflowed, the VMStack's overflow flag is set then.
+		bool Invoke(const FunctionImplementation* pCallee, ScriptInstance* pInstance, const uint32* pArgs, uint32* pResult);
+		/// false while compiled calls are nested MAX_DEPTH deep, callers interpret then
+		bool CanInvoke() const { return m_state.depth < MAX_DEPTH; }
+
+		static uint32 ToRaw(const VMData& data);
+		static void FromRaw(uint32 raw, VMDataType type, VMData* pData);
+
+	private:
+		friend class JitFunctionCompiler;
+
+		/// State compiled code reads, at a fixed address
+		class State
+		{
+		public:
+			DSR_NEWDELETE(State)
+
+			/// set when a call overflowed, compiled code returns right away then
+			uint8 failed;
+			uint32 depth;
+			/// function a compiled tail call continues with, once the caller returned
+			const FunctionImplementation* pTailCallee;
+			uint32 tailArgs[MAX_ARGS];
+		};
+
+		//called by compiled code
+		static uint32 CallStatic(Jit* pJit, ScriptInstance* pInstance, const uint32* pArgs, const FunctionImplementation* pCallee);
+		static uint32 CallVirtual(Jit* pJit, ScriptInstance* pInstance, const uint32* pArgs, size_t fnIdx);
+		static uint32 TailCallStatic(Jit* pJit, ScriptInstance* pInstance, const uint32* pArgs, const FunctionImplementation* pCallee);
+		static uint32 TailCallVirtual(Jit* pJit, ScriptInstance* pInstance, const uint32* pArgs, size_t fnIdx);
+
+		uint32 Call(const FunctionImplementation* pCallee, ScriptInstance* pInstance, const uint32* pArgs);
+		void SetTailCall(const FunctionImplementation* pCallee, const uint32* pArgs);
+		bool CallInterpreted(const FunctionImplementation* pCallee, ScriptInstance* pInstance, const uint32* pArgs, uint32* pResult);
+		void Fail();
+
+	private:
+		State m_state;
+		uint32 m_threshold;
+		JitCodeHeap m_codeHeap;
+	};
+}
+
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+
+#if !defined(DSR_JITMEMORY_H_)
+#define DSR_JITMEMORY_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+
+namespace dsr
+{
+	/// Pages for machine code, size a multiple of the page size.  Mapped read/write, 0 if
+	/// the system has none left.
+	void* JitAllocPages(uint32 size);
+	void JitFreePages(void* pPages, uint32 size);
+	/// switches pages between read/write, while code is copied in, and read/execute
+	bool JitProtectPages(void* pPages, uint32 size, bool executable);
+	uint32 JitGetPageSize();
+}
+
+#endif
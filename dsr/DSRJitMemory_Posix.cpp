@@ -0,0 +1,32 @@
+#include "DSRJitMemory.h"
+
+#if !defined(_WIN32)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace dsr
+{
+	void* JitAllocPages(uint32 size)
+	{
+		void* pPages = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return (pPages == MAP_FAILED) ? 0 : pPages;
+	}
+
+	void JitFreePages(void* pPages, uint32 size)
+	{
+		munmap(pPages, size);
+	}
+
+	bool JitProtectPages(void* pPages, uint32 size, bool executable)
+	{
+		return mprotect(pPages, size, executable ? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE)) == 0;
+	}
+
+	uint32 JitGetPageSize()
+	{
+		return (uint32) sysconf(_SC_PAGESIZE);
+	}
+}
+
+#endif
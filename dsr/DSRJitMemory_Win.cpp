@@ -0,0 +1,33 @@
+#include <windows.h>
+#include "DSRJitMemory.h"
+
+namespace dsr
+{
+	void* JitAllocPages(uint32 size)
+	{
+		return VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	}
+
+	void JitFreePages(void* pPages, uint32 size)
+	{
+		VirtualFree(pPages, 0, MEM_RELEASE);
+	}
+
+	bool JitProtectPages(void* pPages, uint32 size, bool executable)
+	{
+		DWORD oldProtect;
+		if (!VirtualProtect(pPages, size, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &oldProtect))
+			return false;
+
+		if (executable)
+			FlushInstructionCache(GetCurrentProcess(), pPages, size);
+		return true;
+	}
+
+	uint32 JitGetPageSize()
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return (uint32) info.dwPageSize;
+	}
+}
@@ -0,0 +1,342 @@
+
+#if !defined(DSR_NATIVEBINDING_H_)
+#define DSR_NATIVEBINDING_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRVMData.h"
+#include "DSRFunction.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptInstance.h"
+
+namespace dsr
+{
+	//------------------------------------------------------------------------------------
+	/// Script type of a C++ type.  Bindings of functions with other types don't compile.
+	template <class T> class NativeValue;
+
+	template <> class NativeValue<int32>
+	{
+	public:
+		static VMDataTypeEnum GetType() { return VMDATATYPE_INT; }
+		static int32 Get(const VMData& data) { return data.GetInt(); }
+		static void Set(VMData* pData, int32 val) { pData->Set(val); }
+	};
+
+	template <> class NativeValue<float>
+	{
+	public:
+		static VMDataTypeEnum GetType() { return VMDATATYPE_FLOAT; }
+		static float Get(const VMData& data) { return data.GetFloat(); }
+		static void Set(VMData* pData, float val) { pData->Set(val); }
+	};
+
+	template <> class NativeValue<bool>
+	{
+	public:
+		static VMDataTypeEnum GetType() { return VMDATATYPE_BOOL; }
+		static bool Get(const VMData& data) { return data.GetBool(); }
+		static void Set(VMData* pData, bool val) { pData->Set(val); }
+	};
+
+	template <> class NativeValue<void>
+	{
+	public:
+		static VMDataTypeEnum GetType() { return VMDATATYPE_VOID; }
+		static void Get(const VMData& data) {}
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Native function bound with its C++ signature, see BindNative.  Reads its arguments
+	/// straight from the calling script's values.
+	class NativeBinding
+	{
+		DSR_NOCOPY(NativeBinding)
+	public:
+		DSR_NEWDELETE(NativeBinding)
+
+		enum
+		{
+			MAX_ARGS = 6,
+		};
+
+		virtual ~NativeBinding() {}
+		/// pArgs points at GetNumArgs() values, retVal can be pArgs[0]
+		virtual void Call(ScriptInstance* pInstance, const VMData* pArgs, VMData* retVal) const = 0;
+
+		/// VMDATATYPE_VOID for functions without result
+		VMDataTypeEnum GetReturnType() const { return m_returnType; }
+		uint32 GetNumArgs() const { return m_numArgs; }
+		VMDataTypeEnum GetArgType(uint32 idx) const { DSR_ASSERT(idx < m_numArgs); return m_argTypes[idx]; }
+
+		/// True if the C++ types are the ones of def.  Functions without result bind to int
+		/// results, which is what void script functions return.
+		bool Matches(const FunctionDefinition& def) const
+		{
+			return Matches(def, m_returnType, m_numArgs, m_argTypes);
+		}
+
+		/// same for a signature given by its types
+		static bool Matches(const FunctionDefinition& def, VMDataTypeEnum returnType, uint32 numArgs, const VMDataTypeEnum* pArgTypes)
+		{
+			if (def.GetNumArgs() != numArgs)
+				return false;
+			for (uint32 i=0; i<numArgs; ++i)
+			{
+				if (def.GetArgVMDataType(i).GetVMDataTypeEnum() != pArgTypes[i])
+					return false;
+			}
+
+			const VMDataTypeEnum defReturnType = def.GetReturnVMDataType().GetVMDataTypeEnum();
+			return defReturnType == returnType || (returnType == VMDATATYPE_VOID && defReturnType == VMDATATYPE_INT);
+		}
+
+	protected:
+		NativeBinding(VMDataTypeEnum returnType, uint32 numArgs, const VMDataTypeEnum* pArgTypes)
+		: m_returnType(returnType), m_numArgs(numArgs)
+		{
+			DSR_ASSERT(numArgs <= MAX_ARGS);
+			for (uint32 i=0; i<numArgs; ++i)
+				m_argTypes[i] = pArgTypes[i];
+		}
+
+	private:
+		VMDataTypeEnum m_returnType;
+		uint32 m_numArgs;
+		VMDataTypeEnum m_argTypes[MAX_ARGS];
+	};
+
+	//------------------------------------------------------------------------------------
+	//calls of bound functions, one overload per number of arguments.  the ones for
+	//functions without result are picked over the others as they are more specialized.
+	//retVal may be the first argument, it's only set once the arguments are read.
+	template <class R> void NativeInvoke(R (*pFnc)(), const VMData* pArgs, VMData* retVal)
+	{
+		NativeValue<R>::Set(retVal, pFnc());
+	}
+
+	DSR_INLINE void NativeInvoke(void (*pFnc)(), const VMData* pArgs, VMData* retVal)
+	{
+		pFnc();
+		retVal->Set(0);
+	}
+
+	template <class C, class R> void NativeInvoke(C* pObj, R (C::*pFnc)(), const VMData* pArgs, VMData* retVal)
+	{
+		NativeValue<R>::Set(retVal, (pObj->*pFnc)());
+	}
+
+	template <class C> void NativeInvoke(C* pObj, void (C::*pFnc)(), const VMData* pArgs, VMData* retVal)
+	{
+		(pObj->*pFnc)();
+		retVal->Set(0);
+	}
+
+	template <class C, class R> void NativeInvoke(C* pObj, R (C::*pFnc)() const, const VMData* pArgs, VMData* retVal)
+	{
+		NativeValue<R>::Set(retVal, (pObj->*pFnc)());
+	}
+
+	template <class C> void NativeInvoke(C* pObj, void (C::*pFnc)() const, const VMData* pArgs, VMData* retVal)
+	{
+		(pObj->*pFnc)();
+		retVal->Set(0);
+	}
+
+	//argument lists of the overloads with arguments
+	#define DSR_NATIVE_TYPENAMES_1 class A0
+	#define DSR_NATIVE_TYPENAMES_2 DSR_NATIVE_TYPENAMES_1, class A1
+	#define DSR_NATIVE_TYPENAMES_3 DSR_NATIVE_TYPENAMES_2, class A2
+	#define DSR_NATIVE_TYPENAMES_4 DSR_NATIVE_TYPENAMES_3, class A3
+	#define DSR_NATIVE_TYPENAMES_5 DSR_NATIVE_TYPENAMES_4, class A4
+	#define DSR_NATIVE_TYPENAMES_6 DSR_NATIVE_TYPENAMES_5, class A5
+	#define DSR_NATIVE_PARAMS_1 A0
+	#define DSR_NATIVE_PARAMS_2 DSR_NATIVE_PARAMS_1, A1
+	#define DSR_NATIVE_PARAMS_3 DSR_NATIVE_PARAMS_2, A2
+	#define DSR_NATIVE_PARAMS_4 DSR_NATIVE_PARAMS_3, A3
+	#define DSR_NATIVE_PARAMS_5 DSR_NATIVE_PARAMS_4, A4
+	#define DSR_NATIVE_PARAMS_6 DSR_NATIVE_PARAMS_5, A5
+	#define DSR_NATIVE_ARGS_1 NativeValue<A0>::Get(pArgs[0])
+	#define DSR_NATIVE_ARGS_2 DSR_NATIVE_ARGS_1, NativeValue<A1>::Get(pArgs[1])
+	#define DSR_NATIVE_ARGS_3 DSR_NATIVE_ARGS_2, NativeValue<A2>::Get(pArgs[2])
+	#define DSR_NATIVE_ARGS_4 DSR_NATIVE_ARGS_3, NativeValue<A3>::Get(pArgs[3])
+	#define DSR_NATIVE_ARGS_5 DSR_NATIVE_ARGS_4, NativeValue<A4>::Get(pArgs[4])
+	#define DSR_NATIVE_ARGS_6 DSR_NATIVE_ARGS_5, NativeValue<A5>::Get(pArgs[5])
+	#define DSR_NATIVE_TYPES_1 NativeValue<A0>::GetType()
+	#define DSR_NATIVE_TYPES_2 DSR_NATIVE_TYPES_1, NativeValue<A1>::GetType()
+	#define DSR_NATIVE_TYPES_3 DSR_NATIVE_TYPES_2, NativeValue<A2>::GetType()
+	#define DSR_NATIVE_TYPES_4 DSR_NATIVE_TYPES_3, NativeValue<A3>::GetType()
+	#define DSR_NATIVE_TYPES_5 DSR_NATIVE_TYPES_4, NativeValue<A4>::GetType()
+	#define DSR_NATIVE_TYPES_6 DSR_NATIVE_TYPES_5, NativeValue<A5>::GetType()
+
+	#define DSR_NATIVE_INVOKE(N)																	\
+	template <class R, DSR_NATIVE_TYPENAMES_##N>													\
+	void NativeInvoke(R (*pFnc)(DSR_NATIVE_PARAMS_##N), const VMData* pArgs, VMData* retVal)		\
+	{																								\
+		NativeValue<R>::Set(retVal, pFnc(DSR_NATIVE_ARGS_##N));										\
+	}																								\
+	template <DSR_NATIVE_TYPENAMES_##N>																\
+	void NativeInvoke(void (*pFnc)(DSR_NATIVE_PARAMS_##N), const VMData* pArgs, VMData* retVal)		\
+	{																								\
+		pFnc(DSR_NATIVE_ARGS_##N);																	\
+		retVal->Set(0);																				\
+	}																								\
+	template <class C, class R, DSR_NATIVE_TYPENAMES_##N>											\
+	void NativeInvoke(C* pObj, R (C::*pFnc)(DSR_NATIVE_PARAMS_##N), const VMData* pArgs, VMData* retVal)	\
+	{																								\
+		NativeValue<R>::Set(retVal, (pObj->*pFnc)(DSR_NATIVE_ARGS_##N));							\
+	}																								\
+	template <class C, DSR_NATIVE_TYPENAMES_##N>													\
+	void NativeInvoke(C* pObj, void (C::*pFnc)(DSR_NATIVE_PARAMS_##N), const VMData* pArgs, VMData* retVal)	\
+	{																								\
+		(pObj->*pFnc)(DSR_NATIVE_ARGS_##N);															\
+		retVal->Set(0);																				\
+	}																								\
+	template <class C, class R, DSR_NATIVE_TYPENAMES_##N>											\
+	void NativeInvoke(C* pObj, R (C::*pFnc)(DSR_NATIVE_PARAMS_##N) const, const VMData* pArgs, VMData* retVal)	\
+	{																								\
+		NativeValue<R>::Set(retVal, (pObj->*pFnc)(DSR_NATIVE_ARGS_##N));							\
+	}																								\
+	template <class C, DSR_NATIVE_TYPENAMES_##N>													\
+	void NativeInvoke(C* pObj, void (C::*pFnc)(DSR_NATIVE_PARAMS_##N) const, const VMData* pArgs, VMData* retVal)	\
+	{																								\
+		(pObj->*pFnc)(DSR_NATIVE_ARGS_##N);															\
+		retVal->Set(0);																				\
+	}
+
+	DSR_NATIVE_INVOKE(1)
+	DSR_NATIVE_INVOKE(2)
+	DSR_NATIVE_INVOKE(3)
+	DSR_NATIVE_INVOKE(4)
+	DSR_NATIVE_INVOKE(5)
+	DSR_NATIVE_INVOKE(6)
+
+	//------------------------------------------------------------------------------------
+	/// binding of a free function of type F
+	template <class F> class NativeFunctionBinding : public NativeBinding
+	{
+	public:
+		NativeFunctionBinding(F pFnc, VMDataTypeEnum returnType, uint32 numArgs, const VMDataTypeEnum* pArgTypes)
+		: NativeBinding(returnType, numArgs, pArgTypes), m_pFnc(pFnc)
+		{
+		}
+
+		virtual void Call(ScriptInstance* pInstance, const VMData* pArgs, VMData* retVal) const
+		{
+			NativeInvoke(m_pFnc, pArgs, retVal);
+		}
+
+	private:
+		F m_pFnc;
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Binding of a member function of type F.  The script instances the function is called
+	/// for are instances of C, the native class's ScriptInstance its ScriptFactory creates.
+	template <class C, class F> class NativeMethodBinding : public NativeBinding
+	{
+	public:
+		NativeMethodBinding(F pFnc, VMDataTypeEnum returnType, uint32 numArgs, const VMDataTypeEnum* pArgTypes)
+		: NativeBinding(returnType, numArgs, pArgTypes), m_pFnc(pFnc)
+		{
+		}
+
+		virtual void Call(ScriptInstance* pInstance, const VMData* pArgs, VMData* retVal) const
+		{
+			NativeInvoke(static_cast<C*>(pInstance), m_pFnc, pArgs, retVal);
+		}
+
+	private:
+		F m_pFnc;
+	};
+
+	//------------------------------------------------------------------------------------
+	//bindings of functions, one overload per number of arguments
+	template <class R> NativeBinding* NewNativeBinding(R (*pFnc)())
+	{
+		return new NativeFunctionBinding<R (*)()>(pFnc, NativeValue<R>::GetType(), 0, 0);
+	}
+
+	template <class C, class R> NativeBinding* NewNativeBinding(R (C::*pFnc)())
+	{
+		return new NativeMethodBinding<C, R (C::*)()>(pFnc, NativeValue<R>::GetType(), 0, 0);
+	}
+
+	template <class C, class R> NativeBinding* NewNativeBinding(R (C::*pFnc)() const)
+	{
+		return new NativeMethodBinding<C, R (C::*)() const>(pFnc, NativeValue<R>::GetType(), 0, 0);
+	}
+
+	#define DSR_NATIVE_NEWBINDING(N)																\
+	template <class R, DSR_NATIVE_TYPENAMES_##N>													\
+	NativeBinding* NewNativeBinding(R (*pFnc)(DSR_NATIVE_PARAMS_##N))								\
+	{																								\
+		const VMDataTypeEnum argTypes[] = { DSR_NATIVE_TYPES_##N };									\
+		return new NativeFunctionBinding<R (*)(DSR_NATIVE_PARAMS_##N)>(pFnc, NativeValue<R>::GetType(), N, argTypes);	\
+	}																								\
+	template <class C, class R, DSR_NATIVE_TYPENAMES_##N>											\
+	NativeBinding* NewNativeBinding(R (C::*pFnc)(DSR_NATIVE_PARAMS_##N))							\
+	{																								\
+		const VMDataTypeEnum argTypes[] = { DSR_NATIVE_TYPES_##N };									\
+		return new NativeMethodBinding<C, R (C::*)(DSR_NATIVE_PARAMS_##N)>(pFnc, NativeValue<R>::GetType(), N, argTypes);	\
+	}																								\
+	template <class C, class R, DSR_NATIVE_TYPENAMES_##N>											\
+	NativeBinding* NewNativeBinding(R (C::*pFnc)(DSR_NATIVE_PARAMS_##N) const)						\
+	{																								\
+		const VMDataTypeEnum argTypes[] = { DSR_NATIVE_TYPES_##N };									\
+		return new NativeMethodBinding<C, R (C::*)(DSR_NATIVE_PARAMS_##N) const>(pFnc, NativeValue<R>::GetType(), N, argTypes);	\
+	}
+
+	DSR_NATIVE_NEWBINDING(1)
+	DSR_NATIVE_NEWBINDING(2)
+	DSR_NATIVE_NEWBINDING(3)
+	DSR_NATIVE_NEWBINDING(4)
+	DSR_NATIVE_NEWBINDING(5)
+	DSR_NATIVE_NEWBINDING(6)
+
+	#undef DSR_NATIVE_NEWBINDING
+	#undef DSR_NATIVE_INVOKE
+	#undef DSR_NATIVE_TYPENAMES_1
+	#undef DSR_NATIVE_TYPENAMES_2
+	#undef DSR_NATIVE_TYPENAMES_3
+	#undef DSR_NATIVE_TYPENAMES_4
+	#undef DSR_NATIVE_TYPENAMES_5
+	#undef DSR_NATIVE_TYPENAMES_6
+	#undef DSR_NATIVE_PARAMS_1
+	#undef DSR_NATIVE_PARAMS_2
+	#undef DSR_NATIVE_PARAMS_3
+	#undef DSR_NATIVE_PARAMS_4
+	#undef DSR_NATIVE_PARAMS_5
+	#undef DSR_NATIVE_PARAMS_6
+	#undef DSR_NATIVE_ARGS_1
+	#undef DSR_NATIVE_ARGS_2
+	#undef DSR_NATIVE_ARGS_3
+	#undef DSR_NATIVE_ARGS_4
+	#undef DSR_NATIVE_ARGS_5
+	#undef DSR_NATIVE_ARGS_6
+	#undef DSR_NATIVE_TYPES_1
+	#undef DSR_NATIVE_TYPES_2
+	#undef DSR_NATIVE_TYPES_3
+	#undef DSR_NATIVE_TYPES_4
+	#undef DSR_NATIVE_TYPES_5
+	#undef DSR_NATIVE_TYPES_6
+
+	//------------------------------------------------------------------------------------
+	/// Binds pFnc to the native function functionName of pClass, in place of a hand written
+	/// NativeScriptFunction.  pFnc is a free function or a member function of the class's
+	/// C++ instance type, with int32, float and bool arguments and result.  False if the
+	/// class has no such native function or the types don't match its definition.
+	template <class F> bool BindNative(ScriptClass* pClass, const char* functionName, F pFnc)
+	{
+		DSR_ASSERT(pClass);
+		const int32 fncIdx = pClass->GetFunctionVTableIndex(functionName);
+		if (fncIdx < 0)
+			return false;
+
+		return pClass->SetNativeBinding(fncIdx, NewNativeBinding(pFnc));
+	}
+}
+
+#endif
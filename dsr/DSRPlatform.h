@@ -31,4 +31,11 @@
 	#define for	if (0){}else for
 #endif
 
+//baseline compiler from bytecode to machine code, x86-64 only
+#if DSR_TARGET == DSR_TARGET_PC && (defined(_M_X64) || defined(__x86_64__))
+	#define DSR_JIT 1
+#else
+	#define DSR_JIT 0
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+
+#if !defined(DSR_PREPAREDCALL_H_)
+#define DSR_PREPAREDCALL_H_
+
+#include "DSRPlatform.h"
+#include "DSRBaseTypes.h"
+#include "DSRMemory.h"
+#include "DSRVMData.h"
+#include "DSRFunction.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptInstance.h"
+#include "DSRNativeBinding.h"
+
+namespace dsr
+{
+	//------------------------------------------------------------------------------------
+	/// Script function the host calls, found by name and checked against its C++ types once.
+	class PreparedCallBase
+	{
+	public:
+		DSR_NEWDELETE(PreparedCallBase)
+
+		bool IsPrepared() const { return m_pClass != 0; }
+		const ScriptClass* GetScriptClassPtr() const { return m_pClass; }
+		uint32 GetFunctionIndex() const { DSR_ASSERT(m_pClass); return m_fncIdx; }
+
+	protected:
+		PreparedCallBase() : m_pClass(0), m_fncIdx(0) {}
+
+		bool Prepare(const ScriptClass* pClass, const char* functionName, VMDataTypeEnum returnType, uint32 numArgs, const VMDataTypeEnum* pArgTypes)
+		{
+			DSR_ASSERT(pClass);
+			m_pClass = 0;
+			const int32 fncIdx = pClass->GetFunctionVTableIndex(functionName);
+			if (fncIdx < 0 || !NativeBinding::Matches(*pClass->GetFunctionDefinitionPtr(fncIdx), returnType, numArgs, pArgTypes))
+				return false;
+
+			m_pClass = pClass;
+			m_fncIdx = (uint32) fncIdx;
+			return true;
+		}
+
+		/// instances of subclasses run their override, at the same vtable index
+		const FunctionImplementation* GetFunctionImplementationPtr(const ScriptInstance* pInstance) const
+		{
+			DSR_ASSERT(m_pClass);
+			DSR_ASSERT(pInstance);
+			DSR_ASSERT(pInstance->GetScriptClassPtr()->IsA(m_pClass));
+			return pInstance->GetScriptClassPtr()->GetFunctionImplementationPtr(m_fncIdx);
+		}
+
+	private:
+		const ScriptClass* m_pClass;
+		uint32 m_fncIdx;
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Call of a script function with the C++ signature F, e.g. PreparedCall<float (int32)>,
+	/// with int32, float and bool arguments and result.  Prepare looks the function up;
+	/// Call then passes the arguments to it from the native stack and returns its result,
+	/// without looking anything up or allocating.
+	template <class F> class PreparedCall;
+
+	template <class R> class PreparedCall<R ()> : public PreparedCallBase
+	{
+	public:
+		/// false if pClass has no function functionName of type F
+		bool Prepare(const ScriptClass* pClass, const char* functionName)
+		{
+			return PreparedCallBase::Prepare(pClass, functionName, NativeValue<R>::GetType(), 0, 0);
+		}
+
+		R Call(ScriptInstance* pInstance) const
+		{
+			VMData retVal;
+			GetFunctionImplementationPtr(pInstance)->CallSpan(pInstance, 0, 0, &retVal);
+			return NativeValue<R>::Get(retVal);
+		}
+	};
+
+	//lists of the template parameters, parameters, and argument types of each arity
+	#define DSR_PREPARED_TYPENAMES_1 class A1
+	#define DSR_PREPARED_TYPENAMES_2 DSR_PREPARED_TYPENAMES_1, class A2
+	#define DSR_PREPARED_TYPENAMES_3 DSR_PREPARED_TYPENAMES_2, class A3
+	#define DSR_PREPARED_TYPENAMES_4 DSR_PREPARED_TYPENAMES_3, class A4
+	#define DSR_PREPARED_TYPENAMES_5 DSR_PREPARED_TYPENAMES_4, class A5
+	#define DSR_PREPARED_TYPENAMES_6 DSR_PREPARED_TYPENAMES_5, class A6
+	#define DSR_PREPARED_TYPES_1 A1
+	#define DSR_PREPARED_TYPES_2 DSR_PREPARED_TYPES_1, A2
+	#define DSR_PREPARED_TYPES_3 DSR_PREPARED_TYPES_2, A3
+	#define DSR_PREPARED_TYPES_4 DSR_PREPARED_TYPES_3, A4
+	#define DSR_PREPARED_TYPES_5 DSR_PREPARED_TYPES_4, A5
+	#define DSR_PREPARED_TYPES_6 DSR_PREPARED_TYPES_5, A6
+	#define DSR_PREPARED_PARAMS_1 A1 a1
+	#define DSR_PREPARED_PARAMS_2 DSR_PREPARED_PARAMS_1, A2 a2
+	#define DSR_PREPARED_PARAMS_3 DSR_PREPARED_PARAMS_2, A3 a3
+	#define DSR_PREPARED_PARAMS_4 DSR_PREPARED_PARAMS_3, A4 a4
+	#define DSR_PREPARED_PARAMS_5 DSR_PREPARED_PARAMS_4, A5 a5
+	#define DSR_PREPARED_PARAMS_6 DSR_PREPARED_PARAMS_5, A6 a6
+	#define DSR_PREPARED_SETARGS_1 NativeValue<A1>::Set(&args[0], a1);
+	#define DSR_PREPARED_SETARGS_2 DSR_PREPARED_SETARGS_1 NativeValue<A2>::Set(&args[1], a2);
+	#define DSR_PREPARED_SETARGS_3 DSR_PREPARED_SETARGS_2 NativeValue<A3>::Set(&args[2], a3);
+	#define DSR_PREPARED_SETARGS_4 DSR_PREPARED_SETARGS_3 NativeValue<A4>::Set(&args[3], a4);
+	#define DSR_PREPARED_SETARGS_5 DSR_PREPARED_SETARGS_4 NativeValue<A5>::Set(&args[4], a5);
+	#define DSR_PREPARED_SETARGS_6 DSR_PREPARED_SETARGS_5 NativeValue<A6>::Set(&args[5], a6);
+	#define DSR_PREPARED_ARGTYPES_1 NativeValue<A1>::GetType()
+	#define DSR_PREPARED_ARGTYPES_2 DSR_PREPARED_ARGTYPES_1, NativeValue<A2>::GetType()
+	#define DSR_PREPARED_ARGTYPES_3 DSR_PREPARED_ARGTYPES_2, NativeValue<A3>::GetType()
+	#define DSR_PREPARED_ARGTYPES_4 DSR_PREPARED_ARGTYPES_3, NativeValue<A4>::GetType()
+	#define DSR_PREPARED_ARGTYPES_5 DSR_PREPARED_ARGTYPES_4, NativeValue<A5>::GetType()
+	#define DSR_PREPARED_ARGTYPES_6 DSR_PREPARED_ARGTYPES_5, NativeValue<A6>::GetType()
+
+	#define DSR_PREPARED_CALL(N)																	\
+	template <class R, DSR_PREPARED_TYPENAMES_##N> class PreparedCall<R (DSR_PREPARED_TYPES_##N)> : public PreparedCallBase	\
+	{																								\
+	public:																							\
+		bool Prepare(const ScriptClass* pClass, const char* functionName)							\
+		{																							\
+			const VMDataTypeEnum argTypes[] = { DSR_PREPARED_ARGTYPES_##N };						\
+			return PreparedCallBase::Prepare(pClass, functionName, NativeValue<R>::GetType(), N, argTypes);	\
+		}																							\
+																									\
+		R Call(ScriptInstance* pInstance, DSR_PREPARED_PARAMS_##N) const							\
+		{																							\
+			VMData args[N];																			\
+			DSR_PREPARED_SETARGS_##N																\
+			VMData retVal;																			\
+			GetFunctionImplementationPtr(pInstance)->CallSpan(pInstance, args, N, &retVal);		\
+			return NativeValue<R>::Get(retVal);														\
+		}																							\
+	};
+
+	DSR_PREPARED_CALL(1)
+	DSR_PREPARED_CALL(2)
+	DSR_PREPARED_CALL(3)
+	DSR_PREPARED_CALL(4)
+	DSR_PREPARED_CALL(5)
+	DSR_PREPARED_CALL(6)
+
+	#undef DSR_PREPARED_CALL
+	#undef DSR_PREPARED_TYPENAMES_1
+	#undef DSR_PREPARED_TYPENAMES_2
+	#undef DSR_PREPARED_TYPENAMES_3
+	#undef DSR_PREPARED_TYPENAMES_4
+	#undef DSR_PREPARED_TYPENAMES_5
+	#undef DSR_PREPARED_TYPENAMES_6
+	#undef DSR_PREPARED_TYPES_1
+	#undef DSR_PREPARED_TYPES_2
+	#undef DSR_PREPARED_TYPES_3
+	#undef DSR_PREPARED_TYPES_4
+	#undef DSR_PREPARED_TYPES_5
+	#undef DSR_PREPARED_TYPES_6
+	#undef DSR_PREPARED_PARAMS_1
+	#undef DSR_PREPARED_PARAMS_2
+	#undef DSR_PREPARED_PARAMS_3
+	#undef DSR_PREPARED_PARAMS_4
+	#undef DSR_PREPARED_PARAMS_5
+	#undef DSR_PREPARED_PARAMS_6
+	#undef DSR_PREPARED_SETARGS_1
+	#undef DSR_PREPARED_SETARGS_2
+	#undef DSR_PREPARED_SETARGS_3
+	#undef DSR_PREPARED_SETARGS_4
+	#undef DSR_PREPARED_SETARGS_5
+	#undef DSR_PREPARED_SETARGS_6
+	#undef DSR_PREPARED_ARGTYPES_1
+	#undef DSR_PREPARED_ARGTYPES_2
+	#undef DSR_PREPARED_ARGTYPES_3
+	#undef DSR_PREPARED_ARGTYPES_4
+	#undef DSR_PREPARED_ARGTYPES_5
+	#undef DSR_PREPARED_ARGTYPES_6
+}
+
+#endif
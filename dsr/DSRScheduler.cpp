@@ -0,0 +1,185 @@
+
+#include "DSRScheduler.h"
+
+#include "DSRScriptTask.h"
+
+namespace dsr
+{
+	ScriptTaskQueue::ScriptTaskQueue(bool byWakeTime)
+	: m_size(0), m_byWakeTime(byWakeTime)
+	{
+	}
+
+	ScriptTaskQueue::~ScriptTaskQueue()
+	{
+		while (!empty())
+			Pop()->RemoveReference();
+	}
+
+	void ScriptTaskQueue::Push(ScriptTask* pTask, float wakeTime, uint32 order)
+	{
+		DSR_ASSERT(pTask);
+
+		//grow by doubling
+		if (m_size == m_entries.size())
+		{
+			Array<Entry> entries(m_size > 0 ? m_size * 2 : 64);
+			for (uint32 i=0; i<m_size; ++i)
+				entries[i] = m_entries[i];
+			m_entries = entries;
+		}
+
+		Entry entry;
+		entry.pTask = pTask;
+		entry.wakeTime = wakeTime;
+		entry.priority = pTask->GetPriority();
+		entry.order = order;
+		pTask->AddReference();
+
+		//sift up
+		uint32 idx = m_size++;
+		while (idx > 0)
+		{
+			const uint32 parent = (idx - 1) / 2;
+			if (!IsBefore(entry, m_entries[parent]))
+				break;
+			m_entries[idx] = m_entries[parent];
+			idx = parent;
+		}
+		m_entries[idx] = entry;
+	}
+
+	ScriptTask* ScriptTaskQueue::Pop()
+	{
+		DSR_ASSERT(m_size > 0);
+		ScriptTask* pTask = m_entries[0].pTask;
+
+		//sift the last entry down from the top
+		const Entry last = m_entries[--m_size];
+		uint32 idx = 0;
+		while (true)
+		{
+			uint32 child = idx * 2 + 1;
+			if (child >= m_size)
+				break;
+			if (child + 1 < m_size && IsBefore(m_entries[child + 1], m_entries[child]))
+				++child;
+			if (!IsBefore(m_entries[child], last))
+				break;
+			m_entries[idx] = m_entries[child];
+			idx = child;
+		}
+		if (m_size > 0)
+			m_entries[idx] = last;
+
+		return pTask;
+	}
+
+	bool ScriptTaskQueue::IsBefore(const Entry& lhs, const Entry& rhs) const
+	{
+		if (m_byWakeTime && lhs.wakeTime != rhs.wakeTime)
+			return lhs.wakeTime < rhs.wakeTime;
+		if (lhs.priority != rhs.priority)
+			return lhs.priority > rhs.priority;
+		return lhs.order < rhs.order;
+	}
+
+	//-------------------------------------------------------------------------
+	Scheduler::Scheduler()
+	: m_readyIdx(0), m_updating(false), m_sleeping(true), m_pFirstTask(0), m_numTasks(0), m_order(0), m_time(0.0f)
+	{
+	}
+
+	Scheduler::~Scheduler()
+	{
+		DSR_ASSERT(!m_updating);
+		while (m_pFirstTask)
+			m_pFirstTask->Cancel();
+	}
+
+	void Scheduler::Add(ScriptTask* pTask)
+	{
+		DSR_ASSERT(pTask);
+		DSR_ASSERT(!pTask->m_pScheduler);
+		DSR_ASSERT(pTask->m_state == ScriptTask::STATE_READY);
+		DSR_ASSERT(pTask->m_vmStack.GetNumFrames() == 0);
+
+		//the scheduler keeps the task until it finishes
+		pTask->AddReference();
+		pTask->m_pScheduler = this;
+		pTask->m_pPrevTask = 0;
+		pTask->m_pNextTask = m_pFirstTask;
+		if (m_pFirstTask)
+			m_pFirstTask->m_pPrevTask = pTask;
+		m_pFirstTask = pTask;
+		++m_numTasks;
+
+		Ready(pTask);
+	}
+
+	void Scheduler::Update(float time)
+	{
+		DSR_ASSERT(!m_updating);
+		m_time = time;
+
+		//wake the sleeping tasks that are due.  cancelled ones are left behind.
+		while (!m_sleeping.empty() && m_sleeping.GetTopWakeTime() <= m_time)
+		{
+			ScriptTask* pTask = m_sleeping.Pop();
+			if (pTask->m_state == ScriptTask::STATE_SLEEPING)
+			{
+				pTask->m_state = ScriptTask::STATE_READY;
+				Ready(pTask);
+			}
+			pTask->RemoveReference();
+		}
+
+		//run the ready tasks, the ones they make ready go to the other queue
+		m_updating = true;
+		ScriptTaskQueue& ready = m_ready[m_readyIdx];
+		while (!ready.empty())
+		{
+			ScriptTask* pTask = ready.Pop();
+			if (pTask->m_state == ScriptTask::STATE_READY)
+			{
+				pTask->Run();
+
+				if (pTask->m_state == ScriptTask::STATE_READY)
+					Ready(pTask);
+				else if (pTask->m_state == ScriptTask::STATE_SLEEPING)
+					m_sleeping.Push(pTask, pTask->m_wakeTime, m_order++);
+			}
+			pTask->RemoveReference();
+		}
+		m_updating = false;
+		m_readyIdx = 1 - m_readyIdx;
+	}
+
+	void Scheduler::Ready(ScriptTask* pTask)
+	{
+		DSR_ASSERT(pTask->m_state == ScriptTask::STATE_READY);
+		const uint32 idx = m_updating ? 1 - m_readyIdx : m_readyIdx;
+		m_ready[idx].Push(pTask, 0.0f, m_order++);
+	}
+
+	void Scheduler::Remove(ScriptTask* pTask)
+	{
+		DSR_ASSERT(pTask->m_pScheduler == this);
+		DSR_ASSERT(m_numTasks > 0);
+
+		if (pTask->m_pPrevTask)
+			pTask->m_pPrevTask->m_pNextTask = pTask->m_pNextTask;
+		else
+			m_pFirstTask = pTask->m_pNextTask;
+		if (pTask->m_pNextTask)
+			pTask->m_pNextTask->m_pPrevTask = pTask->m_pPrevTask;
+
+		pTask->m_pScheduler = 0;
+		pTask->m_pPrevTask = 0;
+		pTask->m_pNextTask = 0;
+		--m_numTasks;
+
+		//entries left in the queues keep their own references
+		pTask->RemoveReference();
+	}
+}
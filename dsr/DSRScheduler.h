@@ -0,0 +1,104 @@
+
+#if !defined(DSR_SCHEDULER_H_)
+#define DSR_SCHEDULER_H_
+
+#include "DSRPlatform.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRArray.h"
+
+namespace dsr
+{
+	class ScriptTask;
+
+	//------------------------------------------------------------------------------------
+	/// Binary heap of tasks, by priority or by wake time.  Holds a reference to each task
+	/// in it.
+	class ScriptTaskQueue
+	{
+		DSR_NOCOPY(ScriptTaskQueue)
+	public:
+		DSR_NEWDELETE(ScriptTaskQueue)
+
+		explicit ScriptTaskQueue(bool byWakeTime = false);
+		~ScriptTaskQueue();
+
+		bool empty() const { return m_size == 0; }
+		uint32 size() const { return m_size; }
+		/// wake time of the task Pop returns next
+		float GetTopWakeTime() const { DSR_ASSERT(m_size > 0); return m_entries[0].wakeTime; }
+
+		/// order breaks ties, the lower goes first
+		void Push(ScriptTask* pTask, float wakeTime, uint32 order);
+		/// the caller takes over the reference to the task
+		ScriptTask* Pop();
+
+	private:
+		class Entry
+		{
+		public:
+			DSR_NEWDELETE(Entry)
+
+			ScriptTask* pTask;
+			float wakeTime;
+			int32 priority;
+			uint32 order;
+		};
+
+		bool IsBefore(const Entry& lhs, const Entry& rhs) const;
+
+	private:
+		Array<Entry> m_entries;
+		uint32 m_size;
+		bool m_byWakeTime;
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Runs script tasks cooperatively.  Each Update wakes the sleeping tasks that are due,
+	/// then runs every ready task once, the highest priority first and in the order they
+	/// got ready otherwise.  A task runs until it finishes or a native function suspends
+	/// it.  Tasks that get ready during an update run with the next one.
+	///
+	/// Like the rest of the runtime, a scheduler and its tasks belong to the thread that
+	/// runs scripts.
+	class Scheduler
+	{
+		DSR_NOCOPY(Scheduler)
+	public:
+		DSR_NEWDELETE(Scheduler)
+
+		Scheduler();
+		/// cancels the tasks that haven't finished
+		~Scheduler();
+
+		/// the task runs with the next update, the scheduler keeps it until it finishes
+		void Add(ScriptTask* pTask);
+		/// runs the tasks, time being the scheduler's time in seconds
+		void Update(float time);
+
+		float GetTime() const { return m_time; }
+		/// tasks that haven't finished, ready, running or suspended
+		uint32 GetNumTasks() const { return m_numTasks; }
+		uint32 GetNumReadyTasks() const { return m_ready[0].size() + m_ready[1].size(); }
+		uint32 GetNumSleepingTasks() const { return m_sleeping.size(); }
+
+	private:
+		friend class ScriptTask;
+
+		void Ready(ScriptTask* pTask);
+		void Remove(ScriptTask* pTask);
+
+	private:
+		/// tasks ready for this update, and for the next one while this one runs
+		ScriptTaskQueue m_ready[2];
+		uint32 m_readyIdx;
+		bool m_updating;
+		ScriptTaskQueue m_sleeping;
+		ScriptTask* m_pFirstTask;
+		uint32 m_numTasks;
+		uint32 m_order;
+		float m_time;
+	};
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "DSRScriptClass.h"
 #include "DSRScriptFactory.h"
 #include "DSRScriptInstance.h"
+#include "DSRNativeBinding.h"
+#include "DSRScriptManager.h"
 
 namespace dsr
 {
@@ -10,34 +12,61 @@ namespace dsr
 
 	int32 ScriptClass::GetFunctionVTableIndex(const char* functionName) const
 	{
-		for (int32 i=0; i<(int32)m_functionVTable.GetNumFunctions(); ++i)
+		BuildSlotMaps();
+		return GetFunctionVTableIndex(ScriptManagerPtr()->GetAtomTable().Find(functionName));
+	}
+
+	int32 ScriptClass::GetDataTypeIndex(const char* dataName) const
+	{
+		BuildSlotMaps();
+		return GetDataTypeIndex(ScriptManagerPtr()->GetAtomTable().Find(dataName));
+	}
+
+	int32 ScriptClass::GetFunctionVTableIndex(Atom functionName) const
+	{
+		BuildSlotMaps();
+		const uint32* pIdx = m_functionSlots.Find(functionName);
+		return pIdx ? (int32) *pIdx : -1;
+	}
+
+	int32 ScriptClass::GetDataTypeIndex(Atom dataName) const
+	{
+		BuildSlotMaps();
+		const uint32* pIdx = m_dataSlots.Find(dataName);
+		return pIdx ? (int32) *pIdx : -1;
+	}
+
+	void ScriptClass::BuildSlotMaps() const
+	{
+		if (m_functionSlots.IsBuilt())
+			return;
+
+		//the first function of a name wins, as the linear search did
+		m_functionSlots.Reserve(m_functionVTable.GetNumFunctions());
+		AtomTable& atoms = ScriptManagerPtr()->GetAtomTable();
+		for (uint32 i=0; i<m_functionVTable.GetNumFunctions(); ++i)
 		{
-			const char* funcName = m_functionVTable.GetFunctionImplementationPtr(i)->GetFunctionDefinitionPtr()->GetName();
-			if (stricmp(functionName, funcName) == 0)
-				return i;
+			const Atom atom = atoms.Add(m_functionVTable.GetFunctionImplementationPtr(i)->GetFunctionDefinitionPtr()->GetName());
+			if (!m_functionSlots.Find(atom))
+				m_functionSlots.Set(atom, i);
 		}
 
-		return -1;
+		AddDataSlots(m_dataSlots);
 	}
 
-	int32 ScriptClass::GetDataTypeIndex(const char* dataName) const
+	void ScriptClass::AddDataSlots(AtomMap<uint32>& dataSlots) const
 	{
-		for (int32 i=0; i<(int32) m_data.size(); ++i)
+		//own data hides the super class's data of the same name
+		uint32 first = 0;
+		if (m_super)
 		{
-			const char* dName = m_data[i].GetName();
-			if (stricmp(dName, dataName) == 0)
-			{
-				if (m_super)
-					return m_super->GetNumData() + i;
-				else
-					return i;
-			}
+			m_super->AddDataSlots(dataSlots);
+			first = m_super->GetNumData();
 		}
 
-		if (m_super)
-			return m_super->GetDataTypeIndex(dataName);
-		else
-			return -1;
+		AtomTable& atoms = ScriptManagerPtr()->GetAtomTable();
+		for (uint32 i=0; i<m_data.size(); ++i)
+			dataSlots.Set(atoms.Add(m_data[i].GetName()), first + i);
 	}
 
 	const FunctionImplementation* ScriptClass::GetFunctionImplementationPtr(uint32 fnIdx) const
@@ -56,10 +85,15 @@ namespace dsr
 	{
 		DSR_ASSERT(dataIdx >=0 && dataIdx < GetNumData());
 
-		if (m_super && dataIdx < m_super->GetNumData())
+		if (!m_super)
+			return &m_data[dataIdx];
+
+		//this class's data follows the super class's
+		const uint32 numSuperData = m_super->GetNumData();
+		if (dataIdx < numSuperData)
 			return m_super->GetDataTypePtr(dataIdx);
 		else
-			return &m_data[dataIdx];
+			return &m_data[dataIdx - numSuperData];
 	}
 
 	void ScriptClass::SetNativeFunction(uint32 fncIdx, NativeFunctionImplementation::NativeScriptFunction* pFunc)
@@ -82,15 +116,85 @@ namespace dsr
 		pNFI->SetNativeScriptFunction(pFunc);
 	}
 
-	bool ScriptClass::IsA(const ScriptClass* pScriptType) const
+	void ScriptClass::SetNativeFunction(uint32 fncIdx, NativeFunctionImplementation::NativeSpanFunction* pFunc)
 	{
-		if (pScriptType == this)
-			return true;
+		DSR_ASSERT(m_native);
+		DSR_ASSERT(fncIdx >= 0 && fncIdx < GetNumFunctions());
+		DSR_ASSERT(GetFunctionImplementationPtr(fncIdx)->IsNative());
+		DSR_ASSERT(pFunc);
+		NativeFunctionImplementation* pNFI = (NativeFunctionImplementation*) GetFunctionImplementationPtr(fncIdx);
+		pNFI->SetNativeSpanFunction(pFunc);
+	}
 
-		if (!m_super)
+	void ScriptClass::SetNativeConstructor(uint32 cnIdx, NativeFunctionImplementation::NativeSpanFunction* pFunc)
+	{
+		DSR_ASSERT(m_native);
+		DSR_ASSERT(cnIdx >= 0 && cnIdx < GetNumConstructors());
+		DSR_ASSERT(GetConstructorImplementationPtr(cnIdx)->IsNative());
+		DSR_ASSERT(pFunc);
+		NativeFunctionImplementation* pNFI = (NativeFunctionImplementation*) GetConstructorImplementationPtr(cnIdx);
+		pNFI->SetNativeSpanFunction(pFunc);
+	}
+
+	bool ScriptClass::SetNativeBinding(uint32 fncIdx, NativeBinding* pBinding)
+	{
+		DSR_ASSERT(m_native);
+		DSR_ASSERT(pBinding);
+		const FunctionImplementation* pImpl = fncIdx < GetNumFunctions() ? GetFunctionImplementationPtr(fncIdx) : 0;
+		if (!pImpl || !pImpl->IsNative() || pImpl->GetScriptClassPtr() != this || !pBinding->Matches(*GetFunctionDefinitionPtr(fncIdx)))
+		{
+			delete pBinding;
+			return false;
+		}
+
+		NativeFunctionImplementation* pNFI = (NativeFunctionImplementation*) pImpl;
+		pNFI->SetNativeBinding(pBinding);
+		return true;
+	}
+
+	bool ScriptClass::SetCompiledFunction(uint32 fncIdx, uint32 codeHash, NativeFunctionImplementation::NativeScriptFunction* pFunc)
+	{
+		DSR_ASSERT(pFunc);
+		if (fncIdx >= GetNumFunctions())
 			return false;
 
-		return m_super->IsA(pScriptType);
+		//only the class's own code, not what it inherits
+		const FunctionImplementation* pImpl = GetFunctionImplementationPtr(fncIdx);
+		if (pImpl->IsNative() || pImpl->GetScriptClassPtr() != this)
+			return false;
+
+		ScriptedFunctionImplementation* pSFI = (ScriptedFunctionImplementation*) pImpl;
+		if (pSFI->GetCodeHash() != codeHash)
+			return false;
+
+		pSFI->SetCompiledFunction(pFunc);
+		return true;
+	}
+
+	bool ScriptClass::IsA(const ScriptClass* pScriptType) const
+	{
+		DSR_ASSERT(pScriptType);
+
+		//a super class is at its own depth in the ancestors of its subclasses
+		const Array<const ScriptClass*>& ancestors = GetAncestors();
+		const uint32 depth = pScriptType->GetDepth();
+		return depth < ancestors.size() && ancestors[depth] == pScriptType;
+	}
+
+	const Array<const ScriptClass*>& ScriptClass::GetAncestors() const
+	{
+		if (m_ancestors.empty())
+		{
+			//the hierarchy doesn't change once the class is loaded
+			const uint32 depth = m_super ? m_super->GetAncestors().size() : 0;
+			Array<const ScriptClass*> ancestors(depth + 1);
+			for (uint32 i=0; i<depth; ++i)
+				ancestors[i] = m_super->GetAncestors()[i];
+			ancestors[depth] = this;
+			m_ancestors = ancestors;
+		}
+
+		return m_ancestors;
 	}
 
 	const ScriptClass* ScriptClass::GetClosestNativeClassPtr() const
@@ -5,6 +5,8 @@
 #include "DSRArray.h"
 #include "DSRFunction.h"
 #include "DSRFunctionVTable.h"
+#include "DSRAtomTable.h"
+#include "DSRInstanceHeap.h"
 
 namespace dsr
 {
@@ -27,6 +29,9 @@ namespace dsr
 		bool IsNative() const { return m_native; }
 		int32 GetFunctionVTableIndex(const char* functionName) const;
 		int32 GetDataTypeIndex(const char* dataName) const;
+		/// same, for names from ScriptManager::GetAtomTable, without hashing them again
+		int32 GetFunctionVTableIndex(Atom functionName) const;
+		int32 GetDataTypeIndex(Atom dataName) const;
 		const FunctionImplementation* GetFunctionImplementationPtr(uint32 fnIdx) const;
 		const FunctionDefinition* GetFunctionDefinitionPtr(uint32 fnIdx) const;
 		const DataType* GetDataTypePtr(uint32 dataIdx) const;
@@ -53,15 +58,35 @@ namespace dsr
 		//used by factory only
 		void SetNativeFunction(uint32 fncIdx, NativeFunctionImplementation::NativeScriptFunction* pFunc);
 		void SetNativeConstructor(uint32 cnIdx, NativeFunctionImplementation::NativeScriptFunction* pFunc);
+		//same, for functions reading their args off the operand stack
+		void SetNativeFunction(uint32 fncIdx, NativeFunctionImplementation::NativeSpanFunction* pFunc);
+		void SetNativeConstructor(uint32 cnIdx, NativeFunctionImplementation::NativeSpanFunction* pFunc);
+		//takes over pBinding.  false if function fncIdx isn't native or has other types.
+		bool SetNativeBinding(uint32 fncIdx, NativeBinding* pBinding);
+		//used by ScriptManager only.  false if the class doesn't define function fncIdx with
+		//bytecode hashing to codeHash.
+		bool SetCompiledFunction(uint32 fncIdx, uint32 codeHash, NativeFunctionImplementation::NativeScriptFunction* pFunc);
 
-		//is a relationship
+		//is a relationship, a compare once both classes know their ancestors
 		bool IsA(const ScriptClass* pScriptType) const;
+		/// number of super classes above this one
+		uint32 GetDepth() const { return GetAncestors().size() - 1; }
 		const ScriptClass* GetClosestNativeClassPtr() const;
 
 		ScriptInstance* CreateInstance() const;
+		/// the instances of this class, not of the ones derived from it, and their data.  See
+		/// ScriptManager::InstanceIterator for those too.
+		ClassHeap& GetClassHeap() const { return m_classHeap; }
 
 	private:
+		friend class InstanceHeap;
+
 		ScriptClass();
+		/// fills the slot maps on the first lookup by name
+		void BuildSlotMaps() const;
+		void AddDataSlots(AtomMap<uint32>& dataSlots) const;
+		/// the root class first, this one last, filled on the first use
+		const Array<const ScriptClass*>& GetAncestors() const;
 
 	private:
 		String m_name;
@@ -74,6 +99,13 @@ namespace dsr
 		FunctionVTable m_functionVTable;
 		DataTypeArray m_data;
 		ScriptFactory* m_pFactory;
+		/// vtable index of each function name, and data index of each data name, the
+		/// super class's included
+		mutable AtomMap<uint32> m_functionSlots;
+		mutable AtomMap<uint32> m_dataSlots;
+		/// class at each depth of the hierarchy, down to this one
+		mutable Array<const ScriptClass*> m_ancestors;
+		mutable ClassHeap m_classHeap;
 	};
 }
 
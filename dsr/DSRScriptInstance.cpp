@@ -4,11 +4,13 @@
 namespace dsr
 {
 	ScriptInstance::ScriptInstance(const ScriptClass* pClass)
-	: m_scriptClass(pClass), m_instanceData(0), m_handleOwner()
+	: m_scriptClass(pClass), m_instanceData(0), m_handleOwner(), m_collectable(false),
+		m_pPrevCollectable(0), m_pNextCollectable(0), m_collectMark(0), m_collectCount(0),
+		m_numFrames(0), m_heapSlot(InstanceHeap::NO_SLOT), m_classIdx(0)
 	{
 		DSR_ASSERT(pClass);
 
-		m_instanceData = new int32[m_scriptClass->GetNumData()];
+		ScriptManagerPtr()->GetInstanceHeap().Alloc(this);
 		for (uint32 i=0; i<m_scriptClass->GetNumData(); ++i)
 		{
 			if (m_scriptClass->GetDataTypePtr(i)->GetVMDataType().IsNative())
@@ -30,7 +32,14 @@ namespace dsr
 
 	ScriptInstance::~ScriptInstance()
 	{
-		ScriptManagerPtr()->Remove(this);
+		if (m_collectable)
+			ScriptManagerPtr()->GetCollector().Remove(this);
+		else
+			ScriptManagerPtr()->Remove(this);
+
+		//the frames of a suspended ScriptTask can outlive it
+		if (m_numFrames > 0)
+			ScriptManagerPtr()->GetCollector().ClearFrames(this);
 
 		for (uint32 i=0; i<m_scriptClass->GetNumData(); ++i)
 		{
@@ -40,5 +49,7 @@ namespace dsr
 				pHandle->RemoveReference();
 			}
 		}
+
+		ScriptManagerPtr()->GetInstanceHeap().Free(this);
 	}
 }
\ No newline at end of file
@@ -43,17 +43,38 @@ namespace dsr
 		}
 
 		const ScriptClass* GetScriptClassPtr() const { return m_scriptClass; }
+		/// moves when the InstanceHeap compacts, look it up again after
 		int32* GetInstanceData() { return m_instanceData; }
 		const int32* GetInstanceData() const { return m_instanceData; }
 		ScriptInstanceHandle* GetHandlePtr() { return m_handleOwner.GetHandlePtr(); }
+		/// created by a script, the Collector frees it
+		bool IsCollectable() const { return m_collectable; }
 
 	private:
+		friend class Collector;
+		friend class InstanceHeap;
+		friend class VMStack;
+
 		ScriptInstance();	//not implemented
 
 	protected:
 		const ScriptClass* m_scriptClass;
 		int32* m_instanceData;
 		HandleOwner<ScriptInstance> m_handleOwner;
+
+	private:
+		/// the Collector's list, and its state while it checks the instance
+		bool m_collectable;
+		ScriptInstance* m_pPrevCollectable;
+		ScriptInstance* m_pNextCollectable;
+		uint32 m_collectMark;
+		uint32 m_collectCount;
+		/// frames of the VMStacks running on it, the Collector keeps it while there are any
+		uint32 m_numFrames;
+		/// slot of the data in the InstanceHeap, InstanceHeap::NO_SLOT if it has its own
+		uint32 m_heapSlot;
+		/// index among the instances of the class, see ClassHeap
+		uint32 m_classIdx;
 	};
 }
 
@@ -1,6 +1,8 @@
 #include "DSRScriptManager.h"
 #include "DSRScriptInstance.h"
 #include "DSRScriptFactory.h"
+#include "DSRScriptClass.h"
+#include "DSRCompiledFunction.h"
 
 namespace dsr
 {
@@ -12,7 +14,8 @@ namespace dsr
 
 	ScriptManager::~ScriptManager()
 	{
-		//delete script instances
+		//delete the instances scripts created, then the host's
+		m_collector.FreeAll();
 		while (!m_scriptInsts.empty())
 		{
 			ScriptInstance* pInst = m_scriptInsts.front();
@@ -45,4 +48,77 @@ namespace dsr
 		if (m_pScriptManager)
 			delete m_pScriptManager;
 	}
-}
\ No newline at end of file
+
+	void ScriptManager::Add(ScriptClass* pClass)
+	{
+		m_scriptClasses.push_front(pClass);
+		m_classesByName.Set(m_atoms.Add(pClass->GetName()), pClass);
+		m_eventDispatcher.Reset();
+		for (List<const CompiledFunction*>::iterator it = m_compiledFncs.begin(); it != m_compiledFncs.end(); ++it)
+			Bind(pClass, **it);
+	}
+
+	void ScriptManager::Remove(ScriptClass* pClass)
+	{
+		m_scriptClasses.remove(pClass);
+		m_eventDispatcher.Reset();
+
+		//the map only adds, it's filled again from the classes left, the newest first
+		m_classesByName.Clear();
+		for (List<ScriptClass*>::iterator it = m_scriptClasses.begin(); it != m_scriptClasses.end(); ++it)
+		{
+			const Atom name = m_atoms.Add((*it)->GetName());
+			if (!m_classesByName.Find(name))
+				m_classesByName.Set(name, *it);
+		}
+	}
+
+	const ScriptClass* ScriptManager::GetScriptClassPtr(const char* name) const
+	{
+		return GetScriptClassPtr(m_atoms.Find(name));
+	}
+
+	const ScriptClass* ScriptManager::GetScriptClassPtr(Atom name) const
+	{
+		ScriptClass* const* ppClass = m_classesByName.Find(name);
+		return ppClass ? *ppClass : 0;
+	}
+
+	void ScriptManager::Add(const CompiledFunction* pFncs, uint32 numFncs)
+	{
+		for (uint32 i=0; i<numFncs; ++i)
+		{
+			m_compiledFncs.push_front(&pFncs[i]);
+			for (List<ScriptClass*>::iterator it = m_scriptClasses.begin(); it != m_scriptClasses.end(); ++it)
+				Bind(*it, pFncs[i]);
+		}
+	}
+
+	void ScriptManager::Bind(ScriptClass* pClass, const CompiledFunction& fnc)
+	{
+		if (stricmp(pClass->GetName(), fnc.className) == 0 && pClass->SetCompiledFunction(fnc.fnIdx, fnc.codeHash, fnc.pFnc))
+			*fnc.ppImpl = (const ScriptedFunctionImplementation*) pClass->GetFunctionImplementationPtr(fnc.fnIdx);
+	}
+
+	//------------------------------------------------------------------------------------
+	ScriptManager::InstanceIterator::InstanceIterator(const ScriptClass* pClass)
+	: m_pClass(pClass), m_classIt(ScriptManagerPtr()->m_scriptClasses.begin()), m_pClassHeap(0), m_idx(0)
+	{
+		DSR_ASSERT(pClass);
+		NextClass();
+	}
+
+	void ScriptManager::InstanceIterator::NextClass()
+	{
+		const List<ScriptClass*>::const_iterator endIt = ScriptManagerPtr()->m_scriptClasses.end();
+		m_pClassHeap = 0;
+		m_idx = 0;
+		while (m_classIt != endIt && !m_pClassHeap)
+		{
+			const ScriptClass* pClass = *m_classIt;
+			++m_classIt;
+			if (pClass->GetClassHeap().GetNumInstances() > 0 && pClass->IsA(m_pClass))
+				m_pClassHeap = &pClass->GetClassHeap();
+		}
+	}
+}
@@ -6,12 +6,19 @@
 #include "DSRMemory.h"
 #include "DSRClassUtils.h"
 #include "DSRList.h"
+#include "DSRVMStack.h"
+#include "DSRJit.h"
+#include "DSRAtomTable.h"
+#include "DSRCollector.h"
+#include "DSRInstanceHeap.h"
+#include "DSREventDispatcher.h"
 
 namespace dsr
 {
 	class ScriptInstance;
 	class ScriptFactory;
 	class ScriptClass;
+	class CompiledFunction;
 
 	class ScriptManager
 	{
@@ -19,6 +26,37 @@ namespace dsr
 	public:
 		DSR_NEWDELETE(ScriptManager)
 
+		/** Visits the instances of a class and of the classes derived from it, those of a
+			class one after the other, in the order of their ClassHeap.  No instance may be
+			created or deleted while it's in use.
+			for (ScriptManager::InstanceIterator it(pClass); !it.IsDone(); it.Next())
+				Update(it.Get()); */
+		class InstanceIterator
+		{
+		public:
+			DSR_NEWDELETE(InstanceIterator)
+
+			explicit InstanceIterator(const ScriptClass* pClass);
+
+			bool IsDone() const { return !m_pClassHeap; }
+			ScriptInstance* Get() const { return m_pClassHeap->GetInstancePtr(m_idx); }
+			void Next()
+			{
+				if (++m_idx == m_pClassHeap->GetNumInstances())
+					NextClass();
+			}
+
+		private:
+			/// to the first instance of the next class with any
+			void NextClass();
+
+		private:
+			const ScriptClass* m_pClass;
+			List<ScriptClass*>::const_iterator m_classIt;
+			const ClassHeap* m_pClassHeap;
+			uint32 m_idx;
+		};
+
 		static void Create();
 		static void Destroy();
 
@@ -28,16 +66,10 @@ namespace dsr
 		}
 
 		/** Add ScriptClass.  Should only get called by ScriptClass */
-		void Add(ScriptClass* pClass)
-		{
-			m_scriptClasses.push_front(pClass);
-		}
+		void Add(ScriptClass* pClass);
 
 		/** Remove ScriptClass.  Should only get called by ScriptClass */
-		void Remove(ScriptClass* pClass)
-		{
-			m_scriptClasses.remove(pClass);
-		}
+		void Remove(ScriptClass* pClass);
 
 		void Add(ScriptInstance* pInstance)
 		{
@@ -60,15 +92,63 @@ namespace dsr
 		}
 
 		const ScriptClass* GetScriptClassPtr(const char* name) const;
+		const ScriptClass* GetScriptClassPtr(Atom name) const;
+
+		/** Names of the classes, functions and data loaded, and of any others added.  Host
+			code looks names up here once, and then by atom. */
+		AtomTable& GetAtomTable() { return m_atoms; }
+		const AtomTable& GetAtomTable() const { return m_atoms; }
+
+		/** Registers C++ translations of scripted functions, generated by dsc.  Classes
+			loaded now or later run them in place of bytecode that matches.  The table has
+			to outlive the ScriptManager. */
+		void Add(const CompiledFunction* pFncs, uint32 numFncs);
+
+		/** Frees the instances scripts create.  Step it between calls into scripts. */
+		Collector& GetCollector() { return m_collector; }
+		const Collector& GetCollector() const { return m_collector; }
+
+		/** Keeps the instances by class, and their data once it's enabled.  Compact it
+			between calls into scripts. */
+		InstanceHeap& GetInstanceHeap() { return m_instanceHeap; }
+		const InstanceHeap& GetInstanceHeap() const { return m_instanceHeap; }
+
+		/** Broadcasts events to the instances with handlers for them.  Dispatch it between
+			calls into scripts. */
+		EventDispatcher& GetEventDispatcher() { return m_eventDispatcher; }
+		const EventDispatcher& GetEventDispatcher() const { return m_eventDispatcher; }
+
+		/** Frames and values of the running scripts.  Set the limits here before running any. */
+		VMStack& GetVMStack() { return m_vmStack; }
+		const VMStack& GetVMStack() const { return m_vmStack; }
+#if DSR_JIT
+		/** Compiles the scripts called most.  Its code lives as long as the ScriptManager. */
+		Jit& GetJit() { return m_jit; }
+		const Jit& GetJit() const { return m_jit; }
+#endif
 
 	private:
+		friend class InstanceIterator;
+		friend class EventDispatcher;
+
 		ScriptManager();
+		void Bind(ScriptClass* pClass, const CompiledFunction& fnc);
 
 	private:
 		static ScriptManager* m_pScriptManager;
 		List<ScriptClass*> m_scriptClasses;
 		List<ScriptInstance*> m_scriptInsts;
 		List<ScriptFactory*> m_scriptFactories;
+		List<const CompiledFunction*> m_compiledFncs;
+		AtomTable m_atoms;
+		AtomMap<ScriptClass*> m_classesByName;
+		InstanceHeap m_instanceHeap;
+		Collector m_collector;
+		EventDispatcher m_eventDispatcher;
+		VMStack m_vmStack;
+#if DSR_JIT
+		Jit m_jit;
+#endif
 	};
 }
 
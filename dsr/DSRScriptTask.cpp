@@ -0,0 +1,159 @@
+
+#include "DSRScriptTask.h"
+
+#include "DSRFunction.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptInstance.h"
+#include "DSRScheduler.h"
+#include "DSRScriptManager.h"
+
+namespace dsr
+{
+	ScriptTask* ScriptTask::m_pRunningTask = 0;
+
+	ScriptTask::ScriptTask(ScriptInstance* pInstance, uint32 fnIdx, const VMDataArray& args, int32 priority,
+		uint32 maxValues, uint32 maxFrames)
+	: m_cpInstance(0), m_pImpl(0), m_args(args), m_vmStack(maxValues, maxFrames), m_priority(priority),
+		m_state(STATE_READY), m_cancelled(false), m_pScheduler(0), m_pPrevTask(0), m_pNextTask(0),
+		m_wakeTime(0.0f), m_completed(false)
+	{
+		DSR_ASSERT(pInstance);
+		DSR_ASSERT(fnIdx < pInstance->GetScriptClassPtr()->GetNumFunctions());
+
+		m_cpInstance = pInstance->GetHandlePtr();
+		m_pImpl = pInstance->GetScriptClassPtr()->GetFunctionImplementationPtr(fnIdx);
+		DSR_ASSERT(m_pImpl->GetFunctionDefinitionPtr()->GetNumArgs() == args.size());
+
+		//only scripts can be suspended
+		DSR_ASSERT(!m_pImpl->IsNative());
+
+		//suspended frames keep the instances they run on
+		ScriptManagerPtr()->GetCollector().Add(&m_vmStack);
+	}
+
+	ScriptTask::~ScriptTask()
+	{
+		DSR_ASSERT(!m_pScheduler);
+		if (m_vmStack.GetNumFrames() > 0)
+			m_vmStack.Abort(0);
+		ScriptManagerPtr()->GetCollector().Remove(&m_vmStack);
+	}
+
+	void ScriptTask::Wait()
+	{
+		DSR_ASSERT(m_pRunningTask == this);
+		DSR_ASSERT(m_state == STATE_RUNNING);
+
+		m_vmStack.Suspend();
+		m_state = STATE_WAITING;
+	}
+
+	void ScriptTask::Sleep(float seconds)
+	{
+		DSR_ASSERT(m_pRunningTask == this);
+		DSR_ASSERT(m_state == STATE_RUNNING);
+		DSR_ASSERT(m_pScheduler);
+
+		m_vmStack.Suspend();
+		m_state = STATE_SLEEPING;
+		m_wakeTime = m_pScheduler->GetTime() + seconds;
+	}
+
+	void ScriptTask::Complete(const VMData& result)
+	{
+		if (IsFinished())
+			return;
+
+		DSR_ASSERT(m_state == STATE_WAITING);
+		m_completion = result;
+		m_completed = true;
+		m_state = STATE_READY;
+
+		//a task completed by the native function it runs gets queued once that returns
+		if (m_pRunningTask != this)
+		{
+			DSR_ASSERT(m_pScheduler);
+			m_pScheduler->Ready(this);
+		}
+	}
+
+	void ScriptTask::Cancel()
+	{
+		if (IsFinished())
+			return;
+
+		//a running task stops once the native function cancelling it returns
+		if (m_pRunningTask == this)
+		{
+			m_vmStack.Suspend();
+			m_cancelled = true;
+			return;
+		}
+
+		if (m_vmStack.GetNumFrames() > 0)
+			m_vmStack.Abort(0);
+		Finish(STATE_FAILED);
+	}
+
+	void ScriptTask::Run()
+	{
+		DSR_ASSERT(m_state == STATE_READY);
+		DSR_ASSERT(!m_pRunningTask);
+
+		//the host may have deleted an instance a suspended frame runs on, not just the task's
+		ScriptInstance* pInstance = m_cpInstance->get();
+		bool lost = !pInstance;
+		for (uint32 i=0; i<m_vmStack.GetNumFrames() && !lost; ++i)
+			lost = !m_vmStack.GetFrame(i).GetScriptInstancePtr();
+		if (lost)
+		{
+			//an instance is gone, the scripts can't continue
+			if (m_vmStack.GetNumFrames() > 0)
+				m_vmStack.Abort(0);
+			Finish(STATE_FAILED);
+			return;
+		}
+
+		m_state = STATE_RUNNING;
+		m_pRunningTask = this;
+		if (m_vmStack.IsSuspended())
+		{
+			if (m_completed)
+			{
+				m_vmStack.SetSuspendedResult(m_completion);
+				m_completion.Clear();
+				m_completed = false;
+			}
+			ScriptedFunctionImplementation::Resume(m_vmStack, &m_result);
+		}
+		else
+		{
+			static_cast<const ScriptedFunctionImplementation*>(m_pImpl)->Start(m_vmStack, pInstance, m_args, &m_result);
+		}
+		m_pRunningTask = 0;
+
+		if (m_cancelled)
+		{
+			if (m_vmStack.GetNumFrames() > 0)
+				m_vmStack.Abort(0);
+			Finish(STATE_FAILED);
+		}
+		else if (!m_vmStack.IsSuspended())
+		{
+			//the scripts returned, or overflowed the stack
+			Finish(m_vmStack.HasOverflowed() ? STATE_FAILED : STATE_DONE);
+		}
+	}
+
+	void ScriptTask::Finish(State state)
+	{
+		m_state = state;
+		m_args.clear();
+		m_completion.Clear();
+		m_completed = false;
+
+		//last, the scheduler may hold the final reference
+		if (m_pScheduler)
+			m_pScheduler->Remove(this);
+	}
+}
@@ -0,0 +1,106 @@
+
+#if !defined(DSR_SCRIPTTASK_H_)
+#define DSR_SCRIPTTASK_H_
+
+#include "DSRPlatform.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRCountedPtr.h"
+#include "DSRHandleTypedefs.h"
+#include "DSRVMData.h"
+#include "DSRVMStack.h"
+
+namespace dsr
+{
+	class ScriptInstance;
+	class FunctionImplementation;
+	class Scheduler;
+
+	//------------------------------------------------------------------------------------
+	/// Function of a script instance, run by a Scheduler.  Its scripts run on a VMStack of
+	/// their own, so a native function they call can suspend them: Wait until the host
+	/// hands over the native function's result with Complete, or Sleep for a while.
+	class ScriptTask : public CountedResource
+	{
+		DSR_NOCOPY(ScriptTask)
+	public:
+		DSR_NEWDELETE(ScriptTask)
+
+		enum State
+		{
+			STATE_READY,		///< runs with the scheduler's next update
+			STATE_RUNNING,
+			STATE_WAITING,		///< waits for Complete
+			STATE_SLEEPING,		///< waits for its wake time
+			STATE_DONE,			///< returned, GetResult has its return value
+			STATE_FAILED,		///< overflowed its stack, lost an instance it runs on or got cancelled
+		};
+
+		/// small, tasks are many and their scripts are shallow
+		enum
+		{
+			DEFAULT_MAX_VALUES = 128,
+			DEFAULT_MAX_FRAMES = 16,
+		};
+
+		/// Task running function fnIdx of pInstance with args.  Tasks with a higher priority
+		/// run first.
+		ScriptTask(ScriptInstance* pInstance, uint32 fnIdx, const VMDataArray& args, int32 priority = 0,
+			uint32 maxValues = DEFAULT_MAX_VALUES, uint32 maxFrames = DEFAULT_MAX_FRAMES);
+		virtual ~ScriptTask();
+
+		State GetState() const { return m_state; }
+		bool IsFinished() const { return m_state == STATE_DONE || m_state == STATE_FAILED; }
+		int32 GetPriority() const { return m_priority; }
+		const VMData& GetResult() const { DSR_ASSERT(m_state == STATE_DONE); return m_result; }
+		/// frames of the suspended scripts
+		const VMStack& GetVMStack() const { return m_vmStack; }
+
+		/// task whose scripts run now, 0 if none does.  For native functions to suspend it.
+		static ScriptTask* GetRunningPtr() { return m_pRunningTask; }
+
+		/// Suspends the running task once the native function calling this returns.  Keep a
+		/// ScriptTaskCPtr to it, to Complete it later.
+		void Wait();
+		/// Suspends the running task for seconds of its scheduler's time, once the native
+		/// function calling this returns.  Its scripts get the native function's result.
+		void Sleep(float seconds);
+		/// Hands a waiting task the result of the native function it waits on, it runs with
+		/// the scheduler's next update.  Ignored if the task was cancelled meanwhile.
+		void Complete(const VMData& result);
+		/// drops the task's frames, it fails
+		void Cancel();
+
+	private:
+		friend class Scheduler;
+
+		/// runs the task until it finishes or suspends
+		void Run();
+		void Finish(State state);
+
+	private:
+		ScriptInstanceHandleCPtr m_cpInstance;
+		const FunctionImplementation* m_pImpl;
+		VMDataArray m_args;
+		VMStack m_vmStack;
+		VMData m_result;
+		int32 m_priority;
+		State m_state;
+		bool m_cancelled;
+		/// scheduler running the task, and its neighbours among the scheduler's tasks
+		Scheduler* m_pScheduler;
+		ScriptTask* m_pPrevTask;
+		ScriptTask* m_pNextTask;
+		/// scheduler time a sleeping task wakes at
+		float m_wakeTime;
+		/// Complete's result, for the suspended scripts
+		VMData m_completion;
+		bool m_completed;
+
+		static ScriptTask* m_pRunningTask;
+	};
+
+	typedef CountedPtr<ScriptTask> ScriptTaskCPtr;
+}
+
+#endif
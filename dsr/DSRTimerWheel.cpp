@@ -0,0 +1,201 @@
+#include "DSRTimerWheel.h"
+
+#include "DSRFunction.h"
+#include "DSRScriptClass.h"
+#include "DSRScriptInstance.h"
+
+namespace dsr
+{
+	ScriptTimer::ScriptTimer(ScriptInstance* pInstance, uint32 fnIdx, const VMDataArray& args, uint32 period)
+	: m_cpInstance(0), m_pImpl(0), m_args(args), m_period(period), m_due(0), m_pWheel(0), m_ppSlot(0),
+		m_pPrev(0), m_pNext(0)
+	{
+		DSR_ASSERT(pInstance);
+		DSR_ASSERT(fnIdx < pInstance->GetScriptClassPtr()->GetNumFunctions());
+
+		m_cpInstance = pInstance->GetHandlePtr();
+		m_pImpl = pInstance->GetScriptClassPtr()->GetFunctionImplementationPtr(fnIdx);
+		DSR_ASSERT(m_pImpl->GetFunctionDefinitionPtr()->GetNumArgs() == args.size());
+	}
+
+	ScriptTimer::~ScriptTimer()
+	{
+		DSR_ASSERT(!m_pWheel);
+	}
+
+	void ScriptTimer::Cancel()
+	{
+		if (m_pWheel)
+			m_pWheel->Remove(this);
+	}
+
+	//-------------------------------------------------------------------------
+	TimerWheel::TimerWheel()
+	: m_slots(NUM_LEVELS * LEVEL_SLOTS), m_tick(0), m_numTimers(0), m_numDue(0)
+	{
+	}
+
+	TimerWheel::~TimerWheel()
+	{
+		DSR_ASSERT(m_numDue == 0);
+		for (uint32 i=0; i<m_slots.size(); ++i)
+		{
+			while (m_slots[i])
+				m_slots[i]->Cancel();
+		}
+	}
+
+	void TimerWheel::Add(ScriptTimer* pTimer, uint32 delay)
+	{
+		DSR_ASSERT(pTimer);
+		DSR_ASSERT(!pTimer->m_pWheel);
+
+		//the wheel keeps the timer until it's done
+		pTimer->AddReference();
+		pTimer->m_pWheel = this;
+		pTimer->m_due = m_tick + (delay > 0 ? delay : 1);
+		++m_numTimers;
+		Insert(pTimer);
+	}
+
+	uint32 TimerWheel::Advance(uint32 numTicks)
+	{
+		//timers can't advance the wheel calling them
+		DSR_ASSERT(m_numDue == 0);
+
+		uint32 numCalls = 0;
+		VMData result;
+		for (uint32 t=0; t<numTicks; ++t)
+		{
+			++m_tick;
+
+			//a level turns over with the ones below it, the highest first so its timers
+			//reach the first level
+			uint32 numLevels = 1;
+			while (numLevels < NUM_LEVELS && (m_tick & ((1u << (LEVEL_BITS * numLevels)) - 1)) == 0)
+				++numLevels;
+			for (uint32 level=numLevels - 1; level > 0; --level)
+				Cascade(level);
+
+			TakeDue(&m_slots[m_tick & (LEVEL_SLOTS - 1)]);
+			for (uint32 i=0; i<m_numDue; ++i)
+			{
+				//a timer cancelled meanwhile, or cancelled and added again, isn't due anymore
+				ScriptTimer* pTimer = m_due[i];
+				if (pTimer->m_pWheel == this && !pTimer->m_ppSlot)
+				{
+					ScriptInstance* pInstance = pTimer->m_cpInstance->get();
+					if (pInstance)
+					{
+						const VMDataArray& args = pTimer->m_args;
+						pTimer->m_pImpl->CallSpan(pInstance, args.empty() ? 0 : &args[0], args.size(), &result);
+						++numCalls;
+					}
+
+					//again after its period, unless its function cancelled it or added it again
+					if (pTimer->m_pWheel == this && !pTimer->m_ppSlot)
+					{
+						if (pInstance && pTimer->m_period > 0)
+						{
+							pTimer->m_due += pTimer->m_period;
+							pTimer->AddReference();
+							Insert(pTimer);
+						}
+						else
+						{
+							pTimer->m_pWheel = 0;
+							--m_numTimers;
+						}
+					}
+				}
+
+				//the reference the slot had
+				pTimer->RemoveReference();
+			}
+			m_numDue = 0;
+		}
+
+		return numCalls;
+	}
+
+	void TimerWheel::Insert(ScriptTimer* pTimer)
+	{
+		//0 for the slot the wheel is at, while a level turns over
+		const uint32 delta = pTimer->m_due - m_tick;
+		uint32 level = 0;
+		while (level + 1 < NUM_LEVELS && delta >= (1u << (LEVEL_BITS * (level + 1))))
+			++level;
+
+		const uint32 slot = (pTimer->m_due >> (LEVEL_BITS * level)) & (LEVEL_SLOTS - 1);
+		ScriptTimer** ppSlot = &m_slots[level * LEVEL_SLOTS + slot];
+		pTimer->m_ppSlot = ppSlot;
+		pTimer->m_pPrev = 0;
+		pTimer->m_pNext = *ppSlot;
+		if (*ppSlot)
+			(*ppSlot)->m_pPrev = pTimer;
+		*ppSlot = pTimer;
+	}
+
+	void TimerWheel::Unlink(ScriptTimer* pTimer)
+	{
+		DSR_ASSERT(pTimer->m_ppSlot);
+
+		if (pTimer->m_pPrev)
+			pTimer->m_pPrev->m_pNext = pTimer->m_pNext;
+		else
+			*pTimer->m_ppSlot = pTimer->m_pNext;
+		if (pTimer->m_pNext)
+			pTimer->m_pNext->m_pPrev = pTimer->m_pPrev;
+
+		pTimer->m_ppSlot = 0;
+		pTimer->m_pPrev = 0;
+		pTimer->m_pNext = 0;
+	}
+
+	void TimerWheel::Cascade(uint32 level)
+	{
+		ScriptTimer** ppSlot = &m_slots[level * LEVEL_SLOTS + ((m_tick >> (LEVEL_BITS * level)) & (LEVEL_SLOTS - 1))];
+		ScriptTimer* pTimer = *ppSlot;
+		*ppSlot = 0;
+		while (pTimer)
+		{
+			ScriptTimer* pNext = pTimer->m_pNext;
+			Insert(pTimer);
+			pTimer = pNext;
+		}
+	}
+
+	void TimerWheel::TakeDue(ScriptTimer** ppSlot)
+	{
+		while (*ppSlot)
+		{
+			//grow by doubling
+			if (m_numDue == m_due.size())
+			{
+				Array<ScriptTimer*> due(m_numDue > 0 ? m_numDue * 2 : 64);
+				for (uint32 i=0; i<m_numDue; ++i)
+					due[i] = m_due[i];
+				m_due = due;
+			}
+
+			ScriptTimer* pTimer = *ppSlot;
+			Unlink(pTimer);
+			m_due[m_numDue++] = pTimer;
+		}
+	}
+
+	void TimerWheel::Remove(ScriptTimer* pTimer)
+	{
+		DSR_ASSERT(pTimer->m_pWheel == this);
+
+		pTimer->m_pWheel = 0;
+		--m_numTimers;
+
+		//Advance drops the reference of one that's due
+		if (pTimer->m_ppSlot)
+		{
+			Unlink(pTimer);
+			pTimer->RemoveReference();
+		}
+	}
+}
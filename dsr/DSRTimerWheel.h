@@ -0,0 +1,118 @@
+
+#if !defined(DSR_TIMERWHEEL_H_)
+#define DSR_TIMERWHEEL_H_
+
+#include "DSRPlatform.h"
+#include "DSRClassUtils.h"
+#include "DSRMemory.h"
+#include "DSRArray.h"
+#include "DSRCountedPtr.h"
+#include "DSRHandleTypedefs.h"
+#include "DSRVMData.h"
+
+namespace dsr
+{
+	class ScriptInstance;
+	class FunctionImplementation;
+	class TimerWheel;
+
+	//------------------------------------------------------------------------------------
+	/// Call of a function of a script instance, after a delay and then every period ticks
+	/// of a TimerWheel.  Keep a ScriptTimerCPtr to it, to Cancel it later.
+	class ScriptTimer : public CountedResource
+	{
+		DSR_NOCOPY(ScriptTimer)
+	public:
+		DSR_NEWDELETE(ScriptTimer)
+
+		/// Timer calling function fnIdx of pInstance with args, once if period is 0
+		ScriptTimer(ScriptInstance* pInstance, uint32 fnIdx, const VMDataArray& args, uint32 period = 0);
+		virtual ~ScriptTimer();
+
+		bool IsScheduled() const { return m_pWheel != 0; }
+		uint32 GetPeriod() const { return m_period; }
+		/// tick of the wheel the timer calls its function at next
+		uint32 GetDueTick() const { DSR_ASSERT(m_pWheel); return m_due; }
+
+		/// takes the timer off its wheel, a timer cancelled by its function isn't called again
+		void Cancel();
+
+	private:
+		friend class TimerWheel;
+
+	private:
+		ScriptInstanceHandleCPtr m_cpInstance;
+		const FunctionImplementation* m_pImpl;
+		VMDataArray m_args;
+		uint32 m_period;
+		uint32 m_due;
+		/// wheel the timer is on, and the list of the slot it's in, 0 while it's due
+		TimerWheel* m_pWheel;
+		ScriptTimer** m_ppSlot;
+		ScriptTimer* m_pPrev;
+		ScriptTimer* m_pNext;
+	};
+
+	typedef CountedPtr<ScriptTimer> ScriptTimerCPtr;
+
+	//------------------------------------------------------------------------------------
+	/// Calls the script functions that are due, instead of the host calling every instance
+	/// each frame.  Timers are kept in LEVEL_SLOTS slots per level, by due tick: the first
+	/// level has a slot per tick, each next one a slot per full turn of the one below.
+	/// Adding and cancelling a timer is constant time.  Each tick the timers of the next
+	/// slot up are spread over the slots below when a level turns over, then the timers of
+	/// the first level's slot are called, in no particular order.  An update costs the
+	/// number of timers due, not the number of timers.
+	///
+	/// Like the Scheduler, it belongs to the thread that runs scripts, the host advances it
+	/// once per tick.  Timers whose instance is gone are dropped.
+	class TimerWheel
+	{
+		DSR_NOCOPY(TimerWheel)
+	public:
+		DSR_NEWDELETE(TimerWheel)
+
+		enum
+		{
+			LEVEL_BITS = 8,
+			LEVEL_SLOTS = 1 << LEVEL_BITS,
+			/// enough for any uint32 delay
+			NUM_LEVELS = 4,
+		};
+
+		TimerWheel();
+		/// cancels the timers left
+		~TimerWheel();
+
+		/// The timer's function is called delay ticks from now, at least one.  The wheel
+		/// keeps it until it's called for the last time or cancelled.
+		void Add(ScriptTimer* pTimer, uint32 delay);
+		/// Moves on by numTicks ticks, calling the timers due.  Returns the number of calls.
+		uint32 Advance(uint32 numTicks = 1);
+
+		uint32 GetTick() const { return m_tick; }
+		uint32 GetNumTimers() const { return m_numTimers; }
+
+	private:
+		friend class ScriptTimer;
+
+		/// into the slot of its due tick, at the lowest level that covers it
+		void Insert(ScriptTimer* pTimer);
+		void Unlink(ScriptTimer* pTimer);
+		void Cascade(uint32 level);
+		/// unlinks the timers of the slot into m_due
+		void TakeDue(ScriptTimer** ppSlot);
+		void Remove(ScriptTimer* pTimer);
+
+	private:
+		/// first timer of each slot, the first level's slots first
+		Array<ScriptTimer*> m_slots;
+		uint32 m_tick;
+		uint32 m_numTimers;
+		/// timers being called this tick
+		Array<ScriptTimer*> m_due;
+		uint32 m_numDue;
+	};
+}
+
+#endif
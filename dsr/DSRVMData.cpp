@@ -23,7 +23,7 @@ namespace dsr
 		}
 		else
 		{
-			m_val.intVal = m_val.intVal;
+			m_val.intVal = rhs.m_val.intVal;
 		}
 
 		m_type = rhs.m_type;
@@ -43,7 +43,7 @@ namespace dsr
 		}
 		else
 		{
-			m_val.intVal = m_val.intVal;
+			m_val.intVal = rhs.m_val.intVal;
 		}
 
 		m_type = rhs.m_type;
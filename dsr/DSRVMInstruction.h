@@ -91,12 +91,33 @@ namespace dsr
 		VMI_GTIF,					//I > F
 		VMI_AND,					//B && B
 		VMI_OR,						//B || B
-		VMI_NEW						//00xxxxxx create instance of of type newstring[x]
+		VMI_NEW,					//00xxxxxx create instance of of type newstring[x]
+		VMI_CALLF_SELF_D,			// <Y> call function directcall[Y] in script self, bound at compile time
+		VMI_CALLF_PUSHED_D,			// <Y> call function directcall[Y] in script that is on top of the stack, bound at compile time
+		VMI_TAILCALLF_SELF_G,		// <Y> like VMI_CALLF_SELF_G, in place of the running function, whose result is the call's
+		VMI_TAILCALLF_SUPER_G,		// <Y> like VMI_CALLF_SUPER_G, in place of the running function, whose result is the call's
+		VMI_TAILCALLF_SELF_D,		// <Y> like VMI_CALLF_SELF_D, in place of the running function, whose result is the call's
+		VMI_ISN,					//00xxxxxx pop native type, push whether it is an instance of type newstring[x]
+		VMI_CASTN,					//00xxxxxx native type on top of the stack becomes of type newstring[x], null if it isn't one
 	};
 	
 	typedef uint8 VMInstruction;
 	typedef uint32 VMBytecode;
 	typedef Array<VMBytecode> VMCodeBlock;
+
+	/// FNV-1a over the words of a function's bytecode and types.  Tells whether a C++
+	/// translation of the function, see CompiledFunction, still matches it.
+	static const uint32 VMCODEHASH_SEED = 2166136261u;
+
+	DSR_INLINE uint32 HashVMCode(uint32 hash, uint32 word)
+	{
+		for (uint32 i=0; i<4; ++i)
+		{
+			hash ^= (word >> (i * 8)) & 0xFF;
+			hash *= 16777619;
+		}
+		return hash;
+	}
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+
+#include "DSRVMStack.h"
+#include "DSRScriptInstance.h"
+
+namespace dsr
+{
+	VMStack::VMStack()
+	: m_values(DEFAULT_MAX_VALUES), m_frames(DEFAULT_MAX_FRAMES), m_numValues(1), m_numFrames(0), m_overflowed(false), m_suspended(false),
+		m_translatedDepth(0), m_pPrevStack(0), m_pNextStack(0)
+	{
+		//value 0 isn't used, so that an empty operand stack always has a value below it
+	}
+
+	VMStack::VMStack(uint32 maxValues, uint32 maxFrames)
+	: m_values(maxValues), m_frames(maxFrames), m_numValues(1), m_numFrames(0), m_overflowed(false), m_suspended(false),
+		m_translatedDepth(0), m_pPrevStack(0), m_pNextStack(0)
+	{
+		DSR_ASSERT(maxValues > 0 && maxFrames > 0);
+	}
+
+	void VMStack::SetLimits(uint32 maxValues, uint32 maxFrames)
+	{
+		DSR_ASSERT(m_numFrames == 0);
+		DSR_ASSERT(maxValues > 0 && maxFrames > 0);
+		m_values.resize(maxValues);
+		m_frames.resize(maxFrames);
+	}
+
+	VMFrame* VMStack::PushFrame(const ScriptedFunctionImplementation* pImpl, ScriptInstance* pInstance, uint32 base, uint32 numData, uint32 size)
+	{
+		DSR_ASSERT(pImpl);
+		DSR_ASSERT(base > 0 && base <= m_numValues);
+
+		if (m_numFrames == m_frames.size() || base + size > m_values.size())
+		{
+			m_overflowed = true;
+			return 0;
+		}
+
+		VMFrame& frame = m_frames[m_numFrames];
+		frame.m_pImpl = pImpl;
+		frame.m_pInstance = pInstance;
+		frame.m_base = base;
+		frame.m_size = size;
+		frame.m_top = base + numData - 1;
+		frame.m_pc = 0;
+
+		//the caller's values stay reserved, even where the callee doesn't reach
+		frame.m_end = base + size;
+		if (m_numFrames > 0 && m_frames[m_numFrames - 1].m_end > frame.m_end)
+			frame.m_end = m_frames[m_numFrames - 1].m_end;
+
+		++m_numFrames;
+		m_numValues = frame.m_end;
+		if (pInstance)
+			++pInstance->m_numFrames;
+		return &frame;
+	}
+
+	VMFrame* VMStack::ReplaceFrame(const ScriptedFunctionImplementation* pImpl, uint32 numData, uint32 size)
+	{
+		VMFrame& frame = GetTopFrame();
+		if (frame.m_base + size > m_values.size())
+		{
+			m_overflowed = true;
+			return 0;
+		}
+
+		//a tail call runs on the same instance, its count stays
+		frame.m_pImpl = pImpl;
+		frame.m_size = size;
+		frame.m_top = frame.m_base + numData - 1;
+		frame.m_pc = 0;
+
+		frame.m_end = frame.m_base + size;
+		if (m_numFrames > 1 && m_frames[m_numFrames - 2].m_end > frame.m_end)
+			frame.m_end = m_frames[m_numFrames - 2].m_end;
+
+		m_numValues = frame.m_end;
+		return &frame;
+	}
+
+	void VMStack::PopFrame()
+	{
+		VMFrame& frame = GetTopFrame();
+		for (uint32 i=frame.m_base; i<frame.m_base + frame.m_size; ++i)
+			m_values[i].Clear();
+		if (frame.m_pInstance)
+			--frame.m_pInstance->m_numFrames;
+
+		--m_numFrames;
+		m_numValues = (m_numFrames > 0) ? m_frames[m_numFrames - 1].m_end : 1;
+	}
+
+	void VMStack::Abort(uint32 idx)
+	{
+		DSR_ASSERT(idx < m_numFrames);
+		while (m_numFrames > idx)
+			PopFrame();
+		m_suspended = false;
+	}
+
+	void VMStack::SetSuspendedResult(const VMData& result)
+	{
+		DSR_ASSERT(m_suspended);
+		m_values[GetTopFrame().m_top] = result;
+	}
+
+	void VMStack::ClearInstance(ScriptInstance* pInstance)
+	{
+		for (uint32 i=0; i<m_numFrames; ++i)
+		{
+			if (m_frames[i].m_pInstance == pInstance)
+			{
+				m_frames[i].m_pInstance = 0;
+				--pInstance->m_numFrames;
+			}
+		}
+	}
+}
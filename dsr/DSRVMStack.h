@@ -0,0 +1,137 @@
+
+#if !defined(DSR_VMSTACK_H_)
+#define DSR_VMSTACK_H_
+
+#include "DSRPlatform.h"
+#include "DSRArray.h"
+#include "DSRVMData.h"
+
+namespace dsr
+{
+	class ScriptInstance;
+	class FunctionImplementation;
+	class ScriptedFunctionImplementation;
+	class ScriptTask;
+
+	//------------------------------------------------------------------------------------
+	/// Call frame of a scripted function.  The frame's values are its arguments, then its
+	/// locals, then its operand stack.
+	class VMFrame
+	{
+	public:
+		DSR_NEWDELETE(VMFrame)
+
+		VMFrame() : m_pImpl(0), m_pInstance(0), m_base(0), m_size(0), m_end(0), m_top(0), m_pc(0) {}
+
+		const ScriptedFunctionImplementation* GetFunctionImplementationPtr() const { return m_pImpl; }
+		ScriptInstance* GetScriptInstancePtr() const { return m_pInstance; }
+		/// index of the first argument on the VMStack, and of the return value once the frame is done
+		uint32 GetBase() const { return m_base; }
+		/// index past the values the frame and the frames below it use
+		uint32 GetEnd() const { return m_end; }
+		/// code position the frame continues at, once the call it waits on returns
+		uint32 GetPC() const { return m_pc; }
+
+	private:
+		friend class VMStack;
+		friend class ScriptedFunctionImplementation;
+
+		const ScriptedFunctionImplementation* m_pImpl;
+		ScriptInstance* m_pInstance;
+		uint32 m_base;
+		uint32 m_size;
+		uint32 m_end;
+		/// index of the top of the operand stack, while the frame waits
+		uint32 m_top;
+		uint32 m_pc;
+	};
+
+	//------------------------------------------------------------------------------------
+	/// Values and call frames of the running scripted functions.  Script to script calls
+	/// push a frame instead of recursing, so the call depth is bounded by the limits set
+	/// here and not by the native stack.  Native functions and the host calling into
+	/// scripts are the only native calls, besides translated functions nested up to
+	/// MAX_TRANSLATED_DEPTH, past which their bytecode runs.  A ScriptTask runs its
+	/// scripts on a stack of its own, which keeps their frames while they are suspended.
+	class VMStack
+	{
+		DSR_NOCOPY(VMStack)
+	public:
+		DSR_NEWDELETE(VMStack)
+
+		enum
+		{
+			DEFAULT_MAX_VALUES = 16384,
+			DEFAULT_MAX_FRAMES = 1024,
+			/// translated functions running nested on the native stack
+			MAX_TRANSLATED_DEPTH = 128,
+		};
+
+		VMStack();
+		VMStack(uint32 maxValues, uint32 maxFrames);
+
+		/// A call that doesn't fit aborts the functions the host called, and sets the
+		/// overflow flag.  Can't be changed while scripts run.
+		void SetLimits(uint32 maxValues, uint32 maxFrames);
+		uint32 GetMaxValues() const { return m_values.size(); }
+		uint32 GetMaxFrames() const { return m_frames.size(); }
+
+		/// frames of the running functions, the outermost first
+		uint32 GetNumFrames() const { return m_numFrames; }
+		const VMFrame& GetFrame(uint32 idx) const { DSR_ASSERT(idx < m_numFrames); return m_frames[idx]; }
+		uint32 GetNumValues() const { return m_numValues; }
+		const VMData& GetValue(uint32 idx) const { DSR_ASSERT(idx < m_numValues); return m_values[idx]; }
+
+		bool HasOverflowed() const { return m_overflowed; }
+		void ClearOverflow() { m_overflowed = false; }
+
+		/// Set when a native function suspended the scripts, they continue with
+		/// ScriptedFunctionImplementation::Resume.  The native function's result is on top
+		/// of the suspended frame's operand stack.
+		bool IsSuspended() const { return m_suspended; }
+
+	private:
+		friend class ScriptedFunctionImplementation;
+		friend class ScriptTask;
+		friend class Jit;
+		friend class Collector;
+		friend bool CallCompiled(const FunctionImplementation* pCallee, ScriptInstance* pInstance, VMDataArray& args, VMData* retVal);
+
+		/// Reserves size values from base for a new frame, 0 if they don't fit.  The operand
+		/// stack starts after the first numData values, the arguments and locals.  The
+		/// frames running on an instance are counted in it, see Collector.
+		VMFrame* PushFrame(const ScriptedFunctionImplementation* pImpl, ScriptInstance* pInstance, uint32 base, uint32 numData, uint32 size);
+		/// same for the frame on top, which a tail call replaces
+		VMFrame* ReplaceFrame(const ScriptedFunctionImplementation* pImpl, uint32 numData, uint32 size);
+		/// clears the values of the frame on top
+		void PopFrame();
+		/// pops every frame down to and including frame idx, after an overflow
+		void Abort(uint32 idx);
+		VMFrame& GetTopFrame() { DSR_ASSERT(m_numFrames > 0); return m_frames[m_numFrames - 1]; }
+		VMData* GetValuePtr(uint32 idx) { return &m_values[idx]; }
+		/// suspends the scripts once the native function they run returns
+		void Suspend() { DSR_ASSERT(m_numFrames > 0); m_suspended = true; }
+		/// replaces the native function's result the suspended scripts continue with
+		void SetSuspendedResult(const VMData& result);
+		/// the frames running on pInstance run on none anymore, it's being deleted
+		void ClearInstance(ScriptInstance* pInstance);
+		/// false while translated functions are nested MAX_TRANSLATED_DEPTH deep
+		bool CanRunTranslated() const { return m_translatedDepth < MAX_TRANSLATED_DEPTH; }
+
+	private:
+		typedef Array<VMFrame> VMFrameArray;
+
+		VMDataArray m_values;
+		VMFrameArray m_frames;
+		uint32 m_numValues;
+		uint32 m_numFrames;
+		bool m_overflowed;
+		bool m_suspended;
+		uint32 m_translatedDepth;
+		/// the Collector's list of stacks
+		VMStack* m_pPrevStack;
+		VMStack* m_pNextStack;
+	};
+}
+
+#endif